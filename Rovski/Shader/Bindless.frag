@@ -0,0 +1,15 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 1) in vec2 fragCoord;
+layout(location = 2) flat in uint fragTexture;
+layout(location = 0) out vec4 outColor;
+
+// every texture by its index, slots no draw references may be left unwritten
+layout(set = 1, binding = 0) uniform texture2D textures[];
+layout(set = 1, binding = 1) uniform sampler textureSampler;
+
+void main(){
+    // one multi draw mixes textures, so the index can differ within a subgroup
+    outColor = texture(sampler2D(textures[nonuniformEXT(fragTexture)], textureSampler), fragCoord);
+}
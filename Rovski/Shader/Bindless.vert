@@ -0,0 +1,29 @@
+#version 450
+layout(location = 0) in vec3 inPosition;
+layout(location = 2) in vec2 inTexCoord;
+
+// view and projection only, the model comes with the draw
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+// the whole per draw state: no descriptor set changes between draws
+layout(push_constant) uniform Draw {
+    mat4 model;
+    uint texture;
+    uint objectBuffer;
+    uint textureBuffer;
+} draw;
+
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragTexture;
+// BindlessPrepass.vert computes the same position, EQUAL depth tests need both bit identical
+invariant gl_Position;
+
+void main(){
+    gl_Position = ubo.proj * ubo.view * draw.model * vec4(inPosition, 1.0 );
+    fragTexCoord = inTexCoord;
+    fragTexture = draw.texture;
+}
@@ -0,0 +1,48 @@
+#version 450
+layout(location = 0) in vec3 inPosition;
+layout(location = 2) in vec2 inTexCoord;
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+layout(push_constant) uniform Draw {
+    mat4 model;
+    uint texture;
+    uint objectBuffer;
+    uint textureBuffer;
+} draw;
+
+// must match GpuObject in Rovski.cpp
+struct Object {
+    mat4 model;
+    vec4 sphere;
+    vec4 extent;
+    uint indexCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint batch;
+};
+
+// the storage buffer table, read as objects and as one texture index per object
+layout(std430, set = 1, binding = 2) readonly buffer Objects {
+    Object objects[];
+} objectBuffers[];
+layout(std430, set = 1, binding = 2) readonly buffer Indices {
+    uint indices[];
+} indexBuffers[];
+
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragTexture;
+// BindlessIndirectPrepass.vert computes the same position, EQUAL depth tests need both bit identical
+invariant gl_Position;
+
+void main(){
+    // the cull shader set firstInstance to the object index
+    mat4 model = objectBuffers[draw.objectBuffer].objects[gl_InstanceIndex].model;
+    gl_Position = ubo.proj * ubo.view * model * vec4(inPosition, 1.0 );
+    fragTexCoord = inTexCoord;
+    fragTexture = indexBuffers[draw.textureBuffer].indices[gl_InstanceIndex];
+}
@@ -0,0 +1,37 @@
+#version 450
+layout(location = 0) in vec3 inPosition;
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+layout(push_constant) uniform Draw {
+    mat4 model;
+    uint texture;
+    uint objectBuffer;
+    uint textureBuffer;
+} draw;
+
+struct Object {
+    mat4 model;
+    vec4 sphere;
+    vec4 extent;
+    uint indexCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint batch;
+};
+
+layout(std430, set = 1, binding = 2) readonly buffer Objects {
+    Object objects[];
+} objectBuffers[];
+
+// must match BindlessIndirect.vert bit for bit, the main pass tests depth with EQUAL
+invariant gl_Position;
+
+void main(){
+    mat4 model = objectBuffers[draw.objectBuffer].objects[gl_InstanceIndex].model;
+    gl_Position = ubo.proj * ubo.view * model * vec4(inPosition, 1.0 );
+}
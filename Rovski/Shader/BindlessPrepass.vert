@@ -0,0 +1,22 @@
+#version 450
+layout(location = 0) in vec3 inPosition;
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+layout(push_constant) uniform Draw {
+    mat4 model;
+    uint texture;
+    uint objectBuffer;
+    uint textureBuffer;
+} draw;
+
+// must match Bindless.vert bit for bit, the main pass tests depth with EQUAL
+invariant gl_Position;
+
+void main(){
+    gl_Position = ubo.proj * ubo.view * draw.model * vec4(inPosition, 1.0 );
+}
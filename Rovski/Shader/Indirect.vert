@@ -0,0 +1,37 @@
+#version 450
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inTexCoord;
+
+// model is unused, every draw's matrix comes from the object buffer
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+struct Object {
+    mat4 model;
+    vec4 sphere;
+    vec4 extent;
+    uint indexCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint batch;
+};
+
+// Cull.comp writes the object index as the draw's firstInstance
+layout(std430, set = 1, binding = 0) readonly buffer Objects {
+    Object objects[];
+};
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+// IndirectPrepass.vert computes the same position, EQUAL depth tests need both bit identical
+invariant gl_Position;
+
+void main(){
+    gl_Position = ubo.proj * ubo.view * objects[gl_InstanceIndex].model * vec4(inPosition, 1.0 );
+    fragColor = inColor;
+    fragTexCoord = inTexCoord;
+}
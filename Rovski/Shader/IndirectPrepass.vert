@@ -0,0 +1,29 @@
+#version 450
+layout(location = 0) in vec3 inPosition;
+
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+struct Object {
+    mat4 model;
+    vec4 sphere;
+    vec4 extent;
+    uint indexCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint batch;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer Objects {
+    Object objects[];
+};
+
+// must match Indirect.vert bit for bit, the main pass tests depth with EQUAL
+invariant gl_Position;
+
+void main(){
+    gl_Position = ubo.proj * ubo.view * objects[gl_InstanceIndex].model * vec4(inPosition, 1.0 );
+}
@@ -0,0 +1,11 @@
+#version 450
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragCoord;
+layout(location = 0) out vec4 outColor;
+layout(binding = 1) uniform sampler2D texSampler;
+
+// the instance color tints the texture
+void main(){
+    outColor = texture(texSampler, fragCoord) * vec4(fragColor, 1.0);
+}
@@ -0,0 +1,25 @@
+#version 450
+// Vertex at binding 0 and Instance at binding 1, the instance locations continue after the vertex ones and
+// the transform takes one per column
+layout(location = 0) in vec3 inPosition;
+layout(location = 2) in vec2 inTexCoord;
+layout(location = 3) in mat4 inModel;
+layout(location = 7) in vec4 inInstanceColor;
+
+// model is unused, every instance brings its own
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+// InstancedPrepass.vert computes the same position, EQUAL depth tests need both bit identical
+invariant gl_Position;
+
+void main(){
+    gl_Position = ubo.proj * ubo.view * inModel * vec4(inPosition, 1.0 );
+    fragColor = inInstanceColor.rgb;
+    fragTexCoord = inTexCoord;
+}
@@ -0,0 +1,15 @@
+#version 450
+layout(location = 0) in vec3 inPosition;
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+// must match Shader.vert bit for bit, the main pass tests depth with EQUAL
+invariant gl_Position;
+
+void main(){
+    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0 );
+}
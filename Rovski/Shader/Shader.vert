@@ -11,6 +11,8 @@ layout(binding = 0) uniform UniformBufferObject {
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
+// the depth prepass computes the same position, EQUAL depth tests need both bit identical
+invariant gl_Position;
 
 void main(){
     gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0 );
@@ -8,3 +8,16 @@
 
 glslc Shader.vert -o vert.spv
 glslc Shader.frag -o frag.spv
+glslc Prepass.vert -o prepass.spv
+glslc Indirect.vert -o indirect.spv
+glslc IndirectPrepass.vert -o indirect_prepass.spv
+glslc Cull.comp -o cull.spv
+glslc DepthReduce.comp -o depth_reduce.spv
+glslc Instanced.vert -o instanced.spv
+glslc InstancedPrepass.vert -o instanced_prepass.spv
+glslc Instanced.frag -o instanced_frag.spv
+glslc Bindless.vert -o bindless.spv
+glslc BindlessPrepass.vert -o bindless_prepass.spv
+glslc Bindless.frag -o bindless_frag.spv
+glslc BindlessIndirect.vert -o bindless_indirect.spv
+glslc BindlessIndirectPrepass.vert -o bindless_indirect_prepass.spv
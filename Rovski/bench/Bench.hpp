@@ -0,0 +1,53 @@
+//
+//  Bench.hpp
+//  Rovski
+//
+
+#ifndef ROVSKI_BENCH_HPP
+#define ROVSKI_BENCH_HPP
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "Rovski.hpp"
+
+struct SampleSummary {
+    double avg = 0;
+    double min = 0;
+    double max = 0;
+    double p50 = 0;
+    double p95 = 0;
+    double p99 = 0;
+};
+
+// the FrameStats times of sampleFrames frames run back to back after warmupFrames, each summarized on its own.
+// Frames without a GPU result yet are left out of gpu, the allocation counts cover the sampled frames only
+struct FrameMeasurement {
+    SampleSummary frame;
+    SampleSummary record;
+    SampleSummary cull;
+    SampleSummary gpu;
+    // the GPU profiler scopes named in MeasureFrames, summed per frame
+    SampleSummary gpuScopes;
+    uint64_t heapAllocations = 0;
+    uint64_t deviceAllocations = 0;
+};
+
+SampleSummary Summarize(std::vector<double> samples);
+FrameMeasurement MeasureFrames(Rovski &rovski, uint32_t warmupFrames, uint32_t sampleFrames, const std::vector<std::string> &gpuScopes = {});
+std::vector<DrawCommand> MakeGridDraws(uint32_t drawCount, const MeshRange &mesh);
+void MakeSphereMesh(uint32_t segments, uint32_t rings, const glm::vec3 &color, std::vector<Vertex> &vertices, std::vector<uint32_t> &indices);
+std::vector<uint8_t> MakeCheckerTexture(uint32_t size, uint32_t cells, uint32_t seed);
+uint64_t HeapAllocationCount();
+
+int RecordBench(int argc, char **argv);
+int WorkerBench(int argc, char **argv);
+int StartupBench(int argc, char **argv);
+int SceneBench(int argc, char **argv);
+int OverdrawBench(int argc, char **argv);
+int CullBench(int argc, char **argv);
+int DrivenBench(int argc, char **argv);
+int InstancingBench(int argc, char **argv);
+int BindlessBench(int argc, char **argv);
+
+#endif //ROVSKI_BENCH_HPP
@@ -0,0 +1,152 @@
+//
+//  BenchCommon.cpp
+//  Rovski
+//
+
+#include "Bench.hpp"
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
+
+// every heap allocation of the bench binary is counted so steady state frames can be checked for allocations
+static std::atomic<uint64_t> heapAllocations{0};
+
+void *operator new(size_t size) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept {
+    std::free(memory);
+}
+
+uint64_t HeapAllocationCount() {
+    return heapAllocations.load(std::memory_order_relaxed);
+}
+
+SampleSummary Summarize(std::vector<double> samples) {
+    SampleSummary summary{};
+    if (samples.empty()) {
+        return summary;
+    }
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&samples](double p) {
+        size_t index = static_cast<size_t>(std::ceil(p * samples.size())) - 1;
+        return samples[std::min(index, samples.size() - 1)];
+    };
+    summary.avg = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+    summary.min = samples.front();
+    summary.max = samples.back();
+    summary.p50 = percentile(0.50);
+    summary.p95 = percentile(0.95);
+    summary.p99 = percentile(0.99);
+    return summary;
+}
+
+FrameMeasurement MeasureFrames(Rovski &rovski, uint32_t warmupFrames, uint32_t sampleFrames, const std::vector<std::string> &gpuScopes) {
+    rovski.RunFrames(warmupFrames);
+    std::vector<double> frame, record, cull, gpu, scopes;
+    for (std::vector<double> *samples : {&frame, &record, &cull, &gpu, &scopes}) {
+        samples->reserve(sampleFrames);
+    }
+    // built before the counts are taken so its own storage is not counted
+    FrameCallback onFrame = [&](const FrameStats &stats) {
+        frame.push_back(stats.frameMs);
+        record.push_back(stats.recordMs);
+        cull.push_back(stats.cullMs);
+        if (stats.gpuMs > 0) {
+            gpu.push_back(stats.gpuMs);
+        }
+        double scopeMs = 0;
+        for (const GpuScopeResult &scope : rovski.GetGpuProfiler().LatestResult().scopes) {
+            if (std::find(gpuScopes.begin(), gpuScopes.end(), scope.name) != gpuScopes.end()) {
+                scopeMs += scope.gpuMs;
+            }
+        }
+        scopes.push_back(scopeMs);
+    };
+    const uint64_t deviceBefore = rovski.GetMemoryStats().totalAllocationCount;
+    const uint64_t heapBefore = HeapAllocationCount();
+    rovski.RunFrames(sampleFrames, onFrame);
+    FrameMeasurement measurement;
+    measurement.heapAllocations = HeapAllocationCount() - heapBefore;
+    measurement.deviceAllocations = rovski.GetMemoryStats().totalAllocationCount - deviceBefore;
+    measurement.frame = Summarize(std::move(frame));
+    measurement.record = Summarize(std::move(record));
+    measurement.cull = Summarize(std::move(cull));
+    measurement.gpu = Summarize(std::move(gpu));
+    measurement.gpuScopes = Summarize(std::move(scopes));
+    return measurement;
+}
+
+std::vector<DrawCommand> MakeGridDraws(uint32_t drawCount, const MeshRange &mesh) {
+    std::vector<DrawCommand> draws(drawCount);
+    uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(drawCount))));
+    float scale = 2.0f / side;
+    for (uint32_t i = 0; i < drawCount; i++) {
+        float x = -1.0f + scale * (i % side + 0.5f);
+        float y = -1.0f + scale * (i / side + 0.5f);
+        draws[i].model = glm::scale(glm::translate(glm::mat4(1), glm::vec3(x, y, 0.0f)), glm::vec3(scale * 0.8f));
+        draws[i].indexCount = mesh.indexCount;
+        draws[i].firstIndex = mesh.firstIndex;
+        draws[i].vertexOffset = mesh.vertexOffset;
+    }
+    return draws;
+}
+
+void MakeSphereMesh(uint32_t segments, uint32_t rings, const glm::vec3 &color, std::vector<Vertex> &vertices, std::vector<uint32_t> &indices) {
+    vertices.clear();
+    indices.clear();
+    for (uint32_t ring = 0; ring <= rings; ring++) {
+        float v = static_cast<float>(ring) / rings;
+        float theta = v * glm::pi<float>();
+        for (uint32_t segment = 0; segment <= segments; segment++) {
+            float u = static_cast<float>(segment) / segments;
+            float phi = u * glm::two_pi<float>();
+            glm::vec3 position{0.5f * std::sin(theta) * std::cos(phi), 0.5f * std::sin(theta) * std::sin(phi), 0.5f * std::cos(theta)};
+            vertices.emplace_back(std::make_tuple(position, color, glm::vec2{u, v}));
+        }
+    }
+    for (uint32_t ring = 0; ring < rings; ring++) {
+        for (uint32_t segment = 0; segment < segments; segment++) {
+            uint32_t a = ring * (segments + 1) + segment;
+            uint32_t b = a + segments + 1;
+            indices.insert(indices.end(), {a, b, a + 1, a + 1, b, b + 1});
+        }
+    }
+}
+
+std::vector<uint8_t> MakeCheckerTexture(uint32_t size, uint32_t cells, uint32_t seed) {
+    std::vector<uint8_t> pixels(size * size * 4);
+    uint32_t cellSize = std::max(1u, size / cells);
+    // cheap integer hash, the same seed always gives the same colors
+    auto hash = [](uint32_t x) {
+        x ^= x >> 16; x *= 0x7feb352du; x ^= x >> 15; x *= 0x846ca68bu; x ^= x >> 16;
+        return x;
+    };
+    uint32_t colorA = hash(seed * 2 + 1);
+    uint32_t colorB = hash(seed * 2 + 2);
+    for (uint32_t y = 0; y < size; y++) {
+        for (uint32_t x = 0; x < size; x++) {
+            uint32_t color = ((x / cellSize + y / cellSize) & 1) ? colorA : colorB;
+            uint8_t *texel = &pixels[(y * size + x) * 4];
+            texel[0] = static_cast<uint8_t>(color);
+            texel[1] = static_cast<uint8_t>(color >> 8);
+            texel[2] = static_cast<uint8_t>(color >> 16);
+            texel[3] = 255;
+        }
+    }
+    return pixels;
+}
@@ -0,0 +1,59 @@
+//
+//  BindlessBench.cpp
+//  Rovski
+//
+//  A grid of draws cycling through many small textures, recorded with a
+//  descriptor set bind per draw and with the bindless table bound once and a
+//  texture index pushed per draw. The GPU driven rows compare one indirect
+//  batch per texture against the single bindless batch.
+//
+
+#include "Bench.hpp"
+#include <iostream>
+#include <cstdlib>
+#include <string>
+
+int BindlessBench(int argc, char **argv) {
+    constexpr uint32_t warmupFrames = 16;
+    constexpr uint32_t sampleFrames = 64;
+    constexpr uint32_t textureSize = 64;
+    uint32_t maxDraws = argc > 1 ? static_cast<uint32_t>(std::stoul(argv[1])) : 100000;
+    uint32_t textureCount = argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 256;
+
+    Rovski rovski;
+    rovski.SetHeadless(true);
+    if (!rovski.Init(1280, 720)) {
+        return EXIT_FAILURE;
+    }
+    rovski.FinishTextureStreaming();
+    rovski.SetFrustumCulling(false);
+    std::vector<uint32_t> textures(textureCount);
+    for (uint32_t i = 0; i < textureCount; i++) {
+        std::vector<uint8_t> pixels = MakeCheckerTexture(textureSize, 4 + i % 8, i);
+        if (!rovski.CreateTexture(textureSize, textureSize, pixels.data(), textures[i])) {
+            return EXIT_FAILURE;
+        }
+    }
+    std::cout << "draws,textures,path,record_avg_ms,frame_avg_ms,gpu_avg_ms" << std::endl;
+    for (uint32_t drawCount = 1000; drawCount <= maxDraws; drawCount *= 10) {
+        std::vector<DrawCommand> draws = MakeGridDraws(drawCount, rovski.GetDemoMesh());
+        for (uint32_t i = 0; i < drawCount; i++) {
+            draws[i].texture = textures[i % textureCount];
+        }
+        rovski.SetDrawList(std::move(draws));
+        for (const char *path : {"sets", "bindless", "driven sets", "driven bindless"}) {
+            const bool gpuDriven = std::string(path).starts_with("driven");
+            const bool bindless = std::string(path).ends_with("bindless");
+            rovski.SetGpuDriven(gpuDriven);
+            rovski.SetBindless(bindless);
+            if (rovski.GetGpuDriven() != gpuDriven || rovski.GetBindless() != bindless) {
+                continue;
+            }
+            FrameMeasurement measurement = MeasureFrames(rovski, warmupFrames, sampleFrames);
+            std::cout << drawCount << "," << textureCount << "," << path << "," << measurement.record.avg << ","
+                      << measurement.frame.avg << "," << measurement.gpu.avg << std::endl;
+        }
+    }
+    rovski.Clean();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,77 @@
+//
+//  CullBench.cpp
+//  Rovski
+//
+//  Frustum culling time against the number of worker threads: random unit
+//  boxes under random rotations filling a cube around the renderer's camera,
+//  so roughly a tenth of them survive. Only the culler runs, no device needed.
+//
+
+#include "Bench.hpp"
+#include "FrustumCuller.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+int CullBench(int argc, char **argv) {
+    constexpr uint32_t warmupRuns = 8;
+    uint32_t objectCount = argc > 1 ? static_cast<uint32_t>(std::stoul(argv[1])) : 1000000;
+    uint32_t runCount = argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 64;
+    uint32_t maxWorkers = JobSystem::DefaultWorkerCount();
+
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> position(-40.0f, 40.0f);
+    std::uniform_real_distribution<float> angle(0.0f, glm::two_pi<float>());
+    std::uniform_real_distribution<float> scale(0.1f, 1.0f);
+    FrustumCuller culler;
+    culler.Resize(objectCount);
+    const MeshBounds unitBox{glm::vec3(-0.5f), glm::vec3(0.5f)};
+    for (uint32_t i = 0; i < objectCount; i++) {
+        float x = position(random);
+        float y = position(random);
+        float z = position(random);
+        float rotation = angle(random);
+        glm::mat4 model = glm::translate(glm::mat4(1), glm::vec3(x, y, z));
+        model = glm::rotate(model, rotation, glm::normalize(glm::vec3(1.0f, 2.0f, 3.0f)));
+        culler.SetBounds(i, unitBox, glm::scale(model, glm::vec3(scale(random))));
+    }
+    // the renderer's camera and its reverse-Z infinite projection
+    glm::mat4 view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    glm::mat4 projection(0.0f);
+    const float focal = 1.0f / std::tan(glm::radians(45.0f) * 0.5f);
+    projection[0][0] = focal / (16.0f / 9.0f);
+    projection[1][1] = -focal;
+    projection[2][3] = -1.0f;
+    projection[3][2] = 0.1f;
+    const Frustum frustum = ExtractFrustum(projection * view);
+
+    std::vector<uint32_t> workerCounts;
+    for (uint32_t workers = 0; workers < maxWorkers; workers = std::max(1u, workers * 2)) {
+        workerCounts.push_back(workers);
+    }
+    workerCounts.push_back(maxWorkers);
+
+    std::cout << "objects,workers,visible,cull_avg_ms,cull_p50_ms,cull_p95_ms,objects_per_us" << std::endl;
+    std::vector<uint32_t> visible;
+    for (auto workers : workerCounts) {
+        JobSystem jobSystem(workers);
+        for (uint32_t i = 0; i < warmupRuns; i++) {
+            culler.Cull(frustum, jobSystem, visible);
+        }
+        std::vector<double> samples;
+        for (uint32_t i = 0; i < runCount; i++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            culler.Cull(frustum, jobSystem, visible);
+            samples.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+        }
+        SampleSummary cull = Summarize(samples);
+        std::cout << objectCount << "," << workers << "," << visible.size() << "," << cull.avg << "," << cull.p50 << ","
+                  << cull.p95 << "," << objectCount / (cull.p50 * 1000.0) << std::endl;
+    }
+    return EXIT_SUCCESS;
+}
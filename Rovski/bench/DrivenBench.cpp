@@ -0,0 +1,46 @@
+//
+//  DrivenBench.cpp
+//  Rovski
+//
+//  CPU recording against GPU driven culling over growing draw counts. The CPU
+//  path's record time grows with the draws, the GPU driven one should stay
+//  flat while its cull dispatch takes the work over on the GPU. The occlusion
+//  path adds the depth pyramid and the late cull to the GPU cull time.
+//
+
+#include "Bench.hpp"
+#include <iostream>
+#include <cstdlib>
+#include <string>
+
+int DrivenBench(int argc, char **argv) {
+    constexpr uint32_t warmupFrames = 16;
+    constexpr uint32_t sampleFrames = 64;
+    uint32_t maxDraws = argc > 1 ? static_cast<uint32_t>(std::stoul(argv[1])) : 100000;
+    const std::vector<std::string> cullScopes = {"cull", "depth pyramid", "late cull"};
+
+    Rovski rovski;
+    rovski.SetHeadless(true);
+    if (!rovski.Init(1280, 720)) {
+        return EXIT_FAILURE;
+    }
+    rovski.FinishTextureStreaming();
+    std::cout << "draws,path,record_avg_ms,cpu_cull_avg_ms,frame_avg_ms,gpu_avg_ms,gpu_cull_avg_ms" << std::endl;
+    for (uint32_t drawCount = 1000; drawCount <= maxDraws; drawCount *= 10) {
+        rovski.SetDrawList(MakeGridDraws(drawCount, rovski.GetDemoMesh()));
+        for (const char *path : {"cpu", "gpu", "occlusion"}) {
+            const bool gpuDriven = std::string(path) != "cpu";
+            const bool occlusionCulling = std::string(path) == "occlusion";
+            rovski.SetGpuDriven(gpuDriven);
+            rovski.SetOcclusionCulling(occlusionCulling);
+            if (rovski.GetGpuDriven() != gpuDriven || rovski.GetOcclusionCulling() != occlusionCulling) {
+                continue;
+            }
+            FrameMeasurement measurement = MeasureFrames(rovski, warmupFrames, sampleFrames, cullScopes);
+            std::cout << drawCount << "," << path << "," << measurement.record.avg << "," << measurement.cull.avg << ","
+                      << measurement.frame.avg << "," << measurement.gpu.avg << "," << measurement.gpuScopes.avg << std::endl;
+        }
+    }
+    rovski.Clean();
+    return EXIT_SUCCESS;
+}
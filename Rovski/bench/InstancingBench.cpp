@@ -0,0 +1,52 @@
+//
+//  InstancingBench.cpp
+//  Rovski
+//
+//  The same grid of copies drawn as a draw list, one uniform block and one
+//  draw call each, and as one instanced draw reading its transforms from the
+//  instance stream. Frustum culling is off so both paths draw every copy.
+//
+
+#include "Bench.hpp"
+#include <iostream>
+#include <cstdlib>
+#include <string>
+
+int InstancingBench(int argc, char **argv) {
+    constexpr uint32_t warmupFrames = 16;
+    constexpr uint32_t sampleFrames = 64;
+    uint32_t maxCopies = argc > 1 ? static_cast<uint32_t>(std::stoul(argv[1])) : 100000;
+
+    Rovski rovski;
+    rovski.SetHeadless(true);
+    if (!rovski.Init(1280, 720)) {
+        return EXIT_FAILURE;
+    }
+    rovski.FinishTextureStreaming();
+    rovski.SetFrustumCulling(false);
+    std::cout << "copies,path,record_avg_ms,frame_avg_ms,gpu_avg_ms" << std::endl;
+    for (uint32_t copyCount = 1000; copyCount <= maxCopies; copyCount *= 10) {
+        std::vector<DrawCommand> draws = MakeGridDraws(copyCount, rovski.GetDemoMesh());
+        std::vector<Instance> instances;
+        instances.reserve(copyCount);
+        for (uint32_t i = 0; i < copyCount; i++) {
+            instances.emplace_back(std::make_tuple(draws[i].model, glm::vec4(1.0f)));
+        }
+        for (const char *path : {"draws", "instanced"}) {
+            if (std::string(path) == "draws") {
+                rovski.SetInstances(rovski.GetDemoMesh(), 0, {});
+                rovski.SetDrawList(draws);
+            } else {
+                rovski.SetDrawList({});
+                if (!rovski.SetInstances(rovski.GetDemoMesh(), 0, instances)) {
+                    return EXIT_FAILURE;
+                }
+            }
+            FrameMeasurement measurement = MeasureFrames(rovski, warmupFrames, sampleFrames);
+            std::cout << copyCount << "," << path << "," << measurement.record.avg << ","
+                      << measurement.frame.avg << "," << measurement.gpu.avg << std::endl;
+        }
+    }
+    rovski.Clean();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,51 @@
+//
+//  OverdrawBench.cpp
+//  Rovski
+//
+//  GPU time with and without the depth prepass against depth complexity:
+//  stacked layers of the demo grid, drawn back to front so that without a
+//  prepass every layer gets shaded, the worst case for early-Z.
+//
+
+#include "Bench.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <cstdlib>
+#include <string>
+
+int OverdrawBench(int argc, char **argv) {
+    constexpr uint32_t warmupFrames = 16;
+    constexpr uint32_t sampleFrames = 128;
+    uint32_t drawsPerLayer = argc > 1 ? static_cast<uint32_t>(std::stoul(argv[1])) : 1024;
+    uint32_t maxLayers = argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 16;
+
+    Rovski rovski;
+    rovski.SetHeadless(true);
+    if (!rovski.Init(1280, 720)) {
+        return EXIT_FAILURE;
+    }
+    rovski.FinishTextureStreaming();
+    std::cout << "layers,draws,prepass,frame_avg_ms,record_avg_ms,gpu_avg_ms,gpu_p95_ms" << std::endl;
+    for (uint32_t layers = 1; layers <= maxLayers; layers *= 2) {
+        // the camera sits above the origin, lower layers are further away and come first
+        std::vector<DrawCommand> draws;
+        std::vector<DrawCommand> layer = MakeGridDraws(drawsPerLayer, rovski.GetDemoMesh());
+        for (uint32_t i = 0; i < layers; i++) {
+            float z = -0.5f + 0.5f * (i + 0.5f) / layers;
+            for (DrawCommand draw : layer) {
+                draw.model = glm::translate(glm::mat4(1), glm::vec3(0.0f, 0.0f, z)) * draw.model;
+                draws.push_back(draw);
+            }
+        }
+        uint32_t drawCount = static_cast<uint32_t>(draws.size());
+        rovski.SetDrawList(std::move(draws));
+        for (bool prepass : {false, true}) {
+            rovski.SetDepthPrepass(prepass);
+            FrameMeasurement measurement = MeasureFrames(rovski, warmupFrames, sampleFrames);
+            std::cout << layers << "," << drawCount << "," << (prepass ? 1 : 0) << "," << measurement.frame.avg << ","
+                      << measurement.record.avg << "," << measurement.gpu.avg << "," << measurement.gpu.p95 << std::endl;
+        }
+    }
+    rovski.Clean();
+    return EXIT_SUCCESS;
+}
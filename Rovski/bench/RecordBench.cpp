@@ -0,0 +1,33 @@
+//
+//  RecordBench.cpp
+//  Rovski
+//
+//  CPU cost of re-recording the frame command buffer from the draw list.
+//
+
+#include "Bench.hpp"
+#include <iostream>
+#include <cstdlib>
+
+int RecordBench(int argc, char **argv) {
+    constexpr uint32_t warmupFrames = 16;
+    constexpr uint32_t sampleFrames = 128;
+    const uint32_t drawCounts[] = {1000, 10000, 100000};
+
+    Rovski rovski;
+    if (!rovski.Init(1280, 720)) {
+        return EXIT_FAILURE;
+    }
+    rovski.FinishTextureStreaming();
+    std::cout << "draws,record_avg_ms,record_p50_ms,record_p95_ms,record_max_ms,ns_per_draw,gpu_avg_ms" << std::endl;
+    for (auto drawCount : drawCounts) {
+        rovski.SetDrawList(MakeGridDraws(drawCount, rovski.GetDemoMesh()));
+        FrameMeasurement measurement = MeasureFrames(rovski, warmupFrames, sampleFrames);
+        const SampleSummary &record = measurement.record;
+        std::cout << drawCount << "," << record.avg << "," << record.p50 << "," << record.p95 << ","
+                  << record.max << "," << record.avg * 1e6 / drawCount << "," << measurement.gpu.avg << std::endl;
+    }
+    rovski.GetGpuProfiler().DumpCsv("rovski_record_gpu.csv");
+    rovski.Clean();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,107 @@
+//
+//  SceneBench.cpp
+//  Rovski
+//
+//  Headless frame time of a procedural scene: N sphere meshes, M checker
+//  textures and K instances spread over a grid. Everything derives from fixed
+//  seeds so runs on different commits draw the exact same frames. Results go to
+//  stdout as CSV and to a JSON file for comparing commits.
+//
+
+#include "Bench.hpp"
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+static void WriteSummary(std::ofstream &file, const char *name, const SampleSummary &summary) {
+    file << "  \"" << name << "\": {\"avg\": " << summary.avg << ", \"min\": " << summary.min << ", \"p50\": " << summary.p50
+         << ", \"p95\": " << summary.p95 << ", \"p99\": " << summary.p99 << ", \"max\": " << summary.max << "},\n";
+}
+
+int SceneBench(int argc, char **argv) {
+    constexpr uint32_t warmupFrames = 16;
+    constexpr uint32_t textureSize = 256;
+    uint32_t meshCount = argc > 1 ? static_cast<uint32_t>(std::stoul(argv[1])) : 16;
+    uint32_t textureCount = argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 8;
+    uint32_t instanceCount = argc > 3 ? static_cast<uint32_t>(std::stoul(argv[3])) : 10000;
+    uint32_t frameCount = argc > 4 ? static_cast<uint32_t>(std::stoul(argv[4])) : 256;
+    std::string outputPath = argc > 5 ? argv[5] : "rovski_scene.json";
+
+    Rovski rovski;
+    // headless runs on any device, lavapipe included, and never waits for vsync
+    rovski.SetHeadless(true);
+    if (!rovski.Init(1280, 720)) {
+        return EXIT_FAILURE;
+    }
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<MeshRange> meshes(meshCount);
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    for (uint32_t i = 0; i < meshCount; i++) {
+        // tessellation varies per mesh so index counts are not uniform
+        uint32_t segments = 8 + (i * 7) % 56;
+        MakeSphereMesh(segments, segments / 2, {unit(random), unit(random), unit(random)}, vertices, indices);
+        if (!rovski.UploadMesh(vertices, indices, meshes[i])) {
+            return EXIT_FAILURE;
+        }
+    }
+    std::vector<uint32_t> textures(textureCount);
+    for (uint32_t i = 0; i < textureCount; i++) {
+        std::vector<uint8_t> pixels = MakeCheckerTexture(textureSize, 8 + i % 8, i);
+        if (!rovski.CreateTexture(textureSize, textureSize, pixels.data(), textures[i])) {
+            return EXIT_FAILURE;
+        }
+    }
+    const MeshRange &fallbackMesh = rovski.GetDemoMesh();
+    std::vector<DrawCommand> draws = MakeGridDraws(instanceCount, fallbackMesh);
+    for (uint32_t i = 0; i < instanceCount; i++) {
+        if (meshCount > 0) {
+            const MeshRange &mesh = meshes[random() % meshCount];
+            draws[i].indexCount = mesh.indexCount;
+            draws[i].firstIndex = mesh.firstIndex;
+            draws[i].vertexOffset = mesh.vertexOffset;
+        }
+        draws[i].texture = textureCount > 0 ? textures[random() % textureCount] : 0;
+    }
+    rovski.SetDrawList(std::move(draws));
+    // the default texture streams in the background, keep its uploads out of the samples
+    rovski.FinishTextureStreaming();
+    FrameMeasurement measurement = MeasureFrames(rovski, warmupFrames, frameCount);
+    uint64_t heapAllocations = measurement.heapAllocations;
+    uint64_t deviceAllocations = measurement.deviceAllocations;
+    MemoryStats memory = rovski.GetMemoryStats();
+    std::string deviceName = rovski.GetDeviceName();
+    uint32_t recordThreads = rovski.GetFrameStats().recordThreads;
+    rovski.Clean();
+
+    const SampleSummary &frame = measurement.frame;
+    const SampleSummary &record = measurement.record;
+    const SampleSummary &gpu = measurement.gpu;
+    std::cout << "meshes,textures,instances,frames,frame_p50_ms,frame_p95_ms,frame_p99_ms,record_p50_ms,gpu_p50_ms,"
+                 "heap_allocs_per_frame,device_allocs,device_memory_count" << std::endl;
+    std::cout << meshCount << "," << textureCount << "," << instanceCount << "," << frameCount << "," << frame.p50 << ","
+              << frame.p95 << "," << frame.p99 << "," << record.p50 << "," << gpu.p50 << ","
+              << static_cast<double>(heapAllocations) / frameCount << "," << deviceAllocations << "," << memory.deviceMemoryCount << std::endl;
+
+    std::ofstream file(outputPath, std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "failed to open " << outputPath << std::endl;
+        return EXIT_FAILURE;
+    }
+    file << "{\n";
+    file << "  \"device\": \"" << deviceName << "\",\n";
+    file << "  \"scene\": {\"meshes\": " << meshCount << ", \"textures\": " << textureCount << ", \"instances\": " << instanceCount
+         << ", \"frames\": " << frameCount << ", \"record_threads\": " << recordThreads << "},\n";
+    WriteSummary(file, "frame_ms", frame);
+    WriteSummary(file, "record_ms", record);
+    WriteSummary(file, "gpu_ms", gpu);
+    file << "  \"allocations\": {\"heap_per_frame\": " << static_cast<double>(heapAllocations) / frameCount
+         << ", \"device_during_frames\": " << deviceAllocations << ", \"device_live\": " << memory.allocationCount
+         << ", \"device_memory_objects\": " << memory.deviceMemoryCount << ", \"device_reserved_bytes\": " << memory.reservedBytes
+         << ", \"device_used_bytes\": " << memory.usedBytes << "}\n";
+    file << "}" << std::endl;
+    return file.good() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,51 @@
+//
+//  StartupBench.cpp
+//  Rovski
+//
+//  Time to first frame with a cold and with a warm pipeline cache. The CPU zones
+//  of the last cold and warm run are written as Chrome traces.
+//
+
+#include "Bench.hpp"
+#include "CpuProfiler.hpp"
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <string>
+
+int StartupBench(int argc, char **argv) {
+    uint32_t runs = argc > 1 ? static_cast<uint32_t>(std::stoul(argv[1])) : 5;
+    const std::string cachePath = "rovski_bench_pipeline.cache";
+
+    std::cout << "run,cache,cache_loaded,init_ms,pipeline_ms,first_frame_ms" << std::endl;
+    std::vector<double> coldSamples, warmSamples;
+    for (uint32_t run = 0; run < runs; run++) {
+        for (bool warm : {false, true}) {
+            if (!warm) {
+                std::remove(cachePath.c_str());
+            }
+            CpuProfiler::Instance().Clear();
+            auto start = std::chrono::high_resolution_clock::now();
+            Rovski rovski;
+            rovski.SetPipelineCachePath(cachePath);
+            if (!rovski.Init(1280, 720)) {
+                return EXIT_FAILURE;
+            }
+            rovski.RunFrames(1);
+            double firstFrameMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            const StartupStats &stats = rovski.GetStartupStats();
+            std::cout << run << "," << (warm ? "warm" : "cold") << "," << stats.pipelineCacheLoaded << ","
+                      << stats.initMs << "," << stats.pipelineMs << "," << firstFrameMs << std::endl;
+            (warm ? warmSamples : coldSamples).push_back(firstFrameMs);
+            rovski.Clean();
+            if (run + 1 == runs) {
+                CpuProfiler::Instance().ExportChromeTrace(warm ? "rovski_startup_warm.json" : "rovski_startup_cold.json");
+            }
+        }
+    }
+    SampleSummary cold = Summarize(coldSamples);
+    SampleSummary warm = Summarize(warmSamples);
+    std::cout << "# first frame cold p50 " << cold.p50 << " ms, warm p50 " << warm.p50 << " ms" << std::endl;
+    return EXIT_SUCCESS;
+}
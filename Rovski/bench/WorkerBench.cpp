@@ -0,0 +1,47 @@
+//
+//  WorkerBench.cpp
+//  Rovski
+//
+//  Frame time against the number of recording worker threads.
+//
+
+#include "Bench.hpp"
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <algorithm>
+
+int WorkerBench(int argc, char **argv) {
+    constexpr uint32_t warmupFrames = 16;
+    constexpr uint32_t sampleFrames = 128;
+    uint32_t drawCount = argc > 1 ? static_cast<uint32_t>(std::stoul(argv[1])) : 50000;
+    uint32_t maxWorkers = JobSystem::DefaultWorkerCount();
+
+    std::vector<uint32_t> workerCounts;
+    for (uint32_t workers = 0; workers < maxWorkers; workers = std::max(1u, workers * 2)) {
+        workerCounts.push_back(workers);
+    }
+    workerCounts.push_back(maxWorkers);
+
+    std::cout << "draws,workers,record_threads,frame_avg_ms,frame_p95_ms,record_avg_ms,record_p95_ms,speedup" << std::endl;
+    double baseline = 0;
+    for (auto workers : workerCounts) {
+        Rovski rovski;
+        if (!rovski.Init(1280, 720, 2, workers)) {
+            return EXIT_FAILURE;
+        }
+        rovski.SetDrawList(MakeGridDraws(drawCount, rovski.GetDemoMesh()));
+        rovski.FinishTextureStreaming();
+        FrameMeasurement measurement = MeasureFrames(rovski, warmupFrames, sampleFrames);
+        uint32_t recordThreads = rovski.GetFrameStats().recordThreads;
+        rovski.Clean();
+        const SampleSummary &frame = measurement.frame;
+        const SampleSummary &record = measurement.record;
+        if (baseline == 0) {
+            baseline = frame.avg;
+        }
+        std::cout << drawCount << "," << workers << "," << recordThreads << "," << frame.avg << "," << frame.p95 << ","
+                  << record.avg << "," << record.p95 << "," << baseline / frame.avg << std::endl;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,48 @@
+//
+//  main.cpp
+//  RovskiBench
+//
+
+#include "Bench.hpp"
+#include <iostream>
+#include <string>
+#include <stdexcept>
+#include <cstdlib>
+
+int main(int argc, char **argv) {
+    std::string mode = argc > 1 ? argv[1] : "record";
+    try {
+        if (mode == "record") {
+            return RecordBench(argc - 1, argv + 1);
+        }
+        if (mode == "workers") {
+            return WorkerBench(argc - 1, argv + 1);
+        }
+        if (mode == "startup") {
+            return StartupBench(argc - 1, argv + 1);
+        }
+        if (mode == "scene") {
+            return SceneBench(argc - 1, argv + 1);
+        }
+        if (mode == "overdraw") {
+            return OverdrawBench(argc - 1, argv + 1);
+        }
+        if (mode == "cull") {
+            return CullBench(argc - 1, argv + 1);
+        }
+        if (mode == "driven") {
+            return DrivenBench(argc - 1, argv + 1);
+        }
+        if (mode == "instancing") {
+            return InstancingBench(argc - 1, argv + 1);
+        }
+        if (mode == "bindless") {
+            return BindlessBench(argc - 1, argv + 1);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cerr << "usage: RovskiBench [record|workers [draws]|startup [runs]|scene [meshes] [textures] [instances] [frames] [out.json]|overdraw [draws per layer] [max layers]|cull [objects] [runs]|driven [max draws]|instancing [max copies]|bindless [max draws] [textures]]" << std::endl;
+    return EXIT_FAILURE;
+}
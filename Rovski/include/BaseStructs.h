@@ -20,43 +20,116 @@ template<typename DataType> VkFormat GetDataFormat(){
         return VK_FORMAT_R32G32B32_SFLOAT;
     } else if constexpr(std::is_same_v<DataType, glm::vec2>) {
         return  VK_FORMAT_R32G32_SFLOAT;
+    } else if constexpr(std::is_same_v<DataType, glm::vec4> || std::is_same_v<DataType, glm::mat4>) {
+        // a matrix is read one column per location
+        return VK_FORMAT_R32G32B32A32_SFLOAT;
     } else {
         assert(0);
     }
 }
 
-template <class ... Types>
-class VertexTemp : public std::tuple<Types...> {
+// locations one element takes, a mat4 takes one per column
+template<typename DataType> constexpr uint32_t GetLocationCount(){
+    if constexpr(std::is_same_v<DataType, glm::mat4>) {
+        return 4;
+    } else {
+        return 1;
+    }
+}
+
+// one interleaved vertex buffer binding. Locations run on from FirstLocation in element order so several streams
+// can feed one pipeline, see InstanceTemp
+template <uint32_t Binding, VkVertexInputRate InputRate, uint32_t FirstLocation, class ... Types>
+class VertexStreamTemp : public std::tuple<Types...> {
 public:
     using DataType = std::tuple<Types...>;
-    using ArrayType = std::array<VkVertexInputAttributeDescription,std::tuple_size_v<DataType>>;
-    VertexTemp(std::tuple<Types...> data) : std::tuple<Types...>(data) {}
+    static constexpr uint32_t BindingIndex = Binding;
+    static constexpr uint32_t AttributeCount = (GetLocationCount<Types>() + ... + 0);
+    // first location free for a stream bound after this one
+    static constexpr uint32_t EndLocation = FirstLocation + AttributeCount;
+    using ArrayType = std::array<VkVertexInputAttributeDescription, AttributeCount>;
+    VertexStreamTemp(std::tuple<Types...> data) : std::tuple<Types...>(data) {}
     static VkVertexInputBindingDescription getBindingDescription(){
         VkVertexInputBindingDescription bindingDescription{};
-        bindingDescription.binding = 0;
-        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        bindingDescription.binding = Binding;
+        bindingDescription.inputRate = InputRate;
         bindingDescription.stride = sizeof(std::tuple<Types...>);
         return bindingDescription;
     }
 
     static ArrayType getVertexInputAttributeDescription() {
         ArrayType result{};
-        fillDes<0>(result);
+        fillDes<0, 0>(result);
         return result;
     }
+
+    // only the listed attributes (a mat4 is four), same stride and locations, for passes that read part of the
+    // stream (depth prepass)
+    template<size_t ... Indices>
+    static std::array<VkVertexInputAttributeDescription, sizeof...(Indices)> getVertexInputAttributeSubset() {
+        ArrayType all = getVertexInputAttributeDescription();
+        return {all[Indices]...};
+    }
 private:
-    template<int index> static void fillDes(ArrayType &result) {
+    template<size_t index, uint32_t attribute> static void fillDes(ArrayType &result) {
         if constexpr(index < std::tuple_size_v<DataType>) {
-            result[index].binding = 0;
-            result[index].location = index;
-            result[index].format = GetDataFormat<std::tuple_element_t<index, DataType>>();
-            result[index].offset = tuple_element_offset<index, DataType>();
-            fillDes<index+1>(result);
+            using ElementType = std::tuple_element_t<index, DataType>;
+            for (uint32_t column = 0; column < GetLocationCount<ElementType>(); column++) {
+                result[attribute + column].binding = Binding;
+                result[attribute + column].location = FirstLocation + attribute + column;
+                result[attribute + column].format = GetDataFormat<ElementType>();
+                result[attribute + column].offset = static_cast<uint32_t>(tuple_element_offset<index, DataType>() + column * sizeof(glm::vec4));
+            }
+            fillDes<index + 1, attribute + GetLocationCount<ElementType>()>(result);
         }
     }
 };
 
+// per vertex data, binding 0 from location 0
+template <class ... Types>
+using VertexTemp = VertexStreamTemp<0, VK_VERTEX_INPUT_RATE_VERTEX, 0, Types...>;
+
+// per instance data drawn together with VertexStream, on the next binding and the locations after its own
+template <class VertexStream, class ... Types>
+using InstanceTemp = VertexStreamTemp<VertexStream::BindingIndex + 1, VK_VERTEX_INPUT_RATE_INSTANCE, VertexStream::EndLocation, Types...>;
+
+// the attributes of several streams in one array, for a pipeline that binds them together
+template <class ... Streams>
+std::array<VkVertexInputAttributeDescription, (Streams::AttributeCount + ...)> GetStreamAttributeDescriptions() {
+    std::array<VkVertexInputAttributeDescription, (Streams::AttributeCount + ...)> result{};
+    size_t next = 0;
+    auto append = [&](const auto &attributes) {
+        for (const VkVertexInputAttributeDescription &attribute : attributes) {
+            result[next++] = attribute;
+        }
+    };
+    (append(Streams::getVertexInputAttributeDescription()), ...);
+    return result;
+}
+
+template <class ... Streams>
+std::array<VkVertexInputBindingDescription, sizeof...(Streams)> GetStreamBindingDescriptions() {
+    return {Streams::getBindingDescription()...};
+}
+
 using Vertex = VertexTemp<glm::vec3, glm::vec3, glm::vec2>;
+// model transform and color of one instance, locations 3 to 6 and 7
+using Instance = InstanceTemp<Vertex, glm::mat4, glm::vec4>;
+
+struct MeshBounds {
+    glm::vec3 min{0.0f};
+    glm::vec3 max{0.0f};
+};
+
+struct DrawCommand {
+    glm::mat4 model;
+    uint32_t indexCount;
+    uint32_t firstIndex;
+    int32_t vertexOffset;
+    uint32_t texture = 0;
+    // model space, left at zero the draw is never frustum culled
+    MeshBounds bounds;
+};
 
 
 
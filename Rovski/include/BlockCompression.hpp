@@ -0,0 +1,48 @@
+//
+//  BlockCompression.hpp
+//  Rovski
+//
+
+#ifndef ROVSKI_BLOCKCOMPRESSION_HPP
+#define ROVSKI_BLOCKCOMPRESSION_HPP
+
+#include <vulkan/vulkan_core.h>
+#include <cstdint>
+#include <vector>
+#include "JobSystem.hpp"
+
+// BC1: opaque color, 8 bytes per block. BC3: BC1 color plus a BC4 alpha block.
+// BC5: two BC4 channels (red, green), for normal maps. BC7: mode 6 only, one
+// RGBA endpoint pair with 4 bit indices.
+enum class BlockFormat { BC1, BC3, BC5, BC7 };
+
+// Fast fits endpoints from the bounding box (BC1/BC4) or the principal axis
+// (BC7). Normal uses the principal axis with one least squares refit and
+// tries every BC7 p-bit pair. High refits until the error stops improving
+// and also searches the BC4 endpoints around the fit.
+enum class EncodeQuality { Fast, Normal, High };
+
+uint32_t BlockBytes(BlockFormat format);
+// BC5 has no sRGB variant, srgb is ignored for it
+VkFormat BlockVkFormat(BlockFormat format, bool srgb);
+// 4x4 blocks of 8 or 16 bytes for the BC formats, 1x1 texels of 4 bytes for the RGBA8 formats
+bool FormatBlockInfo(VkFormat format, uint32_t &blockBytes, uint32_t &blockDim);
+
+// texels: one 4x4 block of RGBA8, row major; block receives BlockBytes(format) bytes
+void EncodeBlock(BlockFormat format, EncodeQuality quality, const uint8_t *texels, uint8_t *block);
+
+// Whole images, rows of blocks are spread over the job system. Partial blocks
+// at the right and bottom edges repeat the last column and row. The palette
+// search runs four texels at a time with SSE2 or NEON.
+class BlockEncoder {
+public:
+    explicit BlockEncoder(JobSystem &jobSystem) : jobSystem(jobSystem) {}
+
+    void Encode(BlockFormat format, EncodeQuality quality, const uint8_t *rgba, uint32_t width, uint32_t height,
+                std::vector<uint8_t> &blocks);
+
+private:
+    JobSystem &jobSystem;
+};
+
+#endif //ROVSKI_BLOCKCOMPRESSION_HPP
@@ -0,0 +1,104 @@
+//
+//  CpuProfiler.hpp
+//  Rovski
+//
+
+#ifndef ROVSKI_CPUPROFILER_HPP
+#define ROVSKI_CPUPROFILER_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Process wide CPU zone recorder. Every thread writes finished zones into its
+// own fixed ring without locks (only the first zone of a thread registers it),
+// old zones are overwritten once a ring is full. When a thread exits its zones
+// are copied out until the next Clear and the ring goes to the next new thread.
+// Export to the Chrome trace_event format is meant to run while the recording
+// threads are idle, e.g. after RunFrames or Init.
+class CpuProfiler {
+public:
+    static constexpr uint32_t RingCapacity = 1u << 16;
+
+    struct Zone {
+        const char *name = nullptr;
+        uint64_t beginNs = 0;
+        uint64_t endNs = 0;
+    };
+
+    static CpuProfiler &Instance();
+    static uint64_t NowNs();
+
+    void SetEnabled(bool enabled) { this->enabled.store(enabled, std::memory_order_relaxed); }
+    bool Enabled() const { return enabled.load(std::memory_order_relaxed); }
+    // name must outlive the profiler, string literals and __func__ are fine
+    void Record(const char *name, uint64_t beginNs, uint64_t endNs);
+    void SetThreadName(std::string name);
+    void Clear();
+    bool ExportChromeTrace(const std::string &path) const;
+
+private:
+    struct ThreadRing {
+        uint32_t threadId = 0;
+        std::string name;
+        std::atomic<uint64_t> head{0};
+        std::atomic<uint64_t> tail{0};
+        std::array<Zone, RingCapacity> zones;
+        bool active = false;
+    };
+
+    // the zones of a thread that exited
+    struct RetiredThread {
+        uint32_t threadId = 0;
+        std::string name;
+        std::vector<Zone> zones;
+    };
+
+    struct ThreadExit;
+
+    CpuProfiler();
+    ThreadRing &LocalRing();
+    void ReleaseLocalRing();
+
+    std::atomic<bool> enabled{true};
+    mutable std::mutex registryMutex;
+    uint32_t nextThreadId = 0;
+    std::vector<std::unique_ptr<ThreadRing>> rings;
+    std::vector<ThreadRing*> freeRings;
+    std::vector<RetiredThread> retiredThreads;
+};
+
+class CpuScope {
+public:
+    explicit CpuScope(const char *name) : name(name) {
+        if (CpuProfiler::Instance().Enabled()) {
+            beginNs = CpuProfiler::NowNs();
+        }
+    }
+    ~CpuScope() {
+        if (beginNs != 0) {
+            CpuProfiler::Instance().Record(name, beginNs, CpuProfiler::NowNs());
+        }
+    }
+    CpuScope(const CpuScope&) = delete;
+    CpuScope& operator=(const CpuScope&) = delete;
+
+private:
+    const char *name;
+    uint64_t beginNs = 0;
+};
+
+#define ROVSKI_CPU_CONCAT_INNER(a, b) a##b
+#define ROVSKI_CPU_CONCAT(a, b) ROVSKI_CPU_CONCAT_INNER(a, b)
+#ifdef ROVSKI_DISABLE_CPU_PROFILER
+#define ROVSKI_CPU_SCOPE(name) ((void)0)
+#else
+#define ROVSKI_CPU_SCOPE(name) CpuScope ROVSKI_CPU_CONCAT(cpuScope, __LINE__)(name)
+#endif
+#define ROVSKI_CPU_FUNCTION() ROVSKI_CPU_SCOPE(__func__)
+
+#endif //ROVSKI_CPUPROFILER_HPP
@@ -0,0 +1,78 @@
+//
+//  DeviceMemoryAllocator.hpp
+//  Rovski
+//
+
+#ifndef ROVSKI_DEVICEMEMORYALLOCATOR_HPP
+#define ROVSKI_DEVICEMEMORYALLOCATOR_HPP
+
+#include <vulkan/vulkan_core.h>
+#include <vector>
+#include <memory>
+#include "TlsfAllocator.hpp"
+
+struct MemoryAllocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void *mapped = nullptr;
+    uint32_t memoryType = UINT32_MAX;
+    uint32_t block = UINT32_MAX;
+    uint32_t node = TlsfAllocator::InvalidNode;
+    bool dedicated = false;
+};
+
+struct MemoryStats {
+    uint32_t deviceMemoryCount = 0;
+    uint32_t blockCount = 0;
+    uint32_t dedicatedCount = 0;
+    uint32_t allocationCount = 0;
+    uint64_t totalAllocationCount = 0;
+    VkDeviceSize reservedBytes = 0;
+    VkDeviceSize usedBytes = 0;
+    VkDeviceSize largestFreeRange = 0;
+};
+
+// Hands out aligned sub-ranges of big VkDeviceMemory blocks, one block list per
+// memory type. Buffers and optimal images live in separate blocks so we never
+// have to care about bufferImageGranularity. Host visible blocks stay mapped for
+// their whole life, MemoryAllocation::mapped already points at the sub-range.
+class DeviceMemoryAllocator {
+public:
+    enum class ResourceKind {
+        Buffer,
+        Image
+    };
+
+    bool Init(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize preferredBlockSize = 64ull << 20);
+    void Destroy();
+    bool Allocate(const VkMemoryRequirements &requirements, uint32_t memoryType, ResourceKind kind, MemoryAllocation &allocation);
+    void Free(MemoryAllocation &allocation);
+    MemoryStats GetStats() const;
+    void PrintStats() const;
+
+private:
+    struct Block {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void *mapped = nullptr;
+        uint32_t memoryType = 0;
+        ResourceKind kind = ResourceKind::Buffer;
+        TlsfAllocator allocator;
+    };
+
+    VkDeviceSize BlockSizeForType(uint32_t memoryType) const;
+    bool AllocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, VkDeviceMemory &memory, void *&mapped);
+    bool AllocateDedicated(const VkMemoryRequirements &requirements, uint32_t memoryType, MemoryAllocation &allocation);
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memoryProperties{};
+    VkDeviceSize preferredBlockSize = 0;
+    uint32_t maxAllocationCount = 0;
+    uint32_t deviceMemoryCount = 0;
+    uint32_t dedicatedCount = 0;
+    uint64_t totalAllocationCount = 0;
+    VkDeviceSize dedicatedBytes = 0;
+    std::vector<std::unique_ptr<Block>> blocks;
+};
+
+#endif //ROVSKI_DEVICEMEMORYALLOCATOR_HPP
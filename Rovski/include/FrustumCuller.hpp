@@ -0,0 +1,68 @@
+//
+//  FrustumCuller.hpp
+//  Rovski
+//
+
+#ifndef ROVSKI_FRUSTUMCULLER_HPP
+#define ROVSKI_FRUSTUMCULLER_HPP
+
+#include <vulkan/vulkan_core.h>
+#include <cstdint>
+#include <vector>
+#include "BaseStructs.h"
+#include "JobSystem.hpp"
+
+// left, right, bottom, top, near, far as (normal, distance) with unit normals pointing inwards. A plane the
+// projection doesn't have, like the far plane of an infinite one, comes out as (0, 0, 0, 1) and passes everything
+struct Frustum {
+    glm::vec4 planes[6];
+};
+
+// from a Vulkan clip space matrix (depth 0..w), usually projection * view
+Frustum ExtractFrustum(const glm::mat4 &viewProjection);
+
+// a model space box moved into world space: the sphere around it and its world aligned hull, both around one center
+struct WorldBounds {
+    glm::vec3 center{0};
+    float radius = 0;
+    glm::vec3 extent{0};
+    bool unbounded = false;
+};
+
+// all zero bounds come out unbounded
+WorldBounds TransformBounds(const MeshBounds &bounds, const glm::mat4 &model);
+
+// World space bounding spheres and boxes of every object, one array per
+// component so eight (AVX2) or four (SSE2, NEON) objects are tested per step.
+// Sphere and box share their center, 28 bytes an object, since at a million
+// objects the test is bound by memory rather than math. An object is visible
+// when both its sphere and its box reach inside all six planes; the sphere is
+// the tighter one for rotated boxes, the box for long thin objects. Extents
+// are only read for steps where a sphere passed. Cull splits the objects into
+// ranges over the job system and only the creating thread of that job system
+// may call it. The AVX2 path is picked at runtime, the build doesn't need to
+// target it.
+class FrustumCuller {
+public:
+    // objects added since the last Resize start out unbounded, they pass every test
+    void Resize(uint32_t count);
+    uint32_t Size() const { return count; }
+    // bounds in model space, all zero marks the object unbounded
+    void SetBounds(uint32_t index, const MeshBounds &bounds, const glm::mat4 &model);
+    // indices of the visible objects in ascending order, visible is resized to the object count and trimmed
+    void Cull(const Frustum &frustum, JobSystem &jobSystem, std::vector<uint32_t> &visible);
+
+private:
+    uint32_t CullRange(const Frustum &frustum, uint32_t begin, uint32_t end, uint32_t *visible) const;
+
+    uint32_t count = 0;
+    // padded to a multiple of eight with objects that fail every test
+    std::vector<float> centerX, centerY, centerZ, radius;
+    std::vector<float> extentX, extentY, extentZ;
+    std::vector<uint32_t> rangeCounts;
+
+    // large enough that a job's setup is lost in its run time, a multiple of the SIMD width
+    static constexpr uint32_t objectsPerJob = 16384;
+};
+
+#endif //ROVSKI_FRUSTUMCULLER_HPP
@@ -0,0 +1,40 @@
+//
+//  GeometryArena.hpp
+//  Rovski
+//
+
+#ifndef ROVSKI_GEOMETRYARENA_HPP
+#define ROVSKI_GEOMETRYARENA_HPP
+
+#include <cstdint>
+#include "TlsfAllocator.hpp"
+
+struct MeshRange {
+    TlsfAllocator::Range vertices;
+    TlsfAllocator::Range indices;
+    uint32_t indexCount = 0;
+    uint32_t firstIndex = 0;
+    int32_t vertexOffset = 0;
+};
+
+// Hands out vertex and index ranges inside one shared vertex buffer and one
+// shared index buffer. Ranges are counted in elements, so a mesh is drawn
+// straight from firstIndex/vertexOffset and the buffers are bound once.
+class GeometryArena {
+public:
+    void Init(uint64_t vertexCapacity, uint64_t indexCapacity);
+    bool Allocate(uint32_t vertexCount, uint32_t indexCount, MeshRange &mesh);
+    void Free(MeshRange &mesh);
+
+    uint64_t VertexCapacity() const { return vertexAllocator.Capacity(); }
+    uint64_t IndexCapacity() const { return indexAllocator.Capacity(); }
+    uint64_t UsedVertices() const { return vertexAllocator.UsedSize(); }
+    uint64_t UsedIndices() const { return indexAllocator.UsedSize(); }
+    uint32_t MeshCount() const { return vertexAllocator.AllocationCount(); }
+
+private:
+    TlsfAllocator vertexAllocator;
+    TlsfAllocator indexAllocator;
+};
+
+#endif //ROVSKI_GEOMETRYARENA_HPP
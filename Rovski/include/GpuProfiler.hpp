@@ -0,0 +1,92 @@
+//
+//  GpuProfiler.hpp
+//  Rovski
+//
+
+#ifndef ROVSKI_GPUPROFILER_HPP
+#define ROVSKI_GPUPROFILER_HPP
+
+#include <vulkan/vulkan_core.h>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+struct GpuScopeResult {
+    std::string name;
+    uint32_t depth = 0;
+    double gpuMs = 0;
+    bool hasStatistics = false;
+    uint64_t inputAssemblyPrimitives = 0;
+    uint64_t vertexShaderInvocations = 0;
+    uint64_t clippingPrimitives = 0;
+    uint64_t fragmentShaderInvocations = 0;
+};
+
+struct GpuFrameResult {
+    uint64_t frameIndex = 0;
+    std::vector<GpuScopeResult> scopes;
+};
+
+// Timestamp and pipeline statistics queries, one pair of query pools per frame
+// in flight. Scopes are written while recording; a slot's results are read
+// without waiting when the slot is recorded again, which is after its fence
+// has passed, so results trail the current frame by the frames in flight.
+class GpuProfiler {
+public:
+    static constexpr uint32_t InvalidScope = UINT32_MAX;
+
+    bool Init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily, uint32_t frameCount,
+              bool statisticsSupported, bool inheritedQueriesSupported, uint32_t maxScopes = 32);
+    void Destroy();
+
+    // collects the slot's previous results and resets its pools, call outside a render pass
+    void BeginFrame(VkCommandBuffer commandBuffer, uint32_t frameSlot, uint64_t frameIndex);
+    uint32_t BeginScope(VkCommandBuffer commandBuffer, const char *name, bool statistics = false);
+    void EndScope(VkCommandBuffer commandBuffer, uint32_t scope);
+
+    bool Enabled() const { return enabled; }
+    bool StatisticsSupported() const { return statisticsSupported; }
+    bool InheritedQueriesSupported() const { return inheritedQueriesSupported; }
+    // statistics flags secondary command buffers must inherit while a statistics scope is open
+    VkQueryPipelineStatisticFlags ActiveStatistics() const;
+
+    const GpuFrameResult &LatestResult() const { return latest; }
+    const std::deque<GpuFrameResult> &History() const { return history; }
+    bool DumpCsv(const std::string &path) const;
+    bool DumpJson(const std::string &path) const;
+
+private:
+    struct ScopeRecord {
+        const char *name = nullptr;
+        uint32_t depth = 0;
+        uint32_t statisticsQuery = InvalidScope;
+    };
+
+    struct FrameQueries {
+        VkQueryPool timestampPool = VK_NULL_HANDLE;
+        VkQueryPool statisticsPool = VK_NULL_HANDLE;
+        std::vector<ScopeRecord> scopes;
+        uint32_t statisticsCount = 0;
+        uint64_t frameIndex = 0;
+    };
+
+    void Collect(FrameQueries &frame);
+
+    VkDevice device = VK_NULL_HANDLE;
+    bool enabled = false;
+    bool statisticsSupported = false;
+    bool inheritedQueriesSupported = false;
+    double timestampPeriodNs = 1;
+    uint64_t timestampMask = ~0ull;
+    uint32_t maxScopes = 0;
+    std::vector<FrameQueries> frames;
+    uint32_t currentSlot = 0;
+    uint32_t openDepth = 0;
+    uint32_t openStatistics = 0;
+    GpuFrameResult latest;
+    std::deque<GpuFrameResult> history;
+    static constexpr size_t historyLimit = 4096;
+};
+
+#endif //ROVSKI_GPUPROFILER_HPP
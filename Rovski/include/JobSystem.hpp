@@ -0,0 +1,70 @@
+//
+//  JobSystem.hpp
+//  Rovski
+//
+
+#ifndef ROVSKI_JOBSYSTEM_HPP
+#define ROVSKI_JOBSYSTEM_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads, each owning a deque. Owners pop from the back,
+// idle threads steal from the front of other deques. The thread that created
+// the system takes part as thread 0 whenever it waits, so per-thread resources
+// (command pools etc.) are indexed by CurrentThreadIndex() in [0, ThreadCount()).
+// Only the creating thread and the workers may submit or wait. Workers show up
+// in traces as "<threadName> <index>".
+class JobSystem {
+public:
+    using JobFunction = std::function<void(uint32_t threadIndex)>;
+    using RangeFunction = std::function<void(uint32_t begin, uint32_t end, uint32_t threadIndex)>;
+
+    struct Counter {
+        std::atomic<uint32_t> pending{0};
+    };
+
+    explicit JobSystem(uint32_t workerCount, std::string threadName = "worker");
+    ~JobSystem();
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    uint32_t ThreadCount() const { return static_cast<uint32_t>(queues.size()); }
+    void Submit(JobFunction function, Counter &counter);
+    void Wait(Counter &counter);
+    void ParallelFor(uint32_t count, uint32_t grain, const RangeFunction &function);
+    static uint32_t CurrentThreadIndex();
+    static uint32_t DefaultWorkerCount();
+
+private:
+    struct Job {
+        JobFunction function;
+        Counter *counter = nullptr;
+    };
+
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    bool PopOrSteal(uint32_t threadIndex, Job &job);
+    void Execute(Job &job, uint32_t threadIndex);
+    void WorkerLoop(uint32_t threadIndex);
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> workers;
+    std::string threadName;
+    std::atomic<bool> running{true};
+    std::atomic<uint32_t> queuedJobs{0};
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+};
+
+#endif //ROVSKI_JOBSYSTEM_HPP
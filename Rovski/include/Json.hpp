@@ -0,0 +1,53 @@
+//
+//  Json.hpp
+//  Rovski
+//
+
+#ifndef ROVSKI_JSON_HPP
+#define ROVSKI_JSON_HPP
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// Just enough JSON for asset headers such as glTF: a plain DOM, objects keep
+// their members in file order and are searched linearly, which is fine for the
+// handful of keys an asset object has. Lookups of missing members or out of
+// range elements return a shared null value so chains like
+// json["meshes"][0]["name"] never throw.
+class JsonValue {
+public:
+    enum class Type { Null, Bool, Number, String, Array, Object };
+
+    static bool Parse(const char *begin, const char *end, JsonValue &value, std::string &error);
+
+    Type GetType() const { return type; }
+    bool IsNull() const { return type == Type::Null; }
+    bool IsNumber() const { return type == Type::Number; }
+    bool IsString() const { return type == Type::String; }
+    bool IsArray() const { return type == Type::Array; }
+    bool IsObject() const { return type == Type::Object; }
+
+    bool AsBool(bool fallback = false) const { return type == Type::Bool ? boolean : fallback; }
+    double AsNumber(double fallback = 0) const { return type == Type::Number ? number : fallback; }
+    const std::string &AsString() const { return text; }
+    // array length or member count
+    size_t Size() const { return type == Type::Array ? elements.size() : members.size(); }
+    bool Has(const std::string &key) const;
+
+    const JsonValue &operator[](size_t index) const;
+    const JsonValue &operator[](const std::string &key) const;
+    const std::vector<std::pair<std::string, JsonValue>> &Members() const { return members; }
+
+private:
+    friend class JsonParser;
+
+    Type type = Type::Null;
+    bool boolean = false;
+    double number = 0;
+    std::string text;
+    std::vector<JsonValue> elements;
+    std::vector<std::pair<std::string, JsonValue>> members;
+};
+
+#endif //ROVSKI_JSON_HPP
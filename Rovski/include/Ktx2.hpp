@@ -0,0 +1,55 @@
+//
+//  Ktx2.hpp
+//  Rovski
+//
+
+#ifndef ROVSKI_KTX2_HPP
+#define ROVSKI_KTX2_HPP
+
+#include <vulkan/vulkan_core.h>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "MappedFile.hpp"
+
+struct Ktx2Level {
+    const uint8_t *data = nullptr;
+    uint64_t size = 0;
+};
+
+// KTX 2.0 2D textures without supercompression (no Basis Universal or zstd):
+// one layer, one face, any VkFormat FormatBlockInfo knows. Open maps the file
+// and the levels point straight into the mapping, so they can be handed to the
+// upload engine without another copy. A level count of 0 (mips to be
+// generated by the loader) reads as a single level. Write stores the levels
+// smallest first as the spec asks, with a basic data format descriptor and the
+// given key/value pairs, through a temporary file and a rename.
+class Ktx2File {
+public:
+    bool Open(const std::string &path);
+
+    VkFormat Format() const { return format; }
+    uint32_t Width() const { return width; }
+    uint32_t Height() const { return height; }
+    uint32_t LevelCount() const { return static_cast<uint32_t>(levels.size()); }
+    const std::vector<Ktx2Level> &Levels() const { return levels; }
+    // value of a key/value entry without its terminating null, empty when the key is absent
+    std::string Value(const std::string &key) const;
+
+    // levels[0] is the full size level, each one tightly packed rows of texel blocks
+    static bool Write(const std::string &path, VkFormat format, uint32_t width, uint32_t height, const std::vector<Ktx2Level> &levels,
+                      std::vector<std::pair<std::string, std::string>> keyValues);
+
+private:
+    bool Fail(const std::string &path, const char *message);
+
+    MappedFile file;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<Ktx2Level> levels;
+    std::vector<std::pair<std::string, std::string>> keyValues;
+};
+
+#endif //ROVSKI_KTX2_HPP
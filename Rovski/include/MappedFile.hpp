@@ -0,0 +1,42 @@
+//
+//  MappedFile.hpp
+//  Rovski
+//
+
+#ifndef ROVSKI_MAPPEDFILE_HPP
+#define ROVSKI_MAPPEDFILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read only mmap of a whole file. Pages come straight from the page cache,
+// nothing is copied through the heap, and the mapping is page aligned so
+// SPIR-V words or cache headers can be read in place. Empty files map to a
+// valid, zero sized view.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const std::string &path);
+    void Close();
+
+    bool IsOpen() const { return opened; }
+    const char *Data() const { return static_cast<const char*>(data); }
+    size_t Size() const { return size; }
+
+private:
+    void *data = nullptr;
+    size_t size = 0;
+    bool opened = false;
+};
+
+// 64 bit content hash (four multiply/rotate lanes, folded at the end), a few GB/s per core
+uint64_t HashBytes(const void *data, size_t size, uint64_t seed = 0);
+
+#endif //ROVSKI_MAPPEDFILE_HPP
@@ -0,0 +1,58 @@
+//
+//  MeshCache.hpp
+//  Rovski
+//
+
+#ifndef ROVSKI_MESHCACHE_HPP
+#define ROVSKI_MESHCACHE_HPP
+
+#include <cstdint>
+#include <string>
+#include "MappedFile.hpp"
+#include "MeshLoader.hpp"
+
+struct MeshCacheHeader {
+    char magic[4];
+    uint32_t version;
+    // Vertex layout the data was written with, compared field by field on open
+    uint32_t vertexStride;
+    uint32_t attributeCount;
+    uint32_t attributeOffsets[4];
+    uint32_t attributeFormats[4];
+    uint64_t sourceHash;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    float boundsMin[3];
+    float boundsMax[3];
+    // from the start of the file, both 16 byte aligned
+    uint64_t vertexDataOffset;
+    uint64_t indexDataOffset;
+};
+
+// Imported meshes stored as the exact bytes UploadMesh copies: a header, the
+// Vertex array in its in-memory layout and the uint32 indices. A cache is
+// opened by mapping it, the ranges go straight into the staging ring. It is
+// only used while the content hash of the source (and of the external buffers
+// of a .gltf) matches and the Vertex layout is unchanged.
+class MeshCache {
+public:
+    static constexpr uint32_t Version = 1;
+
+    static bool HashSource(const std::string &sourcePath, uint64_t &hash);
+    static bool Write(const std::string &cachePath, uint64_t sourceHash, const MeshData &mesh);
+
+    bool Open(const std::string &cachePath, uint64_t sourceHash);
+    void Close() { file.Close(); }
+
+    const MeshCacheHeader &Header() const { return *reinterpret_cast<const MeshCacheHeader*>(file.Data()); }
+    const void *VertexData() const { return file.Data() + Header().vertexDataOffset; }
+    const uint32_t *IndexData() const { return reinterpret_cast<const uint32_t*>(file.Data() + Header().indexDataOffset); }
+    MeshBounds Bounds() const;
+
+private:
+    static MeshCacheHeader ExpectedHeader();
+
+    MappedFile file;
+};
+
+#endif //ROVSKI_MESHCACHE_HPP
@@ -0,0 +1,49 @@
+//
+//  MeshLoader.hpp
+//  Rovski
+//
+
+#ifndef ROVSKI_MESHLOADER_HPP
+#define ROVSKI_MESHLOADER_HPP
+
+#include <vulkan/vulkan_core.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "BaseStructs.h"
+#include "JobSystem.hpp"
+
+struct MeshData {
+    std::string name;
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    MeshBounds bounds;
+};
+
+// Imports OBJ and glTF 2.0 (.gltf with external or data URI buffers, and .glb)
+// into one indexed triangle list per file. glTF node transforms of the default
+// scene are baked in and all primitives are merged; OBJ faces are fan
+// triangulated and position/texcoord pairs are deduplicated by hashing.
+// LoadAll runs one job per file, and inside a file the text parsing, the
+// deduplication and the attribute conversion are split into ranges over the
+// same job system, so large files scale with the worker count too. Texture
+// coordinates are flipped to Vulkan's top-left origin for OBJ; glTF already
+// uses it. Sources are mapped, not read, so text and glb buffers are parsed
+// in place. Only the thread that owns the job system or its workers may call in.
+class MeshLoader {
+public:
+    explicit MeshLoader(JobSystem &jobSystem) : jobSystem(jobSystem) {}
+
+    // format is picked by extension: .obj, .gltf or .glb
+    bool Load(const std::string &path, MeshData &mesh);
+    bool LoadAll(const std::vector<std::string> &paths, std::vector<MeshData> &meshes);
+
+private:
+    bool LoadObj(const std::string &path, MeshData &mesh);
+    bool LoadGltf(const std::string &path, MeshData &mesh);
+    void ComputeBounds(MeshData &mesh);
+
+    JobSystem &jobSystem;
+};
+
+#endif //ROVSKI_MESHLOADER_HPP
@@ -0,0 +1,36 @@
+//
+//  MipChain.hpp
+//  Rovski
+//
+
+#ifndef ROVSKI_MIPCHAIN_HPP
+#define ROVSKI_MIPCHAIN_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// levels down to 1x1, floor(log2(max(width, height))) + 1
+uint32_t MipLevelCount(uint32_t width, uint32_t height);
+
+// CPU mip chain for RGBA8 images, used ahead of block compression and when the
+// device can't blit a format with linear filtering. Every level is a 2x2 box
+// filter of the one above it; odd sizes drop the last row or column the way a
+// blit to floor(size / 2) does. UNORM data is averaged in 8 bit with SSE2 or
+// NEON, sRGB data is averaged in linear space through lookup tables so mips
+// don't darken. The chain holds levels 1..N-1 tightly packed, levelOffsets[i]
+// is where level i + 1 starts.
+struct MipChain {
+    std::vector<uint8_t> data;
+    std::vector<size_t> levelOffsets;
+    std::vector<uint32_t> widths;
+    std::vector<uint32_t> heights;
+
+    void Build(const uint8_t *level0, uint32_t width, uint32_t height, bool srgb);
+    uint32_t LevelCount() const { return static_cast<uint32_t>(levelOffsets.size()); }
+};
+
+// one 2x2 reduction from src (srcWidth x srcHeight) into dst (max(1, srcWidth / 2) x max(1, srcHeight / 2))
+void DownsampleRgba8(const uint8_t *src, uint32_t srcWidth, uint32_t srcHeight, uint8_t *dst, bool srgb);
+
+#endif //ROVSKI_MIPCHAIN_HPP
@@ -0,0 +1,35 @@
+//
+//  PipelineCache.hpp
+//  Rovski
+//
+
+#ifndef ROVSKI_PIPELINECACHE_HPP
+#define ROVSKI_PIPELINECACHE_HPP
+
+#include <vulkan/vulkan_core.h>
+#include <string>
+
+// One VkPipelineCache shared by every pipeline, seeded from a file at start
+// and written back at shutdown. The blob is only handed to the driver when
+// its header matches this device's vendor, device id and cache UUID, so a
+// driver update or another GPU silently falls back to a cold cache.
+class PipelineCache {
+public:
+    bool Init(VkPhysicalDevice physicalDevice, VkDevice device, const std::string &path);
+    void Destroy();
+    bool Save();
+
+    VkPipelineCache Handle() const { return cache; }
+    bool LoadedFromDisk() const { return loadedFromDisk; }
+
+private:
+    bool ReadValidBlob(std::string &blob);
+
+    VkPhysicalDeviceProperties properties{};
+    VkDevice device = VK_NULL_HANDLE;
+    VkPipelineCache cache = VK_NULL_HANDLE;
+    std::string path;
+    bool loadedFromDisk = false;
+};
+
+#endif //ROVSKI_PIPELINECACHE_HPP
@@ -0,0 +1,55 @@
+//
+//  ReadbackPool.hpp
+//  Rovski
+//
+
+#ifndef ROVSKI_READBACKPOOL_HPP
+#define ROVSKI_READBACKPOOL_HPP
+
+#include <vulkan/vulkan_core.h>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct ReadbackFrame {
+    uint64_t frameIndex = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t rowPitch = 0;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    const uint8_t *pixels = nullptr;
+};
+
+// Called on the readback worker thread, pixels are only valid until it returns.
+using ReadbackCallback = std::function<void(const ReadbackFrame &frame)>;
+
+// Writes an 8 bit RGBA/BGRA frame as binary PPM, alpha is dropped.
+bool WritePpm(const std::string &path, const ReadbackFrame &frame);
+
+// Host visible buffers that rendered frames are copied into. A slot is taken
+// when a frame is recorded and given back by whoever consumed the pixels,
+// possibly on a worker thread, so there are more slots than frames in flight
+// and slow consumers don't hold up rendering right away.
+class ReadbackPool {
+public:
+    struct Slot {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        void *mapped = nullptr;
+    };
+
+    void Init(std::vector<Slot> slots);
+    bool TryAcquire(uint32_t &slot);
+    void Release(uint32_t slot);
+
+    const Slot &Get(uint32_t slot) const { return slots[slot]; }
+    uint32_t Size() const { return static_cast<uint32_t>(slots.size()); }
+
+private:
+    std::vector<Slot> slots;
+    std::vector<uint32_t> freeSlots;
+    std::mutex mutex;
+};
+
+#endif //ROVSKI_READBACKPOOL_HPP
@@ -16,6 +16,22 @@
 #include <optional>
 #include <string>
 #include <chrono>
+#include <functional>
+#include <memory>
+#include "BaseStructs.h"
+#include "DeviceMemoryAllocator.hpp"
+#include "UniformRingBuffer.hpp"
+#include "JobSystem.hpp"
+#include "UploadEngine.hpp"
+#include "GeometryArena.hpp"
+#include "PipelineCache.hpp"
+#include "ReadbackPool.hpp"
+#include "GpuProfiler.hpp"
+#include "MeshLoader.hpp"
+#include "BlockCompression.hpp"
+#include "Ktx2.hpp"
+#include "TextureStreamer.hpp"
+#include "FrustumCuller.hpp"
 
 using TimePointType = decltype(std::chrono::high_resolution_clock::now());
 
@@ -25,6 +41,69 @@ struct SwapChainSupportDetail{
     std::vector<VkPresentModeKHR> PresentModes;
 };
 
+struct FrameStats {
+    uint64_t frameIndex = 0;
+    uint32_t drawCount = 0;
+    // draws left after CPU frustum culling, the ones recorded. GPU driven frames cull on the GPU, there it's drawCount
+    uint32_t visibleCount = 0;
+    double cullMs = 0;
+    double frameMs = 0;
+    double recordMs = 0;
+    // GPU time of the newest frame with results, trails frameIndex by the frames in flight
+    double gpuMs = 0;
+    uint32_t recordThreads = 1;
+};
+
+// called after every frame RunFrames submits, without waiting for the device in between
+using FrameCallback = std::function<void(const FrameStats &stats)>;
+
+struct StartupStats {
+    double initMs = 0;
+    double pipelineMs = 0;
+    bool pipelineCacheLoaded = false;
+};
+
+// texture 0 is the one requested at Init, every texture owns a descriptor set that also points at the uniform ring.
+// A texture without a view is still streaming and its set samples the placeholder.
+struct Texture {
+    VkImage image = VK_NULL_HANDLE;
+    MemoryAllocation memory;
+    VkImageView view = VK_NULL_HANDLE;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+};
+
+// a requested texture on its way in: levels [residentLevel, levels) are uploaded, [boundLevel, levels) are in its view
+struct StreamingTexture {
+    uint32_t texture = 0;
+    uint32_t ticket = 0;
+    float hint = 0;
+    float priority = 0;
+    std::unique_ptr<PreparedTexture> prepared;
+    uint32_t residentLevel = 0;
+    uint32_t boundLevel = 0;
+};
+
+// Color is the only pass without the depth prepass. With it every draw is recorded twice: Depth lays down
+// depth only, then ColorOnDepth shades against the finished depth
+enum class DrawPass { Color, Depth, ColorOnDepth };
+
+// Single is frustum culling alone. With occlusion culling Early draws what was visible last frame, Late tests every
+// object against the depth pyramid Early left behind and draws what Early missed
+enum class CullPhase : uint32_t { Single, Early, Late };
+
+// the draws of one texture, drawn by one indirect call: the cull shader appends their commands to [base, base + capacity)
+struct IndirectBatch {
+    uint32_t texture = 0;
+    uint32_t base = 0;
+    uint32_t capacity = 0;
+};
+
+struct ThreadRecordContext {
+    VkCommandPool pool = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> secondaryBuffers;
+    uint32_t used = 0;
+};
+
 struct QueueFamilyIndices {
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
@@ -37,12 +116,82 @@ struct QueueFamilyIndices {
 
 class Rovski {
 public:
+    static constexpr uint32_t AutoWorkerCount = UINT32_MAX;
     Rovski();
     virtual ~Rovski();
     void Run();
-    bool Init(uint32_t windowWidth, uint32_t windowHeight, uint32_t maxFrameInFlight = 2);
+    void RunFrames(uint32_t frameCount, const FrameCallback &onFrame = {});
+    void SetDrawList(std::vector<DrawCommand> draws);
+    // moves one draw of the list, keeping its culling bounds in step. Indices past the end are ignored
+    void SetDrawTransform(uint32_t draw, const glm::mat4 &model);
+    // Draws mesh once per instance with a single instanced call, each with its own transform and tint, on top of
+    // the draw list. Instances are never culled. Every frame in flight draws from its own copy, so updating them
+    // each frame never waits for the device, a frame grows its copy once its fence passed; an empty list removes them
+    bool SetInstances(const MeshRange &mesh, uint32_t texture, const std::vector<Instance> &instances);
+    const FrameStats &GetFrameStats() const;
+    const StartupStats &GetStartupStats() const;
+    const GpuProfiler &GetGpuProfiler() const;
+    // for asset loading (MeshLoader etc.) on the calling thread, the one that called Init
+    JobSystem &GetJobSystem() { return *jobSystem; }
+    void SetPipelineCachePath(std::string path);
+    // must be called before Init; no window, surface or swapchain, frames go to offscreen images
+    void SetHeadless(bool headless);
+    void SetReadbackCallback(ReadbackCallback callback);
+    void SetReadbackDirectory(std::string directory);
+    bool Init(uint32_t windowWidth, uint32_t windowHeight, uint32_t maxFrameInFlight = 2, uint32_t workerCount = AutoWorkerCount);
     bool Clean();
     void OnFrameBufferSized();
+    MemoryStats GetMemoryStats() const;
+    bool UploadMesh(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, MeshRange &mesh);
+    bool UploadMesh(const void *vertices, uint32_t vertexCount, const uint32_t *indices, uint32_t indexCount, MeshRange &mesh);
+    // imports path (OBJ/glTF) or maps its binary cache next to it (path + ".rvmesh") when the source hash still matches
+    bool LoadMesh(const std::string &path, MeshRange &mesh, MeshBounds *bounds = nullptr);
+    void FreeMesh(MeshRange &mesh);
+    const MeshRange &GetDemoMesh() const { return demoMesh; }
+    // tightly packed RGBA8 sRGB texels, the returned index goes into DrawCommand::texture
+    bool CreateTexture(uint32_t width, uint32_t height, const void *pixels, uint32_t &texture);
+    // .ktx2 files upload their levels as stored. Anything stb_image reads is encoded once, mips included, to the
+    // best BC format the device samples and cached next to it as path + ".ktx2" while the source hash matches
+    bool LoadTexture(const std::string &path, uint32_t &texture, TextureKind kind = TextureKind::Color);
+    // Returns at once with a texture that samples a grey placeholder. Decoding runs on the texture workers, most
+    // important first: priority plus the screen area of the draws that reference the texture. The smallest mips
+    // land together and the larger ones follow within a per frame upload budget
+    bool RequestTexture(const std::string &path, uint32_t &texture, TextureKind kind = TextureKind::Color, float priority = 0);
+    // blocks until every requested texture is decoded and uploaded in full, for captures that need the final image
+    void FinishTextureStreaming();
+    // Lays down depth with a position only pass before shading, which then tests EQUAL without writing, so each
+    // pixel is shaded once. Worth it with expensive fragments and deep overdraw, otherwise it only doubles the
+    // vertex work. Can be switched between frames
+    void SetDepthPrepass(bool enabled);
+    bool GetDepthPrepass() const { return depthPrepass; }
+    // Tests every draw's bounds against the view frustum before recording, draws without bounds always pass. On by
+    // default, can be switched between frames
+    void SetFrustumCulling(bool enabled);
+    bool GetFrustumCulling() const { return frustumCulling; }
+    // Culls on the GPU: a compute pass tests the object buffer against the frustum and appends the visible draws
+    // to an indirect buffer, then one vkCmdDrawIndexedIndirectCount per texture draws them. The CPU cost of a
+    // frame no longer grows with the draw count. Needs drawIndirectCount, multiDrawIndirect and
+    // drawIndirectFirstInstance, otherwise the CPU path stays. Can be switched between frames
+    void SetGpuDriven(bool enabled);
+    bool GetGpuDriven() const { return gpuDriven; }
+    // Two phase occlusion culling for GPU driven frames: last frame's visible objects are drawn first, their depth
+    // is reduced into a pyramid of farthest depths, then every object's screen rect is tested against it and
+    // the newly visible ones are drawn on top. Pays off with heavy occluders in front of many objects, costs a
+    // split render pass and a compute pass otherwise. Can be switched between frames
+    void SetOcclusionCulling(bool enabled);
+    bool GetOcclusionCulling() const { return occlusionCulling; }
+    // Draws through one table of every texture and the GPU driven buffers instead of a descriptor set per texture.
+    // Draws pass their model and texture index as push constants, so a frame binds descriptors once per pass, and
+    // GPU driven frames draw everything with a single indirect call. Needs descriptor indexing (runtime arrays,
+    // partially bound, update after bind, non uniform sampled image indexing). Can be switched between frames
+    void SetBindless(bool enabled);
+    bool GetBindless() const { return bindless; }
+    // encoder effort for textures that miss their cache, call before Init to cover the default texture too
+    void SetTextureQuality(EncodeQuality quality);
+    // texture 0, requested at Init, call before Init
+    void SetDefaultTexture(std::string path);
+    uint32_t GetTextureCount() const { return static_cast<uint32_t>(textures.size()); }
+    std::string GetDeviceName() const;
     static VKAPI_ATTR VkBool32 VKAPI_CALL VkApiCallDebugCallBack(
         VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType,
         const VkDebugUtilsMessengerCallbackDataEXT *CallBackData, void* userData);
@@ -65,14 +214,46 @@ private:
     VkSurfaceFormatKHR ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
     VkPresentModeKHR ChooseSwapChainPresentMode(const std::vector<VkPresentModeKHR> &avialablePresentModes);
     VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilites);
-    bool CreateSwapChain();
+    bool CreateSwapChain(VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE);
+    bool CreateOffscreenTargets();
+    bool CreateReadbackBuffers();
+    bool NeedReadback() const;
+    void RecordReadback(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+    void DeliverReadback(uint32_t frame);
+    void FlushReadbacks();
     bool CreateImageViews();
+    VkFormat FindDepthFormat() const;
+    bool CreateDepthResources();
     bool CreateGraphicsPipeline();
-    bool CreateShaderModule(const std::vector<char> &code, VkShaderModule &shaderModule);
+    bool CreateCullPipeline();
+    bool CreateDepthReducePipeline();
+    bool CreateDepthPyramid();
+    void DestroyDepthPyramid();
+    void WriteCullFrameDescriptors();
+    bool CreateShaderModule(const std::string &path, VkShaderModule &shaderModule);
     bool CreateRenderPass();
     bool CreateFrameBuffer();
     bool CreateCommandPool();
     bool CreateCommandBuffer();
+    bool RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+    void BindDrawState(VkCommandBuffer commandBuffer, VkPipeline pipeline);
+    // begin and end index visibleDraws, uniformOffset holds view and projection for the bindless path
+    void RecordDrawRange(VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end, DrawPass pass, uint32_t uniformOffset);
+    void BindBindlessSets(VkCommandBuffer commandBuffer, uint32_t uniformOffset);
+    // returns the uniform offset of the cull data, the late phase reuses it
+    uint32_t RecordGpuCulling(VkCommandBuffer commandBuffer, CullPhase phase);
+    void RecordCullDispatch(VkCommandBuffer commandBuffer, CullPhase phase, uint32_t cullOffset);
+    void RecordDepthPyramid(VkCommandBuffer commandBuffer);
+    void RecordIndirectDraws(VkCommandBuffer commandBuffer, DrawPass pass, uint32_t uniformOffset, CullPhase phase);
+    void RecordInstances(VkCommandBuffer commandBuffer, DrawPass pass, uint32_t uniformOffset);
+    void UpdateDrawBounds();
+    void CullDraws();
+    bool UploadGpuObjects();
+    bool UploadInstances();
+    bool CreateGpuObjectBuffers(uint32_t objectCount, uint32_t batchCount);
+    // points the current frame's sets at the latest upload, its fence passed so its own indirect buffers can grow
+    bool BindFrameGpuObjects();
+    VkCommandBuffer AcquireSecondaryCommandBuffer(uint32_t threadIndex);
     bool CreateSyncObjects();
     void DrawFrame();
     void RecreateSwapChain();
@@ -80,48 +261,134 @@ private:
     bool CreateVertexBuffer();
     bool CreateIndexBuffer();
     uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
-    bool CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory, bool needTransfer);
-    bool CopyBuffer(VkBuffer &dst, VkBuffer &src, VkDeviceSize size);
+    bool CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation& bufferMemory, bool needTransfer);
+    void DestroyBuffer(VkBuffer& buffer, MemoryAllocation& bufferMemory);
+    // destroyed once the frames in flight that may read it are done
+    void RetireBuffer(VkBuffer& buffer, MemoryAllocation& bufferMemory);
+    void ReleaseRetiredBuffers(bool all);
     bool CreateDescriptorLayout();
     bool CreateUniformBuffers();
-    void UpdateUniformBuffer(uint32_t imageIndex);
+    void UpdateUniformBuffer();
+    bool EnsureUniformCapacity(size_t drawCount);
     void UpdateTime();
     bool CreateDescriptorPool();
     bool CreateDescriptorSet();
+    bool WriteTextureDescriptorSet(Texture &texture);
+    bool CreateBindlessTable();
+    // queues the texture's slot for every frame's table, each frame writes its own once its fence passed
+    void WriteBindlessTexture(uint32_t texture);
+    void FlushBindlessTable();
+    void WriteBindlessBuffers(uint32_t frame);
     bool CreateTextureImage();
-    bool CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usageFlags, VkMemoryPropertyFlags propertyFlags, VkImage &image, VkDeviceMemory &imageMemory);
-    VkCommandBuffer BeginSingleTimeCommands();
-    void EndSingleTimeCommands(VkCommandBuffer commandBuffer);
-    void TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
-    void CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
-    bool CreateTextureImageView();
-    VkImageView CreateImageView(VkImage image, VkFormat format);
+    bool UploadTexture(uint32_t width, uint32_t height, const void *pixels, Texture &texture);
+    bool LoadTextureImage(const std::string &path, TextureKind kind, Texture &texture);
+    TextureRequest MakeTextureRequest(const std::string &path, TextureKind kind) const;
+    void StreamTextures();
+    void UpdateTexturePriorities();
+    bool BeginStreamedTexture(StreamingTexture &streaming, std::unique_ptr<PreparedTexture> prepared);
+    bool UploadStreamedLevel(StreamingTexture &streaming, uint32_t level);
+    bool BindStreamedLevels(StreamingTexture &streaming);
+    void ReleaseRetiredBindings(bool all);
+    bool UploadTextureLevels(VkFormat format, uint32_t width, uint32_t height, const std::vector<Ktx2Level> &levels, Texture &texture);
+    bool AddTexture(Texture &created, uint32_t &texture);
+    void DeferDestroyTexture(Texture &texture);
+    bool SupportsSampling(VkFormat format) const;
+    bool SelectBlockFormat(TextureKind kind, bool hasAlpha, BlockFormat &format) const;
+    VkFormat SelectTextureFormat(TextureKind kind, bool hasAlpha) const;
+    bool CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usageFlags, VkMemoryPropertyFlags propertyFlags, VkImage &image, MemoryAllocation &imageMemory, uint32_t mipLevels = 1);
+    void DestroyImage(VkImage& image, MemoryAllocation& imageMemory);
+    void TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t baseMipLevel = 0, uint32_t levelCount = 1);
+    VkImageView CreateImageView(VkImage image, VkFormat format, uint32_t mipLevels = 1, uint32_t baseMipLevel = 0,
+                                VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT);
+    bool SupportsLinearBlit(VkFormat format) const;
     bool CreateTextureSampler();
 
     VkInstance vkInstance;
-    GLFWwindow* window;
+    GLFWwindow* window = nullptr;
     uint32_t windowWidth;
     uint32_t windowHeight;
-    VkSurfaceKHR vkSurface;
+    VkSurfaceKHR vkSurface = VK_NULL_HANDLE;
     VkDebugUtilsMessengerEXT vkDebugMessager;
     VkPhysicalDevice vkPhysicalDevice = VK_NULL_HANDLE;
-    VkDevice vkDevice;
+    VkDevice vkDevice = VK_NULL_HANDLE;
+    DeviceMemoryAllocator memoryAllocator;
+    PipelineCache pipelineCache;
+    GpuProfiler gpuProfiler;
+    std::string pipelineCachePath = "rovski_pipeline.cache";
+    StartupStats startupStats;
     VkQueue vkGraphicsQueue;
     VkQueue vkPresentQueue;
     VkQueue vkTransferQueue;
     VkPhysicalDeviceFeatures vkDeviceFeatures{};
-    VkSwapchainKHR vkSwapChain;
+    VkPhysicalDeviceVulkan12Features vkDeviceFeatures12{};
+    VkSwapchainKHR vkSwapChain = VK_NULL_HANDLE;
+    bool headless = false;
+    std::vector<MemoryAllocation> offscreenImageMemory;
+    ReadbackPool readbackPool;
+    std::vector<VkBuffer> vkReadbackBuffers;
+    std::vector<MemoryAllocation> readbackBufferMemory;
+    std::vector<uint32_t> frameReadbackSlot;
+    std::vector<uint64_t> frameReadbackIndex;
+    std::unique_ptr<JobSystem> readbackJobs;
+    JobSystem::Counter readbackCounter;
+    ReadbackCallback readbackCallback;
+    std::string readbackDirectory;
     std::vector<VkImage> vkSwapChainImages;
     VkFormat vkSwapChainFormat;
     VkExtent2D vkSwapChainExtent;
     std::vector<VkImageView> vkSwapChainImageViews;
+    // one depth image for all swapchain images, the render pass dependency orders its use across frames
+    VkFormat vkDepthFormat = VK_FORMAT_UNDEFINED;
+    VkImage vkDepthImage = VK_NULL_HANDLE;
+    MemoryAllocation depthImageMemory;
+    VkImageView vkDepthImageView = VK_NULL_HANDLE;
+    // depth aspect only, what the depth pyramid samples
+    VkImageView vkDepthSampleView = VK_NULL_HANDLE;
     VkRenderPass vkRenderPass;
+    // the frame split around the depth pyramid: the early pass stores depth, the late pass loads both attachments
+    VkRenderPass vkEarlyRenderPass = VK_NULL_HANDLE;
+    VkRenderPass vkLateRenderPass = VK_NULL_HANDLE;
     VkDescriptorSetLayout vkDescriptorSetLayout;
     VkPipelineLayout vkPipelineLayout;
     VkPipeline vkGraphicsPipeline;
+    VkPipeline vkDepthPrepassPipeline;
+    VkPipeline vkDepthEqualPipeline;
+    bool depthPrepass = false;
+    // the same three with the instance stream on binding 1
+    VkPipeline vkInstancedPipeline = VK_NULL_HANDLE;
+    VkPipeline vkInstancedPrepassPipeline = VK_NULL_HANDLE;
+    VkPipeline vkInstancedEqualPipeline = VK_NULL_HANDLE;
+    // the indirect variants of the main, prepass and depth equal pipelines, set 1 holds the object buffer
+    VkDescriptorSetLayout vkObjectSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout vkIndirectPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline vkIndirectPipeline = VK_NULL_HANDLE;
+    VkPipeline vkIndirectPrepassPipeline = VK_NULL_HANDLE;
+    VkPipeline vkIndirectEqualPipeline = VK_NULL_HANDLE;
+    // Bindless: set 0 is only there for the uniform block, set 1 is the table. Its texture array is indexed by
+    // texture, its storage buffer array by the slots in Rovski.cpp. Every frame in flight owns a table, a slot is
+    // only ever written in a table no submitted frame still reads
+    bool bindlessSupported = false;
+    bool bindless = false;
+    VkDescriptorSetLayout vkBindlessSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout vkBindlessPipelineLayout = VK_NULL_HANDLE;
+    VkDescriptorPool vkBindlessPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> vkBindlessSets;
+    std::vector<std::vector<uint32_t>> pendingBindlessTextures;
+    VkPipeline vkBindlessPipeline = VK_NULL_HANDLE;
+    VkPipeline vkBindlessPrepassPipeline = VK_NULL_HANDLE;
+    VkPipeline vkBindlessEqualPipeline = VK_NULL_HANDLE;
+    VkPipeline vkBindlessIndirectPipeline = VK_NULL_HANDLE;
+    VkPipeline vkBindlessIndirectPrepassPipeline = VK_NULL_HANDLE;
+    VkPipeline vkBindlessIndirectEqualPipeline = VK_NULL_HANDLE;
+    // the color pass reuses the uniform block its depth pass pushed
+    std::vector<uint32_t> drawUniformOffsets;
     std::vector<VkFramebuffer> vkSwapChainFrameBuffers;
     VkCommandPool vkCommandPool;
-    std::vector<VkCommandBuffer> vkCommandBuffer;
+    std::vector<VkCommandPool> vkFrameCommandPools;
+    std::vector<VkCommandBuffer> vkFrameCommandBuffers;
+    std::unique_ptr<JobSystem> jobSystem;
+    std::vector<ThreadRecordContext> threadRecordContexts;
+    std::vector<VkCommandBuffer> chunkCommandBuffers;
     std::vector<VkSemaphore> vkImageAvailableSemaphore;
     std::vector<VkSemaphore> vkRenderFinishSemaphore;
     std::vector<VkFence> vkInFlightFences;
@@ -130,24 +397,125 @@ private:
     std::vector<VkFence> vkImagesInFlight;
     bool frameBufferResized = false;
     VkBuffer vkVertexBuffer;
-    VkDeviceMemory vkVertextBufferMemory;
+    MemoryAllocation vertexBufferMemory;
     VkBuffer vkIndexBuffer;
-    VkDeviceMemory vkIndextBufferMemory;
-    VkCommandPool vkTransferCommandPool;
-    std::vector<VkDeviceMemory> vkUniformBuffersMemory;
-    std::vector<VkBuffer> vkUniformBuffers;
+    MemoryAllocation indexBufferMemory;
+    GeometryArena geometryArena;
+    VkDeviceSize vertexArenaSize = 64ull << 20;
+    VkDeviceSize indexArenaSize = 32ull << 20;
+    MeshRange demoMesh;
+    std::vector<std::pair<uint64_t, MeshRange>> pendingMeshFrees;
+    std::vector<std::pair<uint64_t, std::pair<VkBuffer, MemoryAllocation>>> retiredBuffers;
+    // one instance buffer per frame in flight, a stale one is refreshed from instanceData once its frame's fence passed
+    std::vector<VkBuffer> vkInstanceBuffers;
+    std::vector<MemoryAllocation> instanceBufferMemory;
+    std::vector<uint32_t> instanceBufferCapacity;
+    std::vector<uint8_t> instanceBuffersStale;
+    std::vector<Instance> instanceData;
+    uint32_t instanceCapacity = 0;
+    uint32_t instanceCount = 0;
+    MeshRange instancedMesh;
+    uint32_t instancedTexture = 0;
+    UploadEngine uploadEngine;
+    VkBuffer vkStagingBuffer;
+    MemoryAllocation stagingBufferMemory;
+    VkDeviceSize stagingRingSize = 32ull << 20;
+    uint64_t uploadValueRequired = 0;
+    VkBuffer vkUniformBuffer;
+    MemoryAllocation uniformBufferMemory;
+    UniformRingBuffer uniformRing;
+    VkDeviceSize uniformSliceSize = 2ull << 20;
+    VkDeviceSize uniformAlignment = 256;
+    glm::mat4 frameView = glm::mat4(1);
+    glm::mat4 frameProjection;
+    std::vector<DrawCommand> drawList;
+    bool useDemoScene = true;
+    // world space bounds of drawList, and the indices into it that get recorded this frame
+    FrustumCuller frustumCuller;
+    std::vector<uint32_t> visibleDraws;
+    bool frustumCulling = true;
+    // GPU driven path: objects mirror drawList on the device, the cull pass runs on the graphics queue since the
+    // same frame draws its output. Each frame in flight owns its commands and counts
+    bool gpuDrivenSupported = false;
+    bool gpuDriven = false;
+    bool gpuObjectsStale = true;
+    VkDescriptorSetLayout vkCullSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout vkCullPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline vkCullPipeline = VK_NULL_HANDLE;
+    VkDescriptorPool vkGpuDrivenDescriptorPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> vkObjectDescriptorSets;
+    std::vector<VkDescriptorSet> vkCullDescriptorSets;
+    // every upload gets new objects and batches, the frames in flight keep reading the ones they were recorded
+    // with. A frame's sets point at the upload it last bound, its indirect buffers are grown then too
+    uint64_t gpuObjectUpload = 0;
+    uint64_t gpuCapacityUpload = 0;
+    std::vector<uint64_t> frameGpuObjectUpload;
+    VkBuffer vkObjectBuffer = VK_NULL_HANDLE;
+    MemoryAllocation objectBufferMemory;
+    VkBuffer vkBatchBaseBuffer = VK_NULL_HANDLE;
+    MemoryAllocation batchBaseBufferMemory;
+    std::vector<VkBuffer> vkIndirectBuffers;
+    std::vector<MemoryAllocation> indirectBufferMemory;
+    std::vector<VkBuffer> vkIndirectCountBuffers;
+    std::vector<MemoryAllocation> indirectCountBufferMemory;
+    // Occlusion culling. Commands and counts hold the early phase in their first half and the late phase in the
+    // second, visibility is one flag per object shared by all frames. The pyramid is R32 float in GENERAL layout,
+    // a power of two no larger than the swapchain
+    bool occlusionCullingSupported = false;
+    bool occlusionCulling = false;
+    bool visibilityStale = true;
+    VkBuffer vkVisibilityBuffer = VK_NULL_HANDLE;
+    MemoryAllocation visibilityBufferMemory;
+    // the texture of every object, what bindless GPU driven draws sample
+    VkBuffer vkObjectTextureBuffer = VK_NULL_HANDLE;
+    MemoryAllocation objectTextureBufferMemory;
+    VkImage vkDepthPyramid = VK_NULL_HANDLE;
+    MemoryAllocation depthPyramidMemory;
+    VkImageView vkDepthPyramidView = VK_NULL_HANDLE;
+    std::vector<VkImageView> vkDepthPyramidLevelViews;
+    VkExtent2D depthPyramidExtent{1, 1};
+    uint32_t depthPyramidLevels = 1;
+    VkSampler vkDepthPyramidSampler = VK_NULL_HANDLE;
+    VkDescriptorSetLayout vkDepthReduceSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout vkDepthReducePipelineLayout = VK_NULL_HANDLE;
+    VkPipeline vkDepthReducePipeline = VK_NULL_HANDLE;
+    // one per level, reading the level above (the depth image for level 0) and writing its own
+    std::vector<VkDescriptorSet> vkDepthReduceSets;
+    uint32_t objectCapacity = 0;
+    uint32_t batchCapacity = 0;
+    std::vector<IndirectBatch> indirectBatches;
+    // batch of every texture index, UINT32_MAX for textures no draw uses
+    std::vector<uint32_t> textureBatches;
+    // draws moved by SetDrawTransform since the last frame, written into the object buffer before culling
+    std::vector<uint32_t> dirtyObjects;
+    // per draw, set while it is in dirtyObjects
+    std::vector<uint8_t> objectDirty;
+    FrameStats frameStats;
     TimePointType startTime;
     TimePointType currentTime;
     double currentTimeFromStart = 0;
     double preFrameTimeFromStart = 0;
     double deltaTime = 0;
     VkDescriptorPool  vkDescriptorPool;
-    std::vector<VkDescriptorSet> vkDescriptorSet;
-    VkImage vkTextureImage;
-    VkDeviceMemory vkTextureMemory;
-    VkImageView vkTextureImageView;
+    std::vector<Texture> textures;
+    uint32_t maxTextures = 1024;
+    uint32_t maxBindlessBuffers = 64;
+    EncodeQuality textureQuality = EncodeQuality::Normal;
+    std::string defaultTexturePath;
+    std::unique_ptr<TextureStreamer> textureStreamer;
+    std::vector<StreamingTexture> streamingTextures;
+    // views and descriptor sets replaced by a larger mip range, released once the frames using them are done
+    std::vector<std::pair<uint64_t, Texture>> retiredTextureBindings;
+    std::vector<float> textureImportance;
+    Texture placeholderTexture;
+    // levels at most this large go up together as soon as a texture is decoded
+    uint32_t streamTailSize = 64;
+    VkDeviceSize streamBytesPerFrame = 4ull << 20;
     VkSampler vkTextureSampler;
     
+    static constexpr uint32_t minDrawsPerSecondary = 256;
+    // enough for a 32768 wide swapchain
+    static constexpr uint32_t maxDepthPyramidLevels = 16;
     static const std::vector<const char*> deviceExtensions;
     static const std::vector<const char*> validationLayers;
 
@@ -0,0 +1,39 @@
+//
+//  StagingRing.hpp
+//  Rovski
+//
+
+#ifndef ROVSKI_STAGINGRING_HPP
+#define ROVSKI_STAGINGRING_HPP
+
+#include <vulkan/vulkan_core.h>
+#include <cstdint>
+
+// Fixed size ring over one persistently mapped staging buffer. Positions grow
+// monotonically, the byte offset is position % capacity. The owner hands out
+// space at the head and moves the tail forward once the GPU work that read a
+// range has completed, so staging memory stays bounded however much is
+// streamed through it.
+class StagingRing {
+public:
+    void Init(VkBuffer buffer, void *mapped, uint64_t capacity);
+
+    // Contiguous range of exactly size bytes, false when the ring is too full.
+    bool Allocate(uint64_t size, uint64_t alignment, uint64_t &offset);
+    void Release(uint64_t position) { if (position > tail) tail = position; }
+
+    void *Mapped(uint64_t offset) const { return mapped + offset; }
+    VkBuffer Buffer() const { return buffer; }
+    uint64_t Capacity() const { return capacity; }
+    uint64_t Head() const { return head; }
+    uint64_t UsedSize() const { return head - tail; }
+
+private:
+    VkBuffer buffer = VK_NULL_HANDLE;
+    char *mapped = nullptr;
+    uint64_t capacity = 0;
+    uint64_t head = 0;
+    uint64_t tail = 0;
+};
+
+#endif //ROVSKI_STAGINGRING_HPP
@@ -0,0 +1,115 @@
+//
+//  TextureStreamer.hpp
+//  Rovski
+//
+
+#ifndef ROVSKI_TEXTURESTREAMER_HPP
+#define ROVSKI_TEXTURESTREAMER_HPP
+
+#include <vulkan/vulkan_core.h>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include "BlockCompression.hpp"
+#include "JobSystem.hpp"
+#include "Ktx2.hpp"
+
+// Color is sRGB and may carry alpha; NormalMap is linear and only red/green are kept once compressed (BC5)
+enum class TextureKind { Color, NormalMap };
+
+// format a texture ends up in on this device, compressed picks the encoder for it
+struct TextureFormatChoice {
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    bool compressed = false;
+    BlockFormat blockFormat = BlockFormat::BC1;
+};
+
+// everything a load needs up front, the device side formats are chosen by the caller so workers never query the device
+struct TextureRequest {
+    std::string path;
+    TextureKind kind = TextureKind::Color;
+    EncodeQuality quality = EncodeQuality::Normal;
+    TextureFormatChoice opaque;
+    TextureFormatChoice alpha;
+};
+
+// CPU side of a loaded texture, levels[0] is the full size level. The levels
+// point into ktx when it came from a .ktx2 file and into storage otherwise.
+struct PreparedTexture {
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<Ktx2Level> levels;
+    Ktx2File ktx;
+    std::vector<std::vector<uint8_t>> storage;
+};
+
+// .ktx2 paths load as stored. Anything else goes through its path + ".ktx2"
+// cache while the cache matches the source hash, kind, quality and formats;
+// otherwise it's decoded with stb_image, filtered into mips, block compressed
+// on jobSystem and the cache is rewritten. Safe to call from any thread that
+// may use jobSystem.
+bool PrepareTexture(const TextureRequest &request, JobSystem &jobSystem, PreparedTexture &prepared);
+
+// Decodes textures on a pool of its own, so a slow image never ends up inside
+// a frame's job waits, most important request first. Request and SetPriority
+// only queue work; Pump starts decodes up to the in-flight limit from a binary
+// heap (stale entries are skipped when a priority changes), and TakeReady
+// hands finished ones back, most important first. Everything except the
+// decoding runs on the thread that created the streamer.
+class TextureStreamer {
+public:
+    explicit TextureStreamer(uint32_t workerCount);
+    ~TextureStreamer();
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    // returns the ticket TakeReady reports the texture under, higher priorities decode first
+    uint32_t Request(TextureRequest request, float priority);
+    // only reorders requests that haven't started decoding
+    void SetPriority(uint32_t ticket, float priority);
+    void Pump();
+    // prepared is null when the texture failed to load, the reason has been printed
+    bool TakeReady(uint32_t &ticket, std::unique_ptr<PreparedTexture> &prepared);
+    // decodes everything still queued, the calling thread helps
+    void Finish();
+    bool Idle() const { return queuedCount == 0 && decoding.empty(); }
+
+private:
+    enum class State { Queued, Decoding, Taken };
+
+    struct Entry {
+        TextureRequest request;
+        float priority = 0;
+        uint32_t version = 0;
+        State state = State::Queued;
+        std::unique_ptr<PreparedTexture> prepared;
+        std::atomic<bool> done{false};
+    };
+
+    struct HeapItem {
+        float priority;
+        uint32_t ticket;
+        uint32_t version;
+        // max-heap on priority, older tickets first among equals
+        bool operator<(const HeapItem &other) const {
+            return priority < other.priority || (priority == other.priority && ticket > other.ticket);
+        }
+    };
+
+    void Start(uint32_t count);
+
+    JobSystem jobs;
+    JobSystem::Counter counter;
+    // a deque so decoding jobs keep their entry while new requests are appended
+    std::deque<Entry> entries;
+    std::vector<HeapItem> heap;
+    std::vector<uint32_t> decoding;
+    uint32_t queuedCount = 0;
+    uint32_t maxDecoding;
+};
+
+#endif //ROVSKI_TEXTURESTREAMER_HPP
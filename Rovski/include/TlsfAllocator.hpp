@@ -0,0 +1,72 @@
+//
+//  TlsfAllocator.hpp
+//  Rovski
+//
+
+#ifndef ROVSKI_TLSFALLOCATOR_HPP
+#define ROVSKI_TLSFALLOCATOR_HPP
+
+#include <cstdint>
+#include <vector>
+#include <array>
+
+// Two-level segregated fit allocator over an abstract [0, capacity) range.
+// It never touches the memory itself, so it is used both for VkDeviceMemory
+// blocks and for sub-allocating ranges inside big VkBuffers.
+class TlsfAllocator {
+public:
+    static constexpr uint32_t InvalidNode = UINT32_MAX;
+
+    struct Range {
+        uint64_t offset = 0;
+        uint64_t size = 0;
+        uint32_t node = InvalidNode;
+    };
+
+    TlsfAllocator() = default;
+    explicit TlsfAllocator(uint64_t capacity);
+    void Reset(uint64_t capacity);
+    bool Allocate(uint64_t size, uint64_t alignment, Range &range);
+    void Free(uint32_t node);
+
+    uint64_t Capacity() const { return capacity; }
+    uint64_t UsedSize() const { return usedSize; }
+    uint32_t AllocationCount() const { return allocationCount; }
+    uint64_t LargestFreeRange() const;
+    bool Empty() const { return allocationCount == 0; }
+
+private:
+    static constexpr uint32_t SlIndexLog2 = 4;
+    static constexpr uint32_t SlCount = 1u << SlIndexLog2;
+    static constexpr uint32_t FlCount = 64 - SlIndexLog2 + 1;
+
+    struct Block {
+        uint64_t offset = 0;
+        uint64_t size = 0;
+        uint32_t prevPhysical = InvalidNode;
+        uint32_t nextPhysical = InvalidNode;
+        uint32_t prevFree = InvalidNode;
+        uint32_t nextFree = InvalidNode;
+        bool free = false;
+    };
+
+    static void Mapping(uint64_t size, uint32_t &fl, uint32_t &sl);
+    uint32_t FindSuitableBlock(uint64_t size);
+    void InsertFreeBlock(uint32_t node);
+    void RemoveFreeBlock(uint32_t node);
+    uint32_t NewNode();
+    void ReleaseNode(uint32_t node);
+    uint32_t SplitBlock(uint32_t node, uint64_t size);
+    uint32_t MergeBlock(uint32_t node);
+
+    uint64_t capacity = 0;
+    uint64_t usedSize = 0;
+    uint32_t allocationCount = 0;
+    uint64_t flBitmap = 0;
+    std::array<uint32_t, FlCount> slBitmap{};
+    std::array<std::array<uint32_t, SlCount>, FlCount> freeHeads{};
+    std::vector<Block> blocks;
+    std::vector<uint32_t> unusedNodes;
+};
+
+#endif //ROVSKI_TLSFALLOCATOR_HPP
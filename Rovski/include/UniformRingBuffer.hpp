@@ -0,0 +1,42 @@
+//
+//  UniformRingBuffer.hpp
+//  Rovski
+//
+
+#ifndef ROVSKI_UNIFORMRINGBUFFER_HPP
+#define ROVSKI_UNIFORMRINGBUFFER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+// Linear allocator over one persistently mapped buffer that is split into one
+// slice per frame in flight. A slice is rewritten only after the fence of the
+// frame that last used it has been waited, so no further sync is needed and
+// every per-frame constant block is just a memcpy plus a dynamic offset.
+// Allocate is lock free, recording threads may push concurrently.
+class UniformRingBuffer {
+public:
+    void Init(void *mapped, uint64_t sliceSize, uint32_t frameCount, uint64_t alignment);
+    void BeginFrame(uint32_t frameIndex);
+    void *Allocate(uint64_t size, uint32_t &dynamicOffset);
+
+    template<typename T> uint32_t Push(const T &data) {
+        uint32_t dynamicOffset;
+        memcpy(Allocate(sizeof(T), dynamicOffset), &data, sizeof(T));
+        return dynamicOffset;
+    }
+
+    uint64_t SliceSize() const { return sliceSize; }
+    uint64_t FrameUsedSize() const { return head.load(std::memory_order_relaxed) - sliceBegin; }
+
+private:
+    char *mapped = nullptr;
+    uint64_t sliceSize = 0;
+    uint32_t frameCount = 0;
+    uint64_t alignment = 1;
+    uint64_t sliceBegin = 0;
+    std::atomic<uint64_t> head{0};
+};
+
+#endif //ROVSKI_UNIFORMRINGBUFFER_HPP
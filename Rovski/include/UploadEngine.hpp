@@ -0,0 +1,82 @@
+//
+//  UploadEngine.hpp
+//  Rovski
+//
+
+#ifndef ROVSKI_UPLOADENGINE_HPP
+#define ROVSKI_UPLOADENGINE_HPP
+
+#include <vulkan/vulkan_core.h>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+#include "StagingRing.hpp"
+
+// Batches copies into one command buffer on the transfer queue and signals a
+// timeline semaphore when the batch lands. Host data goes through a fixed
+// staging ring: uploads are split into chunks, and when the ring is full the
+// engine flushes and waits for the oldest batch to hand its space back. When the transfer queue lives in
+// another family, resources are released on the transfer queue and acquired
+// by a small graphics queue submit that waits on the transfer value. Callers
+// wait on the returned value (GPU side through the semaphore, or Wait on the
+// host) instead of idling the queue after every copy.
+class UploadEngine {
+public:
+    bool Init(VkDevice device, VkQueue transferQueue, uint32_t transferFamily, VkQueue graphicsQueue, uint32_t graphicsFamily,
+              VkBuffer stagingBuffer, void *stagingMapped, uint64_t stagingSize);
+    void Destroy();
+
+    bool UploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void *data, VkDeviceSize size, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+    // dst has to be in TRANSFER_DST_OPTIMAL, data is tightly packed rows of blockSize byte texel blocks that
+    // cover blockDim x blockDim texels each (1 for uncompressed formats, 4 for BC)
+    bool UploadImage(VkImage dst, const VkImageSubresourceLayers &subresource, VkExtent3D extent, const void *data, uint32_t blockSize,
+                     uint32_t blockDim = 1);
+
+    void CopyBuffer(VkBuffer src, VkBuffer dst, const VkBufferCopy &region, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+    void CopyBufferToImage(VkBuffer src, VkImage dst, const VkBufferImageCopy &region);
+    void TransitionImageLayout(VkImage image, const VkImageSubresourceRange &range, VkImageLayout oldLayout, VkImageLayout newLayout);
+    // fills levels 1..levelCount-1 from level 0 with linear blits on the graphics queue (transfer queues
+    // may lack blit support); all levels have to be in TRANSFER_DST_OPTIMAL and end up in finalLayout
+    void GenerateMipmaps(VkImage image, VkExtent2D extent, uint32_t levelCount, VkImageLayout finalLayout);
+    void DeferRelease(std::function<void()> release);
+
+    uint64_t Flush();
+    void Wait(uint64_t value);
+    void Collect();
+    uint64_t CompletedValue() const;
+    uint64_t SubmittedValue() const { return submittedValue; }
+    VkSemaphore TimelineSemaphore() const { return timelineSemaphore; }
+    bool NeedOwnershipTransfer() const { return transferFamily != graphicsFamily; }
+
+private:
+    struct Batch {
+        VkCommandBuffer transferCommands = VK_NULL_HANDLE;
+        VkCommandBuffer graphicsCommands = VK_NULL_HANDLE;
+        uint64_t value = 0;
+        uint64_t stagingEnd = 0;
+        std::vector<std::function<void()>> releases;
+    };
+
+    VkCommandBuffer BeginCommands(VkCommandPool pool);
+    VkCommandBuffer TransferCommands();
+    VkCommandBuffer GraphicsCommands();
+    bool AcquireStaging(uint64_t size, uint64_t alignment, uint64_t &offset);
+    void ReleaseBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+    static void LayoutUsage(VkImageLayout layout, VkPipelineStageFlags &stage, VkAccessFlags &access);
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkQueue transferQueue = VK_NULL_HANDLE;
+    VkQueue graphicsQueue = VK_NULL_HANDLE;
+    uint32_t transferFamily = 0;
+    uint32_t graphicsFamily = 0;
+    VkCommandPool transferPool = VK_NULL_HANDLE;
+    VkCommandPool graphicsPool = VK_NULL_HANDLE;
+    VkSemaphore timelineSemaphore = VK_NULL_HANDLE;
+    uint64_t submittedValue = 0;
+    StagingRing staging;
+    Batch recording;
+    std::deque<Batch> inFlight;
+};
+
+#endif //ROVSKI_UPLOADENGINE_HPP
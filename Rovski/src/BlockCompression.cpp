@@ -0,0 +1,605 @@
+//
+//  BlockCompression.cpp
+//  Rovski
+//
+
+#include "BlockCompression.hpp"
+#include "CpuProfiler.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define ROVSKI_BC_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define ROVSKI_BC_NEON 1
+#endif
+
+namespace {
+
+// texels of one block as planes of floats in [0, 255], four texels fill one vector
+struct BlockTexels {
+    alignas(16) float channels[4][16];
+};
+
+using Palette = float[16][4];
+
+constexpr float bc1Weights[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+constexpr int bc7Weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+void LoadBlock(const uint8_t *texels, BlockTexels &block) {
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 4; c++) {
+            block.channels[c][i] = texels[i * 4 + c];
+        }
+    }
+}
+
+// nearest palette entry over channels [first, first + count) for every texel, returns the summed squared error
+float SelectIndices(const BlockTexels &block, uint32_t first, uint32_t count, const Palette &palette, uint32_t paletteSize,
+                    uint8_t *indices) {
+    float total = 0;
+#if ROVSKI_BC_SSE2
+    for (uint32_t group = 0; group < 16; group += 4) {
+        __m128 best = _mm_set1_ps(FLT_MAX);
+        __m128 bestIndex = _mm_setzero_ps();
+        for (uint32_t entry = 0; entry < paletteSize; entry++) {
+            __m128 distance = _mm_setzero_ps();
+            for (uint32_t c = first; c < first + count; c++) {
+                __m128 d = _mm_sub_ps(_mm_load_ps(&block.channels[c][group]), _mm_set1_ps(palette[entry][c]));
+                distance = _mm_add_ps(distance, _mm_mul_ps(d, d));
+            }
+            __m128 closer = _mm_cmplt_ps(distance, best);
+            best = _mm_min_ps(distance, best);
+            bestIndex = _mm_or_ps(_mm_and_ps(closer, _mm_set1_ps(float(entry))), _mm_andnot_ps(closer, bestIndex));
+        }
+        alignas(16) float index[4];
+        alignas(16) float error[4];
+        _mm_store_ps(index, bestIndex);
+        _mm_store_ps(error, best);
+        for (int i = 0; i < 4; i++) {
+            indices[group + i] = static_cast<uint8_t>(index[i]);
+            total += error[i];
+        }
+    }
+#elif ROVSKI_BC_NEON
+    for (uint32_t group = 0; group < 16; group += 4) {
+        float32x4_t best = vdupq_n_f32(FLT_MAX);
+        float32x4_t bestIndex = vdupq_n_f32(0.0f);
+        for (uint32_t entry = 0; entry < paletteSize; entry++) {
+            float32x4_t distance = vdupq_n_f32(0.0f);
+            for (uint32_t c = first; c < first + count; c++) {
+                float32x4_t d = vsubq_f32(vld1q_f32(&block.channels[c][group]), vdupq_n_f32(palette[entry][c]));
+                distance = vmlaq_f32(distance, d, d);
+            }
+            uint32x4_t closer = vcltq_f32(distance, best);
+            best = vminq_f32(distance, best);
+            bestIndex = vbslq_f32(closer, vdupq_n_f32(float(entry)), bestIndex);
+        }
+        float index[4];
+        float error[4];
+        vst1q_f32(index, bestIndex);
+        vst1q_f32(error, best);
+        for (int i = 0; i < 4; i++) {
+            indices[group + i] = static_cast<uint8_t>(index[i]);
+            total += error[i];
+        }
+    }
+#else
+    for (uint32_t i = 0; i < 16; i++) {
+        float best = FLT_MAX;
+        uint8_t bestIndex = 0;
+        for (uint32_t entry = 0; entry < paletteSize; entry++) {
+            float distance = 0;
+            for (uint32_t c = first; c < first + count; c++) {
+                float d = block.channels[c][i] - palette[entry][c];
+                distance += d * d;
+            }
+            if (distance < best) {
+                best = distance;
+                bestIndex = static_cast<uint8_t>(entry);
+            }
+        }
+        indices[i] = bestIndex;
+        total += best;
+    }
+#endif
+    return total;
+}
+
+// endpoints at the extremes of the block along its principal axis, channels [0, count)
+void AxisEndpoints(const BlockTexels &block, uint32_t count, float *e0, float *e1) {
+    float mean[4] = {};
+    for (uint32_t c = 0; c < count; c++) {
+        for (int i = 0; i < 16; i++) {
+            mean[c] += block.channels[c][i];
+        }
+        mean[c] /= 16.0f;
+    }
+    float covariance[4][4] = {};
+    for (int i = 0; i < 16; i++) {
+        for (uint32_t a = 0; a < count; a++) {
+            for (uint32_t b = 0; b < count; b++) {
+                covariance[a][b] += (block.channels[a][i] - mean[a]) * (block.channels[b][i] - mean[b]);
+            }
+        }
+    }
+    // power iteration, seeded with the covariance row of the widest channel so it can't start orthogonal
+    uint32_t widest = 0;
+    for (uint32_t c = 1; c < count; c++) {
+        if (covariance[c][c] > covariance[widest][widest]) {
+            widest = c;
+        }
+    }
+    float axis[4] = {};
+    for (uint32_t c = 0; c < count; c++) {
+        axis[c] = covariance[widest][c];
+    }
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[4] = {};
+        float length = 0;
+        for (uint32_t a = 0; a < count; a++) {
+            for (uint32_t b = 0; b < count; b++) {
+                next[a] += covariance[a][b] * axis[b];
+            }
+            length += next[a] * next[a];
+        }
+        if (length < 1e-12f) {
+            break;
+        }
+        length = 1.0f / std::sqrt(length);
+        for (uint32_t c = 0; c < count; c++) {
+            axis[c] = next[c] * length;
+        }
+    }
+    float lo = FLT_MAX;
+    float hi = -FLT_MAX;
+    for (int i = 0; i < 16; i++) {
+        float t = 0;
+        for (uint32_t c = 0; c < count; c++) {
+            t += (block.channels[c][i] - mean[c]) * axis[c];
+        }
+        lo = std::min(lo, t);
+        hi = std::max(hi, t);
+    }
+    for (uint32_t c = 0; c < count; c++) {
+        e0[c] = std::clamp(mean[c] + axis[c] * lo, 0.0f, 255.0f);
+        e1[c] = std::clamp(mean[c] + axis[c] * hi, 0.0f, 255.0f);
+    }
+}
+
+// least squares endpoints for fixed interpolation weights (0 picks e0, 1 picks e1); false when the weights are degenerate
+bool RefitEndpoints(const BlockTexels &block, uint32_t first, uint32_t count, const float *weights, float *e0, float *e1) {
+    float a = 0, b = 0, c = 0;
+    float x[4] = {};
+    float y[4] = {};
+    for (int i = 0; i < 16; i++) {
+        float t = weights[i];
+        float s = 1.0f - t;
+        a += s * s;
+        b += s * t;
+        c += t * t;
+        for (uint32_t channel = first; channel < first + count; channel++) {
+            x[channel] += s * block.channels[channel][i];
+            y[channel] += t * block.channels[channel][i];
+        }
+    }
+    float determinant = a * c - b * b;
+    if (std::fabs(determinant) < 1e-6f) {
+        return false;
+    }
+    for (uint32_t channel = first; channel < first + count; channel++) {
+        e0[channel] = std::clamp((c * x[channel] - b * y[channel]) / determinant, 0.0f, 255.0f);
+        e1[channel] = std::clamp((a * y[channel] - b * x[channel]) / determinant, 0.0f, 255.0f);
+    }
+    return true;
+}
+
+uint16_t To565(const float *color) {
+    auto quantize = [](float value, uint32_t levels) {
+        return static_cast<uint32_t>(std::clamp(value, 0.0f, 255.0f) * levels / 255.0f + 0.5f);
+    };
+    return static_cast<uint16_t>(quantize(color[0], 31) << 11 | quantize(color[1], 63) << 5 | quantize(color[2], 31));
+}
+
+void From565(uint16_t packed, float *color) {
+    uint32_t r = packed >> 11, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = static_cast<float>(r << 3 | r >> 2);
+    color[1] = static_cast<float>(g << 2 | g >> 4);
+    color[2] = static_cast<float>(b << 3 | b >> 2);
+}
+
+struct ColorBlock {
+    uint16_t c0 = 0;
+    uint16_t c1 = 0;
+    uint8_t indices[16] = {};
+    float error = FLT_MAX;
+};
+
+void EvaluateBc1(const BlockTexels &block, const float *e0, const float *e1, ColorBlock &result) {
+    // c0 > c1 selects the four color mode, equal endpoints only ever use index 0
+    uint16_t c0 = To565(e0);
+    uint16_t c1 = To565(e1);
+    if (c0 < c1) {
+        std::swap(c0, c1);
+    }
+    Palette palette{};
+    From565(c0, palette[0]);
+    From565(c1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+        palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+        palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+    }
+    result.c0 = c0;
+    result.c1 = c1;
+    result.error = SelectIndices(block, 0, 3, palette, c0 == c1 ? 1 : 4, result.indices);
+}
+
+void EncodeBc1(const BlockTexels &block, EncodeQuality quality, uint8_t *out) {
+    float e0[4] = {};
+    float e1[4] = {};
+    if (quality == EncodeQuality::Fast) {
+        // bounding box, inset a little, along the diagonal that follows the block's correlation with red
+        float lo[3], hi[3], mean[3];
+        for (int c = 0; c < 3; c++) {
+            lo[c] = *std::min_element(block.channels[c], block.channels[c] + 16);
+            hi[c] = *std::max_element(block.channels[c], block.channels[c] + 16);
+            mean[c] = (lo[c] + hi[c]) * 0.5f;
+            float inset = (hi[c] - lo[c]) / 16.0f;
+            lo[c] += inset;
+            hi[c] -= inset;
+        }
+        for (int c = 1; c < 3; c++) {
+            float correlation = 0;
+            for (int i = 0; i < 16; i++) {
+                correlation += (block.channels[0][i] - mean[0]) * (block.channels[c][i] - mean[c]);
+            }
+            if (correlation < 0) {
+                std::swap(lo[c], hi[c]);
+            }
+        }
+        for (int c = 0; c < 3; c++) {
+            e0[c] = hi[c];
+            e1[c] = lo[c];
+        }
+    } else {
+        AxisEndpoints(block, 3, e0, e1);
+    }
+    ColorBlock best;
+    EvaluateBc1(block, e0, e1, best);
+    int refits = quality == EncodeQuality::Fast ? 0 : quality == EncodeQuality::Normal ? 1 : 8;
+    for (int refit = 0; refit < refits && best.c0 != best.c1; refit++) {
+        float weights[16];
+        for (int i = 0; i < 16; i++) {
+            weights[i] = bc1Weights[best.indices[i]];
+        }
+        if (!RefitEndpoints(block, 0, 3, weights, e0, e1)) {
+            break;
+        }
+        ColorBlock candidate;
+        EvaluateBc1(block, e0, e1, candidate);
+        if (candidate.error >= best.error) {
+            break;
+        }
+        best = candidate;
+    }
+    uint32_t bits = 0;
+    for (int i = 0; i < 16; i++) {
+        bits |= uint32_t(best.indices[i]) << (2 * i);
+    }
+    out[0] = static_cast<uint8_t>(best.c0);
+    out[1] = static_cast<uint8_t>(best.c0 >> 8);
+    out[2] = static_cast<uint8_t>(best.c1);
+    out[3] = static_cast<uint8_t>(best.c1 >> 8);
+    for (int i = 0; i < 4; i++) {
+        out[4 + i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+}
+
+struct ScalarBlock {
+    uint8_t a0 = 0;
+    uint8_t a1 = 0;
+    uint8_t indices[16] = {};
+    float error = FLT_MAX;
+};
+
+void EvaluateBc4(const BlockTexels &block, uint32_t channel, int a0, int a1, ScalarBlock &result) {
+    // a0 > a1 interpolates six values, otherwise four plus exact 0 and 255
+    Palette palette{};
+    palette[0][channel] = static_cast<float>(a0);
+    palette[1][channel] = static_cast<float>(a1);
+    if (a0 > a1) {
+        for (int i = 2; i < 8; i++) {
+            palette[i][channel] = ((8 - i) * a0 + (i - 1) * a1) / 7.0f;
+        }
+    } else {
+        for (int i = 2; i < 6; i++) {
+            palette[i][channel] = ((6 - i) * a0 + (i - 1) * a1) / 5.0f;
+        }
+        palette[6][channel] = 0.0f;
+        palette[7][channel] = 255.0f;
+    }
+    result.a0 = static_cast<uint8_t>(a0);
+    result.a1 = static_cast<uint8_t>(a1);
+    result.error = SelectIndices(block, channel, 1, palette, 8, result.indices);
+}
+
+void EncodeBc4(const BlockTexels &block, uint32_t channel, EncodeQuality quality, uint8_t *out) {
+    const float *values = block.channels[channel];
+    int lo = static_cast<int>(*std::min_element(values, values + 16));
+    int hi = static_cast<int>(*std::max_element(values, values + 16));
+    ScalarBlock best;
+    EvaluateBc4(block, channel, hi, lo, best);
+    if (quality != EncodeQuality::Fast && lo != hi) {
+        // blocks that touch 0 or 255 can spend the six value mode on the rest
+        int innerLo = 255, innerHi = 0;
+        for (int i = 0; i < 16; i++) {
+            int value = static_cast<int>(values[i]);
+            if (value != 0 && value != 255) {
+                innerLo = std::min(innerLo, value);
+                innerHi = std::max(innerHi, value);
+            }
+        }
+        if ((lo == 0 || hi == 255) && innerLo <= innerHi) {
+            ScalarBlock candidate;
+            EvaluateBc4(block, channel, innerLo, innerHi, candidate);
+            if (candidate.error < best.error) {
+                best = candidate;
+            }
+        }
+        if (best.a0 > best.a1) {
+            float weights[16];
+            for (int i = 0; i < 16; i++) {
+                weights[i] = best.indices[i] < 2 ? float(best.indices[i]) : (best.indices[i] - 1) / 7.0f;
+            }
+            float e0[4], e1[4];
+            if (RefitEndpoints(block, channel, 1, weights, e0, e1)) {
+                ScalarBlock candidate;
+                int a0 = static_cast<int>(e0[channel] + 0.5f), a1 = static_cast<int>(e1[channel] + 0.5f);
+                EvaluateBc4(block, channel, std::max(a0, a1), std::min(a0, a1), candidate);
+                if (candidate.error < best.error) {
+                    best = candidate;
+                }
+            }
+        }
+    }
+    if (quality == EncodeQuality::High && best.a0 > best.a1) {
+        ScalarBlock center = best;
+        for (int d0 = -2; d0 <= 2; d0++) {
+            for (int d1 = -2; d1 <= 2; d1++) {
+                int a0 = center.a0 + d0, a1 = center.a1 + d1;
+                if (a0 > 255 || a1 < 0 || a0 <= a1) {
+                    continue;
+                }
+                ScalarBlock candidate;
+                EvaluateBc4(block, channel, a0, a1, candidate);
+                if (candidate.error < best.error) {
+                    best = candidate;
+                }
+            }
+        }
+    }
+    uint64_t bits = 0;
+    for (int i = 0; i < 16; i++) {
+        bits |= uint64_t(best.indices[i]) << (3 * i);
+    }
+    out[0] = best.a0;
+    out[1] = best.a1;
+    for (int i = 0; i < 6; i++) {
+        out[2 + i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+}
+
+struct Bc7Block {
+    uint8_t q0[4] = {};
+    uint8_t q1[4] = {};
+    uint8_t p0 = 0;
+    uint8_t p1 = 0;
+    uint8_t indices[16] = {};
+    float error = FLT_MAX;
+};
+
+void EvaluateBc7(const BlockTexels &block, const float *e0, const float *e1, uint8_t p0, uint8_t p1, Bc7Block &result) {
+    // mode 6 endpoints are seven bits per channel plus one shared low bit per endpoint
+    Palette palette{};
+    int v0[4], v1[4];
+    for (int c = 0; c < 4; c++) {
+        result.q0[c] = static_cast<uint8_t>(std::clamp(static_cast<int>(std::lround((e0[c] - p0) * 0.5f)), 0, 127));
+        result.q1[c] = static_cast<uint8_t>(std::clamp(static_cast<int>(std::lround((e1[c] - p1) * 0.5f)), 0, 127));
+        v0[c] = result.q0[c] << 1 | p0;
+        v1[c] = result.q1[c] << 1 | p1;
+    }
+    for (int entry = 0; entry < 16; entry++) {
+        for (int c = 0; c < 4; c++) {
+            palette[entry][c] = static_cast<float>((v0[c] * (64 - bc7Weights[entry]) + v1[c] * bc7Weights[entry] + 32) >> 6);
+        }
+    }
+    result.p0 = p0;
+    result.p1 = p1;
+    result.error = SelectIndices(block, 0, 4, palette, 16, result.indices);
+}
+
+uint8_t PreferredPBit(const float *endpoint) {
+    // the low bit most channels would round to
+    int odd = 0;
+    for (int c = 0; c < 4; c++) {
+        odd += static_cast<int>(endpoint[c] + 0.5f) & 1;
+    }
+    return odd >= 2 ? 1 : 0;
+}
+
+void FitBc7(const BlockTexels &block, EncodeQuality quality, const float *e0, const float *e1, Bc7Block &best) {
+    if (quality == EncodeQuality::Fast) {
+        EvaluateBc7(block, e0, e1, PreferredPBit(e0), PreferredPBit(e1), best);
+        return;
+    }
+    for (uint8_t pbits = 0; pbits < 4; pbits++) {
+        Bc7Block candidate;
+        EvaluateBc7(block, e0, e1, pbits & 1, pbits >> 1, candidate);
+        if (candidate.error < best.error) {
+            best = candidate;
+        }
+    }
+}
+
+class BitWriter {
+public:
+    explicit BitWriter(uint8_t *out) : out(out) {}
+
+    void Put(uint32_t value, uint32_t bits) {
+        for (uint32_t bit = 0; bit < bits; bit++, position++) {
+            if ((value >> bit) & 1) {
+                out[position / 8] |= static_cast<uint8_t>(1 << (position % 8));
+            }
+        }
+    }
+
+private:
+    uint8_t *out;
+    uint32_t position = 0;
+};
+
+void EncodeBc7(const BlockTexels &block, EncodeQuality quality, uint8_t *out) {
+    float e0[4] = {};
+    float e1[4] = {};
+    AxisEndpoints(block, 4, e0, e1);
+    Bc7Block best;
+    FitBc7(block, quality, e0, e1, best);
+    int refits = quality == EncodeQuality::Fast ? 0 : quality == EncodeQuality::Normal ? 1 : 8;
+    for (int refit = 0; refit < refits; refit++) {
+        float weights[16];
+        for (int i = 0; i < 16; i++) {
+            weights[i] = bc7Weights[best.indices[i]] / 64.0f;
+        }
+        if (!RefitEndpoints(block, 0, 4, weights, e0, e1)) {
+            break;
+        }
+        Bc7Block candidate;
+        FitBc7(block, quality, e0, e1, candidate);
+        if (candidate.error >= best.error) {
+            break;
+        }
+        best = candidate;
+    }
+    // the first index is stored with three bits, its top bit has to be zero
+    if (best.indices[0] >= 8) {
+        std::swap(best.q0, best.q1);
+        std::swap(best.p0, best.p1);
+        for (auto &index : best.indices) {
+            index = static_cast<uint8_t>(15 - index);
+        }
+    }
+    memset(out, 0, 16);
+    BitWriter writer(out);
+    writer.Put(1 << 6, 7);
+    for (int c = 0; c < 4; c++) {
+        writer.Put(best.q0[c], 7);
+        writer.Put(best.q1[c], 7);
+    }
+    writer.Put(best.p0, 1);
+    writer.Put(best.p1, 1);
+    writer.Put(best.indices[0], 3);
+    for (int i = 1; i < 16; i++) {
+        writer.Put(best.indices[i], 4);
+    }
+}
+
+} // namespace
+
+uint32_t BlockBytes(BlockFormat format) {
+    return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+VkFormat BlockVkFormat(BlockFormat format, bool srgb) {
+    switch (format) {
+        case BlockFormat::BC1:
+            return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+        case BlockFormat::BC3:
+            return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+        case BlockFormat::BC5:
+            return VK_FORMAT_BC5_UNORM_BLOCK;
+        case BlockFormat::BC7:
+            return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+    }
+    return VK_FORMAT_UNDEFINED;
+}
+
+bool FormatBlockInfo(VkFormat format, uint32_t &blockBytes, uint32_t &blockDim) {
+    switch (format) {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+        case VK_FORMAT_BC4_SNORM_BLOCK:
+            blockBytes = 8;
+            blockDim = 4;
+            return true;
+        case VK_FORMAT_BC2_UNORM_BLOCK:
+        case VK_FORMAT_BC2_SRGB_BLOCK:
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC5_SNORM_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            blockBytes = 16;
+            blockDim = 4;
+            return true;
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+            blockBytes = 4;
+            blockDim = 1;
+            return true;
+        default:
+            return false;
+    }
+}
+
+void EncodeBlock(BlockFormat format, EncodeQuality quality, const uint8_t *texels, uint8_t *block) {
+    BlockTexels loaded;
+    LoadBlock(texels, loaded);
+    switch (format) {
+        case BlockFormat::BC1:
+            EncodeBc1(loaded, quality, block);
+            break;
+        case BlockFormat::BC3:
+            EncodeBc4(loaded, 3, quality, block);
+            EncodeBc1(loaded, quality, block + 8);
+            break;
+        case BlockFormat::BC5:
+            EncodeBc4(loaded, 0, quality, block);
+            EncodeBc4(loaded, 1, quality, block + 8);
+            break;
+        case BlockFormat::BC7:
+            EncodeBc7(loaded, quality, block);
+            break;
+    }
+}
+
+void BlockEncoder::Encode(BlockFormat format, EncodeQuality quality, const uint8_t *rgba, uint32_t width, uint32_t height,
+                          std::vector<uint8_t> &blocks) {
+    ROVSKI_CPU_FUNCTION();
+    const uint32_t blocksX = (width + 3) / 4;
+    const uint32_t blocksY = (height + 3) / 4;
+    const uint32_t blockBytes = BlockBytes(format);
+    blocks.resize(size_t(blocksX) * blocksY * blockBytes);
+    uint8_t *output = blocks.data();
+    jobSystem.ParallelFor(blocksY, 1, [=](uint32_t begin, uint32_t end, uint32_t) {
+        uint8_t texels[64];
+        for (uint32_t by = begin; by < end; by++) {
+            for (uint32_t bx = 0; bx < blocksX; bx++) {
+                for (uint32_t y = 0; y < 4; y++) {
+                    uint32_t sy = std::min(by * 4 + y, height - 1);
+                    for (uint32_t x = 0; x < 4; x++) {
+                        uint32_t sx = std::min(bx * 4 + x, width - 1);
+                        memcpy(texels + (y * 4 + x) * 4, rgba + (size_t(sy) * width + sx) * 4, 4);
+                    }
+                }
+                EncodeBlock(format, quality, texels, output + (size_t(by) * blocksX + bx) * blockBytes);
+            }
+        }
+    });
+}
@@ -0,0 +1,139 @@
+//
+//  CpuProfiler.cpp
+//  Rovski
+//
+
+#include "CpuProfiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
+static const auto profilerEpoch = std::chrono::steady_clock::now();
+static thread_local CpuProfiler *ringOwner = nullptr;
+static thread_local void *localRing = nullptr;
+
+CpuProfiler::CpuProfiler() = default;
+
+CpuProfiler &CpuProfiler::Instance() {
+    static CpuProfiler profiler;
+    return profiler;
+}
+
+uint64_t CpuProfiler::NowNs() {
+    // +1 keeps 0 free as the "not recording" marker of CpuScope
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - profilerEpoch).count()) + 1;
+}
+
+// hands the ring of an exiting thread back to the profiler
+struct CpuProfiler::ThreadExit {
+    CpuProfiler *profiler = nullptr;
+    ~ThreadExit() {
+        if (profiler != nullptr) {
+            profiler->ReleaseLocalRing();
+        }
+    }
+};
+
+CpuProfiler::ThreadRing &CpuProfiler::LocalRing() {
+    if (ringOwner != this) {
+        static thread_local ThreadExit threadExit;
+        ThreadRing *ring;
+        std::lock_guard<std::mutex> lock(registryMutex);
+        if (freeRings.empty()) {
+            rings.push_back(std::make_unique<ThreadRing>());
+            ring = rings.back().get();
+        } else {
+            ring = freeRings.back();
+            freeRings.pop_back();
+        }
+        ring->threadId = nextThreadId++;
+        ring->name = "thread " + std::to_string(ring->threadId);
+        ring->active = true;
+        localRing = ring;
+        ringOwner = this;
+        threadExit.profiler = this;
+    }
+    return *static_cast<ThreadRing*>(localRing);
+}
+
+void CpuProfiler::ReleaseLocalRing() {
+    auto *ring = static_cast<ThreadRing*>(localRing);
+    std::lock_guard<std::mutex> lock(registryMutex);
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    uint64_t begin = std::max(ring->tail.load(std::memory_order_relaxed), head > RingCapacity ? head - RingCapacity : 0);
+    if (begin < head) {
+        RetiredThread &retired = retiredThreads.emplace_back();
+        retired.threadId = ring->threadId;
+        retired.name = std::move(ring->name);
+        retired.zones.reserve(head - begin);
+        for (uint64_t i = begin; i < head; i++) {
+            retired.zones.push_back(ring->zones[i % RingCapacity]);
+        }
+    }
+    ring->tail.store(head, std::memory_order_relaxed);
+    ring->active = false;
+    freeRings.push_back(ring);
+    ringOwner = nullptr;
+    localRing = nullptr;
+}
+
+void CpuProfiler::Record(const char *name, uint64_t beginNs, uint64_t endNs) {
+    ThreadRing &ring = LocalRing();
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+    ring.zones[head % RingCapacity] = Zone{name, beginNs, endNs};
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+void CpuProfiler::SetThreadName(std::string name) {
+    ThreadRing &ring = LocalRing();
+    std::lock_guard<std::mutex> lock(registryMutex);
+    ring.name = std::move(name);
+}
+
+void CpuProfiler::Clear() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (auto &ring : rings) {
+        ring->tail.store(ring->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+    }
+    retiredThreads.clear();
+}
+
+bool CpuProfiler::ExportChromeTrace(const std::string &path) const {
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(registryMutex);
+    file.setf(std::ios::fixed);
+    file.precision(3);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for (const RetiredThread &retired : retiredThreads) {
+        file << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << retired.threadId
+             << ",\"args\":{\"name\":\"" << retired.name << "\"}}";
+        first = false;
+        for (const Zone &zone : retired.zones) {
+            file << ",\n{\"name\":\"" << zone.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << retired.threadId
+                 << ",\"ts\":" << zone.beginNs / 1000.0 << ",\"dur\":" << (zone.endNs - zone.beginNs) / 1000.0 << "}";
+        }
+    }
+    for (auto &ring : rings) {
+        if (!ring->active) {
+            continue;
+        }
+        file << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->threadId
+             << ",\"args\":{\"name\":\"" << ring->name << "\"}}";
+        first = false;
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t begin = std::max(ring->tail.load(std::memory_order_relaxed), head > RingCapacity ? head - RingCapacity : 0);
+        for (uint64_t i = begin; i < head; i++) {
+            const Zone &zone = ring->zones[i % RingCapacity];
+            // complete events, timestamps in microseconds
+            file << ",\n{\"name\":\"" << zone.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring->threadId
+                 << ",\"ts\":" << zone.beginNs / 1000.0 << ",\"dur\":" << (zone.endNs - zone.beginNs) / 1000.0 << "}";
+        }
+    }
+    file << "\n]}" << std::endl;
+    return file.good();
+}
@@ -0,0 +1,216 @@
+//
+//  DeviceMemoryAllocator.cpp
+//  Rovski
+//
+
+#include "DeviceMemoryAllocator.hpp"
+#include <iostream>
+#include <algorithm>
+
+bool DeviceMemoryAllocator::Init(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize preferredBlockSize) {
+    this->device = device;
+    this->preferredBlockSize = preferredBlockSize;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    VkPhysicalDeviceProperties deviceProperties{};
+    vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+    maxAllocationCount = deviceProperties.limits.maxMemoryAllocationCount;
+    return true;
+}
+
+void DeviceMemoryAllocator::Destroy() {
+    for (auto &block : blocks) {
+        if (!block) {
+            continue;
+        }
+        if (!block->allocator.Empty()) {
+            std::cout << "memory block of type " << block->memoryType << " still has "
+                      << block->allocator.AllocationCount() << " live allocations" << std::endl;
+        }
+        if (block->mapped != nullptr) {
+            vkUnmapMemory(device, block->memory);
+        }
+        vkFreeMemory(device, block->memory, nullptr);
+    }
+    blocks.clear();
+    deviceMemoryCount = 0;
+}
+
+VkDeviceSize DeviceMemoryAllocator::BlockSizeForType(uint32_t memoryType) const {
+    VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryType].heapIndex].size;
+    // small heaps (e.g. the 256MB BAR heap) would be eaten by a handful of blocks
+    if (heapSize <= (1ull << 30)) {
+        return std::min(preferredBlockSize, heapSize / 8);
+    }
+    return preferredBlockSize;
+}
+
+bool DeviceMemoryAllocator::AllocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, VkDeviceMemory &memory, void *&mapped) {
+    if (deviceMemoryCount >= maxAllocationCount) {
+        std::cout << "reach maxMemoryAllocationCount: " << maxAllocationCount << std::endl;
+        return false;
+    }
+    VkMemoryAllocateInfo allocateInfo{};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocateInfo.allocationSize = size;
+    allocateInfo.memoryTypeIndex = memoryType;
+    if (vkAllocateMemory(device, &allocateInfo, nullptr, &memory) != VK_SUCCESS) {
+        return false;
+    }
+    mapped = nullptr;
+    if (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS) {
+            vkFreeMemory(device, memory, nullptr);
+            return false;
+        }
+    }
+    deviceMemoryCount++;
+    return true;
+}
+
+bool DeviceMemoryAllocator::AllocateDedicated(const VkMemoryRequirements &requirements, uint32_t memoryType, MemoryAllocation &allocation) {
+    void *mapped;
+    if (!AllocateDeviceMemory(requirements.size, memoryType, allocation.memory, mapped)) {
+        return false;
+    }
+    allocation.offset = 0;
+    allocation.size = requirements.size;
+    allocation.mapped = mapped;
+    allocation.memoryType = memoryType;
+    allocation.block = UINT32_MAX;
+    allocation.node = TlsfAllocator::InvalidNode;
+    allocation.dedicated = true;
+    dedicatedCount++;
+    dedicatedBytes += requirements.size;
+    totalAllocationCount++;
+    return true;
+}
+
+bool DeviceMemoryAllocator::Allocate(const VkMemoryRequirements &requirements, uint32_t memoryType,
+                                     ResourceKind kind, MemoryAllocation &allocation) {
+    VkDeviceSize blockSize = BlockSizeForType(memoryType);
+    // a whole block's worth gains nothing from sharing it, and large images (render targets, big textures) get
+    // their own memory, the driver may place them better
+    if (requirements.size >= blockSize || (kind == ResourceKind::Image && requirements.size >= blockSize / 2)) {
+        return AllocateDedicated(requirements, memoryType, allocation);
+    }
+    TlsfAllocator::Range range;
+    for (uint32_t i = 0; i < blocks.size(); i++) {
+        Block *block = blocks[i].get();
+        if (block == nullptr || block->memoryType != memoryType || block->kind != kind) {
+            continue;
+        }
+        if (block->allocator.Allocate(requirements.size, requirements.alignment, range)) {
+            allocation.memory = block->memory;
+            allocation.offset = range.offset;
+            allocation.size = requirements.size;
+            allocation.mapped = block->mapped ? static_cast<char*>(block->mapped) + range.offset : nullptr;
+            allocation.memoryType = memoryType;
+            allocation.block = i;
+            allocation.node = range.node;
+            allocation.dedicated = false;
+            totalAllocationCount++;
+            return true;
+        }
+    }
+
+    auto block = std::make_unique<Block>();
+    if (!AllocateDeviceMemory(blockSize, memoryType, block->memory, block->mapped)) {
+        // out of room for a whole block, try to fit the resource alone
+        return AllocateDedicated(requirements, memoryType, allocation);
+    }
+    block->memoryType = memoryType;
+    block->kind = kind;
+    block->allocator.Reset(blockSize);
+    if (!block->allocator.Allocate(requirements.size, requirements.alignment, range)) {
+        // a request close to the block size can miss even an empty block once rounded and aligned
+        if (block->mapped != nullptr) {
+            vkUnmapMemory(device, block->memory);
+        }
+        vkFreeMemory(device, block->memory, nullptr);
+        deviceMemoryCount--;
+        return AllocateDedicated(requirements, memoryType, allocation);
+    }
+    auto slot = std::find(blocks.begin(), blocks.end(), nullptr);
+    uint32_t blockIndex = static_cast<uint32_t>(slot - blocks.begin());
+    if (slot == blocks.end()) {
+        blocks.push_back(nullptr);
+    }
+    allocation.memory = block->memory;
+    allocation.offset = range.offset;
+    allocation.size = requirements.size;
+    allocation.mapped = block->mapped ? static_cast<char*>(block->mapped) + range.offset : nullptr;
+    allocation.memoryType = memoryType;
+    allocation.block = blockIndex;
+    allocation.node = range.node;
+    allocation.dedicated = false;
+    blocks[blockIndex] = std::move(block);
+    totalAllocationCount++;
+    return true;
+}
+
+void DeviceMemoryAllocator::Free(MemoryAllocation &allocation) {
+    if (allocation.memory == VK_NULL_HANDLE) {
+        return;
+    }
+    if (allocation.dedicated) {
+        if (allocation.mapped != nullptr) {
+            vkUnmapMemory(device, allocation.memory);
+        }
+        vkFreeMemory(device, allocation.memory, nullptr);
+        deviceMemoryCount--;
+        dedicatedCount--;
+        dedicatedBytes -= allocation.size;
+    } else {
+        Block *block = blocks[allocation.block].get();
+        block->allocator.Free(allocation.node);
+        if (block->allocator.Empty()) {
+            // keep one empty block per type around so a free/alloc pair does not hit the driver
+            bool hasOtherEmpty = false;
+            for (auto &other : blocks) {
+                if (other && other.get() != block && other->memoryType == block->memoryType
+                    && other->kind == block->kind && other->allocator.Empty()) {
+                    hasOtherEmpty = true;
+                    break;
+                }
+            }
+            if (hasOtherEmpty) {
+                if (block->mapped != nullptr) {
+                    vkUnmapMemory(device, block->memory);
+                }
+                vkFreeMemory(device, block->memory, nullptr);
+                deviceMemoryCount--;
+                blocks[allocation.block].reset();
+            }
+        }
+    }
+    allocation = MemoryAllocation{};
+}
+
+MemoryStats DeviceMemoryAllocator::GetStats() const {
+    MemoryStats stats{};
+    stats.deviceMemoryCount = deviceMemoryCount;
+    stats.dedicatedCount = dedicatedCount;
+    stats.allocationCount = dedicatedCount;
+    stats.totalAllocationCount = totalAllocationCount;
+    stats.reservedBytes = dedicatedBytes;
+    stats.usedBytes = dedicatedBytes;
+    for (auto &block : blocks) {
+        if (!block) {
+            continue;
+        }
+        stats.blockCount++;
+        stats.allocationCount += block->allocator.AllocationCount();
+        stats.reservedBytes += block->allocator.Capacity();
+        stats.usedBytes += block->allocator.UsedSize();
+        stats.largestFreeRange = std::max<VkDeviceSize>(stats.largestFreeRange, block->allocator.LargestFreeRange());
+    }
+    return stats;
+}
+
+void DeviceMemoryAllocator::PrintStats() const {
+    MemoryStats stats = GetStats();
+    std::cout << "device memory: " << stats.deviceMemoryCount << " vkAllocateMemory (" << stats.blockCount << " blocks, "
+              << stats.dedicatedCount << " dedicated), " << stats.allocationCount << " live allocations, "
+              << (stats.usedBytes >> 10) << "KB used / " << (stats.reservedBytes >> 10) << "KB reserved, largest free range "
+              << (stats.largestFreeRange >> 10) << "KB" << std::endl;
+}
@@ -0,0 +1,303 @@
+//
+//  FrustumCuller.cpp
+//  Rovski
+//
+
+#include "FrustumCuller.hpp"
+#include "CpuProfiler.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define ROVSKI_CULL_SSE2 1
+#if defined(__GNUC__) || defined(__clang__)
+#include <immintrin.h>
+#define ROVSKI_CULL_AVX2 1
+#endif
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define ROVSKI_CULL_NEON 1
+#endif
+
+namespace {
+
+constexpr float unbounded = std::numeric_limits<float>::max();
+
+// plane constants splatted once per range: the normal, its absolute value for the box extent and the distance
+struct PlaneSet {
+    float x[6], y[6], z[6], w[6];
+    float ax[6], ay[6], az[6];
+
+    explicit PlaneSet(const Frustum &frustum) {
+        for (int i = 0; i < 6; i++) {
+            x[i] = frustum.planes[i].x;
+            y[i] = frustum.planes[i].y;
+            z[i] = frustum.planes[i].z;
+            w[i] = frustum.planes[i].w;
+            ax[i] = std::fabs(x[i]);
+            ay[i] = std::fabs(y[i]);
+            az[i] = std::fabs(z[i]);
+        }
+    }
+};
+
+struct SoaView {
+    const float *centerX, *centerY, *centerZ, *radius;
+    const float *extentX, *extentY, *extentZ;
+};
+
+#if !ROVSKI_CULL_SSE2 && !ROVSKI_CULL_NEON
+// the smallest signed distance over all planes of sphere and box, the object is visible when it isn't negative
+float ScalarReach(const PlaneSet &planes, const SoaView &soa, uint32_t i) {
+    float reach = unbounded;
+    for (int p = 0; p < 6; p++) {
+        float center = planes.x[p] * soa.centerX[i] + planes.y[p] * soa.centerY[i] + planes.z[p] * soa.centerZ[i] + planes.w[p];
+        float box = center + planes.ax[p] * soa.extentX[i] + planes.ay[p] * soa.extentY[i] + planes.az[p] * soa.extentZ[i];
+        reach = std::min(reach, std::min(center + soa.radius[i], box));
+    }
+    return reach;
+}
+#else
+// set bits of mask are visible objects starting at base, appended in order
+uint32_t AppendVisible(uint32_t mask, uint32_t base, uint32_t *visible, uint32_t written) {
+    while (mask != 0) {
+        visible[written++] = base + static_cast<uint32_t>(std::countr_zero(mask));
+        mask &= mask - 1;
+    }
+    return written;
+}
+#endif
+
+#if ROVSKI_CULL_AVX2
+__attribute__((target("avx2,fma")))
+uint32_t CullAvx2(const PlaneSet &planes, const SoaView &soa, uint32_t begin, uint32_t end, uint32_t *visible) {
+    __m256 px[6], py[6], pz[6], pw[6];
+    for (int p = 0; p < 6; p++) {
+        px[p] = _mm256_set1_ps(planes.x[p]);
+        py[p] = _mm256_set1_ps(planes.y[p]);
+        pz[p] = _mm256_set1_ps(planes.z[p]);
+        pw[p] = _mm256_set1_ps(planes.w[p]);
+    }
+    const __m256 zero = _mm256_setzero_ps();
+    uint32_t written = 0;
+    for (uint32_t i = begin; i < end; i += 8) {
+        __m256 cx = _mm256_loadu_ps(soa.centerX + i), cy = _mm256_loadu_ps(soa.centerY + i);
+        __m256 cz = _mm256_loadu_ps(soa.centerZ + i), r = _mm256_loadu_ps(soa.radius + i);
+        __m256 distance[6];
+        __m256 reach = _mm256_set1_ps(unbounded);
+        for (int p = 0; p < 6; p++) {
+            distance[p] = _mm256_fmadd_ps(px[p], cx, _mm256_fmadd_ps(py[p], cy, _mm256_fmadd_ps(pz[p], cz, pw[p])));
+            reach = _mm256_min_ps(reach, _mm256_add_ps(distance[p], r));
+        }
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(reach, zero, _CMP_GE_OQ)));
+        if (mask == 0) {
+            continue;
+        }
+        __m256 ex = _mm256_loadu_ps(soa.extentX + i), ey = _mm256_loadu_ps(soa.extentY + i), ez = _mm256_loadu_ps(soa.extentZ + i);
+        for (int p = 0; p < 6; p++) {
+            __m256 box = _mm256_fmadd_ps(_mm256_set1_ps(planes.ax[p]), ex, _mm256_fmadd_ps(_mm256_set1_ps(planes.ay[p]), ey,
+                         _mm256_fmadd_ps(_mm256_set1_ps(planes.az[p]), ez, distance[p])));
+            reach = _mm256_min_ps(reach, box);
+        }
+        mask = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(reach, zero, _CMP_GE_OQ)));
+        written = AppendVisible(mask, i, visible, written);
+    }
+    return written;
+}
+
+bool HasAvx2() {
+    static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return supported;
+}
+#endif
+
+#if ROVSKI_CULL_SSE2
+uint32_t CullSse2(const PlaneSet &planes, const SoaView &soa, uint32_t begin, uint32_t end, uint32_t *visible) {
+    const __m128 zero = _mm_setzero_ps();
+    uint32_t written = 0;
+    for (uint32_t i = begin; i < end; i += 4) {
+        __m128 cx = _mm_loadu_ps(soa.centerX + i), cy = _mm_loadu_ps(soa.centerY + i);
+        __m128 cz = _mm_loadu_ps(soa.centerZ + i), r = _mm_loadu_ps(soa.radius + i);
+        __m128 distance[6];
+        __m128 reach = _mm_set1_ps(unbounded);
+        for (int p = 0; p < 6; p++) {
+            distance[p] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.x[p]), cx), _mm_mul_ps(_mm_set1_ps(planes.y[p]), cy)),
+                                     _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.z[p]), cz), _mm_set1_ps(planes.w[p])));
+            reach = _mm_min_ps(reach, _mm_add_ps(distance[p], r));
+        }
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_ps(_mm_cmpge_ps(reach, zero)));
+        if (mask == 0) {
+            continue;
+        }
+        __m128 ex = _mm_loadu_ps(soa.extentX + i), ey = _mm_loadu_ps(soa.extentY + i), ez = _mm_loadu_ps(soa.extentZ + i);
+        for (int p = 0; p < 6; p++) {
+            __m128 spread = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.ax[p]), ex), _mm_mul_ps(_mm_set1_ps(planes.ay[p]), ey)),
+                                       _mm_mul_ps(_mm_set1_ps(planes.az[p]), ez));
+            reach = _mm_min_ps(reach, _mm_add_ps(distance[p], spread));
+        }
+        mask = static_cast<uint32_t>(_mm_movemask_ps(_mm_cmpge_ps(reach, zero)));
+        written = AppendVisible(mask, i, visible, written);
+    }
+    return written;
+}
+#endif
+
+#if ROVSKI_CULL_NEON
+uint32_t CullNeon(const PlaneSet &planes, const SoaView &soa, uint32_t begin, uint32_t end, uint32_t *visible) {
+    const uint32x4_t laneBits = {1, 2, 4, 8};
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    auto laneMask = [&laneBits](uint32x4_t inside) {
+        inside = vandq_u32(inside, laneBits);
+        return vgetq_lane_u32(inside, 0) | vgetq_lane_u32(inside, 1) | vgetq_lane_u32(inside, 2) | vgetq_lane_u32(inside, 3);
+    };
+    uint32_t written = 0;
+    for (uint32_t i = begin; i < end; i += 4) {
+        float32x4_t cx = vld1q_f32(soa.centerX + i), cy = vld1q_f32(soa.centerY + i);
+        float32x4_t cz = vld1q_f32(soa.centerZ + i), r = vld1q_f32(soa.radius + i);
+        float32x4_t distance[6];
+        float32x4_t reach = vdupq_n_f32(unbounded);
+        for (int p = 0; p < 6; p++) {
+            distance[p] = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(planes.w[p]), cx, planes.x[p]), cy, planes.y[p]), cz, planes.z[p]);
+            reach = vminq_f32(reach, vaddq_f32(distance[p], r));
+        }
+        if (laneMask(vcgeq_f32(reach, zero)) == 0) {
+            continue;
+        }
+        float32x4_t ex = vld1q_f32(soa.extentX + i), ey = vld1q_f32(soa.extentY + i), ez = vld1q_f32(soa.extentZ + i);
+        for (int p = 0; p < 6; p++) {
+            reach = vminq_f32(reach, vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(distance[p], ex, planes.ax[p]), ey, planes.ay[p]), ez, planes.az[p]));
+        }
+        written = AppendVisible(laneMask(vcgeq_f32(reach, zero)), i, visible, written);
+    }
+    return written;
+}
+#endif
+
+}
+
+Frustum ExtractFrustum(const glm::mat4 &viewProjection) {
+    // rows of the matrix, glm stores columns
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    }
+    // -w <= x <= w, -w <= y <= w, 0 <= z <= w
+    Frustum frustum;
+    for (int i = 0; i < 4; i++) {
+        frustum.planes[0][i] = rows[3][i] + rows[0][i];
+        frustum.planes[1][i] = rows[3][i] - rows[0][i];
+        frustum.planes[2][i] = rows[3][i] + rows[1][i];
+        frustum.planes[3][i] = rows[3][i] - rows[1][i];
+        frustum.planes[4][i] = rows[3][i] - rows[2][i];
+        frustum.planes[5][i] = rows[2][i];
+    }
+    for (glm::vec4 &plane : frustum.planes) {
+        float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+        // reverse-Z with an infinite far plane leaves z >= 0 without a normal, nothing lies behind it
+        plane = length > 1e-6f ? plane * (1.0f / length) : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+    return frustum;
+}
+
+void FrustumCuller::Resize(uint32_t count) {
+    uint32_t padded = (count + 7) & ~7u;
+    uint32_t previous = this->count;
+    this->count = count;
+    for (std::vector<float> *component : {&centerX, &centerY, &centerZ}) {
+        component->resize(padded, 0.0f);
+    }
+    // the padding fails every plane, objects past the old size pass every plane until they get bounds
+    radius.resize(padded);
+    std::fill(radius.begin() + std::min(previous, count), radius.begin() + count, unbounded);
+    std::fill(radius.begin() + count, radius.end(), -unbounded);
+    for (std::vector<float> *extent : {&extentX, &extentY, &extentZ}) {
+        extent->resize(padded);
+        std::fill(extent->begin() + std::min(previous, count), extent->begin() + count, unbounded);
+        std::fill(extent->begin() + count, extent->end(), 0.0f);
+    }
+}
+
+WorldBounds TransformBounds(const MeshBounds &bounds, const glm::mat4 &model) {
+    WorldBounds world;
+    if (bounds.min == glm::vec3(0.0f) && bounds.max == glm::vec3(0.0f)) {
+        world.unbounded = true;
+        return world;
+    }
+    glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+    glm::vec3 halfSize = (bounds.max - bounds.min) * 0.5f;
+    glm::vec4 worldCenter = model * glm::vec4(center, 1.0f);
+    // the box is the model space box's world aligned hull: every world axis gathers |M| * halfSize
+    float maxScale = 0.0f;
+    for (int column = 0; column < 3; column++) {
+        glm::vec3 axis(model[column].x, model[column].y, model[column].z);
+        world.extent = world.extent + glm::abs(axis) * halfSize[column];
+        maxScale = std::max(maxScale, glm::length(axis));
+    }
+    world.center = glm::vec3(worldCenter.x, worldCenter.y, worldCenter.z);
+    world.radius = glm::length(halfSize) * maxScale;
+    return world;
+}
+
+void FrustumCuller::SetBounds(uint32_t index, const MeshBounds &bounds, const glm::mat4 &model) {
+    WorldBounds world = TransformBounds(bounds, model);
+    if (world.unbounded) {
+        centerX[index] = centerY[index] = centerZ[index] = 0.0f;
+        radius[index] = extentX[index] = extentY[index] = extentZ[index] = unbounded;
+        return;
+    }
+    centerX[index] = world.center.x;
+    centerY[index] = world.center.y;
+    centerZ[index] = world.center.z;
+    radius[index] = world.radius;
+    extentX[index] = world.extent.x;
+    extentY[index] = world.extent.y;
+    extentZ[index] = world.extent.z;
+}
+
+uint32_t FrustumCuller::CullRange(const Frustum &frustum, uint32_t begin, uint32_t end, uint32_t *visible) const {
+    const PlaneSet planes(frustum);
+    const SoaView soa{centerX.data(), centerY.data(), centerZ.data(), radius.data(), extentX.data(), extentY.data(), extentZ.data()};
+    // the last range runs into the padding, which never comes out visible
+    end = (end + 7) & ~7u;
+#if ROVSKI_CULL_AVX2
+    if (HasAvx2()) {
+        return CullAvx2(planes, soa, begin, end, visible);
+    }
+#endif
+#if ROVSKI_CULL_SSE2
+    return CullSse2(planes, soa, begin, end, visible);
+#elif ROVSKI_CULL_NEON
+    return CullNeon(planes, soa, begin, end, visible);
+#else
+    uint32_t written = 0;
+    for (uint32_t i = begin; i < end; i++) {
+        if (ScalarReach(planes, soa, i) >= 0.0f) {
+            visible[written++] = i;
+        }
+    }
+    return written;
+#endif
+}
+
+void FrustumCuller::Cull(const Frustum &frustum, JobSystem &jobSystem, std::vector<uint32_t> &visible) {
+    ROVSKI_CPU_FUNCTION();
+    // every range compacts into its own slot of visible, the slots are then closed up in order
+    visible.resize((count + 7) & ~7u);
+    uint32_t rangeCount = (count + objectsPerJob - 1) / objectsPerJob;
+    rangeCounts.assign(rangeCount, 0);
+    jobSystem.ParallelFor(count, objectsPerJob, [&](uint32_t begin, uint32_t end, uint32_t) {
+        rangeCounts[begin / objectsPerJob] = CullRange(frustum, begin, end, visible.data() + begin);
+    });
+    uint32_t written = 0;
+    for (uint32_t range = 0; range < rangeCount; range++) {
+        uint32_t begin = range * objectsPerJob;
+        if (written != begin && rangeCounts[range] > 0) {
+            std::memmove(visible.data() + written, visible.data() + begin, rangeCounts[range] * sizeof(uint32_t));
+        }
+        written += rangeCounts[range];
+    }
+    visible.resize(written);
+}
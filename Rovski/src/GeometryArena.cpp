@@ -0,0 +1,36 @@
+//
+//  GeometryArena.cpp
+//  Rovski
+//
+
+#include "GeometryArena.hpp"
+
+void GeometryArena::Init(uint64_t vertexCapacity, uint64_t indexCapacity) {
+    vertexAllocator.Reset(vertexCapacity);
+    indexAllocator.Reset(indexCapacity);
+}
+
+bool GeometryArena::Allocate(uint32_t vertexCount, uint32_t indexCount, MeshRange &mesh) {
+    if (!vertexAllocator.Allocate(vertexCount, 1, mesh.vertices)) {
+        return false;
+    }
+    if (!indexAllocator.Allocate(indexCount, 1, mesh.indices)) {
+        vertexAllocator.Free(mesh.vertices.node);
+        mesh.vertices = {};
+        return false;
+    }
+    mesh.indexCount = indexCount;
+    mesh.firstIndex = static_cast<uint32_t>(mesh.indices.offset);
+    mesh.vertexOffset = static_cast<int32_t>(mesh.vertices.offset);
+    return true;
+}
+
+void GeometryArena::Free(MeshRange &mesh) {
+    if (mesh.vertices.node != TlsfAllocator::InvalidNode) {
+        vertexAllocator.Free(mesh.vertices.node);
+    }
+    if (mesh.indices.node != TlsfAllocator::InvalidNode) {
+        indexAllocator.Free(mesh.indices.node);
+    }
+    mesh = {};
+}
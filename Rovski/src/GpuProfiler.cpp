@@ -0,0 +1,226 @@
+//
+//  GpuProfiler.cpp
+//  Rovski
+//
+
+#include "GpuProfiler.hpp"
+#include <fstream>
+#include <iostream>
+
+static constexpr VkQueryPipelineStatisticFlags StatisticsFlags =
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+static constexpr uint32_t StatisticsCount = 4;
+
+bool GpuProfiler::Init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily, uint32_t frameCount,
+                       bool statisticsSupported, bool inheritedQueriesSupported, uint32_t maxScopes) {
+    this->device = device;
+    this->maxScopes = maxScopes;
+    this->statisticsSupported = statisticsSupported;
+    this->inheritedQueriesSupported = statisticsSupported && inheritedQueriesSupported;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+    uint32_t validBits = queueFamily < familyCount ? families[queueFamily].timestampValidBits : 0;
+    if (validBits == 0) {
+        std::cout << "queue family has no timestamps, gpu profiling disabled" << std::endl;
+        enabled = false;
+        return true;
+    }
+    timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+    timestampPeriodNs = properties.limits.timestampPeriod;
+
+    frames.resize(frameCount);
+    for (auto &frame : frames) {
+        VkQueryPoolCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        createInfo.queryCount = maxScopes * 2;
+        if (vkCreateQueryPool(device, &createInfo, nullptr, &frame.timestampPool) != VK_SUCCESS) {
+            return false;
+        }
+        if (statisticsSupported) {
+            createInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+            createInfo.queryCount = maxScopes;
+            createInfo.pipelineStatistics = StatisticsFlags;
+            if (vkCreateQueryPool(device, &createInfo, nullptr, &frame.statisticsPool) != VK_SUCCESS) {
+                return false;
+            }
+        }
+    }
+    enabled = true;
+    return true;
+}
+
+void GpuProfiler::Destroy() {
+    for (auto &frame : frames) {
+        vkDestroyQueryPool(device, frame.timestampPool, nullptr);
+        vkDestroyQueryPool(device, frame.statisticsPool, nullptr);
+    }
+    frames.clear();
+    enabled = false;
+}
+
+void GpuProfiler::Collect(FrameQueries &frame) {
+    if (frame.scopes.empty()) {
+        return;
+    }
+    uint32_t scopeCount = static_cast<uint32_t>(frame.scopes.size());
+    // value and availability per query, never waits: a missing result just drops the frame
+    std::vector<uint64_t> timestamps(scopeCount * 2 * 2);
+    VkResult result = vkGetQueryPoolResults(device, frame.timestampPool, 0, scopeCount * 2,
+                                            timestamps.size() * sizeof(uint64_t), timestamps.data(), 2 * sizeof(uint64_t),
+                                            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (result != VK_SUCCESS && result != VK_NOT_READY) {
+        return;
+    }
+    std::vector<uint64_t> statistics((StatisticsCount + 1) * frame.statisticsCount);
+    if (frame.statisticsCount > 0) {
+        vkGetQueryPoolResults(device, frame.statisticsPool, 0, frame.statisticsCount,
+                              statistics.size() * sizeof(uint64_t), statistics.data(), (StatisticsCount + 1) * sizeof(uint64_t),
+                              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    }
+
+    GpuFrameResult frameResult;
+    frameResult.frameIndex = frame.frameIndex;
+    for (uint32_t i = 0; i < scopeCount; i++) {
+        const ScopeRecord &record = frame.scopes[i];
+        const uint64_t *begin = &timestamps[i * 4];
+        const uint64_t *end = &timestamps[i * 4 + 2];
+        if (begin[1] == 0 || end[1] == 0) {
+            return;
+        }
+        GpuScopeResult scope;
+        scope.name = record.name;
+        scope.depth = record.depth;
+        scope.gpuMs = double((end[0] - begin[0]) & timestampMask) * timestampPeriodNs * 1e-6;
+        if (record.statisticsQuery != InvalidScope) {
+            const uint64_t *values = &statistics[record.statisticsQuery * (StatisticsCount + 1)];
+            // results come in flag bit order, followed by the availability word
+            scope.hasStatistics = values[StatisticsCount] != 0;
+            scope.inputAssemblyPrimitives = values[0];
+            scope.vertexShaderInvocations = values[1];
+            scope.clippingPrimitives = values[2];
+            scope.fragmentShaderInvocations = values[3];
+        }
+        frameResult.scopes.push_back(std::move(scope));
+    }
+    latest = frameResult;
+    history.push_back(std::move(frameResult));
+    if (history.size() > historyLimit) {
+        history.pop_front();
+    }
+}
+
+void GpuProfiler::BeginFrame(VkCommandBuffer commandBuffer, uint32_t frameSlot, uint64_t frameIndex) {
+    if (!enabled) {
+        return;
+    }
+    currentSlot = frameSlot;
+    FrameQueries &frame = frames[frameSlot];
+    Collect(frame);
+    frame.scopes.clear();
+    frame.statisticsCount = 0;
+    frame.frameIndex = frameIndex;
+    openDepth = 0;
+    openStatistics = 0;
+    vkCmdResetQueryPool(commandBuffer, frame.timestampPool, 0, maxScopes * 2);
+    if (frame.statisticsPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(commandBuffer, frame.statisticsPool, 0, maxScopes);
+    }
+}
+
+uint32_t GpuProfiler::BeginScope(VkCommandBuffer commandBuffer, const char *name, bool statistics) {
+    if (!enabled) {
+        return InvalidScope;
+    }
+    FrameQueries &frame = frames[currentSlot];
+    if (frame.scopes.size() == maxScopes) {
+        return InvalidScope;
+    }
+    uint32_t scope = static_cast<uint32_t>(frame.scopes.size());
+    ScopeRecord record;
+    record.name = name;
+    record.depth = openDepth++;
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.timestampPool, scope * 2);
+    // statistics queries of one pool can't nest, an inner scope only gets timestamps
+    if (statistics && statisticsSupported && openStatistics == 0) {
+        record.statisticsQuery = frame.statisticsCount++;
+        vkCmdBeginQuery(commandBuffer, frame.statisticsPool, record.statisticsQuery, 0);
+        openStatistics++;
+    }
+    frame.scopes.push_back(record);
+    return scope;
+}
+
+void GpuProfiler::EndScope(VkCommandBuffer commandBuffer, uint32_t scope) {
+    if (!enabled || scope == InvalidScope) {
+        return;
+    }
+    FrameQueries &frame = frames[currentSlot];
+    const ScopeRecord &record = frame.scopes[scope];
+    if (record.statisticsQuery != InvalidScope) {
+        vkCmdEndQuery(commandBuffer, frame.statisticsPool, record.statisticsQuery);
+        openStatistics--;
+    }
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.timestampPool, scope * 2 + 1);
+    openDepth--;
+}
+
+VkQueryPipelineStatisticFlags GpuProfiler::ActiveStatistics() const {
+    return enabled && openStatistics > 0 ? StatisticsFlags : 0;
+}
+
+bool GpuProfiler::DumpCsv(const std::string &path) const {
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+    file << "frame,scope,depth,gpu_ms,ia_primitives,vs_invocations,clip_primitives,fs_invocations" << std::endl;
+    for (auto &frame : history) {
+        for (auto &scope : frame.scopes) {
+            file << frame.frameIndex << "," << scope.name << "," << scope.depth << "," << scope.gpuMs << ",";
+            if (scope.hasStatistics) {
+                file << scope.inputAssemblyPrimitives << "," << scope.vertexShaderInvocations << ","
+                     << scope.clippingPrimitives << "," << scope.fragmentShaderInvocations;
+            } else {
+                file << ",,,";
+            }
+            file << "\n";
+        }
+    }
+    return file.good();
+}
+
+bool GpuProfiler::DumpJson(const std::string &path) const {
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+    file << "{\"frames\":[";
+    for (size_t f = 0; f < history.size(); f++) {
+        const GpuFrameResult &frame = history[f];
+        file << (f ? "," : "") << "\n{\"frame\":" << frame.frameIndex << ",\"scopes\":[";
+        for (size_t s = 0; s < frame.scopes.size(); s++) {
+            const GpuScopeResult &scope = frame.scopes[s];
+            file << (s ? "," : "") << "{\"name\":\"" << scope.name << "\",\"depth\":" << scope.depth
+                 << ",\"gpu_ms\":" << scope.gpuMs;
+            if (scope.hasStatistics) {
+                file << ",\"ia_primitives\":" << scope.inputAssemblyPrimitives
+                     << ",\"vs_invocations\":" << scope.vertexShaderInvocations
+                     << ",\"clip_primitives\":" << scope.clippingPrimitives
+                     << ",\"fs_invocations\":" << scope.fragmentShaderInvocations;
+            }
+            file << "}";
+        }
+        file << "]}";
+    }
+    file << "\n]}" << std::endl;
+    return file.good();
+}
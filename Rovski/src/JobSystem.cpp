@@ -0,0 +1,136 @@
+//
+//  JobSystem.cpp
+//  Rovski
+//
+
+#include "JobSystem.hpp"
+#include "CpuProfiler.hpp"
+#include <algorithm>
+
+static thread_local uint32_t threadIndexOfCurrent = 0;
+
+JobSystem::JobSystem(uint32_t workerCount, std::string threadName) : threadName(std::move(threadName)) {
+    queues.reserve(workerCount + 1);
+    for (uint32_t i = 0; i <= workerCount; i++) {
+        queues.push_back(std::make_unique<WorkQueue>());
+    }
+    threadIndexOfCurrent = 0;
+    workers.reserve(workerCount);
+    for (uint32_t i = 1; i <= workerCount; i++) {
+        workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        running = false;
+    }
+    wakeUp.notify_all();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+uint32_t JobSystem::CurrentThreadIndex() {
+    return threadIndexOfCurrent;
+}
+
+uint32_t JobSystem::DefaultWorkerCount() {
+    uint32_t hardwareThreads = std::thread::hardware_concurrency();
+    return hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+}
+
+void JobSystem::Submit(JobFunction function, Counter &counter) {
+    counter.pending.fetch_add(1, std::memory_order_relaxed);
+    WorkQueue &queue = *queues[CurrentThreadIndex()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(Job{std::move(function), &counter});
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        queuedJobs.fetch_add(1, std::memory_order_relaxed);
+    }
+    wakeUp.notify_one();
+}
+
+bool JobSystem::PopOrSteal(uint32_t threadIndex, Job &job) {
+    {
+        WorkQueue &own = *queues[threadIndex];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.jobs.empty()) {
+            job = std::move(own.jobs.back());
+            own.jobs.pop_back();
+            queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    uint32_t threadCount = ThreadCount();
+    for (uint32_t i = 1; i < threadCount; i++) {
+        WorkQueue &victim = *queues[(threadIndex + i) % threadCount];
+        std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+        if (lock.owns_lock() && !victim.jobs.empty()) {
+            job = std::move(victim.jobs.front());
+            victim.jobs.pop_front();
+            queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::Execute(Job &job, uint32_t threadIndex) {
+    job.function(threadIndex);
+    job.counter->pending.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+void JobSystem::WorkerLoop(uint32_t threadIndex) {
+    threadIndexOfCurrent = threadIndex;
+    CpuProfiler::Instance().SetThreadName(threadName + " " + std::to_string(threadIndex));
+    Job job;
+    while (true) {
+        if (PopOrSteal(threadIndex, job)) {
+            Execute(job, threadIndex);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wakeUp.wait(lock, [this] {
+            return !running || queuedJobs.load(std::memory_order_relaxed) > 0;
+        });
+        if (!running) {
+            return;
+        }
+    }
+}
+
+void JobSystem::Wait(Counter &counter) {
+    uint32_t threadIndex = CurrentThreadIndex();
+    Job job;
+    while (counter.pending.load(std::memory_order_acquire) > 0) {
+        if (PopOrSteal(threadIndex, job)) {
+            Execute(job, threadIndex);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::ParallelFor(uint32_t count, uint32_t grain, const RangeFunction &function) {
+    if (count == 0) {
+        return;
+    }
+    grain = std::max(grain, 1u);
+    if (count <= grain || ThreadCount() == 1) {
+        function(0, count, CurrentThreadIndex());
+        return;
+    }
+    Counter counter;
+    for (uint32_t begin = 0; begin < count; begin += grain) {
+        uint32_t end = std::min(count, begin + grain);
+        Submit([&function, begin, end](uint32_t threadIndex) {
+            function(begin, end, threadIndex);
+        }, counter);
+    }
+    Wait(counter);
+}
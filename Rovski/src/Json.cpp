@@ -0,0 +1,281 @@
+//
+//  Json.cpp
+//  Rovski
+//
+
+#include "Json.hpp"
+#include <cstdlib>
+#include <cstring>
+
+static const JsonValue nullValue;
+
+class JsonParser {
+public:
+    JsonParser(const char *begin, const char *end) : cursor(begin), end(end) {}
+
+    bool ParseDocument(JsonValue &value, std::string &error) {
+        if (!ParseValue(value, 0)) {
+            error = message;
+            return false;
+        }
+        SkipSpace();
+        if (cursor != end) {
+            error = "trailing characters after the document";
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static constexpr uint32_t maxDepth = 128;
+
+    bool Fail(const char *what) {
+        message = what;
+        return false;
+    }
+
+    void SkipSpace() {
+        while (cursor != end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\n' || *cursor == '\r')) {
+            cursor++;
+        }
+    }
+
+    bool Consume(const char *literal) {
+        size_t length = strlen(literal);
+        if (static_cast<size_t>(end - cursor) < length || memcmp(cursor, literal, length) != 0) {
+            return false;
+        }
+        cursor += length;
+        return true;
+    }
+
+    bool ParseValue(JsonValue &value, uint32_t depth) {
+        if (depth > maxDepth) {
+            return Fail("document nested too deeply");
+        }
+        SkipSpace();
+        if (cursor == end) {
+            return Fail("unexpected end of document");
+        }
+        switch (*cursor) {
+            case '{':
+                return ParseObject(value, depth);
+            case '[':
+                return ParseArray(value, depth);
+            case '"':
+                value.type = JsonValue::Type::String;
+                return ParseString(value.text);
+            case 't':
+                value.type = JsonValue::Type::Bool;
+                value.boolean = true;
+                return Consume("true") || Fail("invalid literal");
+            case 'f':
+                value.type = JsonValue::Type::Bool;
+                value.boolean = false;
+                return Consume("false") || Fail("invalid literal");
+            case 'n':
+                value.type = JsonValue::Type::Null;
+                return Consume("null") || Fail("invalid literal");
+            default:
+                return ParseNumber(value);
+        }
+    }
+
+    bool ParseObject(JsonValue &value, uint32_t depth) {
+        value.type = JsonValue::Type::Object;
+        cursor++;
+        SkipSpace();
+        if (cursor != end && *cursor == '}') {
+            cursor++;
+            return true;
+        }
+        while (true) {
+            SkipSpace();
+            if (cursor == end || *cursor != '"') {
+                return Fail("expected member name");
+            }
+            value.members.emplace_back();
+            if (!ParseString(value.members.back().first)) {
+                return false;
+            }
+            SkipSpace();
+            if (cursor == end || *cursor != ':') {
+                return Fail("expected ':' after member name");
+            }
+            cursor++;
+            if (!ParseValue(value.members.back().second, depth + 1)) {
+                return false;
+            }
+            SkipSpace();
+            if (cursor != end && *cursor == ',') {
+                cursor++;
+                continue;
+            }
+            if (cursor != end && *cursor == '}') {
+                cursor++;
+                return true;
+            }
+            return Fail("expected ',' or '}' in object");
+        }
+    }
+
+    bool ParseArray(JsonValue &value, uint32_t depth) {
+        value.type = JsonValue::Type::Array;
+        cursor++;
+        SkipSpace();
+        if (cursor != end && *cursor == ']') {
+            cursor++;
+            return true;
+        }
+        while (true) {
+            value.elements.emplace_back();
+            if (!ParseValue(value.elements.back(), depth + 1)) {
+                return false;
+            }
+            SkipSpace();
+            if (cursor != end && *cursor == ',') {
+                cursor++;
+                continue;
+            }
+            if (cursor != end && *cursor == ']') {
+                cursor++;
+                return true;
+            }
+            return Fail("expected ',' or ']' in array");
+        }
+    }
+
+    bool ParseHex4(uint32_t &code) {
+        if (end - cursor < 4) {
+            return Fail("truncated unicode escape");
+        }
+        code = 0;
+        for (int i = 0; i < 4; i++) {
+            char c = *cursor++;
+            code <<= 4;
+            if (c >= '0' && c <= '9') {
+                code |= c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                code |= c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                code |= c - 'A' + 10;
+            } else {
+                return Fail("invalid unicode escape");
+            }
+        }
+        return true;
+    }
+
+    static void AppendUtf8(std::string &out, uint32_t code) {
+        if (code < 0x80) {
+            out += static_cast<char>(code);
+        } else if (code < 0x800) {
+            out += static_cast<char>(0xC0 | (code >> 6));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            out += static_cast<char>(0xE0 | (code >> 12));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (code >> 18));
+            out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+
+    bool ParseString(std::string &out) {
+        cursor++;
+        while (cursor != end && *cursor != '"') {
+            char c = *cursor++;
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (cursor == end) {
+                break;
+            }
+            char escaped = *cursor++;
+            switch (escaped) {
+                case '"': out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/': out += '/'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    uint32_t code;
+                    if (!ParseHex4(code)) {
+                        return false;
+                    }
+                    if (code >= 0xD800 && code < 0xDC00) {
+                        uint32_t low;
+                        if (!Consume("\\u") || !ParseHex4(low) || low < 0xDC00 || low >= 0xE000) {
+                            return Fail("invalid surrogate pair");
+                        }
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    AppendUtf8(out, code);
+                    break;
+                }
+                default:
+                    return Fail("invalid escape");
+            }
+        }
+        if (cursor == end) {
+            return Fail("unterminated string");
+        }
+        cursor++;
+        return true;
+    }
+
+    bool ParseNumber(JsonValue &value) {
+        const char *start = cursor;
+        while (cursor != end && (strchr("+-.eE", *cursor) != nullptr || (*cursor >= '0' && *cursor <= '9'))) {
+            cursor++;
+        }
+        size_t length = cursor - start;
+        char token[64];
+        if (length == 0 || length >= sizeof(token)) {
+            return Fail("invalid number");
+        }
+        // the document is not null terminated (glb chunks), strtod gets its own copy
+        memcpy(token, start, length);
+        token[length] = '\0';
+        char *parsedEnd = nullptr;
+        value.type = JsonValue::Type::Number;
+        value.number = strtod(token, &parsedEnd);
+        return parsedEnd == token + length || Fail("invalid number");
+    }
+
+    const char *cursor;
+    const char *end;
+    const char *message = "";
+};
+
+bool JsonValue::Parse(const char *begin, const char *end, JsonValue &value, std::string &error) {
+    value = JsonValue{};
+    JsonParser parser(begin, end);
+    return parser.ParseDocument(value, error);
+}
+
+bool JsonValue::Has(const std::string &key) const {
+    return !(*this)[key].IsNull();
+}
+
+const JsonValue &JsonValue::operator[](size_t index) const {
+    return type == Type::Array && index < elements.size() ? elements[index] : nullValue;
+}
+
+const JsonValue &JsonValue::operator[](const std::string &key) const {
+    if (type == Type::Object) {
+        for (auto &member : members) {
+            if (member.first == key) {
+                return member.second;
+            }
+        }
+    }
+    return nullValue;
+}
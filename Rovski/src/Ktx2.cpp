@@ -0,0 +1,306 @@
+//
+//  Ktx2.cpp
+//  Rovski
+//
+
+#include "Ktx2.hpp"
+#include "BlockCompression.hpp"
+#include "CpuProfiler.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static constexpr uint8_t ktx2Identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+// identifier, nine header words, four index words and two 64 bit index entries
+static constexpr size_t ktx2HeaderSize = 12 + 9 * 4 + 4 * 4 + 2 * 8;
+static constexpr size_t ktx2LevelEntrySize = 3 * 8;
+
+static uint32_t ReadU32(const uint8_t *data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static uint64_t ReadU64(const uint8_t *data) {
+    uint64_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static void AppendU32(std::vector<uint8_t> &out, uint32_t value) {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(value));
+}
+
+static void AppendU64(std::vector<uint8_t> &out, uint64_t value) {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(value));
+}
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static uint64_t LevelSize(uint32_t width, uint32_t height, uint32_t level, uint32_t blockBytes, uint32_t blockDim) {
+    uint64_t w = std::max(1u, width >> level);
+    uint64_t h = std::max(1u, height >> level);
+    return (w + blockDim - 1) / blockDim * ((h + blockDim - 1) / blockDim) * blockBytes;
+}
+
+// Khronos basic data format descriptor: color model, transfer function and one sample per channel (or per BC sub-block)
+static std::vector<uint32_t> BasicDescriptor(VkFormat format, uint32_t blockBytes, uint32_t blockDim) {
+    enum : uint32_t { ModelRgbsda = 1, ModelBc1 = 128, ModelBc2 = 129, ModelBc3 = 130, ModelBc4 = 131, ModelBc5 = 132, ModelBc7 = 134 };
+    enum : uint32_t { ChannelAlpha = 15, QualifierLinear = 0x10, QualifierSigned = 0x40 };
+    struct Sample {
+        uint32_t channel;
+        uint32_t bitOffset;
+        uint32_t bitLength;
+    };
+    bool srgb = false;
+    bool isSigned = false;
+    uint32_t model = ModelRgbsda;
+    std::vector<Sample> samples;
+    switch (format) {
+        case VK_FORMAT_R8G8B8A8_SRGB:
+            srgb = true;
+            [[fallthrough]];
+        case VK_FORMAT_R8G8B8A8_UNORM:
+            samples = {{0, 0, 8}, {1, 8, 8}, {2, 16, 8}, {ChannelAlpha, 24, 8}};
+            break;
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            srgb = true;
+            [[fallthrough]];
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+            model = ModelBc1;
+            samples = {{0, 0, 64}};
+            break;
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+            srgb = true;
+            [[fallthrough]];
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+            model = ModelBc1;
+            samples = {{1, 0, 64}};
+            break;
+        case VK_FORMAT_BC2_SRGB_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+            srgb = true;
+            [[fallthrough]];
+        case VK_FORMAT_BC2_UNORM_BLOCK:
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+            model = format == VK_FORMAT_BC2_UNORM_BLOCK || format == VK_FORMAT_BC2_SRGB_BLOCK ? ModelBc2 : ModelBc3;
+            samples = {{ChannelAlpha, 0, 64}, {0, 64, 64}};
+            break;
+        case VK_FORMAT_BC4_SNORM_BLOCK:
+            isSigned = true;
+            [[fallthrough]];
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+            model = ModelBc4;
+            samples = {{0, 0, 64}};
+            break;
+        case VK_FORMAT_BC5_SNORM_BLOCK:
+            isSigned = true;
+            [[fallthrough]];
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            model = ModelBc5;
+            samples = {{0, 0, 64}, {1, 64, 64}};
+            break;
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            srgb = true;
+            [[fallthrough]];
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+            model = ModelBc7;
+            samples = {{0, 0, 128}};
+            break;
+        default:
+            break;
+    }
+    const uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+    const uint32_t primariesBt709 = 1;
+    const uint32_t transfer = srgb ? 2 : 1;
+    std::vector<uint32_t> words = {
+        4 + blockSize,
+        0,
+        2 | blockSize << 16,
+        model | primariesBt709 << 8 | transfer << 16,
+        (blockDim - 1) | (blockDim - 1) << 8,
+        blockBytes,
+        0,
+    };
+    for (const Sample &sample : samples) {
+        uint32_t channelType = sample.channel;
+        if (srgb && sample.channel == ChannelAlpha) {
+            channelType |= QualifierLinear;
+        }
+        if (isSigned) {
+            channelType |= QualifierSigned;
+        }
+        uint32_t upper = sample.bitLength == 8 ? 255u : isSigned ? 0x7FFFFFFFu : 0xFFFFFFFFu;
+        uint32_t lower = isSigned ? 0x80000000u : 0u;
+        words.push_back(sample.bitOffset | (sample.bitLength - 1) << 16 | channelType << 24);
+        words.push_back(0);
+        words.push_back(lower);
+        words.push_back(upper);
+    }
+    return words;
+}
+
+bool Ktx2File::Fail(const std::string &path, const char *message) {
+    std::cout << path << ": " << message << std::endl;
+    file.Close();
+    levels.clear();
+    keyValues.clear();
+    return false;
+}
+
+bool Ktx2File::Open(const std::string &path) {
+    ROVSKI_CPU_FUNCTION();
+    levels.clear();
+    keyValues.clear();
+    if (!file.Open(path)) {
+        return false;
+    }
+    const uint8_t *data = reinterpret_cast<const uint8_t*>(file.Data());
+    const uint64_t size = file.Size();
+    if (size < ktx2HeaderSize || memcmp(data, ktx2Identifier, sizeof(ktx2Identifier)) != 0) {
+        return Fail(path, "not a KTX2 file");
+    }
+    const uint8_t *header = data + sizeof(ktx2Identifier);
+    format = static_cast<VkFormat>(ReadU32(header));
+    width = ReadU32(header + 8);
+    height = ReadU32(header + 12);
+    uint32_t depth = ReadU32(header + 16);
+    uint32_t layerCount = ReadU32(header + 20);
+    uint32_t faceCount = ReadU32(header + 24);
+    uint32_t levelCount = std::max(1u, ReadU32(header + 28));
+    uint32_t supercompression = ReadU32(header + 32);
+    uint64_t kvdOffset = ReadU32(header + 44);
+    uint64_t kvdLength = ReadU32(header + 48);
+    uint32_t blockBytes, blockDim;
+    if (supercompression != 0) {
+        return Fail(path, "supercompressed KTX2 (Basis Universal, zstd) is not supported");
+    }
+    if (!FormatBlockInfo(format, blockBytes, blockDim)) {
+        return Fail(path, "unsupported KTX2 format");
+    }
+    if (width == 0 || height == 0 || depth > 1 || layerCount > 1 || faceCount != 1 || levelCount > 32) {
+        return Fail(path, "only single layer 2D KTX2 textures are supported");
+    }
+    if (size < ktx2HeaderSize + levelCount * ktx2LevelEntrySize) {
+        return Fail(path, "truncated KTX2 level index");
+    }
+    for (uint32_t level = 0; level < levelCount; level++) {
+        const uint8_t *entry = data + ktx2HeaderSize + level * ktx2LevelEntrySize;
+        uint64_t offset = ReadU64(entry);
+        uint64_t length = ReadU64(entry + 8);
+        uint64_t expected = LevelSize(width, height, level, blockBytes, blockDim);
+        if (length < expected || offset > size || size - offset < length) {
+            return Fail(path, "KTX2 level out of bounds");
+        }
+        levels.push_back({data + offset, expected});
+    }
+    if (kvdOffset > size || size - kvdOffset < kvdLength) {
+        return Fail(path, "KTX2 key/value data out of bounds");
+    }
+    for (uint64_t cursor = kvdOffset; cursor + 4 <= kvdOffset + kvdLength;) {
+        uint32_t length = ReadU32(data + cursor);
+        const char *entry = reinterpret_cast<const char*>(data + cursor + 4);
+        if (length > kvdOffset + kvdLength - cursor - 4) {
+            return Fail(path, "truncated KTX2 key/value entry");
+        }
+        const char *keyEnd = static_cast<const char*>(memchr(entry, '\0', length));
+        if (keyEnd != nullptr) {
+            std::string value(keyEnd + 1, entry + length);
+            if (!value.empty() && value.back() == '\0') {
+                value.pop_back();
+            }
+            keyValues.emplace_back(std::string(entry, keyEnd), std::move(value));
+        }
+        cursor += AlignUp(4 + uint64_t(length), 4);
+    }
+    return true;
+}
+
+std::string Ktx2File::Value(const std::string &key) const {
+    for (auto &keyValue : keyValues) {
+        if (keyValue.first == key) {
+            return keyValue.second;
+        }
+    }
+    return {};
+}
+
+bool Ktx2File::Write(const std::string &path, VkFormat format, uint32_t width, uint32_t height, const std::vector<Ktx2Level> &levels,
+                     std::vector<std::pair<std::string, std::string>> keyValues) {
+    ROVSKI_CPU_FUNCTION();
+    uint32_t blockBytes, blockDim;
+    if (!FormatBlockInfo(format, blockBytes, blockDim) || levels.empty()) {
+        return false;
+    }
+    std::vector<uint32_t> descriptor = BasicDescriptor(format, blockBytes, blockDim);
+    // entries have to be sorted by key
+    std::sort(keyValues.begin(), keyValues.end());
+    std::vector<uint8_t> keyValueData;
+    for (auto &keyValue : keyValues) {
+        uint32_t length = static_cast<uint32_t>(keyValue.first.size() + 1 + keyValue.second.size() + 1);
+        AppendU32(keyValueData, length);
+        keyValueData.insert(keyValueData.end(), keyValue.first.begin(), keyValue.first.end());
+        keyValueData.push_back(0);
+        keyValueData.insert(keyValueData.end(), keyValue.second.begin(), keyValue.second.end());
+        keyValueData.push_back(0);
+        keyValueData.resize(AlignUp(keyValueData.size(), 4));
+    }
+
+    const uint32_t levelCount = static_cast<uint32_t>(levels.size());
+    const uint64_t dfdOffset = ktx2HeaderSize + levelCount * ktx2LevelEntrySize;
+    const uint64_t dfdLength = descriptor.size() * sizeof(uint32_t);
+    const uint64_t kvdOffset = keyValueData.empty() ? 0 : dfdOffset + dfdLength;
+    // level data is aligned to lcm(block size, 4), the block sizes are all powers of two
+    const uint64_t levelAlignment = std::max(4u, blockBytes);
+    std::vector<uint64_t> levelOffsets(levelCount);
+    uint64_t end = dfdOffset + dfdLength + keyValueData.size();
+    for (uint32_t level = levelCount; level-- > 0;) {
+        if (levels[level].size != LevelSize(width, height, level, blockBytes, blockDim)) {
+            return false;
+        }
+        levelOffsets[level] = AlignUp(end, levelAlignment);
+        end = levelOffsets[level] + levels[level].size;
+    }
+
+    std::vector<uint8_t> header(ktx2Identifier, ktx2Identifier + sizeof(ktx2Identifier));
+    for (uint32_t word : {uint32_t(format), 1u, width, height, 0u, 0u, 1u, levelCount, 0u}) {
+        AppendU32(header, word);
+    }
+    AppendU32(header, static_cast<uint32_t>(dfdOffset));
+    AppendU32(header, static_cast<uint32_t>(dfdLength));
+    AppendU32(header, static_cast<uint32_t>(kvdOffset));
+    AppendU32(header, static_cast<uint32_t>(keyValueData.size()));
+    AppendU64(header, 0);
+    AppendU64(header, 0);
+    for (uint32_t level = 0; level < levelCount; level++) {
+        AppendU64(header, levelOffsets[level]);
+        AppendU64(header, levels[level].size);
+        AppendU64(header, levels[level].size);
+    }
+
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size()));
+        file.write(reinterpret_cast<const char*>(descriptor.data()), static_cast<std::streamsize>(dfdLength));
+        file.write(reinterpret_cast<const char*>(keyValueData.data()), static_cast<std::streamsize>(keyValueData.size()));
+        uint64_t written = dfdOffset + dfdLength + keyValueData.size();
+        const char padding[16] = {};
+        for (uint32_t level = levelCount; level-- > 0;) {
+            file.write(padding, static_cast<std::streamsize>(levelOffsets[level] - written));
+            file.write(reinterpret_cast<const char*>(levels[level].data), static_cast<std::streamsize>(levels[level].size));
+            written = levelOffsets[level] + levels[level].size;
+        }
+        if (!file) {
+            std::cout << "failed to write " << tempPath << std::endl;
+            return false;
+        }
+    }
+    return std::rename(tempPath.c_str(), path.c_str()) == 0;
+}
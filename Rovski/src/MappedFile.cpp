@@ -0,0 +1,111 @@
+//
+//  MappedFile.cpp
+//  Rovski
+//
+
+#include "MappedFile.hpp"
+#include <cstring>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+        Close();
+        std::swap(data, other.data);
+        std::swap(size, other.size);
+        std::swap(opened, other.opened);
+    }
+    return *this;
+}
+
+bool MappedFile::Open(const std::string &path) {
+    Close();
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info{};
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return false;
+    }
+    size = static_cast<size_t>(info.st_size);
+    if (size > 0) {
+        data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            data = nullptr;
+            size = 0;
+            close(fd);
+            return false;
+        }
+        // everything is read front to back exactly once
+        madvise(data, size, MADV_SEQUENTIAL);
+    }
+    // the mapping keeps its own reference to the file
+    close(fd);
+    opened = true;
+    return true;
+}
+
+void MappedFile::Close() {
+    if (data != nullptr) {
+        munmap(data, size);
+    }
+    data = nullptr;
+    size = 0;
+    opened = false;
+}
+
+static inline uint64_t RotateLeft(uint64_t x, int bits) {
+    return (x << bits) | (x >> (64 - bits));
+}
+
+static inline uint64_t Round(uint64_t accumulator, uint64_t input) {
+    constexpr uint64_t prime1 = 0x9E3779B185EBCA87ull;
+    constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+    accumulator += input * prime2;
+    return RotateLeft(accumulator, 31) * prime1;
+}
+
+uint64_t HashBytes(const void *data, size_t size, uint64_t seed) {
+    constexpr uint64_t prime1 = 0x9E3779B185EBCA87ull;
+    constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+    constexpr uint64_t prime3 = 0x165667B19E3779F9ull;
+    const char *p = static_cast<const char*>(data);
+    const char *end = p + size;
+    uint64_t lanes[4] = {seed + prime1 + prime2, seed + prime2, seed, seed - prime1};
+    for (; end - p >= 32; p += 32) {
+        for (int lane = 0; lane < 4; lane++) {
+            uint64_t word;
+            memcpy(&word, p + lane * 8, 8);
+            lanes[lane] = Round(lanes[lane], word);
+        }
+    }
+    uint64_t hash = RotateLeft(lanes[0], 1) + RotateLeft(lanes[1], 7) + RotateLeft(lanes[2], 12) + RotateLeft(lanes[3], 18);
+    hash += static_cast<uint64_t>(size);
+    for (; end - p >= 8; p += 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        hash = RotateLeft(hash ^ Round(0, word), 27) * prime1 + prime3;
+    }
+    for (; p < end; p++) {
+        hash = RotateLeft(hash ^ (static_cast<uint8_t>(*p) * prime3), 11) * prime1;
+    }
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    hash *= prime3;
+    hash ^= hash >> 32;
+    return hash;
+}
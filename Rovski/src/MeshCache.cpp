@@ -0,0 +1,128 @@
+//
+//  MeshCache.cpp
+//  Rovski
+//
+
+#include "MeshCache.hpp"
+#include "CpuProfiler.hpp"
+#include "Json.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static constexpr char cacheMagic[4] = {'R', 'V', 'M', 'C'};
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+MeshCacheHeader MeshCache::ExpectedHeader() {
+    MeshCacheHeader header{};
+    memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = Version;
+    header.vertexStride = Vertex::getBindingDescription().stride;
+    auto attributes = Vertex::getVertexInputAttributeDescription();
+    static_assert(std::tuple_size_v<Vertex::DataType> <= 4, "cache header holds at most four attributes");
+    header.attributeCount = static_cast<uint32_t>(attributes.size());
+    for (size_t i = 0; i < attributes.size(); i++) {
+        header.attributeOffsets[i] = attributes[i].offset;
+        header.attributeFormats[i] = static_cast<uint32_t>(attributes[i].format);
+    }
+    return header;
+}
+
+bool MeshCache::HashSource(const std::string &sourcePath, uint64_t &hash) {
+    ROVSKI_CPU_FUNCTION();
+    MappedFile source;
+    if (!source.Open(sourcePath)) {
+        return false;
+    }
+    hash = HashBytes(source.Data(), source.Size());
+    size_t dot = sourcePath.find_last_of('.');
+    if (dot == std::string::npos || sourcePath.compare(dot, std::string::npos, ".gltf") != 0) {
+        return true;
+    }
+    // a .gltf is only the header, its geometry usually sits in .bin files next to it
+    JsonValue gltf;
+    std::string error;
+    if (!JsonValue::Parse(source.Data(), source.Data() + source.Size(), gltf, error)) {
+        return true;
+    }
+    size_t slash = sourcePath.find_last_of("/\\");
+    std::string directory = slash == std::string::npos ? "" : sourcePath.substr(0, slash + 1);
+    const JsonValue &buffers = gltf["buffers"];
+    for (size_t i = 0; i < buffers.Size(); i++) {
+        const std::string &uri = buffers[i]["uri"].AsString();
+        if (uri.empty() || uri.rfind("data:", 0) == 0) {
+            continue;
+        }
+        MappedFile buffer;
+        if (!buffer.Open(directory + uri)) {
+            return false;
+        }
+        hash = HashBytes(buffer.Data(), buffer.Size(), hash);
+    }
+    return true;
+}
+
+bool MeshCache::Write(const std::string &cachePath, uint64_t sourceHash, const MeshData &mesh) {
+    ROVSKI_CPU_FUNCTION();
+    MeshCacheHeader header = ExpectedHeader();
+    header.sourceHash = sourceHash;
+    header.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+    header.indexCount = static_cast<uint32_t>(mesh.indices.size());
+    memcpy(header.boundsMin, &mesh.bounds.min, sizeof(header.boundsMin));
+    memcpy(header.boundsMax, &mesh.bounds.max, sizeof(header.boundsMax));
+    uint64_t vertexBytes = uint64_t(header.vertexCount) * header.vertexStride;
+    header.vertexDataOffset = AlignUp(sizeof(MeshCacheHeader), 16);
+    header.indexDataOffset = AlignUp(header.vertexDataOffset + vertexBytes, 16);
+
+    // write aside and rename, a reader must never map a half written cache
+    std::string tempPath = cachePath + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        const char padding[16] = {};
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(padding, static_cast<std::streamsize>(header.vertexDataOffset - sizeof(header)));
+        file.write(reinterpret_cast<const char*>(mesh.vertices.data()), static_cast<std::streamsize>(vertexBytes));
+        file.write(padding, static_cast<std::streamsize>(header.indexDataOffset - header.vertexDataOffset - vertexBytes));
+        file.write(reinterpret_cast<const char*>(mesh.indices.data()), static_cast<std::streamsize>(mesh.indices.size() * sizeof(uint32_t)));
+        if (!file) {
+            std::cout << "failed to write mesh cache " << tempPath << std::endl;
+            return false;
+        }
+    }
+    return std::rename(tempPath.c_str(), cachePath.c_str()) == 0;
+}
+
+bool MeshCache::Open(const std::string &cachePath, uint64_t sourceHash) {
+    ROVSKI_CPU_FUNCTION();
+    if (!file.Open(cachePath)) {
+        return false;
+    }
+    MeshCacheHeader expected = ExpectedHeader();
+    bool valid = file.Size() >= sizeof(MeshCacheHeader);
+    if (valid) {
+        const MeshCacheHeader &header = Header();
+        valid = memcmp(header.magic, expected.magic, sizeof(expected.magic)) == 0 && header.version == expected.version &&
+                header.vertexStride == expected.vertexStride && header.attributeCount == expected.attributeCount &&
+                memcmp(header.attributeOffsets, expected.attributeOffsets, sizeof(expected.attributeOffsets)) == 0 &&
+                memcmp(header.attributeFormats, expected.attributeFormats, sizeof(expected.attributeFormats)) == 0 &&
+                header.sourceHash == sourceHash &&
+                header.vertexDataOffset % 16 == 0 && header.indexDataOffset % 16 == 0 &&
+                header.vertexDataOffset + uint64_t(header.vertexCount) * header.vertexStride <= header.indexDataOffset &&
+                header.indexDataOffset + uint64_t(header.indexCount) * sizeof(uint32_t) <= file.Size();
+    }
+    if (!valid) {
+        file.Close();
+    }
+    return valid;
+}
+
+MeshBounds MeshCache::Bounds() const {
+    MeshBounds bounds;
+    memcpy(&bounds.min, Header().boundsMin, sizeof(bounds.min));
+    memcpy(&bounds.max, Header().boundsMax, sizeof(bounds.max));
+    return bounds;
+}
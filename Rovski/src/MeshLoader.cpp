@@ -0,0 +1,976 @@
+//
+//  MeshLoader.cpp
+//  Rovski
+//
+
+#include "MeshLoader.hpp"
+#include "CpuProfiler.hpp"
+#include "Json.hpp"
+#include "MappedFile.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace {
+
+// OBJ text is cut into chunks of about this size at line boundaries
+constexpr size_t objChunkSize = 1 << 20;
+// vertices and corners handled per job when converting or deduplicating
+constexpr uint32_t elementGrain = 1 << 16;
+
+std::string Extension(const std::string &path) {
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos || path.find_first_of("/\\", dot) != std::string::npos) {
+        return "";
+    }
+    std::string extension = path.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+    return extension;
+}
+
+std::string Directory(const std::string &path) {
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+}
+
+uint64_t Mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+// ---- OBJ ----
+
+bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+void SkipSpace(const char *&p, const char *end) {
+    while (p != end && IsSpace(*p)) {
+        p++;
+    }
+}
+
+// strtod skips newlines and needs a terminator, this one stays on the line
+bool ParseFloat(const char *&p, const char *end, float &out) {
+    static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    SkipSpace(p, end);
+    bool negative = false;
+    if (p != end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    bool digits = false;
+    for (; p != end && *p >= '0' && *p <= '9'; p++, digits = true) {
+        if (mantissa < 100000000000000000ull) {
+            mantissa = mantissa * 10 + (*p - '0');
+        } else {
+            exponent++;
+        }
+    }
+    if (p != end && *p == '.') {
+        for (p++; p != end && *p >= '0' && *p <= '9'; p++, digits = true) {
+            if (mantissa < 100000000000000000ull) {
+                mantissa = mantissa * 10 + (*p - '0');
+                exponent--;
+            }
+        }
+    }
+    if (!digits) {
+        return false;
+    }
+    if (p != end && (*p == 'e' || *p == 'E')) {
+        p++;
+        bool negativeExponent = false;
+        if (p != end && (*p == '-' || *p == '+')) {
+            negativeExponent = *p == '-';
+            p++;
+        }
+        int value = 0;
+        for (; p != end && *p >= '0' && *p <= '9'; p++) {
+            value = std::min(value * 10 + (*p - '0'), 1000);
+        }
+        exponent += negativeExponent ? -value : value;
+    }
+    double result = static_cast<double>(mantissa);
+    if (exponent >= -22 && exponent <= 22) {
+        result = exponent < 0 ? result / powers[-exponent] : result * powers[exponent];
+    } else {
+        result *= std::pow(10.0, exponent);
+    }
+    out = static_cast<float>(negative ? -result : result);
+    return true;
+}
+
+bool ParseInt(const char *&p, const char *end, int64_t &out) {
+    bool negative = false;
+    if (p != end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    if (p == end || *p < '0' || *p > '9') {
+        return false;
+    }
+    int64_t value = 0;
+    for (; p != end && *p >= '0' && *p <= '9'; p++) {
+        value = std::min<int64_t>(value * 10 + (*p - '0'), INT32_MAX);
+    }
+    out = negative ? -value : value;
+    return true;
+}
+
+struct ObjCorner {
+    int32_t position;
+    // -1 when the face has no texture coordinate
+    int32_t texcoord;
+};
+
+struct ObjChunk {
+    const char *begin = nullptr;
+    const char *end = nullptr;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> colors;
+    std::vector<glm::vec2> texcoords;
+    std::vector<ObjCorner> corners;
+    // corners whose index is relative to this chunk (negative OBJ indices), fixed up once the chunk bases are known
+    std::vector<uint32_t> localPositions;
+    std::vector<uint32_t> localTexcoords;
+    uint32_t positionBase = 0;
+    uint32_t texcoordBase = 0;
+    uint32_t cornerBase = 0;
+    uint32_t line = 0;
+    bool failed = false;
+};
+
+// one face corner "v", "v/vt", "v//vn" or "v/vt/vn"
+bool ParseObjCorner(const char *&p, const char *end, ObjChunk &chunk, ObjCorner &corner, bool &positionLocal, bool &texcoordLocal) {
+    int64_t index;
+    if (!ParseInt(p, end, index) || index == 0) {
+        return false;
+    }
+    positionLocal = index < 0;
+    corner.position = static_cast<int32_t>(index < 0 ? static_cast<int64_t>(chunk.positions.size()) + index : index - 1);
+    corner.texcoord = -1;
+    texcoordLocal = false;
+    if (p != end && *p == '/') {
+        p++;
+        if (p != end && *p != '/') {
+            if (!ParseInt(p, end, index) || index == 0) {
+                return false;
+            }
+            texcoordLocal = index < 0;
+            corner.texcoord = static_cast<int32_t>(index < 0 ? static_cast<int64_t>(chunk.texcoords.size()) + index : index - 1);
+        }
+        if (p != end && *p == '/') {
+            // normals are not part of Vertex
+            p++;
+            int64_t normal;
+            ParseInt(p, end, normal);
+        }
+    }
+    return true;
+}
+
+void ParseObjChunk(ObjChunk &chunk) {
+    std::vector<ObjCorner> polygon;
+    std::vector<uint8_t> polygonLocal;
+    const char *p = chunk.begin;
+    while (p < chunk.end) {
+        const char *lineEnd = static_cast<const char*>(memchr(p, '\n', chunk.end - p));
+        lineEnd = lineEnd ? lineEnd : chunk.end;
+        chunk.line++;
+        SkipSpace(p, lineEnd);
+        if (lineEnd - p >= 2 && p[0] == 'v' && IsSpace(p[1])) {
+            p += 2;
+            glm::vec3 position, color{1.0f};
+            if (!ParseFloat(p, lineEnd, position.x) || !ParseFloat(p, lineEnd, position.y) || !ParseFloat(p, lineEnd, position.z)) {
+                chunk.failed = true;
+                return;
+            }
+            // optional vertex colors after the position, a common extension in scan exports
+            if (ParseFloat(p, lineEnd, color.r) && !(ParseFloat(p, lineEnd, color.g) && ParseFloat(p, lineEnd, color.b))) {
+                color = glm::vec3{1.0f};
+            }
+            chunk.positions.push_back(position);
+            chunk.colors.push_back(color);
+        } else if (lineEnd - p >= 3 && p[0] == 'v' && p[1] == 't' && IsSpace(p[2])) {
+            p += 3;
+            glm::vec2 texcoord;
+            if (!ParseFloat(p, lineEnd, texcoord.x)) {
+                chunk.failed = true;
+                return;
+            }
+            if (!ParseFloat(p, lineEnd, texcoord.y)) {
+                texcoord.y = 0.0f;
+            }
+            chunk.texcoords.push_back(texcoord);
+        } else if (lineEnd - p >= 2 && p[0] == 'f' && IsSpace(p[1])) {
+            p += 2;
+            polygon.clear();
+            polygonLocal.clear();
+            while (true) {
+                SkipSpace(p, lineEnd);
+                if (p == lineEnd) {
+                    break;
+                }
+                ObjCorner corner;
+                bool positionLocal, texcoordLocal;
+                if (!ParseObjCorner(p, lineEnd, chunk, corner, positionLocal, texcoordLocal)) {
+                    chunk.failed = true;
+                    return;
+                }
+                polygon.push_back(corner);
+                polygonLocal.push_back(static_cast<uint8_t>(positionLocal | texcoordLocal << 1));
+            }
+            if (polygon.size() < 3) {
+                chunk.failed = true;
+                return;
+            }
+            // fan triangulation, fine for the convex polygons exporters write
+            for (size_t i = 1; i + 1 < polygon.size(); i++) {
+                for (size_t corner : {size_t(0), i, i + 1}) {
+                    uint32_t cornerIndex = static_cast<uint32_t>(chunk.corners.size());
+                    if (polygonLocal[corner] & 1) {
+                        chunk.localPositions.push_back(cornerIndex);
+                    }
+                    if (polygonLocal[corner] & 2) {
+                        chunk.localTexcoords.push_back(cornerIndex);
+                    }
+                    chunk.corners.push_back(polygon[corner]);
+                }
+            }
+        }
+        // vn, o, g, s, usemtl, mtllib and comments carry nothing we keep
+        p = lineEnd + 1;
+    }
+}
+
+// Open addressing map from a corner key to the first corner that used it.
+class CornerTable {
+public:
+    explicit CornerTable(size_t count) {
+        size_t capacity = 16;
+        while (capacity < count * 2) {
+            capacity <<= 1;
+        }
+        keys.assign(capacity, emptyKey);
+        values.resize(capacity);
+        mask = capacity - 1;
+    }
+
+    uint32_t FindOrInsert(uint64_t key, uint64_t hash, uint32_t value) {
+        for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+            if (keys[slot] == key) {
+                return values[slot];
+            }
+            if (keys[slot] == emptyKey) {
+                keys[slot] = key;
+                values[slot] = value;
+                return value;
+            }
+        }
+    }
+
+private:
+    static constexpr uint64_t emptyKey = UINT64_MAX;
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> values;
+    size_t mask = 0;
+};
+
+uint64_t CornerKey(const ObjCorner &corner) {
+    return static_cast<uint64_t>(corner.position) << 32 | static_cast<uint32_t>(corner.texcoord);
+}
+
+// ---- glTF ----
+
+constexpr uint32_t glbMagic = 0x46546C67;
+constexpr uint32_t glbChunkJson = 0x4E4F534A;
+constexpr uint32_t glbChunkBin = 0x004E4942;
+
+enum GltfComponent : uint32_t {
+    GltfByte = 5120,
+    GltfUnsignedByte = 5121,
+    GltfShort = 5122,
+    GltfUnsignedShort = 5123,
+    GltfUnsignedInt = 5125,
+    GltfFloat = 5126,
+};
+
+struct GltfAccessor {
+    const char *data = nullptr;
+    uint32_t count = 0;
+    uint32_t stride = 0;
+    uint32_t componentType = 0;
+    uint32_t components = 0;
+    bool normalized = false;
+};
+
+// a view into the mapped .glb or .bin file, or into a decoded data uri
+struct GltfBuffer {
+    const char *data = nullptr;
+    size_t size = 0;
+};
+
+struct GltfPrimitive {
+    GltfAccessor positions;
+    GltfAccessor texcoords;
+    GltfAccessor colors;
+    GltfAccessor indices;
+    glm::mat4 transform{1.0f};
+    uint32_t vertexOffset = 0;
+    uint32_t indexOffset = 0;
+    uint32_t indexCount = 0;
+};
+
+uint32_t ComponentSize(uint32_t componentType) {
+    switch (componentType) {
+        case GltfByte: case GltfUnsignedByte: return 1;
+        case GltfShort: case GltfUnsignedShort: return 2;
+        case GltfUnsignedInt: case GltfFloat: return 4;
+        default: return 0;
+    }
+}
+
+uint32_t ComponentCount(const std::string &type) {
+    if (type == "SCALAR") return 1;
+    if (type == "VEC2") return 2;
+    if (type == "VEC3") return 3;
+    if (type == "VEC4") return 4;
+    return 0;
+}
+
+float ReadComponent(const char *p, uint32_t componentType, bool normalized) {
+    switch (componentType) {
+        case GltfFloat: { float v; memcpy(&v, p, 4); return v; }
+        case GltfUnsignedByte: { uint8_t v; memcpy(&v, p, 1); return normalized ? v / 255.0f : v; }
+        case GltfByte: { int8_t v; memcpy(&v, p, 1); return normalized ? std::max(v / 127.0f, -1.0f) : v; }
+        case GltfUnsignedShort: { uint16_t v; memcpy(&v, p, 2); return normalized ? v / 65535.0f : v; }
+        case GltfShort: { int16_t v; memcpy(&v, p, 2); return normalized ? std::max(v / 32767.0f, -1.0f) : v; }
+        case GltfUnsignedInt: { uint32_t v; memcpy(&v, p, 4); return static_cast<float>(v); }
+        default: return 0.0f;
+    }
+}
+
+glm::vec4 Fetch(const GltfAccessor &accessor, uint32_t index, glm::vec4 fallback) {
+    const char *element = accessor.data + size_t(index) * accessor.stride;
+    uint32_t componentSize = ComponentSize(accessor.componentType);
+    for (uint32_t i = 0; i < accessor.components; i++) {
+        fallback[i] = ReadComponent(element + i * componentSize, accessor.componentType, accessor.normalized);
+    }
+    return fallback;
+}
+
+uint32_t FetchIndex(const GltfAccessor &accessor, uint32_t index) {
+    const char *element = accessor.data + size_t(index) * accessor.stride;
+    switch (accessor.componentType) {
+        case GltfUnsignedByte: { uint8_t v; memcpy(&v, element, 1); return v; }
+        case GltfUnsignedShort: { uint16_t v; memcpy(&v, element, 2); return v; }
+        default: { uint32_t v; memcpy(&v, element, 4); return v; }
+    }
+}
+
+bool DecodeBase64(const char *begin, const char *end, std::vector<char> &out) {
+    auto value = [](char c) -> int {
+        if (c >= 'A' && c <= 'Z') return c - 'A';
+        if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+        if (c >= '0' && c <= '9') return c - '0' + 52;
+        if (c == '+' || c == '-') return 62;
+        if (c == '/' || c == '_') return 63;
+        return -1;
+    };
+    out.clear();
+    out.reserve((end - begin) / 4 * 3);
+    uint32_t bits = 0;
+    int bitCount = 0;
+    for (const char *p = begin; p != end && *p != '='; p++) {
+        int v = value(*p);
+        if (v < 0) {
+            return false;
+        }
+        bits = bits << 6 | v;
+        bitCount += 6;
+        if (bitCount >= 8) {
+            bitCount -= 8;
+            out.push_back(static_cast<char>(bits >> bitCount));
+        }
+    }
+    return true;
+}
+
+std::string DecodeUri(const std::string &uri) {
+    auto value = [](char c) -> int {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    };
+    std::string decoded;
+    for (size_t i = 0; i < uri.size(); i++) {
+        // a malformed escape is kept as written, the file open reports the path if it doesn't exist
+        int high = uri[i] == '%' && i + 2 < uri.size() ? value(uri[i + 1]) : -1;
+        int low = high >= 0 ? value(uri[i + 2]) : -1;
+        if (low >= 0) {
+            decoded += static_cast<char>(high << 4 | low);
+            i += 2;
+        } else {
+            decoded += uri[i];
+        }
+    }
+    return decoded;
+}
+
+// glTF references other objects by array index, anything that is not a valid index maps past the end
+size_t JsonIndex(const JsonValue &value) {
+    double number = value.AsNumber(-1);
+    return number >= 0 && number < 4294967296.0 ? static_cast<size_t>(number) : SIZE_MAX;
+}
+
+glm::mat4 NodeTransform(const JsonValue &node) {
+    const JsonValue &matrix = node["matrix"];
+    if (matrix.Size() == 16) {
+        glm::mat4 result;
+        for (int i = 0; i < 16; i++) {
+            // column major, same as glm
+            result[i / 4][i % 4] = static_cast<float>(matrix[i].AsNumber());
+        }
+        return result;
+    }
+    glm::mat4 result{1.0f};
+    const JsonValue &translation = node["translation"];
+    if (translation.Size() == 3) {
+        result = glm::translate(result, glm::vec3(translation[0].AsNumber(), translation[1].AsNumber(), translation[2].AsNumber()));
+    }
+    const JsonValue &rotation = node["rotation"];
+    if (rotation.Size() == 4) {
+        // glTF stores x, y, z, w; glm::quat takes w first
+        glm::quat q(static_cast<float>(rotation[3].AsNumber()), static_cast<float>(rotation[0].AsNumber()),
+                    static_cast<float>(rotation[1].AsNumber()), static_cast<float>(rotation[2].AsNumber()));
+        result = result * glm::mat4_cast(q);
+    }
+    const JsonValue &scale = node["scale"];
+    if (scale.Size() == 3) {
+        result = glm::scale(result, glm::vec3(scale[0].AsNumber(), scale[1].AsNumber(), scale[2].AsNumber()));
+    }
+    return result;
+}
+
+class GltfImporter {
+public:
+    GltfImporter(JobSystem &jobSystem, const std::string &path) : jobSystem(jobSystem), path(path) {}
+
+    bool Import(MeshData &mesh) {
+        MappedFile &file = mappedFiles.emplace_back();
+        if (!file.Open(path)) {
+            return Fail("failed to read file");
+        }
+        const char *jsonBegin = file.Data();
+        const char *jsonEnd = file.Data() + file.Size();
+        GltfBuffer binChunk;
+        bool glb = file.Size() >= 12 && ReadU32(file.Data()) == glbMagic;
+        if (glb && !SplitGlb(file, jsonBegin, jsonEnd, binChunk)) {
+            return false;
+        }
+        std::string error;
+        if (!JsonValue::Parse(jsonBegin, jsonEnd, gltf, error)) {
+            return Fail(("invalid json, " + error).c_str());
+        }
+        if (gltf["asset"]["version"].AsString().rfind("2.", 0) != 0) {
+            return Fail("only glTF 2.0 is supported");
+        }
+        if (!LoadBuffers(glb ? &binChunk : nullptr)) {
+            return false;
+        }
+        if (!CollectPrimitives()) {
+            return false;
+        }
+        Convert(mesh);
+        return true;
+    }
+
+private:
+    static uint32_t ReadU32(const char *p) {
+        uint32_t v;
+        memcpy(&v, p, 4);
+        return v;
+    }
+
+    bool Fail(const char *what) {
+        std::cout << path << ": " << what << std::endl;
+        return false;
+    }
+
+    bool SplitGlb(const MappedFile &file, const char *&jsonBegin, const char *&jsonEnd, GltfBuffer &binChunk) {
+        if (ReadU32(file.Data() + 4) != 2) {
+            return Fail("unsupported glb version");
+        }
+        size_t length = std::min<size_t>(ReadU32(file.Data() + 8), file.Size());
+        jsonBegin = jsonEnd = nullptr;
+        for (size_t offset = 12; offset + 8 <= length;) {
+            size_t chunkLength = ReadU32(file.Data() + offset);
+            uint32_t chunkType = ReadU32(file.Data() + offset + 4);
+            const char *data = file.Data() + offset + 8;
+            if (offset + 8 + chunkLength > length) {
+                return Fail("truncated glb chunk");
+            }
+            if (chunkType == glbChunkJson && jsonBegin == nullptr) {
+                jsonBegin = data;
+                jsonEnd = data + chunkLength;
+            } else if (chunkType == glbChunkBin && binChunk.data == nullptr) {
+                binChunk = {data, chunkLength};
+            }
+            // chunks are padded to 4 bytes
+            offset += 8 + ((chunkLength + 3) & ~size_t(3));
+        }
+        return jsonBegin != nullptr || Fail("glb has no json chunk");
+    }
+
+    bool LoadBuffers(const GltfBuffer *binChunk) {
+        const JsonValue &bufferList = gltf["buffers"];
+        buffers.resize(bufferList.Size());
+        for (size_t i = 0; i < bufferList.Size(); i++) {
+            const JsonValue &buffer = bufferList[i];
+            const std::string &uri = buffer["uri"].AsString();
+            if (uri.empty()) {
+                if (i != 0 || binChunk == nullptr) {
+                    return Fail("buffer without uri");
+                }
+                buffers[i] = *binChunk;
+            } else if (uri.rfind("data:", 0) == 0) {
+                size_t comma = uri.find(',');
+                std::vector<char> &decoded = decodedBuffers.emplace_back();
+                if (comma == std::string::npos || uri.rfind(";base64", comma) == std::string::npos ||
+                    !DecodeBase64(uri.data() + comma + 1, uri.data() + uri.size(), decoded)) {
+                    return Fail("unsupported data uri");
+                }
+                buffers[i] = {decoded.data(), decoded.size()};
+            } else {
+                MappedFile &file = mappedFiles.emplace_back();
+                if (!file.Open(Directory(path) + DecodeUri(uri))) {
+                    return Fail(("failed to read buffer " + uri).c_str());
+                }
+                buffers[i] = {file.Data(), file.Size()};
+            }
+            if (buffers[i].size < static_cast<size_t>(std::max(0.0, buffer["byteLength"].AsNumber()))) {
+                return Fail("buffer is shorter than its byteLength");
+            }
+        }
+        return true;
+    }
+
+    bool ReadAccessor(const JsonValue &index, GltfAccessor &accessor) {
+        const JsonValue &json = gltf["accessors"][JsonIndex(index)];
+        if (!json.IsObject()) {
+            return Fail("invalid accessor index");
+        }
+        if (json.Has("sparse")) {
+            return Fail("sparse accessors are not supported");
+        }
+        const JsonValue &view = gltf["bufferViews"][JsonIndex(json["bufferView"])];
+        if (!view.IsObject()) {
+            return Fail("accessor without buffer view");
+        }
+        size_t bufferIndex = JsonIndex(view["buffer"]);
+        if (bufferIndex >= buffers.size()) {
+            return Fail("invalid buffer index");
+        }
+        accessor.componentType = static_cast<uint32_t>(json["componentType"].AsNumber());
+        accessor.components = ComponentCount(json["type"].AsString());
+        accessor.count = static_cast<uint32_t>(json["count"].AsNumber());
+        accessor.normalized = json["normalized"].AsBool();
+        uint32_t elementSize = ComponentSize(accessor.componentType) * accessor.components;
+        if (elementSize == 0) {
+            return Fail("unsupported accessor format");
+        }
+        accessor.stride = static_cast<uint32_t>(view["byteStride"].AsNumber(elementSize));
+        size_t offset = static_cast<size_t>(std::max(0.0, view["byteOffset"].AsNumber())) + static_cast<size_t>(std::max(0.0, json["byteOffset"].AsNumber()));
+        size_t viewEnd = static_cast<size_t>(std::max(0.0, view["byteOffset"].AsNumber())) + static_cast<size_t>(std::max(0.0, view["byteLength"].AsNumber()));
+        if (accessor.count > 0 && (viewEnd > buffers[bufferIndex].size ||
+                                   offset + size_t(accessor.count - 1) * accessor.stride + elementSize > viewEnd)) {
+            return Fail("accessor reads past its buffer view");
+        }
+        accessor.data = buffers[bufferIndex].data + offset;
+        return true;
+    }
+
+    bool AddMesh(size_t meshIndex, const glm::mat4 &transform) {
+        const JsonValue &primitiveList = gltf["meshes"][meshIndex]["primitives"];
+        for (size_t i = 0; i < primitiveList.Size(); i++) {
+            const JsonValue &primitive = primitiveList[i];
+            if (primitive["mode"].AsNumber(4) != 4) {
+                std::cout << path << ": skipping primitive that is not a triangle list" << std::endl;
+                continue;
+            }
+            const JsonValue &attributes = primitive["attributes"];
+            GltfPrimitive result;
+            result.transform = transform;
+            if (!ReadAccessor(attributes["POSITION"], result.positions)) {
+                return false;
+            }
+            if (result.positions.componentType != GltfFloat || result.positions.components != 3) {
+                return Fail("POSITION has to be float3");
+            }
+            if (attributes.Has("TEXCOORD_0") && !ReadAccessor(attributes["TEXCOORD_0"], result.texcoords)) {
+                return false;
+            }
+            if (attributes.Has("COLOR_0") && !ReadAccessor(attributes["COLOR_0"], result.colors)) {
+                return false;
+            }
+            if (primitive.Has("indices")) {
+                if (!ReadAccessor(primitive["indices"], result.indices)) {
+                    return false;
+                }
+                if (result.indices.components != 1 || result.indices.componentType == GltfFloat) {
+                    return Fail("invalid index accessor");
+                }
+            }
+            result.indexCount = primitive.Has("indices") ? result.indices.count : result.positions.count;
+            result.indexCount -= result.indexCount % 3;
+            primitives.push_back(result);
+        }
+        return true;
+    }
+
+    bool AddNode(size_t nodeIndex, const glm::mat4 &parent, uint32_t depth) {
+        const JsonValue &node = gltf["nodes"][nodeIndex];
+        if (!node.IsObject() || depth > 64) {
+            return Fail("invalid node hierarchy");
+        }
+        glm::mat4 transform = parent * NodeTransform(node);
+        if (node.Has("mesh") && !AddMesh(JsonIndex(node["mesh"]), transform)) {
+            return false;
+        }
+        const JsonValue &children = node["children"];
+        for (size_t i = 0; i < children.Size(); i++) {
+            if (!AddNode(JsonIndex(children[i]), transform, depth + 1)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool CollectPrimitives() {
+        const JsonValue &scenes = gltf["scenes"];
+        if (scenes.Size() == 0) {
+            // a library of meshes without a scene, take every mesh as is
+            for (size_t i = 0; i < gltf["meshes"].Size(); i++) {
+                if (!AddMesh(i, glm::mat4(1.0f))) {
+                    return false;
+                }
+            }
+        } else {
+            const JsonValue &nodes = scenes[gltf.Has("scene") ? JsonIndex(gltf["scene"]) : 0]["nodes"];
+            for (size_t i = 0; i < nodes.Size(); i++) {
+                if (!AddNode(JsonIndex(nodes[i]), glm::mat4(1.0f), 0)) {
+                    return false;
+                }
+            }
+        }
+        uint64_t vertexCount = 0, indexCount = 0;
+        for (auto &primitive : primitives) {
+            primitive.vertexOffset = static_cast<uint32_t>(vertexCount);
+            primitive.indexOffset = static_cast<uint32_t>(indexCount);
+            vertexCount += primitive.positions.count;
+            indexCount += primitive.indexCount;
+        }
+        if (vertexCount > UINT32_MAX || indexCount > UINT32_MAX) {
+            return Fail("mesh does not fit 32 bit indices");
+        }
+        totalVertices = static_cast<uint32_t>(vertexCount);
+        totalIndices = static_cast<uint32_t>(indexCount);
+        return true;
+    }
+
+    void Convert(MeshData &mesh) {
+        ROVSKI_CPU_SCOPE("convert gltf attributes");
+        mesh.vertices.resize(totalVertices, Vertex(std::make_tuple(glm::vec3{0.0f}, glm::vec3{1.0f}, glm::vec2{0.0f})));
+        mesh.indices.resize(totalIndices);
+        for (auto &primitive : primitives) {
+            Vertex *vertices = mesh.vertices.data() + primitive.vertexOffset;
+            jobSystem.ParallelFor(primitive.positions.count, elementGrain, [&primitive, vertices](uint32_t begin, uint32_t end, uint32_t) {
+                for (uint32_t i = begin; i < end; i++) {
+                    glm::vec3 position(primitive.transform * glm::vec4(glm::vec3(Fetch(primitive.positions, i, glm::vec4(0.0f))), 1.0f));
+                    glm::vec3 color = primitive.colors.data && i < primitive.colors.count ? glm::vec3(Fetch(primitive.colors, i, glm::vec4(1.0f))) : glm::vec3(1.0f);
+                    glm::vec2 texcoord = primitive.texcoords.data && i < primitive.texcoords.count ? glm::vec2(Fetch(primitive.texcoords, i, glm::vec4(0.0f))) : glm::vec2(0.0f);
+                    vertices[i] = Vertex(std::make_tuple(position, color, texcoord));
+                }
+            });
+            uint32_t *indices = mesh.indices.data() + primitive.indexOffset;
+            // a mirroring transform turns the triangles inside out, swap two corners to keep the winding
+            bool flip = glm::determinant(glm::mat3(primitive.transform)) < 0.0f;
+            uint32_t vertexCount = primitive.positions.count;
+            uint32_t base = primitive.vertexOffset;
+            std::atomic<bool> outOfRange{false};
+            jobSystem.ParallelFor(primitive.indexCount / 3, elementGrain, [&, indices](uint32_t begin, uint32_t end, uint32_t) {
+                for (uint32_t triangle = begin; triangle < end; triangle++) {
+                    for (uint32_t corner = 0; corner < 3; corner++) {
+                        uint32_t source = triangle * 3 + (flip && corner != 0 ? 3 - corner : corner);
+                        uint32_t index = primitive.indices.data ? FetchIndex(primitive.indices, source) : source;
+                        if (index >= vertexCount) {
+                            outOfRange.store(true, std::memory_order_relaxed);
+                            index = 0;
+                        }
+                        indices[triangle * 3 + corner] = base + index;
+                    }
+                }
+            });
+            if (outOfRange.load()) {
+                std::cout << path << ": index out of range, clamped to the first vertex" << std::endl;
+            }
+        }
+    }
+
+    JobSystem &jobSystem;
+    const std::string &path;
+    JsonValue gltf;
+    // deques, buffers point into their elements
+    std::deque<MappedFile> mappedFiles;
+    std::deque<std::vector<char>> decodedBuffers;
+    std::vector<GltfBuffer> buffers;
+    std::vector<GltfPrimitive> primitives;
+    uint32_t totalVertices = 0;
+    uint32_t totalIndices = 0;
+};
+
+}
+
+bool MeshLoader::Load(const std::string &path, MeshData &mesh) {
+    ROVSKI_CPU_FUNCTION();
+    mesh = MeshData{};
+    size_t slash = path.find_last_of("/\\");
+    mesh.name = slash == std::string::npos ? path : path.substr(slash + 1);
+    std::string extension = Extension(path);
+    bool loaded = false;
+    if (extension == "obj") {
+        loaded = LoadObj(path, mesh);
+    } else if (extension == "gltf" || extension == "glb") {
+        loaded = LoadGltf(path, mesh);
+    } else {
+        std::cout << path << ": unknown mesh format" << std::endl;
+    }
+    if (loaded) {
+        ComputeBounds(mesh);
+    }
+    return loaded;
+}
+
+bool MeshLoader::LoadAll(const std::vector<std::string> &paths, std::vector<MeshData> &meshes) {
+    ROVSKI_CPU_FUNCTION();
+    meshes.clear();
+    meshes.resize(paths.size());
+    std::vector<uint8_t> loaded(paths.size(), 0);
+    JobSystem::Counter counter;
+    for (size_t i = 0; i < paths.size(); i++) {
+        jobSystem.Submit([this, &paths, &meshes, &loaded, i](uint32_t) {
+            loaded[i] = Load(paths[i], meshes[i]) ? 1 : 0;
+        }, counter);
+    }
+    jobSystem.Wait(counter);
+    return std::all_of(loaded.begin(), loaded.end(), [](uint8_t value) { return value != 0; });
+}
+
+bool MeshLoader::LoadObj(const std::string &path, MeshData &mesh) {
+    MappedFile text;
+    if (!text.Open(path)) {
+        std::cout << path << ": failed to read file" << std::endl;
+        return false;
+    }
+
+    // cut at line starts so every chunk parses on its own
+    std::vector<ObjChunk> chunks;
+    const char *cursor = text.Data();
+    const char *textEnd = text.Data() + text.Size();
+    while (cursor < textEnd) {
+        const char *chunkEnd = cursor + std::min<size_t>(objChunkSize, textEnd - cursor);
+        if (chunkEnd < textEnd) {
+            const char *newline = static_cast<const char*>(memchr(chunkEnd, '\n', textEnd - chunkEnd));
+            chunkEnd = newline ? newline + 1 : textEnd;
+        }
+        chunks.emplace_back();
+        chunks.back().begin = cursor;
+        chunks.back().end = chunkEnd;
+        cursor = chunkEnd;
+    }
+    {
+        ROVSKI_CPU_SCOPE("parse obj chunks");
+        jobSystem.ParallelFor(static_cast<uint32_t>(chunks.size()), 1, [&chunks](uint32_t begin, uint32_t end, uint32_t) {
+            for (uint32_t i = begin; i < end; i++) {
+                ParseObjChunk(chunks[i]);
+            }
+        });
+    }
+
+    uint64_t positionCount = 0, texcoordCount = 0, cornerCount = 0, line = 0;
+    for (auto &chunk : chunks) {
+        if (chunk.failed) {
+            std::cout << path << ": parse error at line " << line + chunk.line << std::endl;
+            return false;
+        }
+        chunk.positionBase = static_cast<uint32_t>(positionCount);
+        chunk.texcoordBase = static_cast<uint32_t>(texcoordCount);
+        chunk.cornerBase = static_cast<uint32_t>(cornerCount);
+        positionCount += chunk.positions.size();
+        texcoordCount += chunk.texcoords.size();
+        cornerCount += chunk.corners.size();
+        line += chunk.line;
+    }
+    if (positionCount > INT32_MAX || texcoordCount > INT32_MAX || cornerCount > UINT32_MAX) {
+        std::cout << path << ": mesh does not fit 32 bit indices" << std::endl;
+        return false;
+    }
+
+    // merge the chunks and turn chunk relative indices into file wide ones
+    std::vector<glm::vec3> positions(positionCount), colors(positionCount);
+    std::vector<glm::vec2> texcoords(texcoordCount);
+    std::vector<ObjCorner> corners(cornerCount);
+    std::atomic<bool> outOfRange{false};
+    jobSystem.ParallelFor(static_cast<uint32_t>(chunks.size()), 1, [&](uint32_t begin, uint32_t end, uint32_t) {
+        for (uint32_t i = begin; i < end; i++) {
+            ObjChunk &chunk = chunks[i];
+            std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.positionBase);
+            std::copy(chunk.colors.begin(), chunk.colors.end(), colors.begin() + chunk.positionBase);
+            std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), texcoords.begin() + chunk.texcoordBase);
+            for (uint32_t corner : chunk.localPositions) {
+                chunk.corners[corner].position += static_cast<int32_t>(chunk.positionBase);
+            }
+            for (uint32_t corner : chunk.localTexcoords) {
+                chunk.corners[corner].texcoord += static_cast<int32_t>(chunk.texcoordBase);
+            }
+            for (const ObjCorner &corner : chunk.corners) {
+                if (corner.position < 0 || corner.position >= static_cast<int64_t>(positionCount) ||
+                    corner.texcoord < -1 || corner.texcoord >= static_cast<int64_t>(texcoordCount)) {
+                    outOfRange.store(true, std::memory_order_relaxed);
+                }
+            }
+            std::copy(chunk.corners.begin(), chunk.corners.end(), corners.begin() + chunk.cornerBase);
+            chunk = ObjChunk{};
+        }
+    });
+    if (outOfRange.load()) {
+        std::cout << path << ": face index out of range" << std::endl;
+        return false;
+    }
+
+    // Deduplicate position/texcoord pairs. Corners are bucketed by hash into
+    // shards (a counting sort that keeps corner order inside a shard), every
+    // shard finds the first corner of each key on its own, and one linear pass
+    // numbers the unique vertices in order of first use.
+    const uint32_t count = static_cast<uint32_t>(cornerCount);
+    uint32_t shardBits = 0;
+    while ((1u << shardBits) < jobSystem.ThreadCount() * 4 && (count >> shardBits) > elementGrain) {
+        shardBits++;
+    }
+    const uint32_t shardCount = 1u << shardBits;
+    const uint32_t blockCount = (count + elementGrain - 1) / elementGrain;
+    std::vector<uint64_t> hashes(count);
+    std::vector<uint32_t> shardOffsets(size_t(blockCount) * shardCount, 0);
+    std::vector<uint32_t> firstCorner(count);
+    {
+        ROVSKI_CPU_SCOPE("deduplicate vertices");
+        auto shardOf = [shardBits](uint64_t hash) {
+            return shardBits == 0 ? 0u : static_cast<uint32_t>(hash >> (64 - shardBits));
+        };
+        jobSystem.ParallelFor(blockCount, 1, [&](uint32_t begin, uint32_t end, uint32_t) {
+            for (uint32_t block = begin; block < end; block++) {
+                uint32_t *counts = &shardOffsets[size_t(block) * shardCount];
+                for (uint32_t i = block * elementGrain; i < std::min(count, (block + 1) * elementGrain); i++) {
+                    hashes[i] = Mix64(CornerKey(corners[i]));
+                    counts[shardOf(hashes[i])]++;
+                }
+            }
+        });
+        // exclusive prefix over shard major, block minor order
+        std::vector<uint32_t> shardBegin(shardCount + 1, 0);
+        uint32_t running = 0;
+        for (uint32_t shard = 0; shard < shardCount; shard++) {
+            shardBegin[shard] = running;
+            for (uint32_t block = 0; block < blockCount; block++) {
+                uint32_t blockCountInShard = shardOffsets[size_t(block) * shardCount + shard];
+                shardOffsets[size_t(block) * shardCount + shard] = running;
+                running += blockCountInShard;
+            }
+        }
+        shardBegin[shardCount] = running;
+        std::vector<uint32_t> bucketed(count);
+        jobSystem.ParallelFor(blockCount, 1, [&](uint32_t begin, uint32_t end, uint32_t) {
+            for (uint32_t block = begin; block < end; block++) {
+                uint32_t *offsets = &shardOffsets[size_t(block) * shardCount];
+                for (uint32_t i = block * elementGrain; i < std::min(count, (block + 1) * elementGrain); i++) {
+                    bucketed[offsets[shardOf(hashes[i])]++] = i;
+                }
+            }
+        });
+        jobSystem.ParallelFor(shardCount, 1, [&](uint32_t begin, uint32_t end, uint32_t) {
+            for (uint32_t shard = begin; shard < end; shard++) {
+                CornerTable table(shardBegin[shard + 1] - shardBegin[shard]);
+                for (uint32_t slot = shardBegin[shard]; slot < shardBegin[shard + 1]; slot++) {
+                    uint32_t corner = bucketed[slot];
+                    // shard bits come from the top of the hash, the table probes with the bottom
+                    firstCorner[corner] = table.FindOrInsert(CornerKey(corners[corner]), hashes[corner], corner);
+                }
+            }
+        });
+    }
+    std::vector<uint32_t> uniqueCorners;
+    mesh.indices.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+        if (firstCorner[i] == i) {
+            mesh.indices[i] = static_cast<uint32_t>(uniqueCorners.size());
+            uniqueCorners.push_back(i);
+        } else {
+            mesh.indices[i] = mesh.indices[firstCorner[i]];
+        }
+    }
+
+    mesh.vertices.resize(uniqueCorners.size(), Vertex(std::make_tuple(glm::vec3{0.0f}, glm::vec3{1.0f}, glm::vec2{0.0f})));
+    jobSystem.ParallelFor(static_cast<uint32_t>(uniqueCorners.size()), elementGrain, [&](uint32_t begin, uint32_t end, uint32_t) {
+        for (uint32_t i = begin; i < end; i++) {
+            const ObjCorner &corner = corners[uniqueCorners[i]];
+            glm::vec2 texcoord{0.0f};
+            if (corner.texcoord >= 0) {
+                // OBJ puts v = 0 at the bottom of the image, Vulkan samples from the top
+                texcoord = glm::vec2(texcoords[corner.texcoord].x, 1.0f - texcoords[corner.texcoord].y);
+            }
+            mesh.vertices[i] = Vertex(std::make_tuple(positions[corner.position], colors[corner.position], texcoord));
+        }
+    });
+    return true;
+}
+
+bool MeshLoader::LoadGltf(const std::string &path, MeshData &mesh) {
+    GltfImporter importer(jobSystem, path);
+    return importer.Import(mesh);
+}
+
+void MeshLoader::ComputeBounds(MeshData &mesh) {
+    if (mesh.vertices.empty()) {
+        return;
+    }
+    std::vector<std::pair<glm::vec3, glm::vec3>> threadBounds(jobSystem.ThreadCount(),
+                                                              {glm::vec3(INFINITY), glm::vec3(-INFINITY)});
+    jobSystem.ParallelFor(static_cast<uint32_t>(mesh.vertices.size()), elementGrain, [&](uint32_t begin, uint32_t end, uint32_t threadIndex) {
+        auto &bounds = threadBounds[threadIndex];
+        for (uint32_t i = begin; i < end; i++) {
+            const glm::vec3 &position = std::get<0>(mesh.vertices[i]);
+            bounds.first = glm::min(bounds.first, position);
+            bounds.second = glm::max(bounds.second, position);
+        }
+    });
+    mesh.bounds.min = glm::vec3(INFINITY);
+    mesh.bounds.max = glm::vec3(-INFINITY);
+    for (auto &bounds : threadBounds) {
+        mesh.bounds.min = glm::min(mesh.bounds.min, bounds.first);
+        mesh.bounds.max = glm::max(mesh.bounds.max, bounds.second);
+    }
+}
@@ -0,0 +1,166 @@
+//
+//  MipChain.cpp
+//  Rovski
+//
+
+#include "MipChain.hpp"
+#include <algorithm>
+#include <cmath>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define ROVSKI_MIP_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define ROVSKI_MIP_NEON 1
+#endif
+
+namespace {
+
+constexpr uint32_t linearSteps = 16384;
+
+struct SrgbTables {
+    float toLinear[256];
+    uint8_t fromLinear[linearSteps];
+
+    SrgbTables() {
+        for (uint32_t i = 0; i < 256; i++) {
+            float c = i / 255.0f;
+            toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        for (uint32_t i = 0; i < linearSteps; i++) {
+            float l = i / float(linearSteps - 1);
+            float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+            fromLinear[i] = static_cast<uint8_t>(std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f));
+        }
+    }
+};
+
+const SrgbTables &Tables() {
+    static const SrgbTables tables;
+    return tables;
+}
+
+void AverageSrgb(const uint8_t *a, const uint8_t *b, const uint8_t *c, const uint8_t *d, uint8_t *out) {
+    const SrgbTables &tables = Tables();
+    for (int channel = 0; channel < 3; channel++) {
+        float l = 0.25f * (tables.toLinear[a[channel]] + tables.toLinear[b[channel]] +
+                           tables.toLinear[c[channel]] + tables.toLinear[d[channel]]);
+        out[channel] = tables.fromLinear[static_cast<uint32_t>(l * (linearSteps - 1) + 0.5f)];
+    }
+    // alpha is stored linearly even in sRGB formats
+    out[3] = static_cast<uint8_t>((a[3] + b[3] + c[3] + d[3] + 2) >> 2);
+}
+
+void AverageUnorm(const uint8_t *a, const uint8_t *b, const uint8_t *c, const uint8_t *d, uint8_t *out) {
+    for (int channel = 0; channel < 4; channel++) {
+        out[channel] = static_cast<uint8_t>((a[channel] + b[channel] + c[channel] + d[channel] + 2) >> 2);
+    }
+}
+
+// four destination texels per step from two source rows, rounded like the scalar path; returns how many were written
+uint32_t DownsampleRowUnorm(const uint8_t *row0, const uint8_t *row1, uint8_t *dst, uint32_t dstWidth) {
+    uint32_t x = 0;
+#if ROVSKI_MIP_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16(2);
+    for (; x + 4 <= dstWidth; x += 4) {
+        __m128 a0 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8)));
+        __m128 a1 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8 + 16)));
+        __m128 b0 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8)));
+        __m128 b1 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8 + 16)));
+        // split even and odd pixels, each lane is one RGBA texel
+        __m128i evenA = _mm_castps_si128(_mm_shuffle_ps(a0, a1, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i oddA = _mm_castps_si128(_mm_shuffle_ps(a0, a1, _MM_SHUFFLE(3, 1, 3, 1)));
+        __m128i evenB = _mm_castps_si128(_mm_shuffle_ps(b0, b1, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i oddB = _mm_castps_si128(_mm_shuffle_ps(b0, b1, _MM_SHUFFLE(3, 1, 3, 1)));
+        __m128i low = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(evenA, zero), _mm_unpacklo_epi8(oddA, zero)),
+                                    _mm_add_epi16(_mm_unpacklo_epi8(evenB, zero), _mm_unpacklo_epi8(oddB, zero)));
+        __m128i high = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(evenA, zero), _mm_unpackhi_epi8(oddA, zero)),
+                                     _mm_add_epi16(_mm_unpackhi_epi8(evenB, zero), _mm_unpackhi_epi8(oddB, zero)));
+        low = _mm_srli_epi16(_mm_add_epi16(low, bias), 2);
+        high = _mm_srli_epi16(_mm_add_epi16(high, bias), 2);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), _mm_packus_epi16(low, high));
+    }
+#elif ROVSKI_MIP_NEON
+    for (; x + 4 <= dstWidth; x += 4) {
+        // vld2 on 32 bit lanes deinterleaves even and odd texels
+        uint32x4x2_t a = vld2q_u32(reinterpret_cast<const uint32_t*>(row0 + x * 8));
+        uint32x4x2_t b = vld2q_u32(reinterpret_cast<const uint32_t*>(row1 + x * 8));
+        uint8x16_t evenA = vreinterpretq_u8_u32(a.val[0]);
+        uint8x16_t oddA = vreinterpretq_u8_u32(a.val[1]);
+        uint8x16_t evenB = vreinterpretq_u8_u32(b.val[0]);
+        uint8x16_t oddB = vreinterpretq_u8_u32(b.val[1]);
+        uint16x8_t low = vaddl_u8(vget_low_u8(evenA), vget_low_u8(oddA));
+        low = vaddw_u8(vaddw_u8(low, vget_low_u8(evenB)), vget_low_u8(oddB));
+        uint16x8_t high = vaddl_u8(vget_high_u8(evenA), vget_high_u8(oddA));
+        high = vaddw_u8(vaddw_u8(high, vget_high_u8(evenB)), vget_high_u8(oddB));
+        vst1q_u8(dst + x * 4, vcombine_u8(vrshrn_n_u16(low, 2), vrshrn_n_u16(high, 2)));
+    }
+#endif
+    return x;
+}
+
+} // namespace
+
+uint32_t MipLevelCount(uint32_t width, uint32_t height) {
+    uint32_t size = std::max(width, height);
+    uint32_t levels = 1;
+    while (size > 1) {
+        size >>= 1;
+        levels++;
+    }
+    return levels;
+}
+
+void DownsampleRgba8(const uint8_t *src, uint32_t srcWidth, uint32_t srcHeight, uint8_t *dst, bool srgb) {
+    const uint32_t dstWidth = std::max(1u, srcWidth / 2);
+    const uint32_t dstHeight = std::max(1u, srcHeight / 2);
+    const size_t srcPitch = size_t(srcWidth) * 4;
+    for (uint32_t y = 0; y < dstHeight; y++) {
+        const uint8_t *row0 = src + size_t(2 * y) * srcPitch;
+        // a one texel tall source is filtered against itself
+        const uint8_t *row1 = srcHeight > 1 ? row0 + srcPitch : row0;
+        uint8_t *out = dst + size_t(y) * dstWidth * 4;
+        uint32_t x = 0;
+        if (!srgb && srcWidth > 1) {
+            x = DownsampleRowUnorm(row0, row1, out, dstWidth);
+        }
+        for (; x < dstWidth; x++) {
+            size_t left = size_t(2 * x) * 4;
+            size_t right = srcWidth > 1 ? left + 4 : left;
+            if (srgb) {
+                AverageSrgb(row0 + left, row0 + right, row1 + left, row1 + right, out + x * 4);
+            } else {
+                AverageUnorm(row0 + left, row0 + right, row1 + left, row1 + right, out + x * 4);
+            }
+        }
+    }
+}
+
+void MipChain::Build(const uint8_t *level0, uint32_t width, uint32_t height, bool srgb) {
+    data.clear();
+    levelOffsets.clear();
+    widths.clear();
+    heights.clear();
+    uint32_t levels = MipLevelCount(width, height);
+    size_t total = 0;
+    for (uint32_t level = 1, w = width, h = height; level < levels; level++) {
+        w = std::max(1u, w / 2);
+        h = std::max(1u, h / 2);
+        levelOffsets.push_back(total);
+        widths.push_back(w);
+        heights.push_back(h);
+        total += size_t(w) * h * 4;
+    }
+    data.resize(total);
+    const uint8_t *source = level0;
+    uint32_t sourceWidth = width;
+    uint32_t sourceHeight = height;
+    for (size_t i = 0; i < levelOffsets.size(); i++) {
+        uint8_t *target = data.data() + levelOffsets[i];
+        DownsampleRgba8(source, sourceWidth, sourceHeight, target, srgb);
+        source = target;
+        sourceWidth = widths[i];
+        sourceHeight = heights[i];
+    }
+}
@@ -0,0 +1,91 @@
+//
+//  PipelineCache.cpp
+//  Rovski
+//
+
+#include "PipelineCache.hpp"
+#include "CpuProfiler.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+bool PipelineCache::Init(VkPhysicalDevice physicalDevice, VkDevice device, const std::string &path) {
+    ROVSKI_CPU_FUNCTION();
+    this->device = device;
+    this->path = path;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    std::string blob;
+    loadedFromDisk = ReadValidBlob(blob);
+    VkPipelineCacheCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    createInfo.initialDataSize = loadedFromDisk ? blob.size() : 0;
+    createInfo.pInitialData = loadedFromDisk ? blob.data() : nullptr;
+    if (vkCreatePipelineCache(device, &createInfo, nullptr, &cache) == VK_SUCCESS) {
+        return true;
+    }
+    // a blob the driver still rejects is dropped, an empty cache always works
+    loadedFromDisk = false;
+    createInfo.initialDataSize = 0;
+    createInfo.pInitialData = nullptr;
+    return vkCreatePipelineCache(device, &createInfo, nullptr, &cache) == VK_SUCCESS;
+}
+
+bool PipelineCache::ReadValidBlob(std::string &blob) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return false;
+    }
+    size_t size = static_cast<size_t>(file.tellg());
+    if (size < sizeof(VkPipelineCacheHeaderVersionOne)) {
+        return false;
+    }
+    blob.resize(size);
+    file.seekg(0);
+    file.read(blob.data(), size);
+
+    VkPipelineCacheHeaderVersionOne header;
+    memcpy(&header, blob.data(), sizeof(header));
+    if (header.headerSize < sizeof(header) || header.headerSize > size ||
+        header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+        header.vendorID != properties.vendorID ||
+        header.deviceID != properties.deviceID ||
+        memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+        std::cout << "pipeline cache " << path << " was written by another device or driver, ignored" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool PipelineCache::Save() {
+    ROVSKI_CPU_FUNCTION();
+    size_t size = 0;
+    if (vkGetPipelineCacheData(device, cache, &size, nullptr) != VK_SUCCESS || size == 0) {
+        return false;
+    }
+    std::vector<char> data(size);
+    if (vkGetPipelineCacheData(device, cache, &size, data.data()) != VK_SUCCESS) {
+        return false;
+    }
+    // write aside and rename, a crash mid-write must not leave a truncated cache behind
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.write(data.data(), size)) {
+            std::cout << "failed to write pipeline cache " << tempPath << std::endl;
+            return false;
+        }
+    }
+    return std::rename(tempPath.c_str(), path.c_str()) == 0;
+}
+
+void PipelineCache::Destroy() {
+    if (cache == VK_NULL_HANDLE) {
+        return;
+    }
+    Save();
+    vkDestroyPipelineCache(device, cache, nullptr);
+    cache = VK_NULL_HANDLE;
+}
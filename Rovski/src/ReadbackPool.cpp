@@ -0,0 +1,51 @@
+//
+//  ReadbackPool.cpp
+//  Rovski
+//
+
+#include "ReadbackPool.hpp"
+#include <fstream>
+
+bool WritePpm(const std::string &path, const ReadbackFrame &frame) {
+    bool bgra = frame.format == VK_FORMAT_B8G8R8A8_UNORM || frame.format == VK_FORMAT_B8G8R8A8_SRGB;
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+    file << "P6\n" << frame.width << " " << frame.height << "\n255\n";
+    std::vector<uint8_t> row(frame.width * 3);
+    for (uint32_t y = 0; y < frame.height; y++) {
+        const uint8_t *source = frame.pixels + uint64_t(y) * frame.rowPitch;
+        for (uint32_t x = 0; x < frame.width; x++) {
+            row[x * 3 + 0] = source[x * 4 + (bgra ? 2 : 0)];
+            row[x * 3 + 1] = source[x * 4 + 1];
+            row[x * 3 + 2] = source[x * 4 + (bgra ? 0 : 2)];
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), row.size());
+    }
+    return file.good();
+}
+
+void ReadbackPool::Init(std::vector<Slot> slots) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->slots = std::move(slots);
+    freeSlots.clear();
+    for (uint32_t i = 0; i < this->slots.size(); i++) {
+        freeSlots.push_back(i);
+    }
+}
+
+bool ReadbackPool::TryAcquire(uint32_t &slot) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (freeSlots.empty()) {
+        return false;
+    }
+    slot = freeSlots.back();
+    freeSlots.pop_back();
+    return true;
+}
+
+void ReadbackPool::Release(uint32_t slot) {
+    std::lock_guard<std::mutex> lock(mutex);
+    freeSlots.push_back(slot);
+}
@@ -11,15 +11,33 @@
 #include <map>
 #include <set>
 #include <algorithm>
+#include <numeric>
+#include <limits>
+#include <cmath>
 #include <cstdint>
+#include <cstddef>
 #include <fstream>
+#include <atomic>
+#include <bit>
+#include <cstdio>
 #include "BaseStructs.h"
+#include "CpuProfiler.hpp"
+#include "MappedFile.hpp"
+#include "MeshCache.hpp"
+#include "MipChain.hpp"
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+#ifndef ROVSKI_SHADER_DIR
+#define ROVSKI_SHADER_DIR "/Users/luobin/Rovski/Rovski/Shader/"
+#endif
+#ifndef ROVSKI_TEXTURE_DIR
+#define ROVSKI_TEXTURE_DIR "/Users/luobin/Rovski/Rovski/Texture/"
+#endif
+
 Vertex v = std::make_tuple(glm::vec3{-0.5f, -0.5f, 0.0f}, glm::vec3{1.0f, 1.0f, 1.0f}, glm::vec2{1.0f, 0.0f});
 std::vector<Vertex> Vertices = {
         std::make_tuple(glm::vec3{-0.5f, -0.5f, 0.0f}, glm::vec3{1.0f, 1.0f, 1.0f}, glm::vec2{1.0f, 0.0f}),
@@ -27,10 +45,10 @@ std::vector<Vertex> Vertices = {
         std::make_tuple(glm::vec3{0.5f, 0.5f, 0.0f}, glm::vec3{0.0f, 0.0f, 1.0f}, glm::vec2{0.0f, 1.0f}),
         std::make_tuple(glm::vec3{-0.5f, 0.5f, 0.0f}, glm::vec3{0.0f, 0.0f, 1.0f}, glm::vec2{1.0f, 1.0f}),
 
-        std::make_tuple(glm::vec3{-0.5f, -0.5f, 0.0f}, glm::vec3{1.0f, 1.0f, 1.0f}, glm::vec2{1.0f, 0.0f}),
-        std::make_tuple(glm::vec3{-0.5f, -0.5f, 0.0f}, glm::vec3{1.0f, 1.0f, 1.0f}, glm::vec2{1.0f, 0.0f}),
-        std::make_tuple(glm::vec3{-0.5f, -0.5f, 0.0f}, glm::vec3{1.0f, 1.0f, 1.0f}, glm::vec2{1.0f, 0.0f}),
-        std::make_tuple(glm::vec3{-0.5f, -0.5f, 0.0f}, glm::vec3{1.0f, 1.0f, 1.0f}, glm::vec2{1.0f, 0.0f}),
+        std::make_tuple(glm::vec3{-0.5f, -0.5f, -0.5f}, glm::vec3{1.0f, 1.0f, 1.0f}, glm::vec2{1.0f, 0.0f}),
+        std::make_tuple(glm::vec3{0.5f, -0.5f, -0.5f}, glm::vec3{0.0f, 1.0f, 0.0f}, glm::vec2{0.0f, 0.0f}),
+        std::make_tuple(glm::vec3{0.5f, 0.5f, -0.5f}, glm::vec3{0.0f, 0.0f, 1.0f}, glm::vec2{0.0f, 1.0f}),
+        std::make_tuple(glm::vec3{-0.5f, 0.5f, -0.5f}, glm::vec3{0.0f, 0.0f, 1.0f}, glm::vec2{1.0f, 1.0f}),
 };
 
 
@@ -45,7 +63,7 @@ std::vector<Vertex> Vertices = {
 };
  */
 
-std::vector<uint16_t> Indexes = {
+std::vector<uint32_t> Indexes = {
         0,1,2,2,3,0,
         4,5,6,6,7,4
 };
@@ -56,6 +74,70 @@ struct UniformBufferObject {
     alignas(16) glm::mat4 prj;
 };
 
+// one draw as Cull.comp and Indirect.vert read it, std430
+struct GpuObject {
+    glm::mat4 model;
+    // world space center and radius, the box shares the center. Unbounded draws have FLT_MAX radius and extent
+    glm::vec4 sphere;
+    glm::vec4 extent;
+    uint32_t indexCount;
+    uint32_t firstIndex;
+    int32_t vertexOffset;
+    uint32_t batch;
+};
+static_assert(sizeof(GpuObject) == 112, "GpuObject must match the std430 layout of the shaders");
+
+// the uniform block of Cull.comp, std140
+struct CullData {
+    glm::vec4 planes[6];
+    glm::mat4 view;
+    // P00, P11 and the near plane
+    glm::vec4 projection;
+    glm::vec2 pyramidSize;
+    uint32_t objectCount;
+    uint32_t pyramidLevels;
+    uint32_t lateCommandBase;
+    uint32_t lateCountBase;
+    uint32_t padding[2];
+};
+static_assert(sizeof(CullData) == 208, "CullData must match the uniform block of Cull.comp");
+
+// the push constants of the bindless shaders. Direct draws push the model and the texture, draws from the indirect
+// buffer push the table slots of the object buffer and the per object textures
+struct BindlessConstants {
+    glm::mat4 model;
+    uint32_t texture;
+    uint32_t objectBuffer;
+    uint32_t textureBuffer;
+};
+static_assert(sizeof(BindlessConstants) == 76, "BindlessConstants must match the push constant block of the bindless shaders");
+
+// the storage buffer slots of the bindless table
+constexpr uint32_t bindlessObjectBuffer = 0;
+constexpr uint32_t bindlessObjectTextureBuffer = 1;
+
+// the work group sizes of Cull.comp and DepthReduce.comp
+constexpr uint32_t cullGroupSize = 64;
+constexpr uint32_t depthReduceGroupSize = 8;
+
+static GpuObject MakeGpuObject(const DrawCommand &draw, uint32_t batch) {
+    WorldBounds world = TransformBounds(draw.bounds, draw.model);
+    GpuObject object{};
+    object.model = draw.model;
+    if (world.unbounded) {
+        object.sphere = glm::vec4(0.0f, 0.0f, 0.0f, std::numeric_limits<float>::max());
+        object.extent = glm::vec4(std::numeric_limits<float>::max());
+    } else {
+        object.sphere = glm::vec4(world.center, world.radius);
+        object.extent = glm::vec4(world.extent, 0.0f);
+    }
+    object.indexCount = draw.indexCount;
+    object.firstIndex = draw.firstIndex;
+    object.vertexOffset = draw.vertexOffset;
+    object.batch = batch;
+    return object;
+}
+
 const std::vector<const char*> Rovski::validationLayers = {
     "VK_LAYER_KHRONOS_validation"
 };
@@ -83,54 +165,326 @@ void Rovski::OnFrameBufferSized() {
     frameBufferResized = true;
 }
 
+MemoryStats Rovski::GetMemoryStats() const {
+    return memoryAllocator.GetStats();
+}
+
 void Rovski::Run(){
+    if (headless) {
+        throw std::runtime_error("Run needs a window, use RunFrames in headless mode");
+    }
     auto currentTime = std::chrono::high_resolution_clock::now();
     while (!glfwWindowShouldClose(window)) {
         UpdateTime();
         glfwPollEvents();
+        if (useDemoScene) {
+            SetDrawTransform(0, glm::rotate(glm::mat4(1), glm::radians(90.0f)*static_cast<float>(currentTimeFromStart), glm::vec3(0.0f, 0.0f, 1.0f)));
+        }
+        DrawFrame();
+    }
+    vkDeviceWaitIdle(vkDevice);
+}
+
+void Rovski::RunFrames(uint32_t frameCount, const FrameCallback &onFrame) {
+    for (uint32_t i = 0; i < frameCount && (headless || !glfwWindowShouldClose(window)); i++) {
+        UpdateTime();
+        if (!headless) {
+            glfwPollEvents();
+        }
         DrawFrame();
+        if (onFrame) {
+            onFrame(frameStats);
+        }
     }
     vkDeviceWaitIdle(vkDevice);
+    FlushReadbacks();
+}
+
+void Rovski::SetDrawList(std::vector<DrawCommand> draws) {
+    if (!EnsureUniformCapacity(draws.size())) {
+        throw std::runtime_error("failed to grow uniform ring");
+    }
+    drawList = std::move(draws);
+    useDemoScene = false;
+    UpdateDrawBounds();
+    // uploaded by the next GPU driven frame
+    gpuObjectsStale = true;
+}
+
+bool Rovski::SetInstances(const MeshRange &mesh, uint32_t texture, const std::vector<Instance> &instances) {
+    ROVSKI_CPU_FUNCTION();
+    // the instanced draw reads view and projection from a block of its own, on top of the draw list's
+    if (!EnsureUniformCapacity(drawList.size())) {
+        return false;
+    }
+    // only the capacity grows here, each frame replaces its own buffer in UploadInstances
+    instanceCapacity = std::max(instanceCapacity, 1024u);
+    while (instanceCapacity < instances.size()) {
+        instanceCapacity *= 2;
+    }
+    vkInstanceBuffers.resize(maxFrameInFlight, VK_NULL_HANDLE);
+    instanceBufferMemory.resize(maxFrameInFlight);
+    instanceBufferCapacity.resize(maxFrameInFlight, 0);
+    // each frame copies them into its own buffer before recording, the frames in flight keep the old ones
+    instanceData = instances;
+    instanceBuffersStale.assign(maxFrameInFlight, 1);
+    instancedMesh = mesh;
+    instancedTexture = texture;
+    instanceCount = static_cast<uint32_t>(instances.size());
+    return true;
+}
+
+bool Rovski::UploadInstances() {
+    if (instanceCount == 0 || !instanceBuffersStale[currentFrame]) {
+        return true;
+    }
+    ROVSKI_CPU_FUNCTION();
+    if (instanceBufferCapacity[currentFrame] < instanceCount) {
+        RetireBuffer(vkInstanceBuffers[currentFrame], instanceBufferMemory[currentFrame]);
+        instanceBufferCapacity[currentFrame] = 0;
+        if (!CreateBuffer(VkDeviceSize(instanceCapacity) * sizeof(Instance), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vkInstanceBuffers[currentFrame], instanceBufferMemory[currentFrame], false)) {
+            return false;
+        }
+        instanceBufferCapacity[currentFrame] = instanceCapacity;
+    }
+    instanceBuffersStale[currentFrame] = 0;
+    return uploadEngine.UploadBuffer(vkInstanceBuffers[currentFrame], 0, instanceData.data(), instanceData.size() * sizeof(Instance),
+                                     VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+}
+
+void Rovski::SetDrawTransform(uint32_t draw, const glm::mat4 &model) {
+    if (draw >= drawList.size()) {
+        std::cout << "draw " << draw << " is past the end of the draw list" << std::endl;
+        return;
+    }
+    drawList[draw].model = model;
+    frustumCuller.SetBounds(draw, drawList[draw].bounds, model);
+    // moved again before the next frame, the object is still patched once
+    if (gpuDriven && !gpuObjectsStale && !objectDirty[draw]) {
+        objectDirty[draw] = 1;
+        dirtyObjects.push_back(draw);
+    }
+}
+
+void Rovski::UpdateDrawBounds() {
+    ROVSKI_CPU_FUNCTION();
+    frustumCuller.Resize(static_cast<uint32_t>(drawList.size()));
+    jobSystem->ParallelFor(static_cast<uint32_t>(drawList.size()), 4096, [this](uint32_t begin, uint32_t end, uint32_t) {
+        for (uint32_t i = begin; i < end; i++) {
+            frustumCuller.SetBounds(i, drawList[i].bounds, drawList[i].model);
+        }
+    });
+}
+
+const FrameStats &Rovski::GetFrameStats() const {
+    return frameStats;
+}
+
+const StartupStats &Rovski::GetStartupStats() const {
+    return startupStats;
+}
+
+const GpuProfiler &Rovski::GetGpuProfiler() const {
+    return gpuProfiler;
+}
+
+void Rovski::SetPipelineCachePath(std::string path) {
+    pipelineCachePath = std::move(path);
+}
+
+void Rovski::SetHeadless(bool headless) {
+    this->headless = headless;
+}
+
+void Rovski::SetReadbackCallback(ReadbackCallback callback) {
+    readbackCallback = std::move(callback);
+}
+
+void Rovski::SetReadbackDirectory(std::string directory) {
+    readbackDirectory = std::move(directory);
+}
+
+void Rovski::SetTextureQuality(EncodeQuality quality) {
+    textureQuality = quality;
+}
+
+void Rovski::SetDefaultTexture(std::string path) {
+    defaultTexturePath = std::move(path);
 }
 
-bool Rovski::Init(uint32_t windowWidth, uint32_t windowHeight, uint32_t maxFrameInFlight) {
+void Rovski::SetDepthPrepass(bool enabled) {
+    depthPrepass = enabled;
+}
+
+void Rovski::SetFrustumCulling(bool enabled) {
+    frustumCulling = enabled;
+}
+
+void Rovski::SetGpuDriven(bool enabled) {
+    // before Init the device is unknown, InitVulkan drops the request if it can't
+    if (enabled && vkDevice != VK_NULL_HANDLE && !gpuDrivenSupported) {
+        std::cout << "gpu driven rendering needs drawIndirectCount, multiDrawIndirect and drawIndirectFirstInstance" << std::endl;
+        return;
+    }
+    // transforms set while it was off never reached the object buffer
+    if (enabled && !gpuDriven) {
+        gpuObjectsStale = true;
+    }
+    gpuDriven = enabled;
+}
+
+void Rovski::SetBindless(bool enabled) {
+    // before Init the device is unknown, InitVulkan drops the request if it can't
+    if (enabled && vkDevice != VK_NULL_HANDLE && !bindlessSupported) {
+        std::cout << "bindless rendering needs descriptor indexing with update after bind sampled images and storage buffers" << std::endl;
+        return;
+    }
+    // the indirect batches differ, one per texture or one for everything
+    if (enabled != bindless) {
+        gpuObjectsStale = true;
+    }
+    bindless = enabled;
+}
+
+void Rovski::SetOcclusionCulling(bool enabled) {
+    if (enabled && vkDevice != VK_NULL_HANDLE && !occlusionCullingSupported) {
+        std::cout << "occlusion culling needs gpu driven rendering and a depth format that can be sampled" << std::endl;
+        return;
+    }
+    occlusionCulling = enabled;
+}
+
+bool Rovski::Init(uint32_t windowWidth, uint32_t windowHeight, uint32_t maxFrameInFlight, uint32_t workerCount) {
+    ROVSKI_CPU_FUNCTION();
+    CpuProfiler::Instance().SetThreadName("main");
     this->windowWidth = windowWidth;
     this->windowHeight = windowHeight;
     this->maxFrameInFlight = maxFrameInFlight;
-    InitWindow();
+    auto initStart = std::chrono::high_resolution_clock::now();
+    jobSystem = std::make_unique<JobSystem>(workerCount == AutoWorkerCount ? JobSystem::DefaultWorkerCount() : workerCount);
+    // decoding shares the cores with frame recording, half of the workers keeps both moving
+    textureStreamer = std::make_unique<TextureStreamer>(std::max(1u, JobSystem::DefaultWorkerCount() / 2));
+    if (!headless) {
+        InitWindow();
+    }
     InitVulkan();
     startTime = std::chrono::high_resolution_clock::now();
+    startupStats.initMs = std::chrono::duration<double, std::milli>(startTime - initStart).count();
     return true;
 }
 
 bool Rovski::Clean(){
+    ROVSKI_CPU_FUNCTION();
+    textureStreamer.reset();
+    streamingTextures.clear();
+    uploadEngine.Destroy();
+    DestroyBuffer(vkStagingBuffer, stagingBufferMemory);
+    FlushReadbacks();
+    readbackJobs.reset();
+    for (size_t i = 0; i < vkReadbackBuffers.size(); i++) {
+        DestroyBuffer(vkReadbackBuffers[i], readbackBufferMemory[i]);
+    }
     CleanUpSwapChain();
+    if (headless) {
+        for (size_t i = 0; i < vkSwapChainImages.size(); i++) {
+            DestroyImage(vkSwapChainImages[i], offscreenImageMemory[i]);
+        }
+    } else {
+        vkDestroySwapchainKHR(vkDevice, vkSwapChain, nullptr);
+    }
+    vkDestroyPipeline(vkDevice, vkGraphicsPipeline, nullptr);
+    vkDestroyPipeline(vkDevice, vkDepthPrepassPipeline, nullptr);
+    vkDestroyPipeline(vkDevice, vkDepthEqualPipeline, nullptr);
+    vkDestroyPipeline(vkDevice, vkInstancedPipeline, nullptr);
+    vkDestroyPipeline(vkDevice, vkInstancedPrepassPipeline, nullptr);
+    vkDestroyPipeline(vkDevice, vkInstancedEqualPipeline, nullptr);
+    vkDestroyPipelineLayout(vkDevice, vkPipelineLayout, nullptr);
+    vkDestroyPipeline(vkDevice, vkBindlessPipeline, nullptr);
+    vkDestroyPipeline(vkDevice, vkBindlessPrepassPipeline, nullptr);
+    vkDestroyPipeline(vkDevice, vkBindlessEqualPipeline, nullptr);
+    vkDestroyPipeline(vkDevice, vkBindlessIndirectPipeline, nullptr);
+    vkDestroyPipeline(vkDevice, vkBindlessIndirectPrepassPipeline, nullptr);
+    vkDestroyPipeline(vkDevice, vkBindlessIndirectEqualPipeline, nullptr);
+    vkDestroyPipelineLayout(vkDevice, vkBindlessPipelineLayout, nullptr);
+    vkDestroyDescriptorPool(vkDevice, vkBindlessPool, nullptr);
+    vkDestroyDescriptorSetLayout(vkDevice, vkBindlessSetLayout, nullptr);
+    vkDestroyPipeline(vkDevice, vkIndirectPipeline, nullptr);
+    vkDestroyPipeline(vkDevice, vkIndirectPrepassPipeline, nullptr);
+    vkDestroyPipeline(vkDevice, vkIndirectEqualPipeline, nullptr);
+    vkDestroyPipelineLayout(vkDevice, vkIndirectPipelineLayout, nullptr);
+    vkDestroyPipeline(vkDevice, vkCullPipeline, nullptr);
+    vkDestroyPipelineLayout(vkDevice, vkCullPipelineLayout, nullptr);
+    vkDestroyDescriptorPool(vkDevice, vkGpuDrivenDescriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(vkDevice, vkCullSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(vkDevice, vkObjectSetLayout, nullptr);
+    vkDestroyPipeline(vkDevice, vkDepthReducePipeline, nullptr);
+    vkDestroyPipelineLayout(vkDevice, vkDepthReducePipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(vkDevice, vkDepthReduceSetLayout, nullptr);
+    vkDestroySampler(vkDevice, vkDepthPyramidSampler, nullptr);
+    if (vkObjectBuffer != VK_NULL_HANDLE) {
+        DestroyBuffer(vkObjectBuffer, objectBufferMemory);
+        DestroyBuffer(vkBatchBaseBuffer, batchBaseBufferMemory);
+        DestroyBuffer(vkVisibilityBuffer, visibilityBufferMemory);
+        DestroyBuffer(vkObjectTextureBuffer, objectTextureBufferMemory);
+    }
+    for (uint32_t i = 0; i < vkIndirectBuffers.size(); i++) {
+        DestroyBuffer(vkIndirectBuffers[i], indirectBufferMemory[i]);
+        DestroyBuffer(vkIndirectCountBuffers[i], indirectCountBufferMemory[i]);
+    }
+    ReleaseRetiredBuffers(true);
+    for (uint32_t i = 0; i < vkInstanceBuffers.size(); i++) {
+        DestroyBuffer(vkInstanceBuffers[i], instanceBufferMemory[i]);
+    }
+    vkDestroyRenderPass(vkDevice, vkRenderPass, nullptr);
+    vkDestroyRenderPass(vkDevice, vkEarlyRenderPass, nullptr);
+    vkDestroyRenderPass(vkDevice, vkLateRenderPass, nullptr);
+    ReleaseRetiredBindings(true);
+    vkDestroyDescriptorPool(vkDevice, vkDescriptorPool, nullptr);
+    DestroyBuffer(vkUniformBuffer, uniformBufferMemory);
     vkDestroyDescriptorSetLayout(vkDevice, vkDescriptorSetLayout, nullptr);
     vkDestroySampler(vkDevice, vkTextureSampler, nullptr);
-    vkDestroyImageView(vkDevice, vkTextureImageView, nullptr);
-    vkDestroyImage(vkDevice, vkTextureImage, nullptr);
-    vkFreeMemory(vkDevice, vkTextureMemory, nullptr);
-    vkDestroyBuffer(vkDevice, vkIndexBuffer, nullptr);
-    vkFreeMemory(vkDevice, vkIndextBufferMemory, nullptr);
-    vkDestroyBuffer(vkDevice, vkVertexBuffer, nullptr);
-    vkFreeMemory(vkDevice, vkVertextBufferMemory, nullptr);
+    for (auto &texture : textures) {
+        vkDestroyImageView(vkDevice, texture.view, nullptr);
+        DestroyImage(texture.image, texture.memory);
+    }
+    textures.clear();
+    vkDestroyImageView(vkDevice, placeholderTexture.view, nullptr);
+    DestroyImage(placeholderTexture.image, placeholderTexture.memory);
+    DestroyBuffer(vkIndexBuffer, indexBufferMemory);
+    DestroyBuffer(vkVertexBuffer, vertexBufferMemory);
     for (int i = 0; i < maxFrameInFlight; i++) {
         vkDestroySemaphore(vkDevice, vkImageAvailableSemaphore[i], nullptr);
         vkDestroySemaphore(vkDevice, vkRenderFinishSemaphore[i], nullptr);
         vkDestroyFence(vkDevice, vkInFlightFences[i], nullptr);
     }
+    for (auto pool : vkFrameCommandPools) {
+        vkDestroyCommandPool(vkDevice, pool, nullptr);
+    }
+    for (auto &context : threadRecordContexts) {
+        vkDestroyCommandPool(vkDevice, context.pool, nullptr);
+    }
     vkDestroyCommandPool(vkDevice, vkCommandPool, nullptr);
-    vkDestroyCommandPool(vkDevice, vkTransferCommandPool, nullptr);
+    pipelineCache.Destroy();
+    gpuProfiler.Destroy();
+    memoryAllocator.PrintStats();
+    memoryAllocator.Destroy();
     vkDestroyDevice(vkDevice, nullptr);
     DestroyDebugMessager();
-    vkDestroySurfaceKHR(vkInstance, vkSurface, nullptr);
+    if (!headless) {
+        vkDestroySurfaceKHR(vkInstance, vkSurface, nullptr);
+    }
     vkDestroyInstance(vkInstance, nullptr);
-    glfwDestroyWindow(window);
-    glfwTerminate();
+    if (!headless) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
+    jobSystem.reset();
     return true;
 }
 
 bool Rovski::InitWindow(){
+    ROVSKI_CPU_FUNCTION();
     glfwInit();
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
@@ -141,8 +495,11 @@ bool Rovski::InitWindow(){
 }
 
 bool Rovski::InitVulkan(){
+    ROVSKI_CPU_FUNCTION();
     CreateVkInstance();
-    CreateSurface();
+    if (!headless) {
+        CreateSurface();
+    }
     SetDebugMessage();
     if (!PickPhysicCard()){
         std::cout << "failed to find a suitable physic card." << std::endl;
@@ -152,14 +509,46 @@ bool Rovski::InitVulkan(){
         std::cout << "failed to create logical device" << std::endl;
         return false;
     }
-    if (!CreateSwapChain()) {
+    memoryAllocator.Init(vkPhysicalDevice, vkDevice);
+    if (!pipelineCache.Init(vkPhysicalDevice, vkDevice, pipelineCachePath)) {
+        std::cout << "failed to create pipeline cache" << std::endl;
+        return false;
+    }
+    startupStats.pipelineCacheLoaded = pipelineCache.LoadedFromDisk();
+    if (!gpuProfiler.Init(vkPhysicalDevice, vkDevice, FindQueueFamilies(vkPhysicalDevice).graphicsFamily.value(), maxFrameInFlight,
+                          vkDeviceFeatures.pipelineStatisticsQuery == VK_TRUE, vkDeviceFeatures.inheritedQueries == VK_TRUE)) {
+        std::cout << "failed to create gpu profiler" << std::endl;
+        return false;
+    }
+    if (!CreateBuffer(stagingRingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                      vkStagingBuffer, stagingBufferMemory, false)) {
+        std::cout << "failed to create staging buffer" << std::endl;
+        return false;
+    }
+    QueueFamilyIndices queueFamilies = FindQueueFamilies(vkPhysicalDevice);
+    if (!uploadEngine.Init(vkDevice, vkTransferQueue, queueFamilies.transferFamily.value(),
+                           vkGraphicsQueue, queueFamilies.graphicsFamily.value(),
+                           vkStagingBuffer, stagingBufferMemory.mapped, stagingRingSize)) {
+        std::cout << "failed to create upload engine" << std::endl;
+        return false;
+    }
+    if (!(headless ? CreateOffscreenTargets() : CreateSwapChain())) {
         std::cout << "failed to create swap chain" << std::endl;
         return false;
     }
+    if (NeedReadback() && !CreateReadbackBuffers()) {
+        std::cout << "failed to create readback buffers" << std::endl;
+        return false;
+    }
     if (!CreateImageViews()) {
         std::cout << "failed to create image view" << std::endl;
         return false;
     }
+    if (!CreateDepthResources()) {
+        std::cout << "failed to create depth buffer" << std::endl;
+        return false;
+    }
     if (!CreateRenderPass()) {
         std::cout << "failed to create render pass" << std::endl;
         return false;
@@ -168,10 +557,32 @@ bool Rovski::InitVulkan(){
         std::cout << "failed to create descriptor pipeline" << std::endl;
         return false;
     }
+    auto pipelineStart = std::chrono::high_resolution_clock::now();
     if (!CreateGraphicsPipeline()) {
         std::cout << "failed to create graphics pipeline" << std::endl;
         return false;
     }
+    if (gpuDrivenSupported && !CreateCullPipeline()) {
+        std::cout << "failed to create cull pipeline" << std::endl;
+        return false;
+    }
+    if (occlusionCullingSupported && !CreateDepthReducePipeline()) {
+        std::cout << "failed to create depth reduce pipeline" << std::endl;
+        return false;
+    }
+    startupStats.pipelineMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - pipelineStart).count();
+    if (gpuDriven && !gpuDrivenSupported) {
+        std::cout << "gpu driven rendering is not supported by " << GetDeviceName() << ", culling on the CPU" << std::endl;
+        gpuDriven = false;
+    }
+    if (bindless && !bindlessSupported) {
+        std::cout << "bindless rendering is not supported by " << GetDeviceName() << ", binding a set per texture" << std::endl;
+        bindless = false;
+    }
+    if (occlusionCulling && !occlusionCullingSupported) {
+        std::cout << "occlusion culling is not supported by " << GetDeviceName() << ", culling against the frustum only" << std::endl;
+        occlusionCulling = false;
+    }
     if (!CreateFrameBuffer()) {
         std::cout << "failed to create frame buffers" << std::endl;
         return false;
@@ -184,10 +595,6 @@ bool Rovski::InitVulkan(){
         std::cout << "failed to create texture image" << std::endl;
         return false;
     }
-    if (!CreateTextureImageView()) {
-        std::cout << "failed to create texture image view" << std::endl;
-        return false;
-    }
     if (!CreateTextureSampler()) {
         std::cout << "failed to create texture sampler" << std::endl;
         return false;
@@ -212,25 +619,44 @@ bool Rovski::InitVulkan(){
         std::cout << "failed to create descriptor set" << std::endl;
         return false;
     }
+    if (bindlessSupported && !CreateBindlessTable()) {
+        std::cout << "failed to create bindless table" << std::endl;
+        return false;
+    }
+    if (gpuDrivenSupported && !CreateDepthPyramid()) {
+        std::cout << "failed to create depth pyramid" << std::endl;
+        return false;
+    }
     if (!CreateCommandBuffer()) {
         std::cout << "failed to create command buffer" << std::endl;
         return false;
     }
+    if (!UploadMesh(Vertices, Indexes, demoMesh)) {
+        std::cout << "failed to upload demo mesh" << std::endl;
+        return false;
+    }
+    drawList = {DrawCommand{glm::mat4(1), demoMesh.indexCount, demoMesh.firstIndex, demoMesh.vertexOffset, 0,
+                            MeshBounds{glm::vec3(-0.5f, -0.5f, -0.5f), glm::vec3(0.5f, 0.5f, 0.0f)}}};
+    UpdateDrawBounds();
     if (!CreateSyncObjects()) {
         std::cout << "failed to create semaphores" << std::endl;
         return false;
     }
+    // everything above only recorded copies, they all go out in one submit
+    uploadValueRequired = uploadEngine.Flush();
+    memoryAllocator.PrintStats();
     return true;
 }
 
 bool Rovski::CreateVkInstance(){
+    ROVSKI_CPU_FUNCTION();
     VkApplicationInfo appInfo{};
     appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
     appInfo.pApplicationName = "Rovski";
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.pEngineName = "Rovski";
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_0;
+    appInfo.apiVersion = VK_API_VERSION_1_2;
     VkInstanceCreateInfo insCreateInfo{};
     insCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
     insCreateInfo.pApplicationInfo = &appInfo;
@@ -284,11 +710,13 @@ bool Rovski::CheckoutValidationLayerSupport() {
 }
 
 std::vector<const char*> Rovski::GetRequiredExtensions() {
-    uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-    std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    std::vector<const char*> extensions;
+    if (!headless) {
+        uint32_t glfwExtensionCount = 0;
+        const char** glfwExtensions;
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    }
 
     if (enableValidationLayers) {
         extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -338,6 +766,7 @@ void Rovski::DestroyDebugMessager(){
 }
 
 bool Rovski::PickPhysicCard() {
+    ROVSKI_CPU_FUNCTION();
     uint32_t physicalDeviceCount;
     vkEnumeratePhysicalDevices(vkInstance, &physicalDeviceCount, nullptr);
     if (physicalDeviceCount == 0) {
@@ -352,6 +781,47 @@ bool Rovski::PickPhysicCard() {
     }
     if (candidates.rbegin()->first > 0) {
         vkPhysicalDevice = candidates.rbegin()->second;
+        // RateDevice left the features of the last device it looked at, the device is created with these
+        vkGetPhysicalDeviceFeatures(vkPhysicalDevice, &vkDeviceFeatures);
+        VkPhysicalDeviceProperties deviceProperties{};
+        vkGetPhysicalDeviceProperties(vkPhysicalDevice, &deviceProperties);
+        vkDeviceFeatures12 = {};
+        vkDeviceFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        VkPhysicalDeviceVulkan12Properties properties12{};
+        properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+        if (deviceProperties.apiVersion >= VK_API_VERSION_1_2) {
+            VkPhysicalDeviceFeatures2 features2{};
+            features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            features2.pNext = &vkDeviceFeatures12;
+            vkGetPhysicalDeviceFeatures2(vkPhysicalDevice, &features2);
+            vkDeviceFeatures12.pNext = nullptr;
+            VkPhysicalDeviceProperties2 properties2{};
+            properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+            properties2.pNext = &properties12;
+            vkGetPhysicalDeviceProperties2(vkPhysicalDevice, &properties2);
+        }
+        // the bindless table: runtime sized arrays, partly filled, written while bound, textures indexed per draw
+        // of a multi draw. Update after bind pools come with much higher descriptor limits, they have to hold
+        // every texture
+        bindlessSupported = vkDeviceFeatures12.runtimeDescriptorArray == VK_TRUE
+            && vkDeviceFeatures12.descriptorBindingPartiallyBound == VK_TRUE
+            && vkDeviceFeatures12.descriptorBindingSampledImageUpdateAfterBind == VK_TRUE
+            && vkDeviceFeatures12.descriptorBindingStorageBufferUpdateAfterBind == VK_TRUE
+            && vkDeviceFeatures12.shaderSampledImageArrayNonUniformIndexing == VK_TRUE
+            && vkDeviceFeatures.shaderStorageBufferArrayDynamicIndexing == VK_TRUE
+            && properties12.maxPerStageDescriptorUpdateAfterBindSampledImages >= maxTextures
+            && properties12.maxDescriptorSetUpdateAfterBindSampledImages >= maxTextures
+            && properties12.maxPerStageDescriptorUpdateAfterBindStorageBuffers >= maxBindlessBuffers
+            && properties12.maxDescriptorSetUpdateAfterBindStorageBuffers >= maxBindlessBuffers;
+        // the cull dispatch goes into the frame's command buffer, so the graphics family has to run compute too
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(vkPhysicalDevice, &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(vkPhysicalDevice, &queueFamilyCount, queueFamilies.data());
+        uint32_t graphicsFamily = FindQueueFamilies(vkPhysicalDevice).graphicsFamily.value_or(0);
+        gpuDrivenSupported = vkDeviceFeatures12.drawIndirectCount == VK_TRUE && vkDeviceFeatures.multiDrawIndirect == VK_TRUE
+            && vkDeviceFeatures.drawIndirectFirstInstance == VK_TRUE && queueFamilyCount > graphicsFamily
+            && (queueFamilies[graphicsFamily].queueFlags & VK_QUEUE_COMPUTE_BIT) != 0;
         /*
         VkPhysicalDeviceProperties deviceProperties{};
         vkGetPhysicalDeviceProperties(vkPhysicalDevice, &deviceProperties);
@@ -373,6 +843,17 @@ int Rovski::RateDevice(VkPhysicalDevice device){
     if (vkDeviceFeatures.samplerAnisotropy != VK_TRUE) {
         score -= 100000;
     }
+    VkPhysicalDeviceVulkan12Features features12{};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    VkPhysicalDeviceFeatures2 features2{};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &features12;
+    if (devicePropoerties.apiVersion >= VK_API_VERSION_1_2) {
+        vkGetPhysicalDeviceFeatures2(device, &features2);
+    }
+    if (features12.timelineSemaphore != VK_TRUE) {
+        score -= 100000;
+    }
     if (devicePropoerties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) {
         score += 100;
     }
@@ -386,6 +867,10 @@ int Rovski::RateDevice(VkPhysicalDevice device){
     } else {
         score -= 100000;
     }
+    if (headless) {
+        // nothing is presented, software rasterizers such as lavapipe are fine
+        return score;
+    }
     if (!CheckDeviceExtSupport(device)){
         score -= 100000;
     }
@@ -404,28 +889,41 @@ QueueFamilyIndices Rovski::FindQueueFamilies(VkPhysicalDevice device) {
     std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
     vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
     
-    int i = 0;
+    uint32_t i = 0;
+    std::optional<uint32_t> dedicatedTransferFamily;
     for (auto queueFamily : queueFamilies) {
-        if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+        bool graphics = queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT;
+        if (graphics && !indices.graphicsFamily.has_value()) {
             indices.graphicsFamily = i;
         }
         VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, vkSurface, &presentSupport);
-        if (presentSupport){
-            indices.presentFamily = i;
+        if (vkSurface != VK_NULL_HANDLE) {
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, vkSurface, &presentSupport);
+        } else {
+            presentSupport = graphics;
         }
-        if (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) {
-            indices.transferFamily = i;
+        if (presentSupport && (!indices.presentFamily.has_value() || indices.graphicsFamily == i)){
+            indices.presentFamily = i;
         }
-        if (indices.isComplete()) {
-            break;
+        // a transfer-only family maps to the copy engines and runs beside graphics work
+        if ((queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !graphics) {
+            bool compute = queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT;
+            if (!dedicatedTransferFamily.has_value() || !compute) {
+                dedicatedTransferFamily = i;
+            }
         }
         i++;
     }
+    if (dedicatedTransferFamily.has_value()) {
+        indices.transferFamily = dedicatedTransferFamily;
+    } else {
+        indices.transferFamily = indices.graphicsFamily;
+    }
     return indices;
 }
 
 bool Rovski::CreateLogicalDevice(){
+    ROVSKI_CPU_FUNCTION();
     QueueFamilyIndices queueFamily = FindQueueFamilies(vkPhysicalDevice);;
     if (!queueFamily.isComplete()){
         std::cout << "failed to get grappic queue family" << std::endl;
@@ -434,12 +932,12 @@ bool Rovski::CreateLogicalDevice(){
     
     std::set<uint32_t> uniqueQueueFamilies = {queueFamily.graphicsFamily.value(), queueFamily.presentFamily.value(), queueFamily.transferFamily.value()};
     std::vector<VkDeviceQueueCreateInfo> queueInfos;
+    float queuePriority = 1.0f;
     for (auto family : uniqueQueueFamilies) {
         VkDeviceQueueCreateInfo queueCreateInfo{};
         queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
         queueCreateInfo.queueFamilyIndex = family;
         queueCreateInfo.queueCount = 1;
-        float queuePriority = 1.0f;
         queueCreateInfo.pQueuePriorities = &queuePriority;
         queueInfos.push_back(queueCreateInfo);
     }
@@ -448,7 +946,17 @@ bool Rovski::CreateLogicalDevice(){
     deviceCreateInfo.pQueueCreateInfos = queueInfos.data();
     deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueInfos.size());
     deviceCreateInfo.pEnabledFeatures = &vkDeviceFeatures;
-    deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
+    VkPhysicalDeviceVulkan12Features features12{};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    features12.timelineSemaphore = VK_TRUE;
+    features12.drawIndirectCount = vkDeviceFeatures12.drawIndirectCount;
+    features12.runtimeDescriptorArray = bindlessSupported;
+    features12.descriptorBindingPartiallyBound = bindlessSupported;
+    features12.descriptorBindingSampledImageUpdateAfterBind = bindlessSupported;
+    features12.descriptorBindingStorageBufferUpdateAfterBind = bindlessSupported;
+    features12.shaderSampledImageArrayNonUniformIndexing = bindlessSupported;
+    deviceCreateInfo.pNext = &features12;
+    deviceCreateInfo.enabledExtensionCount = headless ? 0 : static_cast<uint32_t>(deviceExtensions.size());
     deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
     if (enableValidationLayers) {
         deviceCreateInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -532,7 +1040,8 @@ VkExtent2D Rovski::ChooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilites)
     }
 }
 
-bool Rovski::CreateSwapChain(){
+bool Rovski::CreateSwapChain(VkSwapchainKHR oldSwapChain){
+    ROVSKI_CPU_FUNCTION();
     SwapChainSupportDetail swapChainSupportDetail = QuerrySwapChainSupport(vkPhysicalDevice);
     VkSurfaceFormatKHR format = ChooseSwapSurfaceFormat(swapChainSupportDetail.Formats);
     VkPresentModeKHR presentMode = ChooseSwapChainPresentMode(swapChainSupportDetail.PresentModes);
@@ -553,10 +1062,10 @@ bool Rovski::CreateSwapChain(){
     swapChainCreateInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
     
     QueueFamilyIndices indices = FindQueueFamilies(vkPhysicalDevice);
-    if (indices.graphicsFamily != indices.presentFamily || indices.transferFamily != indices.graphicsFamily) {
+    uint32_t queueFamilyIndeices[] = {indices.graphicsFamily.value(), indices.presentFamily.value()};
+    if (indices.graphicsFamily != indices.presentFamily) {
         swapChainCreateInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
         swapChainCreateInfo.queueFamilyIndexCount = 2;
-        uint32_t queueFamilyIndeices[] = {indices.graphicsFamily.value(), indices.presentFamily.value(), indices.transferFamily.value()};
         swapChainCreateInfo.pQueueFamilyIndices = queueFamilyIndeices;
     } else {
         swapChainCreateInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
@@ -567,7 +1076,8 @@ bool Rovski::CreateSwapChain(){
     swapChainCreateInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     swapChainCreateInfo.presentMode = presentMode;
     swapChainCreateInfo.clipped = VK_TRUE;
-    swapChainCreateInfo.oldSwapchain = VK_NULL_HANDLE;
+    // handing over the retired swapchain lets the presentation engine reuse its resources
+    swapChainCreateInfo.oldSwapchain = oldSwapChain;
     if (vkCreateSwapchainKHR(vkDevice, &swapChainCreateInfo, nullptr, &vkSwapChain) != VK_SUCCESS) {
         return false;
     }
@@ -580,7 +1090,149 @@ bool Rovski::CreateSwapChain(){
     return true;
 }
 
+bool Rovski::CreateOffscreenTargets() {
+    ROVSKI_CPU_FUNCTION();
+    vkSwapChainFormat = VK_FORMAT_R8G8B8A8_UNORM;
+    vkSwapChainExtent = {windowWidth, windowHeight};
+    vkSwapChainImages.resize(maxFrameInFlight);
+    offscreenImageMemory.resize(maxFrameInFlight);
+    for (uint32_t i = 0; i < maxFrameInFlight; i++) {
+        if (!CreateImage(windowWidth, windowHeight, vkSwapChainFormat, VK_IMAGE_TILING_OPTIMAL,
+                         VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vkSwapChainImages[i], offscreenImageMemory[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Rovski::NeedReadback() const {
+    return headless && (readbackCallback || !readbackDirectory.empty());
+}
+
+bool Rovski::CreateReadbackBuffers() {
+    ROVSKI_CPU_FUNCTION();
+    // cached memory makes reading the pixels back on the CPU much faster where it exists
+    VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(vkPhysicalDevice, &memProperties);
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        VkMemoryPropertyFlags flags = memProperties.memoryTypes[i].propertyFlags;
+        if ((flags & (properties | VK_MEMORY_PROPERTY_HOST_CACHED_BIT)) == (properties | VK_MEMORY_PROPERTY_HOST_CACHED_BIT)) {
+            properties |= VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+            break;
+        }
+    }
+    // twice the frames in flight, so a slow consumer doesn't stall the next frame right away
+    uint32_t slotCount = maxFrameInFlight * 2;
+    VkDeviceSize size = VkDeviceSize(vkSwapChainExtent.width) * vkSwapChainExtent.height * 4;
+    vkReadbackBuffers.resize(slotCount);
+    readbackBufferMemory.resize(slotCount);
+    std::vector<ReadbackPool::Slot> slots(slotCount);
+    for (uint32_t i = 0; i < slotCount; i++) {
+        if (!CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, properties, vkReadbackBuffers[i], readbackBufferMemory[i], false)) {
+            return false;
+        }
+        slots[i].buffer = vkReadbackBuffers[i];
+        slots[i].mapped = readbackBufferMemory[i].mapped;
+    }
+    readbackPool.Init(std::move(slots));
+    frameReadbackSlot.assign(maxFrameInFlight, UINT32_MAX);
+    frameReadbackIndex.assign(maxFrameInFlight, 0);
+    // consumers get a worker of their own, a slow one never runs inside a frame's ParallelFor wait
+    readbackJobs = std::make_unique<JobSystem>(1, "readback");
+    return true;
+}
+
+void Rovski::RecordReadback(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+    uint32_t slot;
+    while (!readbackPool.TryAcquire(slot)) {
+        // every slot is still with a consumer, help finish them instead of idling
+        readbackJobs->Wait(readbackCounter);
+    }
+    frameReadbackSlot[currentFrame] = slot;
+    frameReadbackIndex[currentFrame] = frameStats.frameIndex;
+
+    // the render pass already left the image in TRANSFER_SRC, only the write has to be made visible
+    VkImageMemoryBarrier imageBarrier{};
+    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.image = vkSwapChainImages[imageIndex];
+    imageBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    imageBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+    VkBufferImageCopy region{};
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {vkSwapChainExtent.width, vkSwapChainExtent.height, 1};
+    VkBuffer buffer = readbackPool.Get(slot).buffer;
+    vkCmdCopyImageToBuffer(commandBuffer, vkSwapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, 1, &region);
+
+    VkBufferMemoryBarrier bufferBarrier{};
+    bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.buffer = buffer;
+    bufferBarrier.offset = 0;
+    bufferBarrier.size = VK_WHOLE_SIZE;
+    bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                         0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+}
+
+void Rovski::DeliverReadback(uint32_t frame) {
+    if (frameReadbackSlot.empty() || frameReadbackSlot[frame] == UINT32_MAX) {
+        return;
+    }
+    uint32_t slot = frameReadbackSlot[frame];
+    frameReadbackSlot[frame] = UINT32_MAX;
+    ReadbackFrame readback{};
+    readback.frameIndex = frameReadbackIndex[frame];
+    readback.width = vkSwapChainExtent.width;
+    readback.height = vkSwapChainExtent.height;
+    readback.rowPitch = vkSwapChainExtent.width * 4;
+    readback.format = vkSwapChainFormat;
+    readback.pixels = static_cast<const uint8_t*>(readbackPool.Get(slot).mapped);
+    // consumers run on the readback worker, the slot goes back to the pool once they are done with the pixels
+    readbackJobs->Submit([this, readback, slot](uint32_t) {
+        if (readbackCallback) {
+            readbackCallback(readback);
+        }
+        if (!readbackDirectory.empty()) {
+            char name[32];
+            snprintf(name, sizeof(name), "/frame_%06llu.ppm", static_cast<unsigned long long>(readback.frameIndex));
+            if (!WritePpm(readbackDirectory + name, readback)) {
+                std::cout << "failed to write " << readbackDirectory + name << std::endl;
+            }
+        }
+        readbackPool.Release(slot);
+    }, readbackCounter);
+}
+
+void Rovski::FlushReadbacks() {
+    if (!readbackJobs) {
+        return;
+    }
+    // frames are handed out oldest first, the device is idle here so every slot holds finished pixels
+    for (uint32_t i = 0; i < maxFrameInFlight; i++) {
+        vkWaitForFences(vkDevice, 1, &vkInFlightFences[(currentFrame + i) % maxFrameInFlight], VK_TRUE, UINT64_MAX);
+        DeliverReadback(static_cast<uint32_t>((currentFrame + i) % maxFrameInFlight));
+    }
+    readbackJobs->Wait(readbackCounter);
+}
+
 bool Rovski::CreateImageViews(){
+    ROVSKI_CPU_FUNCTION();
     vkSwapChainImageViews.resize(vkSwapChainImages.size());
     for (int i = 0; i < vkSwapChainImages.size(); i++) {
         vkSwapChainImageViews[i] = CreateImageView(vkSwapChainImages[i], vkSwapChainFormat);
@@ -591,57 +1243,97 @@ bool Rovski::CreateImageViews(){
     return true;
 }
 
-bool Rovski::CreateShaderModule(const std::vector<char> &code, VkShaderModule &shaderModule){
+bool Rovski::CreateShaderModule(const std::string &path, VkShaderModule &shaderModule){
+    // SPIR-V is handed to the driver straight from the page cache, the mapping is page aligned
+    MappedFile code;
+    if (!code.Open(path) || code.Size() == 0 || code.Size() % sizeof(uint32_t) != 0) {
+        std::cout << "failed to read shader " << path << std::endl;
+        return false;
+    }
     VkShaderModuleCreateInfo createInfo{};
-    createInfo.codeSize = code.size();
+    createInfo.codeSize = code.Size();
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+    createInfo.pCode = reinterpret_cast<const uint32_t*>(code.Data());
     return VK_SUCCESS == vkCreateShaderModule(vkDevice, &createInfo, nullptr, &shaderModule);
 }
 
-bool ReadFile(const std::string &fileName, std::vector<char> &buffer) {
-    std::ifstream file(fileName, std::ios::ate | std::ios::binary);
-    if (!file.is_open()) {
-        return false;
-    }
-    size_t fileSize = (size_t)file.tellg();
-    buffer.resize(fileSize);
-    file.seekg(0);
-    file.read(buffer.data(), fileSize);
-    file.close();
-    return true;
-}
-
 bool Rovski::CreateGraphicsPipeline(){
-    std::vector<char> vertShaderCode(0),fragShaderCode(0);
-    if (!ReadFile("/Users/luobin/Rovski/Rovski/Shader/vert.spv", vertShaderCode)){
-        return false;
-    }
-    if(!ReadFile("/Users/luobin/Rovski/Rovski/Shader/frag.spv", fragShaderCode)){
-        return false;
-    }
-    VkShaderModule vertShaderModule, fragShaderModule;
-    if (CreateShaderModule(vertShaderCode, vertShaderModule) != true) {
-        return false;
-    }
-    if (CreateShaderModule(fragShaderCode, fragShaderModule) != true) {
-        return false;
+    ROVSKI_CPU_FUNCTION();
+    // the variants a device can't draw with are never loaded, their handles stay null
+    struct ShaderSource {
+        const char *path;
+        bool needed;
+        VkShaderModule module = VK_NULL_HANDLE;
+    };
+    std::array<ShaderSource, 13> shaders = {{
+        {ROVSKI_SHADER_DIR "vert.spv", true},
+        {ROVSKI_SHADER_DIR "frag.spv", true},
+        {ROVSKI_SHADER_DIR "prepass.spv", true},
+        {ROVSKI_SHADER_DIR "instanced.spv", true},
+        {ROVSKI_SHADER_DIR "instanced_prepass.spv", true},
+        {ROVSKI_SHADER_DIR "instanced_frag.spv", true},
+        {ROVSKI_SHADER_DIR "indirect.spv", gpuDrivenSupported},
+        {ROVSKI_SHADER_DIR "indirect_prepass.spv", gpuDrivenSupported},
+        {ROVSKI_SHADER_DIR "bindless.spv", bindlessSupported},
+        {ROVSKI_SHADER_DIR "bindless_prepass.spv", bindlessSupported},
+        {ROVSKI_SHADER_DIR "bindless_frag.spv", bindlessSupported},
+        {ROVSKI_SHADER_DIR "bindless_indirect.spv", bindlessSupported && gpuDrivenSupported},
+        {ROVSKI_SHADER_DIR "bindless_indirect_prepass.spv", bindlessSupported && gpuDrivenSupported},
+    }};
+    auto destroyShaderModules = [&]() {
+        for (ShaderSource &shader : shaders) {
+            vkDestroyShaderModule(vkDevice, shader.module, nullptr);
+        }
+    };
+    for (ShaderSource &shader : shaders) {
+        if (shader.needed && !CreateShaderModule(shader.path, shader.module)) {
+            destroyShaderModules();
+            return false;
+        }
     }
     
     VkPipelineShaderStageCreateInfo vertCreateInfo{};
     vertCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     vertCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vertCreateInfo.module = vertShaderModule;
+    vertCreateInfo.module = shaders[0].module;
     vertCreateInfo.pName = "main";
     
     VkPipelineShaderStageCreateInfo fragCreateInfo{};
     fragCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     fragCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fragCreateInfo.module = fragShaderModule;
+    fragCreateInfo.module = shaders[1].module;
     fragCreateInfo.pName = "main";
     
     VkPipelineShaderStageCreateInfo shaderStages[] = {vertCreateInfo, fragCreateInfo};
 
+    // the depth prepass has no fragment stage at all
+    VkPipelineShaderStageCreateInfo prepassCreateInfo = vertCreateInfo;
+    prepassCreateInfo.module = shaders[2].module;
+
+    // the indirect variants fetch the model matrix from the object buffer
+    VkPipelineShaderStageCreateInfo indirectStages[] = {vertCreateInfo, fragCreateInfo};
+    indirectStages[0].module = shaders[6].module;
+    VkPipelineShaderStageCreateInfo indirectPrepassCreateInfo = vertCreateInfo;
+    indirectPrepassCreateInfo.module = shaders[7].module;
+
+    // the instanced variants take the model matrix and a tint from the instance stream
+    VkPipelineShaderStageCreateInfo instancedStages[] = {vertCreateInfo, fragCreateInfo};
+    instancedStages[0].module = shaders[3].module;
+    instancedStages[1].module = shaders[5].module;
+    VkPipelineShaderStageCreateInfo instancedPrepassCreateInfo = vertCreateInfo;
+    instancedPrepassCreateInfo.module = shaders[4].module;
+
+    // the bindless variants take the model or the object from push constants and sample the texture table
+    VkPipelineShaderStageCreateInfo bindlessStages[] = {vertCreateInfo, fragCreateInfo};
+    bindlessStages[0].module = shaders[8].module;
+    bindlessStages[1].module = shaders[10].module;
+    VkPipelineShaderStageCreateInfo bindlessPrepassCreateInfo = vertCreateInfo;
+    bindlessPrepassCreateInfo.module = shaders[9].module;
+    VkPipelineShaderStageCreateInfo bindlessIndirectStages[] = {bindlessStages[0], bindlessStages[1]};
+    bindlessIndirectStages[0].module = shaders[11].module;
+    VkPipelineShaderStageCreateInfo bindlessIndirectPrepassCreateInfo = vertCreateInfo;
+    bindlessIndirectPrepassCreateInfo.module = shaders[12].module;
+
     auto vertexBinding = Vertex::getBindingDescription();
     auto vertexAttribute = Vertex::getVertexInputAttributeDescription();
     VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo{};
@@ -650,30 +1342,48 @@ bool Rovski::CreateGraphicsPipeline(){
     vertexInputCreateInfo.pVertexBindingDescriptions = &vertexBinding;
     vertexInputCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexAttribute.size());
     vertexInputCreateInfo.pVertexAttributeDescriptions = vertexAttribute.data();
+
+    // position only, the other attributes of the interleaved vertex are never fetched
+    auto positionAttribute = Vertex::getVertexInputAttributeSubset<0>();
+    VkPipelineVertexInputStateCreateInfo positionInputCreateInfo = vertexInputCreateInfo;
+    positionInputCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(positionAttribute.size());
+    positionInputCreateInfo.pVertexAttributeDescriptions = positionAttribute.data();
+
+    // the vertex stream at binding 0, the instance stream at binding 1 with its locations after the vertex's
+    static_assert(Instance::EndLocation == 8, "Instanced.vert reads the instance at locations 3 to 7");
+    auto instancedBindings = GetStreamBindingDescriptions<Vertex, Instance>();
+    auto instancedAttributes = GetStreamAttributeDescriptions<Vertex, Instance>();
+    VkPipelineVertexInputStateCreateInfo instancedInputCreateInfo = vertexInputCreateInfo;
+    instancedInputCreateInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(instancedBindings.size());
+    instancedInputCreateInfo.pVertexBindingDescriptions = instancedBindings.data();
+    instancedInputCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(instancedAttributes.size());
+    instancedInputCreateInfo.pVertexAttributeDescriptions = instancedAttributes.data();
+    // position and transform, the color never reaches a depth only pass
+    auto instanceTransform = Instance::getVertexInputAttributeSubset<0, 1, 2, 3>();
+    std::array<VkVertexInputAttributeDescription, 1 + std::tuple_size_v<decltype(instanceTransform)>> instancedPositionAttributes{positionAttribute[0]};
+    std::copy(instanceTransform.begin(), instanceTransform.end(), instancedPositionAttributes.begin() + 1);
+    VkPipelineVertexInputStateCreateInfo instancedPositionInputCreateInfo = instancedInputCreateInfo;
+    instancedPositionInputCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(instancedPositionAttributes.size());
+    instancedPositionInputCreateInfo.pVertexAttributeDescriptions = instancedPositionAttributes.data();
     
     VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
     inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
     inputAssembly.primitiveRestartEnable = VK_FALSE;
     inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
     
-    VkViewport viewPort{};
-    viewPort.x = 0.0f;
-    viewPort.y = 0.0f;
-    viewPort.height = vkSwapChainExtent.height;
-    viewPort.width = vkSwapChainExtent.width;
-    viewPort.minDepth = 0.0f;
-    viewPort.maxDepth = 1.0f;
-    
-    VkRect2D scissor{};
-    scissor.offset = {0,0};
-    scissor.extent = vkSwapChainExtent;
-    
+    // viewport and scissor are set while recording, so the pipeline survives a resize
     VkPipelineViewportStateCreateInfo viewportStateCreateInfo{};
     viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewportStateCreateInfo.scissorCount = 1;
-    viewportStateCreateInfo.pScissors = &scissor;
+    viewportStateCreateInfo.pScissors = nullptr;
     viewportStateCreateInfo.viewportCount = 1;
-    viewportStateCreateInfo.pViewports = &viewPort;
+    viewportStateCreateInfo.pViewports = nullptr;
+
+    VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo{};
+    dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicStateCreateInfo.dynamicStateCount = 2;
+    dynamicStateCreateInfo.pDynamicStates = dynamicStates;
     
     VkPipelineRasterizationStateCreateInfo rasterizationStateCreateInfo{};
     rasterizationStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -694,6 +1404,20 @@ bool Rovski::CreateGraphicsPipeline(){
     multisampleStateCreateInfo.alphaToOneEnable = VK_FALSE;
     multisampleStateCreateInfo.alphaToCoverageEnable = VK_FALSE;
     
+    // reverse-Z, nearer is greater. The fragment shader neither discards nor writes depth, so the test runs
+    // before shading and hidden fragments are never shaded
+    VkPipelineDepthStencilStateCreateInfo depthStencilStateCreateInfo{};
+    depthStencilStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencilStateCreateInfo.depthTestEnable = VK_TRUE;
+    depthStencilStateCreateInfo.depthWriteEnable = VK_TRUE;
+    depthStencilStateCreateInfo.depthCompareOp = VK_COMPARE_OP_GREATER_OR_EQUAL;
+    depthStencilStateCreateInfo.depthBoundsTestEnable = VK_FALSE;
+    depthStencilStateCreateInfo.stencilTestEnable = VK_FALSE;
+    // after a prepass the depth is final, only the visible surface's fragments pass
+    VkPipelineDepthStencilStateCreateInfo depthEqualStateCreateInfo = depthStencilStateCreateInfo;
+    depthEqualStateCreateInfo.depthWriteEnable = VK_FALSE;
+    depthEqualStateCreateInfo.depthCompareOp = VK_COMPARE_OP_EQUAL;
+
     VkPipelineColorBlendAttachmentState colorBlendAttachment{};
     colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_A_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_R_BIT;
     colorBlendAttachment.blendEnable = VK_FALSE;
@@ -714,6 +1438,11 @@ bool Rovski::CreateGraphicsPipeline(){
     colorBlendStateCreateInfo.blendConstants[1] = 0.0f;
     colorBlendStateCreateInfo.blendConstants[2] = 0.0f;
     colorBlendStateCreateInfo.blendConstants[3] = 0.0f;
+
+    VkPipelineColorBlendAttachmentState noColorAttachment = colorBlendAttachment;
+    noColorAttachment.colorWriteMask = 0;
+    VkPipelineColorBlendStateCreateInfo noColorStateCreateInfo = colorBlendStateCreateInfo;
+    noColorStateCreateInfo.pAttachments = &noColorAttachment;
     
     VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
     pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -721,8 +1450,32 @@ bool Rovski::CreateGraphicsPipeline(){
     pipelineLayoutCreateInfo.pSetLayouts = &vkDescriptorSetLayout;
     
     if(vkCreatePipelineLayout(vkDevice, &pipelineLayoutCreateInfo, nullptr, &vkPipelineLayout) != VK_SUCCESS) {
+        destroyShaderModules();
         return false;
     }
+    if (gpuDrivenSupported) {
+        VkDescriptorSetLayout indirectSetLayouts[] = {vkDescriptorSetLayout, vkObjectSetLayout};
+        VkPipelineLayoutCreateInfo indirectLayoutCreateInfo = pipelineLayoutCreateInfo;
+        indirectLayoutCreateInfo.setLayoutCount = 2;
+        indirectLayoutCreateInfo.pSetLayouts = indirectSetLayouts;
+        if (vkCreatePipelineLayout(vkDevice, &indirectLayoutCreateInfo, nullptr, &vkIndirectPipelineLayout) != VK_SUCCESS) {
+            destroyShaderModules();
+            return false;
+        }
+    }
+    if (bindlessSupported) {
+        VkDescriptorSetLayout bindlessSetLayouts[] = {vkDescriptorSetLayout, vkBindlessSetLayout};
+        VkPushConstantRange pushConstantRange{VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(BindlessConstants)};
+        VkPipelineLayoutCreateInfo bindlessLayoutCreateInfo = pipelineLayoutCreateInfo;
+        bindlessLayoutCreateInfo.setLayoutCount = 2;
+        bindlessLayoutCreateInfo.pSetLayouts = bindlessSetLayouts;
+        bindlessLayoutCreateInfo.pushConstantRangeCount = 1;
+        bindlessLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+        if (vkCreatePipelineLayout(vkDevice, &bindlessLayoutCreateInfo, nullptr, &vkBindlessPipelineLayout) != VK_SUCCESS) {
+            destroyShaderModules();
+            return false;
+        }
+    }
     
     VkGraphicsPipelineCreateInfo pipelineCreateInfo{};
     pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -733,81 +1486,469 @@ bool Rovski::CreateGraphicsPipeline(){
     pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
     pipelineCreateInfo.pRasterizationState = &rasterizationStateCreateInfo;
     pipelineCreateInfo.pMultisampleState = &multisampleStateCreateInfo;
-    pipelineCreateInfo.pDepthStencilState = nullptr;
+    pipelineCreateInfo.pDepthStencilState = &depthStencilStateCreateInfo;
     pipelineCreateInfo.pColorBlendState = &colorBlendStateCreateInfo;
-    pipelineCreateInfo.pDynamicState = nullptr;
+    pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
     pipelineCreateInfo.layout = vkPipelineLayout;
     pipelineCreateInfo.renderPass = vkRenderPass;
     pipelineCreateInfo.subpass = 0;
     pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
     pipelineCreateInfo.basePipelineIndex = -1;
 
-    if(vkCreateGraphicsPipelines(vkDevice, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &vkGraphicsPipeline) != VK_SUCCESS){
+    // groups of three: main, depth prepass and depth equal. Plain, instanced, bindless, drawing from the indirect
+    // buffer and bindless from the indirect buffer; the last three groups only where the device supports them
+    std::array<VkGraphicsPipelineCreateInfo, 15> pipelineCreateInfos;
+    pipelineCreateInfos.fill(pipelineCreateInfo);
+    pipelineCreateInfos[1].stageCount = 1;
+    pipelineCreateInfos[1].pStages = &prepassCreateInfo;
+    pipelineCreateInfos[1].pVertexInputState = &positionInputCreateInfo;
+    pipelineCreateInfos[1].pColorBlendState = &noColorStateCreateInfo;
+    pipelineCreateInfos[2].pDepthStencilState = &depthEqualStateCreateInfo;
+    for (uint32_t i = 3; i < pipelineCreateInfos.size(); i++) {
+        pipelineCreateInfos[i] = pipelineCreateInfos[i % 3];
+    }
+    for (uint32_t i = 0; i < 3; i++) {
+        pipelineCreateInfos[3 + i].pStages = instancedStages;
+        pipelineCreateInfos[3 + i].pVertexInputState = &instancedInputCreateInfo;
+        pipelineCreateInfos[6 + i].pStages = bindlessStages;
+        pipelineCreateInfos[6 + i].layout = vkBindlessPipelineLayout;
+        pipelineCreateInfos[9 + i].pStages = indirectStages;
+        pipelineCreateInfos[9 + i].layout = vkIndirectPipelineLayout;
+        pipelineCreateInfos[12 + i].pStages = bindlessIndirectStages;
+        pipelineCreateInfos[12 + i].layout = vkBindlessPipelineLayout;
+    }
+    pipelineCreateInfos[4].pStages = &instancedPrepassCreateInfo;
+    pipelineCreateInfos[4].pVertexInputState = &instancedPositionInputCreateInfo;
+    pipelineCreateInfos[7].pStages = &bindlessPrepassCreateInfo;
+    pipelineCreateInfos[10].pStages = &indirectPrepassCreateInfo;
+    pipelineCreateInfos[13].pStages = &bindlessIndirectPrepassCreateInfo;
+    std::array<VkPipeline *, 15> targets = {
+        &vkGraphicsPipeline, &vkDepthPrepassPipeline, &vkDepthEqualPipeline,
+        &vkInstancedPipeline, &vkInstancedPrepassPipeline, &vkInstancedEqualPipeline,
+        &vkBindlessPipeline, &vkBindlessPrepassPipeline, &vkBindlessEqualPipeline,
+        &vkIndirectPipeline, &vkIndirectPrepassPipeline, &vkIndirectEqualPipeline,
+        &vkBindlessIndirectPipeline, &vkBindlessIndirectPrepassPipeline, &vkBindlessIndirectEqualPipeline,
+    };
+    const std::array<bool, 5> groupSupported = {true, true, bindlessSupported, gpuDrivenSupported, bindlessSupported && gpuDrivenSupported};
+    // one call for all of them, drivers may compile them in parallel
+    std::vector<VkGraphicsPipelineCreateInfo> createInfos;
+    std::vector<VkPipeline *> createdTargets;
+    for (uint32_t i = 0; i < pipelineCreateInfos.size(); i++) {
+        if (groupSupported[i / 3]) {
+            createInfos.push_back(pipelineCreateInfos[i]);
+            createdTargets.push_back(targets[i]);
+        }
+    }
+    std::vector<VkPipeline> pipelines(createInfos.size(), VK_NULL_HANDLE);
+    VkResult result = vkCreateGraphicsPipelines(vkDevice, pipelineCache.Handle(), static_cast<uint32_t>(createInfos.size()),
+                                                createInfos.data(), nullptr, pipelines.data());
+    destroyShaderModules();
+    if (result != VK_SUCCESS) {
+        for (VkPipeline pipeline : pipelines) {
+            vkDestroyPipeline(vkDevice, pipeline, nullptr);
+        }
         return false;
     }
-    
-    
-    vkDestroyShaderModule(vkDevice, vertShaderModule, nullptr);
-    vkDestroyShaderModule(vkDevice, fragShaderModule, nullptr);
-    
+    for (uint32_t i = 0; i < pipelines.size(); i++) {
+        *createdTargets[i] = pipelines[i];
+    }
     return true;
 }
 
-bool Rovski::CreateRenderPass() {
-    VkAttachmentDescription colorAttachment{};
-    colorAttachment.format = vkSwapChainFormat;
-    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-    
-    VkAttachmentReference colorAttachmentRef{};
-    colorAttachmentRef.attachment = 0;
-    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-    VkSubpassDescription subpass{};
-    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpass.colorAttachmentCount = 1;
-    subpass.pColorAttachments = &colorAttachmentRef;
-    
-    VkRenderPassCreateInfo renderPassCreateInfo {};
-    renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassCreateInfo.attachmentCount = 1;
-    renderPassCreateInfo.pAttachments = &colorAttachment;
-    renderPassCreateInfo.subpassCount = 1;
-    renderPassCreateInfo.pSubpasses = &subpass;
-    
-    VkSubpassDependency dependency{};
-    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.srcAccessMask = 0;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    
-    renderPassCreateInfo.dependencyCount = 1;
-    renderPassCreateInfo.pDependencies = &dependency;
-    
-    if (vkCreateRenderPass(vkDevice, &renderPassCreateInfo, nullptr, &vkRenderPass) != VK_SUCCESS){
+bool Rovski::CreateCullPipeline() {
+    ROVSKI_CPU_FUNCTION();
+    VkShaderModule cullShaderModule;
+    if (!CreateShaderModule(ROVSKI_SHADER_DIR "cull.spv", cullShaderModule)) {
+        return false;
+    }
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    // the phase, everything else is in the uniform ring
+    pushConstantRange.size = sizeof(uint32_t);
+    VkPipelineLayoutCreateInfo layoutCreateInfo{};
+    layoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutCreateInfo.setLayoutCount = 1;
+    layoutCreateInfo.pSetLayouts = &vkCullSetLayout;
+    layoutCreateInfo.pushConstantRangeCount = 1;
+    layoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(vkDevice, &layoutCreateInfo, nullptr, &vkCullPipelineLayout) != VK_SUCCESS) {
+        vkDestroyShaderModule(vkDevice, cullShaderModule, nullptr);
+        return false;
+    }
+    VkComputePipelineCreateInfo pipelineCreateInfo{};
+    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineCreateInfo.stage.module = cullShaderModule;
+    pipelineCreateInfo.stage.pName = "main";
+    pipelineCreateInfo.layout = vkCullPipelineLayout;
+    VkResult result = vkCreateComputePipelines(vkDevice, pipelineCache.Handle(), 1, &pipelineCreateInfo, nullptr, &vkCullPipeline);
+    vkDestroyShaderModule(vkDevice, cullShaderModule, nullptr);
+    if (result != VK_SUCCESS) {
         return false;
     }
-    
-    return true;
-}
 
-bool Rovski::CreateFrameBuffer() {
-    vkSwapChainFrameBuffers.resize(vkSwapChainImageViews.size());
-    
+    // a cull set and an object set per frame in flight and the depth reduce sets, written whenever what they
+    // point at is recreated
+    std::array<VkDescriptorPoolSize, 4> poolSizes{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[0].descriptorCount = maxFrameInFlight * 6;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    poolSizes[1].descriptorCount = maxFrameInFlight;
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[2].descriptorCount = maxFrameInFlight + maxDepthPyramidLevels;
+    poolSizes[3].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[3].descriptorCount = maxDepthPyramidLevels;
+    VkDescriptorPoolCreateInfo poolCreateInfo{};
+    poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolCreateInfo.pPoolSizes = poolSizes.data();
+    poolCreateInfo.maxSets = maxFrameInFlight * 2 + maxDepthPyramidLevels;
+    if (vkCreateDescriptorPool(vkDevice, &poolCreateInfo, nullptr, &vkGpuDrivenDescriptorPool) != VK_SUCCESS) {
+        return false;
+    }
+    std::vector<VkDescriptorSetLayout> setLayouts(maxFrameInFlight, vkCullSetLayout);
+    setLayouts.resize(maxFrameInFlight * 2, vkObjectSetLayout);
+    std::vector<VkDescriptorSet> sets(setLayouts.size());
+    VkDescriptorSetAllocateInfo allocateInfo{};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocateInfo.descriptorPool = vkGpuDrivenDescriptorPool;
+    allocateInfo.descriptorSetCount = static_cast<uint32_t>(setLayouts.size());
+    allocateInfo.pSetLayouts = setLayouts.data();
+    if (vkAllocateDescriptorSets(vkDevice, &allocateInfo, sets.data()) != VK_SUCCESS) {
+        return false;
+    }
+    vkObjectDescriptorSets.assign(sets.begin() + maxFrameInFlight, sets.end());
+    sets.resize(maxFrameInFlight);
+    vkCullDescriptorSets = std::move(sets);
+    vkIndirectBuffers.resize(maxFrameInFlight);
+    indirectBufferMemory.resize(maxFrameInFlight);
+    vkIndirectCountBuffers.resize(maxFrameInFlight);
+    indirectCountBufferMemory.resize(maxFrameInFlight);
+    frameGpuObjectUpload.assign(maxFrameInFlight, 0);
+    return true;
+}
+
+bool Rovski::CreateDepthReducePipeline() {
+    ROVSKI_CPU_FUNCTION();
+    VkShaderModule reduceShaderModule;
+    if (!CreateShaderModule(ROVSKI_SHADER_DIR "depth_reduce.spv", reduceShaderModule)) {
+        return false;
+    }
+    // source and destination size
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(int32_t) * 4;
+    VkPipelineLayoutCreateInfo layoutCreateInfo{};
+    layoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutCreateInfo.setLayoutCount = 1;
+    layoutCreateInfo.pSetLayouts = &vkDepthReduceSetLayout;
+    layoutCreateInfo.pushConstantRangeCount = 1;
+    layoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(vkDevice, &layoutCreateInfo, nullptr, &vkDepthReducePipelineLayout) != VK_SUCCESS) {
+        vkDestroyShaderModule(vkDevice, reduceShaderModule, nullptr);
+        return false;
+    }
+    VkComputePipelineCreateInfo pipelineCreateInfo{};
+    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineCreateInfo.stage.module = reduceShaderModule;
+    pipelineCreateInfo.stage.pName = "main";
+    pipelineCreateInfo.layout = vkDepthReducePipelineLayout;
+    VkResult result = vkCreateComputePipelines(vkDevice, pipelineCache.Handle(), 1, &pipelineCreateInfo, nullptr, &vkDepthReducePipeline);
+    vkDestroyShaderModule(vkDevice, reduceShaderModule, nullptr);
+    if (result != VK_SUCCESS) {
+        return false;
+    }
+    // both shaders fetch texels, the sampler only has to exist
+    VkSamplerCreateInfo samplerCreateInfo{};
+    samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+    samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+    samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+    if (vkCreateSampler(vkDevice, &samplerCreateInfo, nullptr, &vkDepthPyramidSampler) != VK_SUCCESS) {
+        return false;
+    }
+    std::vector<VkDescriptorSetLayout> setLayouts(maxDepthPyramidLevels, vkDepthReduceSetLayout);
+    vkDepthReduceSets.resize(maxDepthPyramidLevels);
+    VkDescriptorSetAllocateInfo allocateInfo{};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocateInfo.descriptorPool = vkGpuDrivenDescriptorPool;
+    allocateInfo.descriptorSetCount = maxDepthPyramidLevels;
+    allocateInfo.pSetLayouts = setLayouts.data();
+    return vkAllocateDescriptorSets(vkDevice, &allocateInfo, vkDepthReduceSets.data()) == VK_SUCCESS;
+}
+
+bool Rovski::CreateDepthPyramid() {
+    ROVSKI_CPU_FUNCTION();
+    if (occlusionCullingSupported) {
+        // rounded down to a power of two so every level after the first halves exactly
+        depthPyramidExtent = {std::bit_floor(vkSwapChainExtent.width), std::bit_floor(vkSwapChainExtent.height)};
+        depthPyramidLevels = std::min(static_cast<uint32_t>(std::bit_width(std::max(depthPyramidExtent.width, depthPyramidExtent.height))),
+                                      maxDepthPyramidLevels);
+        if (!CreateImage(depthPyramidExtent.width, depthPyramidExtent.height, VK_FORMAT_R32_SFLOAT, VK_IMAGE_TILING_OPTIMAL,
+                         VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                         vkDepthPyramid, depthPyramidMemory, depthPyramidLevels)) {
+            return false;
+        }
+        vkDepthPyramidView = CreateImageView(vkDepthPyramid, VK_FORMAT_R32_SFLOAT, depthPyramidLevels);
+        if (vkDepthPyramidView == VK_NULL_HANDLE) {
+            return false;
+        }
+        vkDepthPyramidLevelViews.resize(depthPyramidLevels);
+        for (uint32_t level = 0; level < depthPyramidLevels; level++) {
+            vkDepthPyramidLevelViews[level] = CreateImageView(vkDepthPyramid, VK_FORMAT_R32_SFLOAT, 1, level);
+            if (vkDepthPyramidLevelViews[level] == VK_NULL_HANDLE) {
+                return false;
+            }
+        }
+        std::vector<VkDescriptorImageInfo> imageInfos(depthPyramidLevels * 2);
+        std::vector<VkWriteDescriptorSet> writes(depthPyramidLevels * 2);
+        for (uint32_t level = 0; level < depthPyramidLevels; level++) {
+            VkDescriptorImageInfo &source = imageInfos[level * 2];
+            source.sampler = vkDepthPyramidSampler;
+            source.imageView = level == 0 ? vkDepthSampleView : vkDepthPyramidLevelViews[level - 1];
+            source.imageLayout = level == 0 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+            VkDescriptorImageInfo &destination = imageInfos[level * 2 + 1];
+            destination.imageView = vkDepthPyramidLevelViews[level];
+            destination.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+            for (uint32_t binding = 0; binding < 2; binding++) {
+                VkWriteDescriptorSet &write = writes[level * 2 + binding];
+                write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                write.dstSet = vkDepthReduceSets[level];
+                write.dstBinding = binding;
+                write.descriptorCount = 1;
+                write.descriptorType = binding == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+                write.pImageInfo = &imageInfos[level * 2 + binding];
+            }
+        }
+        vkUpdateDescriptorSets(vkDevice, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+    WriteCullFrameDescriptors();
+    return true;
+}
+
+void Rovski::DestroyDepthPyramid() {
+    for (VkImageView view : vkDepthPyramidLevelViews) {
+        vkDestroyImageView(vkDevice, view, nullptr);
+    }
+    vkDepthPyramidLevelViews.clear();
+    vkDestroyImageView(vkDevice, vkDepthPyramidView, nullptr);
+    vkDepthPyramidView = VK_NULL_HANDLE;
+    if (vkDepthPyramid != VK_NULL_HANDLE) {
+        DestroyImage(vkDepthPyramid, depthPyramidMemory);
+    }
+}
+
+void Rovski::WriteCullFrameDescriptors() {
+    // the uniform ring and the pyramid, the placeholder stands in for the pyramid where occlusion culling can't run
+    VkDescriptorBufferInfo bufferInfo{vkUniformBuffer, 0, sizeof(CullData)};
+    VkDescriptorImageInfo imageInfo{};
+    if (vkDepthPyramidView != VK_NULL_HANDLE) {
+        imageInfo.sampler = vkDepthPyramidSampler;
+        imageInfo.imageView = vkDepthPyramidView;
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    } else {
+        imageInfo.sampler = vkTextureSampler;
+        imageInfo.imageView = placeholderTexture.view;
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
+    std::vector<VkWriteDescriptorSet> writes(maxFrameInFlight * 2);
+    for (uint32_t i = 0; i < maxFrameInFlight; i++) {
+        VkWriteDescriptorSet &uniformWrite = writes[i * 2];
+        uniformWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        uniformWrite.dstSet = vkCullDescriptorSets[i];
+        uniformWrite.dstBinding = 5;
+        uniformWrite.descriptorCount = 1;
+        uniformWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        uniformWrite.pBufferInfo = &bufferInfo;
+        VkWriteDescriptorSet &pyramidWrite = writes[i * 2 + 1];
+        pyramidWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        pyramidWrite.dstSet = vkCullDescriptorSets[i];
+        pyramidWrite.dstBinding = 6;
+        pyramidWrite.descriptorCount = 1;
+        pyramidWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        pyramidWrite.pImageInfo = &imageInfo;
+    }
+    vkUpdateDescriptorSets(vkDevice, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+VkFormat Rovski::FindDepthFormat() const {
+    // 32 bit float first, reverse-Z spends its precision best there
+    const VkFormat candidates[] = {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_X8_D24_UNORM_PACK32, VK_FORMAT_D24_UNORM_S8_UINT};
+    for (VkFormat format : candidates) {
+        VkFormatProperties properties{};
+        vkGetPhysicalDeviceFormatProperties(vkPhysicalDevice, format, &properties);
+        if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+            return format;
+        }
+    }
+    return VK_FORMAT_UNDEFINED;
+}
+
+bool Rovski::CreateDepthResources() {
+    ROVSKI_CPU_FUNCTION();
+    // the render pass is built against the format, which doesn't change with the swapchain
+    if (vkDepthFormat == VK_FORMAT_UNDEFINED) {
+        vkDepthFormat = FindDepthFormat();
+        if (vkDepthFormat == VK_FORMAT_UNDEFINED) {
+            return false;
+        }
+        // the depth pyramid samples depth; the R32 float storage image it writes is core
+        VkFormatProperties properties{};
+        vkGetPhysicalDeviceFormatProperties(vkPhysicalDevice, vkDepthFormat, &properties);
+        occlusionCullingSupported = gpuDrivenSupported && (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+    }
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    if (occlusionCullingSupported) {
+        usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+    }
+    if (!CreateImage(vkSwapChainExtent.width, vkSwapChainExtent.height, vkDepthFormat, VK_IMAGE_TILING_OPTIMAL,
+                     usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vkDepthImage, depthImageMemory)) {
+        return false;
+    }
+    // attachment views of combined formats cover both aspects
+    VkImageAspectFlags aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    if (vkDepthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT || vkDepthFormat == VK_FORMAT_D24_UNORM_S8_UINT) {
+        aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+    vkDepthImageView = CreateImageView(vkDepthImage, vkDepthFormat, 1, 0, aspect);
+    if (occlusionCullingSupported) {
+        vkDepthSampleView = CreateImageView(vkDepthImage, vkDepthFormat, 1, 0, VK_IMAGE_ASPECT_DEPTH_BIT);
+        if (vkDepthSampleView == VK_NULL_HANDLE) {
+            return false;
+        }
+    }
+    return vkDepthImageView != VK_NULL_HANDLE;
+}
+
+bool Rovski::CreateRenderPass() {
+    ROVSKI_CPU_FUNCTION();
+    VkAttachmentDescription colorAttachment{};
+    colorAttachment.format = vkSwapChainFormat;
+    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    colorAttachment.finalLayout = headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    
+    // depth only lives for the pass: cleared on load, never stored
+    VkAttachmentDescription depthAttachment{};
+    depthAttachment.format = vkDepthFormat;
+    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference colorAttachmentRef{};
+    colorAttachmentRef.attachment = 0;
+    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    VkAttachmentReference depthAttachmentRef{};
+    depthAttachmentRef.attachment = 1;
+    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorAttachmentRef;
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
+    
+    std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
+    VkRenderPassCreateInfo renderPassCreateInfo {};
+    renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    renderPassCreateInfo.pAttachments = attachments.data();
+    renderPassCreateInfo.subpassCount = 1;
+    renderPassCreateInfo.pSubpasses = &subpass;
+    
+    VkSubpassDependency dependency{};
+    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependency.dstSubpass = 0;
+    // the depth image is shared by the frames in flight, the previous frame's depth tests have to finish first
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                               VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    
+    renderPassCreateInfo.dependencyCount = 1;
+    renderPassCreateInfo.pDependencies = &dependency;
+    
+    if (vkCreateRenderPass(vkDevice, &renderPassCreateInfo, nullptr, &vkRenderPass) != VK_SUCCESS){
+        return false;
+    }
+    if (!occlusionCullingSupported) {
+        return true;
+    }
+
+    // Occlusion culling splits the frame around the depth pyramid. The early pass stores depth and leaves it
+    // readable for the pyramid's compute pass, the late pass loads both attachments and ends like the pass above.
+    // All three are compatible, the pipelines and framebuffers serve them all
+    const VkImageLayout presentLayout = colorAttachment.finalLayout;
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    VkSubpassDependency pyramidDependency{};
+    pyramidDependency.srcSubpass = 0;
+    pyramidDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+    pyramidDependency.srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    pyramidDependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    pyramidDependency.dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    pyramidDependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    std::array<VkSubpassDependency, 2> earlyDependencies = {dependency, pyramidDependency};
+    attachments = {colorAttachment, depthAttachment};
+    renderPassCreateInfo.dependencyCount = static_cast<uint32_t>(earlyDependencies.size());
+    renderPassCreateInfo.pDependencies = earlyDependencies.data();
+    if (vkCreateRenderPass(vkDevice, &renderPassCreateInfo, nullptr, &vkEarlyRenderPass) != VK_SUCCESS) {
+        return false;
+    }
+
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.finalLayout = presentLayout;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    // the early pass's color and the pyramid's reads of depth come first
+    VkSubpassDependency lateDependency{};
+    lateDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    lateDependency.dstSubpass = 0;
+    lateDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    lateDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    lateDependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    lateDependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                   VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    attachments = {colorAttachment, depthAttachment};
+    renderPassCreateInfo.dependencyCount = 1;
+    renderPassCreateInfo.pDependencies = &lateDependency;
+    return vkCreateRenderPass(vkDevice, &renderPassCreateInfo, nullptr, &vkLateRenderPass) == VK_SUCCESS;
+}
+
+bool Rovski::CreateFrameBuffer() {
+    ROVSKI_CPU_FUNCTION();
+    vkSwapChainFrameBuffers.resize(vkSwapChainImageViews.size());
+    
     for (int i = 0; i < vkSwapChainImageViews.size(); i++) {
         VkImageView attachments[] = {
-            vkSwapChainImageViews[i]
+            vkSwapChainImageViews[i],
+            vkDepthImageView
         };
         VkFramebufferCreateInfo frameBufferCreateInfo{};
         frameBufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
         frameBufferCreateInfo.renderPass = vkRenderPass;
-        frameBufferCreateInfo.attachmentCount = 1;
+        frameBufferCreateInfo.attachmentCount = 2;
         frameBufferCreateInfo.pAttachments = attachments;
         frameBufferCreateInfo.width = vkSwapChainExtent.width;
         frameBufferCreateInfo.height = vkSwapChainExtent.height;
@@ -821,67 +1962,435 @@ bool Rovski::CreateFrameBuffer() {
 }
 
 bool Rovski::CreateCommandPool() {
+    ROVSKI_CPU_FUNCTION();
     QueueFamilyIndices queueFamilyIndices = FindQueueFamilies(vkPhysicalDevice);
     VkCommandPoolCreateInfo commandPoolCreateInfo{};
     commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     commandPoolCreateInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
-    commandPoolCreateInfo.flags = 0;
+    commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
     
     if (vkCreateCommandPool(vkDevice, &commandPoolCreateInfo, nullptr, &vkCommandPool) != VK_SUCCESS){
         return false;
     }
-    commandPoolCreateInfo.queueFamilyIndex = queueFamilyIndices.transferFamily.value();
-    commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
-    return vkCreateCommandPool(vkDevice, &commandPoolCreateInfo, nullptr, &vkTransferCommandPool) == VK_SUCCESS;
+    // one pool per frame in flight, reset as a whole once the frame's fence is signaled
+    vkFrameCommandPools.resize(maxFrameInFlight);
+    for (uint32_t i = 0; i < maxFrameInFlight; i++) {
+        if (vkCreateCommandPool(vkDevice, &commandPoolCreateInfo, nullptr, &vkFrameCommandPools[i]) != VK_SUCCESS){
+            return false;
+        }
+    }
+    // command pools are externally synchronized, so every recording thread gets its own per frame
+    threadRecordContexts.resize(maxFrameInFlight * jobSystem->ThreadCount());
+    for (auto &context : threadRecordContexts) {
+        if (vkCreateCommandPool(vkDevice, &commandPoolCreateInfo, nullptr, &context.pool) != VK_SUCCESS){
+            return false;
+        }
+    }
+    return true;
 }
 
 bool Rovski::CreateCommandBuffer() {
-    vkCommandBuffer.resize(vkSwapChainFrameBuffers.size());
-    VkCommandBufferAllocateInfo commandBufferAllocInfo{};
-    commandBufferAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    commandBufferAllocInfo.commandBufferCount = static_cast<uint32_t>(vkCommandBuffer.size());
-    commandBufferAllocInfo.commandPool = vkCommandPool;
-    commandBufferAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    
-    if(vkAllocateCommandBuffers(vkDevice, &commandBufferAllocInfo, vkCommandBuffer.data()) != VK_SUCCESS) {
-        return false;
-    }
-    
-    for (int i = 0; i < vkCommandBuffer.size(); i++) {
-        VkCommandBufferBeginInfo commandBufferBeginInfo{};
-        commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        commandBufferBeginInfo.flags = 0;
-        commandBufferBeginInfo.pInheritanceInfo = nullptr;
-        if (vkBeginCommandBuffer(vkCommandBuffer[i], &commandBufferBeginInfo) != VK_SUCCESS) {
+    ROVSKI_CPU_FUNCTION();
+    vkFrameCommandBuffers.resize(maxFrameInFlight);
+    for (uint32_t i = 0; i < maxFrameInFlight; i++) {
+        VkCommandBufferAllocateInfo commandBufferAllocInfo{};
+        commandBufferAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        commandBufferAllocInfo.commandBufferCount = 1;
+        commandBufferAllocInfo.commandPool = vkFrameCommandPools[i];
+        commandBufferAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        if(vkAllocateCommandBuffers(vkDevice, &commandBufferAllocInfo, &vkFrameCommandBuffers[i]) != VK_SUCCESS) {
             return false;
         }
-        
-        VkRenderPassBeginInfo renderPassBeginInfo{};
-        renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassBeginInfo.renderPass = vkRenderPass;
-        renderPassBeginInfo.framebuffer = vkSwapChainFrameBuffers[i];
-        renderPassBeginInfo.renderArea.offset = {0,0};
-        renderPassBeginInfo.renderArea.extent = vkSwapChainExtent;
-        
-        VkClearValue clearValue{0.0f,0.0f,0.0f,1.0f};
-        renderPassBeginInfo.clearValueCount = 1;
-        renderPassBeginInfo.pClearValues = &clearValue;
-        vkCmdBeginRenderPass(vkCommandBuffer[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-        vkCmdBindPipeline(vkCommandBuffer[i], VK_PIPELINE_BIND_POINT_GRAPHICS, vkGraphicsPipeline);
-        VkBuffer vertexBuffers[] = {vkVertexBuffer};
-        VkDeviceSize offsets[] = {0};
-        vkCmdBindVertexBuffers(vkCommandBuffer[i], 0, 1, vertexBuffers, offsets);
-        vkCmdBindIndexBuffer(vkCommandBuffer[i], vkIndexBuffer, 0, VK_INDEX_TYPE_UINT16);
-        vkCmdBindDescriptorSets(vkCommandBuffer[i], VK_PIPELINE_BIND_POINT_GRAPHICS, vkPipelineLayout, 0, 1, &vkDescriptorSet[i], 0, nullptr);
-        vkCmdDrawIndexed(vkCommandBuffer[i], static_cast<uint32_t>(Indexes.size()), 1, 0, 0, 0);
-        vkCmdEndRenderPass(vkCommandBuffer[i]);
-        vkEndCommandBuffer(vkCommandBuffer[i]);
     }
-    
     return true;
 }
 
+bool Rovski::RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+    ROVSKI_CPU_FUNCTION();
+    VkCommandBufferBeginInfo commandBufferBeginInfo{};
+    commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    commandBufferBeginInfo.pInheritanceInfo = nullptr;
+    if (vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo) != VK_SUCCESS) {
+        return false;
+    }
+    gpuProfiler.BeginFrame(commandBuffer, static_cast<uint32_t>(currentFrame), frameStats.frameIndex);
+    uint32_t frameScope = gpuProfiler.BeginScope(commandBuffer, "frame");
+    const bool indirect = gpuDriven;
+    const bool occlusion = indirect && occlusionCulling;
+    const CullPhase firstPhase = occlusion ? CullPhase::Early : CullPhase::Single;
+    uint32_t cullOffset = 0;
+    if (indirect) {
+        cullOffset = RecordGpuCulling(commandBuffer, firstPhase);
+    }
+
+    VkRenderPassBeginInfo renderPassBeginInfo{};
+    renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassBeginInfo.renderPass = occlusion ? vkEarlyRenderPass : vkRenderPass;
+    renderPassBeginInfo.framebuffer = vkSwapChainFrameBuffers[imageIndex];
+    renderPassBeginInfo.renderArea.offset = {0,0};
+    renderPassBeginInfo.renderArea.extent = vkSwapChainExtent;
+
+    // reverse-Z: the far plane is 0
+    std::array<VkClearValue, 2> clearValues{};
+    clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+    clearValues[1].depthStencil = {0.0f, 0};
+    renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+    renderPassBeginInfo.pClearValues = clearValues.data();
+
+    uint32_t drawCount = indirect ? 0 : static_cast<uint32_t>(visibleDraws.size());
+    uint32_t threadCount = jobSystem->ThreadCount();
+    // about four slices per thread so stealing can even out uneven slices
+    uint32_t grain = std::max(minDrawsPerSecondary, (drawCount + threadCount * 4 - 1) / (threadCount * 4));
+    bool inlineDraws = threadCount == 1 || drawCount <= grain;
+    // a statistics query may only stay open across secondaries when the device can inherit it
+    uint32_t passScope = gpuProfiler.BeginScope(commandBuffer, "main pass", inlineDraws || gpuProfiler.InheritedQueriesSupported());
+    const bool prepass = depthPrepass;
+    const DrawPass colorPass = prepass ? DrawPass::ColorOnDepth : DrawPass::Color;
+    if (prepass) {
+        drawUniformOffsets.resize(drawCount);
+    }
+    // view and projection alone, for draws whose model comes from the object buffer, the instance stream or a push constant
+    uint32_t uniformOffset = 0;
+    if (indirect || instanceCount > 0 || bindless) {
+        UniformBufferObject ubo{glm::mat4(1), frameView, frameProjection};
+        uniformOffset = uniformRing.Push(ubo);
+    }
+    if (indirect) {
+        // a handful of calls whatever the draw count, recording them on the workers would not pay
+        frameStats.recordThreads = 1;
+        vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+        // the instances go with the first phase, they are never culled
+        if (prepass) {
+            RecordIndirectDraws(commandBuffer, DrawPass::Depth, uniformOffset, firstPhase);
+            RecordInstances(commandBuffer, DrawPass::Depth, uniformOffset);
+        }
+        RecordIndirectDraws(commandBuffer, colorPass, uniformOffset, firstPhase);
+        RecordInstances(commandBuffer, colorPass, uniformOffset);
+        if (occlusion) {
+            vkCmdEndRenderPass(commandBuffer);
+            RecordDepthPyramid(commandBuffer);
+            uint32_t lateScope = gpuProfiler.BeginScope(commandBuffer, "late cull");
+            RecordCullDispatch(commandBuffer, CullPhase::Late, cullOffset);
+            gpuProfiler.EndScope(commandBuffer, lateScope);
+            renderPassBeginInfo.renderPass = vkLateRenderPass;
+            vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+            if (prepass) {
+                RecordIndirectDraws(commandBuffer, DrawPass::Depth, uniformOffset, CullPhase::Late);
+            }
+            RecordIndirectDraws(commandBuffer, colorPass, uniformOffset, CullPhase::Late);
+        }
+    } else if (inlineDraws) {
+        frameStats.recordThreads = 1;
+        vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+        if (prepass) {
+            RecordDrawRange(commandBuffer, 0, drawCount, DrawPass::Depth, uniformOffset);
+            RecordInstances(commandBuffer, DrawPass::Depth, uniformOffset);
+        }
+        RecordDrawRange(commandBuffer, 0, drawCount, colorPass, uniformOffset);
+        RecordInstances(commandBuffer, colorPass, uniformOffset);
+    } else {
+        vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        // with the prepass, every slice's depth secondary goes before all the color ones
+        const uint32_t chunkCount = (drawCount + grain - 1) / grain;
+        chunkCommandBuffers.assign(prepass ? chunkCount * 2 : chunkCount, VK_NULL_HANDLE);
+        VkCommandBufferInheritanceInfo inheritanceInfo{};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass = vkRenderPass;
+        inheritanceInfo.subpass = 0;
+        inheritanceInfo.framebuffer = vkSwapChainFrameBuffers[imageIndex];
+        inheritanceInfo.pipelineStatistics = gpuProfiler.ActiveStatistics();
+        std::atomic<uint64_t> threadMask{0};
+        jobSystem->ParallelFor(drawCount, grain, [&](uint32_t begin, uint32_t end, uint32_t threadIndex) {
+            VkCommandBufferBeginInfo secondaryBeginInfo{};
+            secondaryBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            secondaryBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+            secondaryBeginInfo.pInheritanceInfo = &inheritanceInfo;
+            if (prepass) {
+                VkCommandBuffer depthSecondary = AcquireSecondaryCommandBuffer(threadIndex);
+                vkBeginCommandBuffer(depthSecondary, &secondaryBeginInfo);
+                RecordDrawRange(depthSecondary, begin, end, DrawPass::Depth, uniformOffset);
+                vkEndCommandBuffer(depthSecondary);
+                chunkCommandBuffers[begin / grain] = depthSecondary;
+            }
+            VkCommandBuffer secondary = AcquireSecondaryCommandBuffer(threadIndex);
+            vkBeginCommandBuffer(secondary, &secondaryBeginInfo);
+            RecordDrawRange(secondary, begin, end, colorPass, uniformOffset);
+            vkEndCommandBuffer(secondary);
+            chunkCommandBuffers[(prepass ? chunkCount : 0) + begin / grain] = secondary;
+            threadMask.fetch_or(1ull << (threadIndex % 64), std::memory_order_relaxed);
+        });
+        frameStats.recordThreads = std::popcount(threadMask.load());
+        if (instanceCount > 0) {
+            // one more secondary per pass for the instanced draw, after the draw list's
+            VkCommandBufferBeginInfo secondaryBeginInfo{};
+            secondaryBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            secondaryBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+            secondaryBeginInfo.pInheritanceInfo = &inheritanceInfo;
+            if (prepass) {
+                VkCommandBuffer depthSecondary = AcquireSecondaryCommandBuffer(JobSystem::CurrentThreadIndex());
+                vkBeginCommandBuffer(depthSecondary, &secondaryBeginInfo);
+                RecordInstances(depthSecondary, DrawPass::Depth, uniformOffset);
+                vkEndCommandBuffer(depthSecondary);
+                chunkCommandBuffers.insert(chunkCommandBuffers.begin() + chunkCount, depthSecondary);
+            }
+            VkCommandBuffer secondary = AcquireSecondaryCommandBuffer(JobSystem::CurrentThreadIndex());
+            vkBeginCommandBuffer(secondary, &secondaryBeginInfo);
+            RecordInstances(secondary, colorPass, uniformOffset);
+            vkEndCommandBuffer(secondary);
+            chunkCommandBuffers.push_back(secondary);
+        }
+        vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(chunkCommandBuffers.size()), chunkCommandBuffers.data());
+    }
+    vkCmdEndRenderPass(commandBuffer);
+    gpuProfiler.EndScope(commandBuffer, passScope);
+    if (NeedReadback()) {
+        uint32_t readbackScope = gpuProfiler.BeginScope(commandBuffer, "readback");
+        RecordReadback(commandBuffer, imageIndex);
+        gpuProfiler.EndScope(commandBuffer, readbackScope);
+    }
+    gpuProfiler.EndScope(commandBuffer, frameScope);
+    return vkEndCommandBuffer(commandBuffer) == VK_SUCCESS;
+}
+
+void Rovski::BindDrawState(VkCommandBuffer commandBuffer, VkPipeline pipeline) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    // dynamic state is not inherited by secondary command buffers, every range sets its own
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(vkSwapChainExtent.width);
+    viewport.height = static_cast<float>(vkSwapChainExtent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    VkRect2D scissor{};
+    scissor.offset = {0, 0};
+    scissor.extent = vkSwapChainExtent;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    VkBuffer vertexBuffers[] = {vkVertexBuffer};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, vkIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+}
+
+void Rovski::RecordDrawRange(VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end, DrawPass pass, uint32_t uniformOffset) {
+    ROVSKI_CPU_FUNCTION();
+    if (bindless) {
+        // the sets go on once for the whole range, each draw only pushes its model and texture index
+        BindDrawState(commandBuffer, pass == DrawPass::Depth ? vkBindlessPrepassPipeline : pass == DrawPass::ColorOnDepth ? vkBindlessEqualPipeline : vkBindlessPipeline);
+        BindBindlessSets(commandBuffer, uniformOffset);
+        for (uint32_t i = begin; i < end; i++) {
+            const DrawCommand &draw = drawList[visibleDraws[i]];
+            BindlessConstants constants{draw.model, draw.texture};
+            vkCmdPushConstants(commandBuffer, vkBindlessPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, offsetof(BindlessConstants, objectBuffer), &constants);
+            vkCmdDrawIndexed(commandBuffer, draw.indexCount, 1, draw.firstIndex, draw.vertexOffset, 0);
+        }
+        return;
+    }
+    BindDrawState(commandBuffer, pass == DrawPass::Depth ? vkDepthPrepassPipeline : pass == DrawPass::ColorOnDepth ? vkDepthEqualPipeline : vkGraphicsPipeline);
+    for (uint32_t i = begin; i < end; i++) {
+        const DrawCommand &draw = drawList[visibleDraws[i]];
+        uint32_t drawUniformOffset;
+        if (pass == DrawPass::ColorOnDepth) {
+            drawUniformOffset = drawUniformOffsets[i];
+        } else {
+            UniformBufferObject ubo{draw.model, frameView, frameProjection};
+            drawUniformOffset = uniformRing.Push(ubo);
+            if (pass == DrawPass::Depth) {
+                drawUniformOffsets[i] = drawUniformOffset;
+            }
+        }
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vkPipelineLayout, 0, 1,
+                                &textures[draw.texture].descriptorSet, 1, &drawUniformOffset);
+        vkCmdDrawIndexed(commandBuffer, draw.indexCount, 1, draw.firstIndex, draw.vertexOffset, 0);
+    }
+}
+
+void Rovski::BindBindlessSets(VkCommandBuffer commandBuffer, uint32_t uniformOffset) {
+    // set 0 only carries the uniform block, any texture's set would do
+    VkDescriptorSet sets[] = {placeholderTexture.descriptorSet, vkBindlessSets[currentFrame]};
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vkBindlessPipelineLayout, 0, 2, sets, 1, &uniformOffset);
+}
+
+void Rovski::RecordInstances(VkCommandBuffer commandBuffer, DrawPass pass, uint32_t uniformOffset) {
+    ROVSKI_CPU_FUNCTION();
+    if (instanceCount == 0) {
+        return;
+    }
+    BindDrawState(commandBuffer, pass == DrawPass::Depth ? vkInstancedPrepassPipeline : pass == DrawPass::ColorOnDepth ? vkInstancedEqualPipeline : vkInstancedPipeline);
+    // BindDrawState put the shared vertex buffer on binding 0, the instance stream goes next to it
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(commandBuffer, Instance::BindingIndex, 1, &vkInstanceBuffers[currentFrame], &offset);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vkPipelineLayout, 0, 1,
+                            &textures[instancedTexture].descriptorSet, 1, &uniformOffset);
+    vkCmdDrawIndexed(commandBuffer, instancedMesh.indexCount, instanceCount, instancedMesh.firstIndex, instancedMesh.vertexOffset, 0);
+}
+
+uint32_t Rovski::RecordGpuCulling(VkCommandBuffer commandBuffer, CullPhase phase) {
+    ROVSKI_CPU_FUNCTION();
+    uint32_t cullScope = gpuProfiler.BeginScope(commandBuffer, "cull");
+    // the frame before may still be culling or drawing with the old objects, and its late phase writes the
+    // visibility this one reads
+    if (!dirtyObjects.empty() || phase != CullPhase::Single) {
+        VkMemoryBarrier previousBarrier{};
+        previousBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        previousBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        previousBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &previousBarrier, 0, nullptr, 0, nullptr);
+    }
+    for (uint32_t draw : dirtyObjects) {
+        GpuObject object = MakeGpuObject(drawList[draw], textureBatches[bindless ? 0 : drawList[draw].texture]);
+        vkCmdUpdateBuffer(commandBuffer, vkObjectBuffer, VkDeviceSize(draw) * sizeof(GpuObject), sizeof(GpuObject), &object);
+        objectDirty[draw] = 0;
+    }
+    dirtyObjects.clear();
+    // nothing visible yet, the late phase draws and marks whatever it finds
+    if (visibilityStale && phase != CullPhase::Single) {
+        vkCmdFillBuffer(commandBuffer, vkVisibilityBuffer, 0, VK_WHOLE_SIZE, 0);
+        visibilityStale = false;
+    }
+    vkCmdFillBuffer(commandBuffer, vkIndirectCountBuffers[currentFrame], 0, VK_WHOLE_SIZE, 0);
+    VkMemoryBarrier writeBarrier{};
+    writeBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    writeBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    writeBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                         0, 1, &writeBarrier, 0, nullptr, 0, nullptr);
+
+    CullData cullData{};
+    if (frustumCulling) {
+        Frustum frustum = ExtractFrustum(frameProjection * frameView);
+        std::copy(std::begin(frustum.planes), std::end(frustum.planes), cullData.planes);
+    } else {
+        // planes every object passes
+        std::fill(std::begin(cullData.planes), std::end(cullData.planes), glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    }
+    cullData.view = frameView;
+    cullData.projection = glm::vec4(frameProjection[0][0], frameProjection[1][1], frameProjection[3][2], 0.0f);
+    cullData.pyramidSize = glm::vec2(depthPyramidExtent.width, depthPyramidExtent.height);
+    cullData.objectCount = static_cast<uint32_t>(drawList.size());
+    cullData.pyramidLevels = depthPyramidLevels;
+    cullData.lateCommandBase = objectCapacity;
+    cullData.lateCountBase = batchCapacity;
+    uint32_t cullOffset = uniformRing.Push(cullData);
+    RecordCullDispatch(commandBuffer, phase, cullOffset);
+    gpuProfiler.EndScope(commandBuffer, cullScope);
+    return cullOffset;
+}
+
+void Rovski::RecordCullDispatch(VkCommandBuffer commandBuffer, CullPhase phase, uint32_t cullOffset) {
+    const uint32_t objectCount = static_cast<uint32_t>(drawList.size());
+    const uint32_t phaseIndex = static_cast<uint32_t>(phase);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, vkCullPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, vkCullPipelineLayout, 0, 1,
+                            &vkCullDescriptorSets[currentFrame], 1, &cullOffset);
+    vkCmdPushConstants(commandBuffer, vkCullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &phaseIndex);
+    if (objectCount > 0) {
+        vkCmdDispatch(commandBuffer, (objectCount + cullGroupSize - 1) / cullGroupSize, 1, 1);
+    }
+    VkMemoryBarrier indirectBarrier{};
+    indirectBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    indirectBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    indirectBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                         0, 1, &indirectBarrier, 0, nullptr, 0, nullptr);
+}
+
+void Rovski::RecordDepthPyramid(VkCommandBuffer commandBuffer) {
+    ROVSKI_CPU_FUNCTION();
+    uint32_t pyramidScope = gpuProfiler.BeginScope(commandBuffer, "depth pyramid");
+    // every level is rewritten, the previous frame's late cull only has to be done reading
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = vkDepthPyramid;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, depthPyramidLevels, 0, 1};
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, vkDepthReducePipeline);
+    VkExtent2D source = vkSwapChainExtent;
+    for (uint32_t level = 0; level < depthPyramidLevels; level++) {
+        VkExtent2D destination = {std::max(depthPyramidExtent.width >> level, 1u), std::max(depthPyramidExtent.height >> level, 1u)};
+        const int32_t sizes[4] = {static_cast<int32_t>(source.width), static_cast<int32_t>(source.height),
+                                  static_cast<int32_t>(destination.width), static_cast<int32_t>(destination.height)};
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, vkDepthReducePipelineLayout, 0, 1,
+                                &vkDepthReduceSets[level], 0, nullptr);
+        vkCmdPushConstants(commandBuffer, vkDepthReducePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(sizes), sizes);
+        vkCmdDispatch(commandBuffer, (destination.width + depthReduceGroupSize - 1) / depthReduceGroupSize,
+                      (destination.height + depthReduceGroupSize - 1) / depthReduceGroupSize, 1);
+        // read by the next level and by the late cull
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.subresourceRange.baseMipLevel = level;
+        barrier.subresourceRange.levelCount = 1;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &barrier);
+        source = destination;
+    }
+    gpuProfiler.EndScope(commandBuffer, pyramidScope);
+}
+
+void Rovski::RecordIndirectDraws(VkCommandBuffer commandBuffer, DrawPass pass, uint32_t uniformOffset, CullPhase phase) {
+    ROVSKI_CPU_FUNCTION();
+    // the late phase has the second half of commands and counts
+    const uint32_t commandBase = phase == CullPhase::Late ? objectCapacity : 0;
+    const uint32_t countBase = phase == CullPhase::Late ? batchCapacity : 0;
+    if (bindless) {
+        // every object is in batch 0, the vertex shader finds its texture through the object index
+        BindDrawState(commandBuffer, pass == DrawPass::Depth ? vkBindlessIndirectPrepassPipeline : pass == DrawPass::ColorOnDepth ? vkBindlessIndirectEqualPipeline : vkBindlessIndirectPipeline);
+        BindBindlessSets(commandBuffer, uniformOffset);
+        const uint32_t slots[] = {bindlessObjectBuffer, bindlessObjectTextureBuffer};
+        vkCmdPushConstants(commandBuffer, vkBindlessPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, offsetof(BindlessConstants, objectBuffer), sizeof(slots), slots);
+        for (uint32_t batch = 0; batch < indirectBatches.size(); batch++) {
+            const IndirectBatch &indirectBatch = indirectBatches[batch];
+            vkCmdDrawIndexedIndirectCount(commandBuffer, vkIndirectBuffers[currentFrame],
+                                          VkDeviceSize(commandBase + indirectBatch.base) * sizeof(VkDrawIndexedIndirectCommand),
+                                          vkIndirectCountBuffers[currentFrame], VkDeviceSize(countBase + batch) * sizeof(uint32_t),
+                                          indirectBatch.capacity, sizeof(VkDrawIndexedIndirectCommand));
+        }
+        return;
+    }
+    BindDrawState(commandBuffer, pass == DrawPass::Depth ? vkIndirectPrepassPipeline : pass == DrawPass::ColorOnDepth ? vkIndirectEqualPipeline : vkIndirectPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vkIndirectPipelineLayout, 1, 1, &vkObjectDescriptorSets[currentFrame], 0, nullptr);
+    // the texture is the only state that differs between draws, each batch's count says how many of its commands the cull pass wrote
+    for (uint32_t batch = 0; batch < indirectBatches.size(); batch++) {
+        const IndirectBatch &indirectBatch = indirectBatches[batch];
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vkIndirectPipelineLayout, 0, 1,
+                                &textures[indirectBatch.texture].descriptorSet, 1, &uniformOffset);
+        vkCmdDrawIndexedIndirectCount(commandBuffer, vkIndirectBuffers[currentFrame],
+                                      VkDeviceSize(commandBase + indirectBatch.base) * sizeof(VkDrawIndexedIndirectCommand),
+                                      vkIndirectCountBuffers[currentFrame], VkDeviceSize(countBase + batch) * sizeof(uint32_t),
+                                      indirectBatch.capacity, sizeof(VkDrawIndexedIndirectCommand));
+    }
+}
+
+VkCommandBuffer Rovski::AcquireSecondaryCommandBuffer(uint32_t threadIndex) {
+    ThreadRecordContext &context = threadRecordContexts[currentFrame * jobSystem->ThreadCount() + threadIndex];
+    if (context.used == context.secondaryBuffers.size()) {
+        VkCommandBufferAllocateInfo allocateInfo{};
+        allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocateInfo.commandBufferCount = 1;
+        allocateInfo.commandPool = context.pool;
+        allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        VkCommandBuffer commandBuffer;
+        if (vkAllocateCommandBuffers(vkDevice, &allocateInfo, &commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate secondary command buffer");
+        }
+        context.secondaryBuffers.push_back(commandBuffer);
+    }
+    return context.secondaryBuffers[context.used++];
+}
+
 bool Rovski::CreateSyncObjects() {
+    ROVSKI_CPU_FUNCTION();
     vkImageAvailableSemaphore.resize(maxFrameInFlight);
     vkRenderFinishSemaphore.resize(maxFrameInFlight);
     vkInFlightFences.resize(maxFrameInFlight);
@@ -902,92 +2411,209 @@ bool Rovski::CreateSyncObjects() {
 }
 
 void Rovski::DrawFrame() {
+    ROVSKI_CPU_FUNCTION();
+    auto frameStart = std::chrono::high_resolution_clock::now();
     uint32_t imageIndex;
-    vkWaitForFences(vkDevice, 1, &vkInFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
-    VkResult result = vkAcquireNextImageKHR(vkDevice, vkSwapChain, UINT64_MAX, vkImageAvailableSemaphore[currentFrame], VK_NULL_HANDLE, &imageIndex);
-    if (result == VK_ERROR_OUT_OF_DATE_KHR){
-        RecreateSwapChain();
-        return;
-    } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR){
-        std::cerr << "failed to acquire image" << std::endl;
-        return;
+    {
+        ROVSKI_CPU_SCOPE("wait frame fence");
+        vkWaitForFences(vkDevice, 1, &vkInFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+    }
+    VkResult result = VK_SUCCESS;
+    if (headless) {
+        // one offscreen image per frame in flight, its fence just passed so the pixels are ready
+        imageIndex = static_cast<uint32_t>(currentFrame);
+        DeliverReadback(imageIndex);
+    } else {
+        ROVSKI_CPU_SCOPE("acquire image");
+        result = vkAcquireNextImageKHR(vkDevice, vkSwapChain, UINT64_MAX, vkImageAvailableSemaphore[currentFrame], VK_NULL_HANDLE, &imageIndex);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR){
+            RecreateSwapChain();
+            return;
+        } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR){
+            std::cerr << "failed to acquire image" << std::endl;
+            return;
+        }
+        if (vkImagesInFlight[imageIndex] != VK_NULL_HANDLE) {
+            vkWaitForFences(vkDevice, 1, &vkImagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+        }
+        vkImagesInFlight[imageIndex] = vkInFlightFences[currentFrame];
     }
-    if (vkImagesInFlight[imageIndex] != VK_NULL_HANDLE) {
-        vkWaitForFences(vkDevice, 1, &vkImagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+    uploadEngine.Collect();
+    std::erase_if(pendingMeshFrees, [this](std::pair<uint64_t, MeshRange> &pending) {
+        if (pending.first > frameStats.frameIndex) {
+            return false;
+        }
+        geometryArena.Free(pending.second);
+        return true;
+    });
+    ReleaseRetiredBuffers(false);
+    StreamTextures();
+    // this frame's fence passed, nothing pending reads its table or its instance buffer any more
+    FlushBindlessTable();
+    if (!UploadInstances()) {
+        std::cerr << "failed to upload instances, dropping the instanced draw" << std::endl;
+        instanceCount = 0;
+    }
+    if (gpuDriven && ((gpuObjectsStale && !UploadGpuObjects()) || !BindFrameGpuObjects())) {
+        std::cerr << "failed to upload gpu objects, culling on the CPU" << std::endl;
+        gpuDriven = false;
+    }
+    // copies recorded since the last frame (UploadMesh, CreateTexture) go out before the frame that reads them
+    uint64_t uploadValue = uploadEngine.Flush();
+    uploadValueRequired = uploadEngine.CompletedValue() >= uploadValue ? 0 : uploadValue;
+    auto recordStart = std::chrono::high_resolution_clock::now();
+    {
+        ROVSKI_CPU_SCOPE("reset command pools");
+        vkResetCommandPool(vkDevice, vkFrameCommandPools[currentFrame], 0);
+        for (uint32_t i = 0; i < jobSystem->ThreadCount(); i++) {
+            ThreadRecordContext &context = threadRecordContexts[currentFrame * jobSystem->ThreadCount() + i];
+            vkResetCommandPool(vkDevice, context.pool, 0);
+            context.used = 0;
+        }
     }
-    vkImagesInFlight[imageIndex] = vkInFlightFences[currentFrame];
-    UpdateUniformBuffer(imageIndex);
+    uniformRing.BeginFrame(static_cast<uint32_t>(currentFrame));
+    UpdateUniformBuffer();
+    if (!gpuDriven) {
+        CullDraws();
+    } else {
+        frameStats.cullMs = 0;
+    }
+    VkCommandBuffer commandBuffer = vkFrameCommandBuffers[currentFrame];
+    if (!RecordCommandBuffer(commandBuffer, imageIndex)) {
+        std::cerr << "failed to record command buffer" << std::endl;
+    }
+    auto recordEnd = std::chrono::high_resolution_clock::now();
 
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    VkSemaphore waitSemaphores[] = {vkImageAvailableSemaphore[currentFrame]};
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.pWaitDstStageMask = waitStages;
+    // uploads still in flight are waited on the GPU, only the stages that read them stall
+    VkSemaphore waitSemaphores[] = {vkImageAvailableSemaphore[currentFrame], uploadEngine.TimelineSemaphore()};
+    VkPipelineStageFlags waitStages[] = {
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+            | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+    };
+    uint64_t waitValues[] = {0, uploadValueRequired};
+    uint64_t signalValues[] = {0};
+    // headless frames have no acquire to wait for and nothing to present
+    uint32_t firstWait = headless ? 1 : 0;
+    uint32_t waitCount = (uploadValueRequired != 0 ? 2 : 1) - firstWait;
+    uint32_t signalCount = headless ? 0 : 1;
+    VkTimelineSemaphoreSubmitInfo timelineSubmitInfo{};
+    timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineSubmitInfo.waitSemaphoreValueCount = waitCount;
+    timelineSubmitInfo.pWaitSemaphoreValues = waitValues + firstWait;
+    timelineSubmitInfo.signalSemaphoreValueCount = signalCount;
+    timelineSubmitInfo.pSignalSemaphoreValues = signalValues;
+    submitInfo.pNext = &timelineSubmitInfo;
+    submitInfo.waitSemaphoreCount = waitCount;
+    submitInfo.pWaitSemaphores = waitSemaphores + firstWait;
+    submitInfo.pWaitDstStageMask = waitStages + firstWait;
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = vkCommandBuffer.data() + imageIndex;
+    submitInfo.pCommandBuffers = &commandBuffer;
     VkSemaphore signalSemaphores[] = {vkRenderFinishSemaphore[currentFrame]};
-    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.signalSemaphoreCount = signalCount;
     submitInfo.pSignalSemaphores = signalSemaphores;
     vkResetFences(vkDevice, 1, &vkInFlightFences[currentFrame]);
-    if (vkQueueSubmit(vkGraphicsQueue, 1, &submitInfo, vkInFlightFences[currentFrame]) != VK_SUCCESS) {
-        std::cout << "failed to submit queue" << std::endl;
-    }
-    VkPresentInfoKHR presentInfo{};
-    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-    presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
-    VkSwapchainKHR swapChains[] = {vkSwapChain};
-    presentInfo.swapchainCount = 1;
-    presentInfo.pSwapchains = swapChains;
-    presentInfo.pImageIndices = &imageIndex;
-    result = vkQueuePresentKHR(vkGraphicsQueue, &presentInfo);
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || frameBufferResized) {
-        RecreateSwapChain();
-        frameBufferResized = false;
-    } else if (result != VK_SUCCESS) {
-        std::cerr << "failed to present" << std::endl;
+    {
+        ROVSKI_CPU_SCOPE("submit");
+        if (vkQueueSubmit(vkGraphicsQueue, 1, &submitInfo, vkInFlightFences[currentFrame]) != VK_SUCCESS) {
+            std::cout << "failed to submit queue" << std::endl;
+        }
+    }
+    if (!headless) {
+        ROVSKI_CPU_SCOPE("present");
+        VkPresentInfoKHR presentInfo{};
+        presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        presentInfo.waitSemaphoreCount = 1;
+        presentInfo.pWaitSemaphores = signalSemaphores;
+        VkSwapchainKHR swapChains[] = {vkSwapChain};
+        presentInfo.swapchainCount = 1;
+        presentInfo.pSwapchains = swapChains;
+        presentInfo.pImageIndices = &imageIndex;
+        result = vkQueuePresentKHR(vkGraphicsQueue, &presentInfo);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || frameBufferResized) {
+            RecreateSwapChain();
+            frameBufferResized = false;
+        } else if (result != VK_SUCCESS) {
+            std::cerr << "failed to present" << std::endl;
+        }
     }
     currentFrame = (currentFrame+1) % maxFrameInFlight;
+    frameStats.frameIndex++;
+    frameStats.drawCount = static_cast<uint32_t>(drawList.size());
+    frameStats.visibleCount = gpuDriven ? frameStats.drawCount : static_cast<uint32_t>(visibleDraws.size());
+    frameStats.recordMs = std::chrono::duration<double, std::milli>(recordEnd - recordStart).count();
+    const GpuFrameResult &gpuResult = gpuProfiler.LatestResult();
+    frameStats.gpuMs = gpuResult.scopes.empty() ? 0 : gpuResult.scopes.front().gpuMs;
+    frameStats.frameMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - frameStart).count();
 }
 
 void Rovski::RecreateSwapChain() {
+    ROVSKI_CPU_FUNCTION();
     int width = 0, height = 0;
     glfwGetFramebufferSize(window, &width, &height);
     while (width == 0 || height == 0) {
         glfwGetFramebufferSize(window, &width, &height);
         glfwWaitEvents();
     }
-    vkDeviceWaitIdle(vkDevice);
+    // only the frames in flight can still use the framebuffers, no need to drain the upload queue
+    vkWaitForFences(vkDevice, maxFrameInFlight, vkInFlightFences.data(), VK_TRUE, UINT64_MAX);
     CleanUpSwapChain();
-    vkDestroyDescriptorSetLayout(vkDevice, vkDescriptorSetLayout, nullptr);
-    CreateSwapChain();
+    VkSwapchainKHR oldSwapChain = vkSwapChain;
+    VkFormat oldFormat = vkSwapChainFormat;
+    if (!CreateSwapChain(oldSwapChain)) {
+        std::cerr << "failed to recreate swap chain" << std::endl;
+    }
+    vkDestroySwapchainKHR(vkDevice, oldSwapChain, nullptr);
     CreateImageViews();
-    CreateRenderPass();
-    CreateGraphicsPipeline();
+    CreateDepthResources();
+    if (gpuDrivenSupported) {
+        CreateDepthPyramid();
+    }
+    if (vkSwapChainFormat != oldFormat) {
+        // the render pass and pipeline depend on the format only, never on the size
+        vkDestroyPipeline(vkDevice, vkGraphicsPipeline, nullptr);
+        vkDestroyPipeline(vkDevice, vkDepthPrepassPipeline, nullptr);
+        vkDestroyPipeline(vkDevice, vkDepthEqualPipeline, nullptr);
+        vkDestroyPipeline(vkDevice, vkInstancedPipeline, nullptr);
+        vkDestroyPipeline(vkDevice, vkInstancedPrepassPipeline, nullptr);
+        vkDestroyPipeline(vkDevice, vkInstancedEqualPipeline, nullptr);
+        vkDestroyPipelineLayout(vkDevice, vkPipelineLayout, nullptr);
+        vkDestroyPipeline(vkDevice, vkBindlessPipeline, nullptr);
+        vkDestroyPipeline(vkDevice, vkBindlessPrepassPipeline, nullptr);
+        vkDestroyPipeline(vkDevice, vkBindlessEqualPipeline, nullptr);
+        vkDestroyPipeline(vkDevice, vkBindlessIndirectPipeline, nullptr);
+        vkDestroyPipeline(vkDevice, vkBindlessIndirectPrepassPipeline, nullptr);
+        vkDestroyPipeline(vkDevice, vkBindlessIndirectEqualPipeline, nullptr);
+        vkDestroyPipelineLayout(vkDevice, vkBindlessPipelineLayout, nullptr);
+        vkDestroyPipeline(vkDevice, vkIndirectPipeline, nullptr);
+        vkDestroyPipeline(vkDevice, vkIndirectPrepassPipeline, nullptr);
+        vkDestroyPipeline(vkDevice, vkIndirectEqualPipeline, nullptr);
+        vkDestroyPipelineLayout(vkDevice, vkIndirectPipelineLayout, nullptr);
+        vkDestroyRenderPass(vkDevice, vkRenderPass, nullptr);
+        vkDestroyRenderPass(vkDevice, vkEarlyRenderPass, nullptr);
+        vkDestroyRenderPass(vkDevice, vkLateRenderPass, nullptr);
+        CreateRenderPass();
+        CreateGraphicsPipeline();
+    }
     CreateFrameBuffer();
-    CreateUniformBuffers();
-    CreateDescriptorPool();
-    CreateDescriptorSet();
-    CreateCommandBuffer();
+    vkImagesInFlight.assign(vkSwapChainImages.size(), VK_NULL_HANDLE);
 }
 
 void Rovski::CleanUpSwapChain() {
     for (size_t i = 0; i < vkSwapChainFrameBuffers.size(); i++) {
         vkDestroyFramebuffer(vkDevice, vkSwapChainFrameBuffers[i], nullptr);
     }
-    vkFreeCommandBuffers(vkDevice, vkCommandPool, static_cast<uint32_t>(vkCommandBuffer.size()), vkCommandBuffer.data());
-    vkDestroyPipeline(vkDevice, vkGraphicsPipeline, nullptr);
-    vkDestroyPipelineLayout(vkDevice, vkPipelineLayout, nullptr);
-    vkDestroyRenderPass(vkDevice, vkRenderPass, nullptr);
     for (size_t i = 0; i < vkSwapChainImageViews.size();i++) {
         vkDestroyImageView(vkDevice, vkSwapChainImageViews[i], nullptr);
-        vkDestroyBuffer(vkDevice, vkUniformBuffers[i], nullptr);
-        vkFreeMemory(vkDevice, vkUniformBuffersMemory[i], nullptr);
     }
-    vkDestroyDescriptorPool(vkDevice, vkDescriptorPool, nullptr);
-    vkDestroySwapchainKHR(vkDevice, vkSwapChain, nullptr);
+    vkDestroyImageView(vkDevice, vkDepthImageView, nullptr);
+    vkDepthImageView = VK_NULL_HANDLE;
+    vkDestroyImageView(vkDevice, vkDepthSampleView, nullptr);
+    vkDepthSampleView = VK_NULL_HANDLE;
+    DestroyImage(vkDepthImage, depthImageMemory);
+    DestroyDepthPyramid();
 }
 
 uint32_t Rovski::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties){
@@ -1003,27 +2629,13 @@ uint32_t Rovski::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags prope
 }
 
 bool Rovski::CreateVertexBuffer() {
-    VkDeviceSize size = sizeof(Vertices[0]) * Vertices.size();
-    VkBuffer stageBuffer;
-    VkDeviceMemory stageBufferMemory;
-    CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 stageBuffer, stageBufferMemory, false);
-    void *data;
-    vkMapMemory(vkDevice, stageBufferMemory, 0, size, 0, &data);
-    memcpy(data, Vertices.data(), size);
-    vkUnmapMemory(vkDevice, stageBufferMemory);
-
-    CreateBuffer(size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 vkVertexBuffer, vkVertextBufferMemory, false);
-    CopyBuffer(vkVertexBuffer, stageBuffer, size);
-    vkDestroyBuffer(vkDevice, stageBuffer, nullptr);
-    vkFreeMemory(vkDevice, stageBufferMemory, nullptr);
-    return true;
+    ROVSKI_CPU_FUNCTION();
+    // the whole vertex arena, meshes are placed in it by UploadMesh
+    return CreateBuffer(vertexArenaSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vkVertexBuffer, vertexBufferMemory, false);
 }
 
-bool Rovski::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory, bool needTransfer) {
+bool Rovski::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation& bufferMemory, bool needTransfer) {
     VkBufferCreateInfo bufferCreateInfo{};
     bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferCreateInfo.size = size;
@@ -1042,44 +2654,116 @@ bool Rovski::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryP
     }
     VkMemoryRequirements memoryRequirements;
     vkGetBufferMemoryRequirements(vkDevice, buffer, &memoryRequirements);
-    VkMemoryAllocateInfo allocateInfo{};
-    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocateInfo.allocationSize = memoryRequirements.size;
-    allocateInfo.memoryTypeIndex = FindMemoryType(memoryRequirements.memoryTypeBits,
-                                                  properties);
-    if (vkAllocateMemory(vkDevice, &allocateInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
+    uint32_t memoryType = FindMemoryType(memoryRequirements.memoryTypeBits, properties);
+    if (!memoryAllocator.Allocate(memoryRequirements, memoryType, DeviceMemoryAllocator::ResourceKind::Buffer, bufferMemory)) {
+        vkDestroyBuffer(vkDevice, buffer, nullptr);
+        buffer = VK_NULL_HANDLE;
         return false;
     }
-    vkBindBufferMemory(vkDevice, buffer, bufferMemory, 0);
+    vkBindBufferMemory(vkDevice, buffer, bufferMemory.memory, bufferMemory.offset);
     return true;
 }
 
+void Rovski::DestroyBuffer(VkBuffer &buffer, MemoryAllocation &bufferMemory) {
+    vkDestroyBuffer(vkDevice, buffer, nullptr);
+    memoryAllocator.Free(bufferMemory);
+    buffer = VK_NULL_HANDLE;
+}
+
+void Rovski::RetireBuffer(VkBuffer &buffer, MemoryAllocation &bufferMemory) {
+    if (buffer == VK_NULL_HANDLE) {
+        return;
+    }
+    retiredBuffers.emplace_back(frameStats.frameIndex + maxFrameInFlight, std::make_pair(buffer, bufferMemory));
+    buffer = VK_NULL_HANDLE;
+    bufferMemory = MemoryAllocation{};
+}
+
+void Rovski::ReleaseRetiredBuffers(bool all) {
+    std::erase_if(retiredBuffers, [this, all](std::pair<uint64_t, std::pair<VkBuffer, MemoryAllocation>> &retired) {
+        if (!all && retired.first > frameStats.frameIndex) {
+            return false;
+        }
+        DestroyBuffer(retired.second.first, retired.second.second);
+        return true;
+    });
+}
+
 bool Rovski::CreateIndexBuffer() {
-    VkDeviceSize size = sizeof(Indexes[0]) * Indexes.size();
-    VkBuffer stageBuffer;
-    VkDeviceMemory stageBufferMemory;
-    CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 stageBuffer, stageBufferMemory, false);
-    void *data;
-    vkMapMemory(vkDevice, stageBufferMemory, 0, size, 0, &data);
-    memcpy(data, Indexes.data(), size);
-    vkUnmapMemory(vkDevice, stageBufferMemory);
-
-    CreateBuffer(size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 vkIndexBuffer, vkIndextBufferMemory, false);
-    CopyBuffer(vkIndexBuffer, stageBuffer, size);
-    vkDestroyBuffer(vkDevice, stageBuffer, nullptr);
-    vkFreeMemory(vkDevice, stageBufferMemory, nullptr);
+    ROVSKI_CPU_FUNCTION();
+    if (!CreateBuffer(indexArenaSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vkIndexBuffer, indexBufferMemory, false)) {
+        return false;
+    }
+    geometryArena.Init(vertexArenaSize / sizeof(Vertex), indexArenaSize / sizeof(uint32_t));
     return true;
 }
 
+bool Rovski::UploadMesh(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, MeshRange &mesh) {
+    return UploadMesh(vertices.data(), static_cast<uint32_t>(vertices.size()), indices.data(), static_cast<uint32_t>(indices.size()), mesh);
+}
+
+bool Rovski::UploadMesh(const void *vertices, uint32_t vertexCount, const uint32_t *indices, uint32_t indexCount, MeshRange &mesh) {
+    ROVSKI_CPU_FUNCTION();
+    if (!geometryArena.Allocate(vertexCount, indexCount, mesh)) {
+        std::cout << "geometry arena is full" << std::endl;
+        return false;
+    }
+    bool uploaded = uploadEngine.UploadBuffer(vkVertexBuffer, mesh.vertices.offset * sizeof(Vertex), vertices,
+                                              uint64_t(vertexCount) * sizeof(Vertex),
+                                              VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+    uploaded = uploaded && uploadEngine.UploadBuffer(vkIndexBuffer, mesh.indices.offset * sizeof(uint32_t), indices,
+                                                     uint64_t(indexCount) * sizeof(uint32_t),
+                                                     VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+    if (!uploaded) {
+        geometryArena.Free(mesh);
+    }
+    return uploaded;
+}
+
+bool Rovski::LoadMesh(const std::string &path, MeshRange &mesh, MeshBounds *bounds) {
+    ROVSKI_CPU_FUNCTION();
+    uint64_t sourceHash;
+    if (!MeshCache::HashSource(path, sourceHash)) {
+        std::cout << "failed to read mesh " << path << std::endl;
+        return false;
+    }
+    std::string cachePath = path + ".rvmesh";
+    MeshCache cache;
+    if (cache.Open(cachePath, sourceHash)) {
+        // the mapped ranges are copied into the staging ring as they are
+        const MeshCacheHeader &header = cache.Header();
+        if (bounds != nullptr) {
+            *bounds = cache.Bounds();
+        }
+        return UploadMesh(cache.VertexData(), header.vertexCount, cache.IndexData(), header.indexCount, mesh);
+    }
+    MeshLoader loader(*jobSystem);
+    MeshData data;
+    if (!loader.Load(path, data)) {
+        return false;
+    }
+    if (!MeshCache::Write(cachePath, sourceHash, data)) {
+        std::cout << "failed to write mesh cache " << cachePath << std::endl;
+    }
+    if (bounds != nullptr) {
+        *bounds = data.bounds;
+    }
+    return UploadMesh(data.vertices, data.indices, mesh);
+}
+
+void Rovski::FreeMesh(MeshRange &mesh) {
+    // frames still in flight may draw from the range, hand it back once their fences have passed
+    pendingMeshFrees.emplace_back(frameStats.frameIndex + maxFrameInFlight, mesh);
+    mesh = {};
+}
+
 bool Rovski::CreateDescriptorLayout() {
+    ROVSKI_CPU_FUNCTION();
     VkDescriptorSetLayoutBinding uboLayoutBinding{};
     uboLayoutBinding.binding = 0;
     uboLayoutBinding.descriptorCount = 1;
-    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
     VkDescriptorSetLayoutBinding samplerLayoutBinding{};
@@ -1097,33 +2781,263 @@ bool Rovski::CreateDescriptorLayout() {
     if (vkCreateDescriptorSetLayout(vkDevice, &createInfo, nullptr, &vkDescriptorSetLayout)!=VK_SUCCESS) {
         return false;
     }
-    return true;
+    if (bindlessSupported) {
+        // every texture and the storage buffers in one table, indexed by the draws. The arrays are only partly
+        // filled and slots are written while earlier frames still have the set bound
+        std::array<VkDescriptorSetLayoutBinding, 3> bindlessBindings{};
+        bindlessBindings[0] = {0, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, maxTextures, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr};
+        bindlessBindings[1] = {1, VK_DESCRIPTOR_TYPE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr};
+        bindlessBindings[2] = {2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxBindlessBuffers, VK_SHADER_STAGE_VERTEX_BIT, nullptr};
+        const VkDescriptorBindingFlags tableFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+        std::array<VkDescriptorBindingFlags, 3> bindingFlags = {tableFlags, 0, tableFlags};
+        VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+        bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+        bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+        bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+        VkDescriptorSetLayoutCreateInfo bindlessCreateInfo{};
+        bindlessCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        bindlessCreateInfo.pNext = &bindingFlagsInfo;
+        bindlessCreateInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+        bindlessCreateInfo.bindingCount = static_cast<uint32_t>(bindlessBindings.size());
+        bindlessCreateInfo.pBindings = bindlessBindings.data();
+        if (vkCreateDescriptorSetLayout(vkDevice, &bindlessCreateInfo, nullptr, &vkBindlessSetLayout) != VK_SUCCESS) {
+            return false;
+        }
+    }
+    if (!gpuDrivenSupported) {
+        return true;
+    }
+    // objects, batch bases, indirect commands, counts and visibility for the cull shader, then its uniform block
+    // and the depth pyramid; the vertex stage only reads objects
+    std::array<VkDescriptorSetLayoutBinding, 7> cullBindings{};
+    for (uint32_t i = 0; i < cullBindings.size(); i++) {
+        cullBindings[i].binding = i;
+        cullBindings[i].descriptorCount = 1;
+        cullBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        cullBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    cullBindings[5].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    cullBindings[6].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    createInfo.bindingCount = static_cast<uint32_t>(cullBindings.size());
+    createInfo.pBindings = cullBindings.data();
+    if (vkCreateDescriptorSetLayout(vkDevice, &createInfo, nullptr, &vkCullSetLayout) != VK_SUCCESS) {
+        return false;
+    }
+    VkDescriptorSetLayoutBinding objectBinding = cullBindings[0];
+    objectBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    createInfo.bindingCount = 1;
+    createInfo.pBindings = &objectBinding;
+    if (vkCreateDescriptorSetLayout(vkDevice, &createInfo, nullptr, &vkObjectSetLayout) != VK_SUCCESS) {
+        return false;
+    }
+    if (!occlusionCullingSupported) {
+        return true;
+    }
+    // one pyramid level: the level above, or the depth image, in and this level out
+    std::array<VkDescriptorSetLayoutBinding, 2> reduceBindings{};
+    for (uint32_t i = 0; i < reduceBindings.size(); i++) {
+        reduceBindings[i].binding = i;
+        reduceBindings[i].descriptorCount = 1;
+        reduceBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    reduceBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    reduceBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    createInfo.bindingCount = static_cast<uint32_t>(reduceBindings.size());
+    createInfo.pBindings = reduceBindings.data();
+    return vkCreateDescriptorSetLayout(vkDevice, &createInfo, nullptr, &vkDepthReduceSetLayout) == VK_SUCCESS;
 }
 
 bool Rovski::CreateUniformBuffers() {
-    VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-    vkUniformBuffers.resize(bufferSize);
-    vkUniformBuffersMemory.resize(bufferSize);
-    for (int i = 0; i < vkSwapChainImages.size(); i++) {
-        if (!CreateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|
-        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, vkUniformBuffers[i], vkUniformBuffersMemory[i], false)){
-            return false;
+    ROVSKI_CPU_FUNCTION();
+    VkPhysicalDeviceProperties deviceProperties{};
+    vkGetPhysicalDeviceProperties(vkPhysicalDevice, &deviceProperties);
+    VkDeviceSize bufferSize = uniformSliceSize * maxFrameInFlight;
+    if (!CreateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|
+    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, vkUniformBuffer, uniformBufferMemory, false)){
+        return false;
+    }
+    uniformAlignment = deviceProperties.limits.minUniformBufferOffsetAlignment;
+    uniformRing.Init(uniformBufferMemory.mapped, uniformSliceSize, maxFrameInFlight, uniformAlignment);
+    return true;
+}
+
+bool Rovski::EnsureUniformCapacity(size_t drawCount) {
+    ROVSKI_CPU_FUNCTION();
+    auto aligned = [this](VkDeviceSize size) { return (size + uniformAlignment - 1) & ~(uniformAlignment - 1); };
+    // one block per draw, then what a frame pushes once: view and projection alone and the cull data
+    VkDeviceSize required = aligned(sizeof(UniformBufferObject)) * (drawCount + 1) + aligned(sizeof(CullData));
+    if (required <= uniformSliceSize) {
+        return true;
+    }
+    while (uniformSliceSize < required) {
+        uniformSliceSize *= 2;
+    }
+    vkDeviceWaitIdle(vkDevice);
+    ReleaseRetiredBindings(true);
+    vkDestroyDescriptorPool(vkDevice, vkDescriptorPool, nullptr);
+    DestroyBuffer(vkUniformBuffer, uniformBufferMemory);
+    if (!CreateUniformBuffers() || !CreateDescriptorPool() || !CreateDescriptorSet()) {
+        return false;
+    }
+    if (gpuDrivenSupported) {
+        WriteCullFrameDescriptors();
+    }
+    return true;
+}
+
+void Rovski::UpdateUniformBuffer() {
+    ROVSKI_CPU_FUNCTION();
+    frameView = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    // reverse-Z with the far plane at infinity: depth is near / -z, 1 on the near plane falling towards 0, so the
+    // float's exponent keeps distant surfaces apart instead of spending the precision right in front of the camera
+    const float nearPlane = 0.1f;
+    const float focal = 1.0f / std::tan(glm::radians(45.0f) * 0.5f);
+    const float aspect = static_cast<float>(vkSwapChainExtent.width) / vkSwapChainExtent.height;
+    frameProjection = glm::mat4(0.0f);
+    frameProjection[0][0] = focal / aspect;
+    frameProjection[1][1] = focal;
+    frameProjection[2][3] = -1.0f;
+    frameProjection[3][2] = nearPlane;
+    frameProjection[1][1] *= -1;
+}
+
+void Rovski::CullDraws() {
+    ROVSKI_CPU_FUNCTION();
+    auto cullStart = std::chrono::high_resolution_clock::now();
+    if (frustumCulling) {
+        frustumCuller.Cull(ExtractFrustum(frameProjection * frameView), *jobSystem, visibleDraws);
+    } else {
+        visibleDraws.resize(drawList.size());
+        std::iota(visibleDraws.begin(), visibleDraws.end(), 0u);
+    }
+    frameStats.cullMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - cullStart).count();
+}
+
+bool Rovski::UploadGpuObjects() {
+    ROVSKI_CPU_FUNCTION();
+    const uint32_t objectCount = static_cast<uint32_t>(drawList.size());
+    indirectBatches.clear();
+    textureBatches.assign(textures.size(), UINT32_MAX);
+    for (const DrawCommand &draw : drawList) {
+        // bindless draws pick their texture per object, a single batch holds them all
+        uint32_t &batch = textureBatches[bindless ? 0 : draw.texture];
+        if (batch == UINT32_MAX) {
+            batch = static_cast<uint32_t>(indirectBatches.size());
+            indirectBatches.push_back(IndirectBatch{draw.texture, 0, 0});
         }
+        indirectBatches[batch].capacity++;
+    }
+    std::vector<uint32_t> batchBases(indirectBatches.size());
+    for (uint32_t batch = 0, base = 0; batch < indirectBatches.size(); batch++) {
+        indirectBatches[batch].base = batchBases[batch] = base;
+        base += indirectBatches[batch].capacity;
+    }
+    if (!CreateGpuObjectBuffers(objectCount, static_cast<uint32_t>(indirectBatches.size()))) {
+        return false;
     }
+    std::vector<GpuObject> objects(objectCount);
+    jobSystem->ParallelFor(objectCount, 4096, [&](uint32_t begin, uint32_t end, uint32_t) {
+        for (uint32_t i = begin; i < end; i++) {
+            objects[i] = MakeGpuObject(drawList[i], textureBatches[bindless ? 0 : drawList[i].texture]);
+        }
+    });
+    std::vector<uint32_t> objectTextures;
+    if (bindlessSupported) {
+        objectTextures.resize(objectCount);
+        for (uint32_t i = 0; i < objectCount; i++) {
+            objectTextures[i] = drawList[i].texture;
+        }
+    }
+    dirtyObjects.clear();
+    objectDirty.assign(objectCount, 0);
+    gpuObjectsStale = false;
+    // the flags belonged to the old list
+    visibilityStale = true;
+    if (objectCount == 0) {
+        return true;
+    }
+    // later frames overwrite single objects with vkCmdUpdateBuffer, so transfer writes are among the users too
+    const VkPipelineStageFlags dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+    return uploadEngine.UploadBuffer(vkObjectBuffer, 0, objects.data(), objects.size() * sizeof(GpuObject), dstStage,
+                                     VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT)
+        && uploadEngine.UploadBuffer(vkBatchBaseBuffer, 0, batchBases.data(), batchBases.size() * sizeof(uint32_t),
+                                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT)
+        && (!bindlessSupported || uploadEngine.UploadBuffer(vkObjectTextureBuffer, 0, objectTextures.data(), objectTextures.size() * sizeof(uint32_t),
+                                                            VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT));
+}
+
+bool Rovski::CreateGpuObjectBuffers(uint32_t objectCount, uint32_t batchCount) {
+    ROVSKI_CPU_FUNCTION();
+    // frames in flight still cull and draw from the old objects and batches
+    RetireBuffer(vkObjectBuffer, objectBufferMemory);
+    RetireBuffer(vkBatchBaseBuffer, batchBaseBufferMemory);
+    RetireBuffer(vkVisibilityBuffer, visibilityBufferMemory);
+    RetireBuffer(vkObjectTextureBuffer, objectTextureBufferMemory);
+    gpuObjectUpload++;
+    if (objectCapacity == 0 || objectCount > objectCapacity || batchCount > batchCapacity) {
+        objectCapacity = std::max(objectCapacity, 1024u);
+        while (objectCapacity < objectCount) {
+            objectCapacity *= 2;
+        }
+        batchCapacity = std::max(batchCapacity, 64u);
+        while (batchCapacity < batchCount) {
+            batchCapacity *= 2;
+        }
+        gpuCapacityUpload = gpuObjectUpload;
+    }
+    if (!CreateBuffer(VkDeviceSize(objectCapacity) * sizeof(GpuObject), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vkObjectBuffer, objectBufferMemory, false)
+        || !CreateBuffer(VkDeviceSize(batchCapacity) * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vkBatchBaseBuffer, batchBaseBufferMemory, false)
+        || !CreateBuffer(VkDeviceSize(objectCapacity) * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vkVisibilityBuffer, visibilityBufferMemory, false)) {
+        return false;
+    }
+    if (bindlessSupported && !CreateBuffer(VkDeviceSize(objectCapacity) * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vkObjectTextureBuffer, objectTextureBufferMemory, false)) {
+        return false;
+    }
+    visibilityStale = true;
     return true;
 }
 
-void Rovski::UpdateUniformBuffer(uint32_t imageIndex) {
-    UniformBufferObject ubo{};
-    ubo.model = glm::rotate(glm::mat4(1), glm::radians(90.0f)*static_cast<float>(currentTimeFromStart), glm::vec3(0.0f, 0.0f, 1.0f));
-    ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    ubo.prj = glm::perspective(glm::radians(45.0f), static_cast<float>(vkSwapChainExtent.width)/vkSwapChainExtent.height,
-                               0.1f, 10.0f);
-    ubo.prj[1][1] *= -1;
-    void *data;
-    vkMapMemory(vkDevice, vkUniformBuffersMemory[imageIndex], 0, sizeof(ubo), 0, &data);
-    memcpy(data, &ubo, sizeof(ubo));
-    vkUnmapMemory(vkDevice, vkUniformBuffersMemory[imageIndex]);
+bool Rovski::BindFrameGpuObjects() {
+    if (frameGpuObjectUpload[currentFrame] == gpuObjectUpload) {
+        return true;
+    }
+    ROVSKI_CPU_FUNCTION();
+    // every object gets at most one command per phase, so the batches' ranges never overlap. The early (or only)
+    // phase fills the first half of commands and counts, the late phase the second
+    if (vkIndirectBuffers[currentFrame] == VK_NULL_HANDLE || frameGpuObjectUpload[currentFrame] < gpuCapacityUpload) {
+        DestroyBuffer(vkIndirectBuffers[currentFrame], indirectBufferMemory[currentFrame]);
+        DestroyBuffer(vkIndirectCountBuffers[currentFrame], indirectCountBufferMemory[currentFrame]);
+        if (!CreateBuffer(VkDeviceSize(objectCapacity) * 2 * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vkIndirectBuffers[currentFrame], indirectBufferMemory[currentFrame], false)
+            || !CreateBuffer(VkDeviceSize(batchCapacity) * 2 * sizeof(uint32_t),
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vkIndirectCountBuffers[currentFrame], indirectCountBufferMemory[currentFrame], false)) {
+            return false;
+        }
+    }
+
+    // bindings 0-4 of the cull set, then the object set's only one
+    const VkBuffer buffers[] = {vkObjectBuffer, vkBatchBaseBuffer, vkIndirectBuffers[currentFrame], vkIndirectCountBuffers[currentFrame],
+                                vkVisibilityBuffer, vkObjectBuffer};
+    std::array<VkDescriptorBufferInfo, 6> bufferInfos{};
+    std::array<VkWriteDescriptorSet, 6> writes{};
+    for (uint32_t i = 0; i < writes.size(); i++) {
+        bufferInfos[i] = VkDescriptorBufferInfo{buffers[i], 0, VK_WHOLE_SIZE};
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = i < 5 ? vkCullDescriptorSets[currentFrame] : vkObjectDescriptorSets[currentFrame];
+        writes[i].dstBinding = i < 5 ? i : 0;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i].pBufferInfo = &bufferInfos[i];
+    }
+    vkUpdateDescriptorSets(vkDevice, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    WriteBindlessBuffers(currentFrame);
+    frameGpuObjectUpload[currentFrame] = gpuObjectUpload;
+    return true;
 }
 
 void Rovski::UpdateTime() {
@@ -1134,17 +3048,22 @@ void Rovski::UpdateTime() {
 }
 
 bool Rovski::CreateDescriptorPool() {
+    ROVSKI_CPU_FUNCTION();
+    // every texture's set plus as many retired by streaming, freed once the frames using them are done, and the
+    // placeholder's, which bindless draws bind for the uniform block
+    const uint32_t setCount = maxTextures * 2 + 1;
     std::array<VkDescriptorPoolSize,2> poolSize{};
-    poolSize[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSize[0].descriptorCount = static_cast<uint32_t>(vkSwapChainImages.size());
+    poolSize[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    poolSize[0].descriptorCount = setCount;
     poolSize[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    poolSize[1].descriptorCount = static_cast<uint32_t>(vkSwapChainImages.size());
+    poolSize[1].descriptorCount = setCount;
 
     VkDescriptorPoolCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    createInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
     createInfo.poolSizeCount = static_cast<uint32_t>(poolSize.size());
     createInfo.pPoolSizes = poolSize.data();
-    createInfo.maxSets = static_cast<uint32_t>(vkSwapChainImages.size());
+    createInfo.maxSets = setCount;
     if (VK_SUCCESS != vkCreateDescriptorPool(vkDevice, &createInfo, nullptr, &vkDescriptorPool)) {
         return false;
     }
@@ -1153,95 +3072,565 @@ bool Rovski::CreateDescriptorPool() {
 }
 
 bool Rovski::CreateDescriptorSet() {
-    std::vector<VkDescriptorSetLayout> layout(vkSwapChainImages.size(), vkDescriptorSetLayout);
+    ROVSKI_CPU_FUNCTION();
+    for (auto &texture : textures) {
+        if (!WriteTextureDescriptorSet(texture)) {
+            return false;
+        }
+    }
+    return WriteTextureDescriptorSet(placeholderTexture);
+}
+
+bool Rovski::WriteTextureDescriptorSet(Texture &texture) {
     VkDescriptorSetAllocateInfo allocateInfo{};
     allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
     allocateInfo.descriptorPool = vkDescriptorPool;
-    allocateInfo.descriptorSetCount = static_cast<uint32_t>(vkSwapChainImages.size());
-    allocateInfo.pSetLayouts = layout.data();
+    allocateInfo.descriptorSetCount = 1;
+    allocateInfo.pSetLayouts = &vkDescriptorSetLayout;
 
-    vkDescriptorSet.resize(vkSwapChainImages.size());
-    if(vkAllocateDescriptorSets(vkDevice, &allocateInfo, vkDescriptorSet.data()) != VK_SUCCESS) {
+    if(vkAllocateDescriptorSets(vkDevice, &allocateInfo, &texture.descriptorSet) != VK_SUCCESS) {
         return false;
     }
-    for (int i = 0; i < vkSwapChainImages.size(); i++) {
-        VkDescriptorBufferInfo bufferInfo{};
-        bufferInfo.buffer = vkUniformBuffers[i];
-        bufferInfo.offset = 0;
-        bufferInfo.range = sizeof(UniformBufferObject);
-        VkDescriptorImageInfo imageInfo{};
-        imageInfo.imageView = vkTextureImageView;
-        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imageInfo.sampler = vkTextureSampler;
+    VkDescriptorBufferInfo bufferInfo{};
+    bufferInfo.buffer = vkUniformBuffer;
+    bufferInfo.offset = 0;
+    bufferInfo.range = sizeof(UniformBufferObject);
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.imageView = texture.view != VK_NULL_HANDLE ? texture.view : placeholderTexture.view;
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfo.sampler = vkTextureSampler;
+
+    std::array<VkWriteDescriptorSet,2> descriptorSet = {};
+    descriptorSet[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorSet[0].dstSet = texture.descriptorSet;
+    descriptorSet[0].dstBinding = 0;
+    descriptorSet[0].dstArrayElement = 0;
+    descriptorSet[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    descriptorSet[0].descriptorCount = 1;
+    descriptorSet[0].pBufferInfo = &bufferInfo;
+    descriptorSet[0].pImageInfo = nullptr;
+    descriptorSet[0].pTexelBufferView = nullptr;
+
+    descriptorSet[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorSet[1].dstSet = texture.descriptorSet;
+    descriptorSet[1].dstBinding = 1;
+    descriptorSet[1].dstArrayElement = 0;
+    descriptorSet[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorSet[1].descriptorCount = 1;
+    descriptorSet[1].pBufferInfo = &bufferInfo;
+    descriptorSet[1].pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(vkDevice, static_cast<uint32_t>(descriptorSet.size()), descriptorSet.data(), 0, nullptr);
+    return true;
+}
 
-        std::array<VkWriteDescriptorSet,2> descriptorSet = {};
-        descriptorSet[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorSet[0].dstSet = vkDescriptorSet[i];
-        descriptorSet[0].dstBinding = 0;
-        descriptorSet[0].dstArrayElement = 0;
-        descriptorSet[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        descriptorSet[0].descriptorCount = 1;
-        descriptorSet[0].pBufferInfo = &bufferInfo;
-        descriptorSet[0].pImageInfo = nullptr;
-        descriptorSet[0].pTexelBufferView = nullptr;
-
-        descriptorSet[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorSet[1].dstSet = vkDescriptorSet[i];
-        descriptorSet[1].dstBinding = 1;
-        descriptorSet[1].dstArrayElement = 0;
-        descriptorSet[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        descriptorSet[1].descriptorCount = 1;
-        descriptorSet[1].pBufferInfo = &bufferInfo;
-        descriptorSet[1].pImageInfo = &imageInfo;
-        vkUpdateDescriptorSets(vkDevice, static_cast<uint32_t>(descriptorSet.size()), descriptorSet.data(), 0, nullptr);
+bool Rovski::CreateBindlessTable() {
+    ROVSKI_CPU_FUNCTION();
+    // one table per frame in flight, a slot is only rewritten once the frames reading the old one are done
+    std::array<VkDescriptorPoolSize, 3> poolSize{};
+    poolSize[0] = {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, maxTextures * maxFrameInFlight};
+    poolSize[1] = {VK_DESCRIPTOR_TYPE_SAMPLER, maxFrameInFlight};
+    poolSize[2] = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxBindlessBuffers * maxFrameInFlight};
+    VkDescriptorPoolCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    createInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    createInfo.poolSizeCount = static_cast<uint32_t>(poolSize.size());
+    createInfo.pPoolSizes = poolSize.data();
+    createInfo.maxSets = maxFrameInFlight;
+    if (vkCreateDescriptorPool(vkDevice, &createInfo, nullptr, &vkBindlessPool) != VK_SUCCESS) {
+        return false;
+    }
+    std::vector<VkDescriptorSetLayout> layouts(maxFrameInFlight, vkBindlessSetLayout);
+    VkDescriptorSetAllocateInfo allocateInfo{};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocateInfo.descriptorPool = vkBindlessPool;
+    allocateInfo.descriptorSetCount = maxFrameInFlight;
+    allocateInfo.pSetLayouts = layouts.data();
+    vkBindlessSets.resize(maxFrameInFlight);
+    if (vkAllocateDescriptorSets(vkDevice, &allocateInfo, vkBindlessSets.data()) != VK_SUCCESS) {
+        return false;
+    }
+    VkDescriptorImageInfo samplerInfo{};
+    samplerInfo.sampler = vkTextureSampler;
+    std::vector<VkWriteDescriptorSet> writes(maxFrameInFlight);
+    for (uint32_t i = 0; i < maxFrameInFlight; i++) {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = vkBindlessSets[i];
+        writes[i].dstBinding = 1;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+        writes[i].pImageInfo = &samplerInfo;
+    }
+    vkUpdateDescriptorSets(vkDevice, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    // nothing is in flight yet, the first frame of each table writes the textures there are
+    pendingBindlessTextures.assign(maxFrameInFlight, {});
+    for (uint32_t texture = 0; texture < textures.size(); texture++) {
+        WriteBindlessTexture(texture);
     }
     return true;
 }
 
+void Rovski::WriteBindlessTexture(uint32_t texture) {
+    for (auto &pending : pendingBindlessTextures) {
+        pending.push_back(texture);
+    }
+}
+
+void Rovski::FlushBindlessTable() {
+    if (vkBindlessSets.empty() || pendingBindlessTextures[currentFrame].empty()) {
+        return;
+    }
+    ROVSKI_CPU_FUNCTION();
+    std::vector<uint32_t> &pending = pendingBindlessTextures[currentFrame];
+    std::vector<VkDescriptorImageInfo> imageInfos(pending.size());
+    std::vector<VkWriteDescriptorSet> writes(pending.size());
+    for (size_t i = 0; i < pending.size(); i++) {
+        // textures still streaming their first levels sample the placeholder
+        const Texture &texture = textures[pending[i]];
+        imageInfos[i].imageView = texture.view != VK_NULL_HANDLE ? texture.view : placeholderTexture.view;
+        imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = vkBindlessSets[currentFrame];
+        writes[i].dstBinding = 0;
+        writes[i].dstArrayElement = pending[i];
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        writes[i].pImageInfo = &imageInfos[i];
+    }
+    vkUpdateDescriptorSets(vkDevice, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    pending.clear();
+}
+
+void Rovski::WriteBindlessBuffers(uint32_t frame) {
+    // the frame's fence passed, nothing pending reads its table
+    if (vkBindlessSets.empty()) {
+        return;
+    }
+    std::array<VkDescriptorBufferInfo, 2> bufferInfos{};
+    bufferInfos[bindlessObjectBuffer] = {vkObjectBuffer, 0, VK_WHOLE_SIZE};
+    bufferInfos[bindlessObjectTextureBuffer] = {vkObjectTextureBuffer, 0, VK_WHOLE_SIZE};
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = vkBindlessSets[frame];
+    write.dstBinding = 2;
+    write.dstArrayElement = 0;
+    write.descriptorCount = static_cast<uint32_t>(bufferInfos.size());
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = bufferInfos.data();
+    vkUpdateDescriptorSets(vkDevice, 1, &write, 0, nullptr);
+}
+
 bool Rovski::CreateTextureImage() {
-    int texHeight, texWidth, texChannels;
-    stbi_uc* pixels = stbi_load("/Users/luobin/Rovski/Rovski/Texture/texture.jpg", &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-    VkDeviceSize imageSize = texWidth * texHeight * 4;
-    if (!pixels) {
-        std::cout << __LINE__ << std::endl;
+    ROVSKI_CPU_FUNCTION();
+    // mid grey, sampled by every texture that is still streaming
+    std::vector<uint8_t> grey(4 * 4 * 4, 128);
+    for (size_t i = 3; i < grey.size(); i += 4) {
+        grey[i] = 255;
+    }
+    if (!UploadTexture(4, 4, grey.data(), placeholderTexture)) {
+        std::cout << "failed to create placeholder texture" << std::endl;
         return false;
     }
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingMemory;
-    CreateBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 stagingBuffer, stagingMemory, false);
-    void *data;
-    vkMapMemory(vkDevice, stagingMemory, 0, imageSize, 0, &data);
-    memcpy(data, pixels, imageSize);
-    vkUnmapMemory(vkDevice, stagingMemory);
-    stbi_image_free(pixels);
-
-    if (!CreateImage(texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
-                             VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vkTextureImage,
-                             vkTextureMemory)) {
+    // texture 0 streams like any other, its descriptor set is written with the rest in CreateDescriptorSet
+    std::string path = defaultTexturePath.empty() ? ROVSKI_TEXTURE_DIR "texture.jpg" : defaultTexturePath;
+    StreamingTexture streaming;
+    streaming.texture = static_cast<uint32_t>(textures.size());
+    streaming.ticket = textureStreamer->Request(MakeTextureRequest(path, TextureKind::Color), 0);
+    textures.push_back({});
+    streamingTextures.push_back(std::move(streaming));
+    // decoding overlaps the rest of Init
+    textureStreamer->Pump();
+    return true;
+}
+
+bool Rovski::UploadTexture(uint32_t width, uint32_t height, const void *pixels, Texture &texture) {
+    const VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+    const uint32_t mipLevels = MipLevelCount(width, height);
+    const bool blit = SupportsLinearBlit(format);
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    if (blit) {
+        usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
+    if (!CreateImage(width, height, format, VK_IMAGE_TILING_OPTIMAL, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture.image,
+                     texture.memory, mipLevels)) {
         std::cout << __LINE__ << std::endl;
         return false;
     }
-    TransitionImageLayout(vkTextureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    std::cout << texHeight << "x" << texWidth << "=" << texHeight * texWidth << ", channels: " << texChannels << std::endl;
-    CopyBufferToImage(stagingBuffer, vkTextureImage, texWidth, texHeight);
-    TransitionImageLayout(vkTextureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    vkDestroyBuffer(vkDevice, stagingBuffer, nullptr);
-    vkFreeMemory(vkDevice, stagingMemory, nullptr);
+    TransitionImageLayout(texture.image, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, mipLevels);
+    VkImageSubresourceLayers subresource{};
+    subresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    subresource.mipLevel = 0;
+    subresource.baseArrayLayer = 0;
+    subresource.layerCount = 1;
+    bool uploaded = uploadEngine.UploadImage(texture.image, subresource, {width, height, 1}, pixels, 4);
+    if (blit) {
+        uploadEngine.GenerateMipmaps(texture.image, {width, height}, mipLevels, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    } else {
+        // no linear blits for this format, filter on the CPU and upload every level
+        MipChain chain;
+        {
+            ROVSKI_CPU_SCOPE("build mip chain");
+            chain.Build(static_cast<const uint8_t*>(pixels), width, height, true);
+        }
+        for (uint32_t level = 1; uploaded && level < mipLevels; level++) {
+            subresource.mipLevel = level;
+            uploaded = uploadEngine.UploadImage(texture.image, subresource, {chain.widths[level - 1], chain.heights[level - 1], 1},
+                                                chain.data.data() + chain.levelOffsets[level - 1], 4);
+        }
+        TransitionImageLayout(texture.image, format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, mipLevels);
+    }
+    texture.view = uploaded ? CreateImageView(texture.image, format, mipLevels) : VK_NULL_HANDLE;
+    if (texture.view == VK_NULL_HANDLE) {
+        DeferDestroyTexture(texture);
+        return false;
+    }
     return true;
 }
 
+bool Rovski::LoadTexture(const std::string &path, uint32_t &texture, TextureKind kind) {
+    ROVSKI_CPU_FUNCTION();
+    if (textures.size() >= maxTextures) {
+        std::cout << "texture limit reached" << std::endl;
+        return false;
+    }
+    Texture loaded;
+    if (!LoadTextureImage(path, kind, loaded)) {
+        return false;
+    }
+    return AddTexture(loaded, texture);
+}
+
+bool Rovski::LoadTextureImage(const std::string &path, TextureKind kind, Texture &texture) {
+    ROVSKI_CPU_FUNCTION();
+    PreparedTexture prepared;
+    if (!PrepareTexture(MakeTextureRequest(path, kind), *jobSystem, prepared)) {
+        return false;
+    }
+    if (!SupportsSampling(prepared.format)) {
+        std::cout << path << ": format " << prepared.format << " can't be sampled on this device" << std::endl;
+        return false;
+    }
+    return UploadTextureLevels(prepared.format, prepared.width, prepared.height, prepared.levels, texture);
+}
+
+TextureRequest Rovski::MakeTextureRequest(const std::string &path, TextureKind kind) const {
+    TextureRequest request;
+    request.path = path;
+    request.kind = kind;
+    request.quality = textureQuality;
+    for (bool hasAlpha : {false, true}) {
+        TextureFormatChoice &choice = hasAlpha ? request.alpha : request.opaque;
+        choice.compressed = SelectBlockFormat(kind, hasAlpha, choice.blockFormat);
+        choice.format = SelectTextureFormat(kind, hasAlpha);
+    }
+    return request;
+}
+
+bool Rovski::RequestTexture(const std::string &path, uint32_t &texture, TextureKind kind, float priority) {
+    ROVSKI_CPU_FUNCTION();
+    if (textures.size() >= maxTextures) {
+        std::cout << "texture limit reached" << std::endl;
+        return false;
+    }
+    Texture pending;
+    if (!AddTexture(pending, texture)) {
+        return false;
+    }
+    StreamingTexture streaming;
+    streaming.texture = texture;
+    streaming.hint = priority;
+    streaming.priority = priority;
+    streaming.ticket = textureStreamer->Request(MakeTextureRequest(path, kind), priority);
+    streamingTextures.push_back(std::move(streaming));
+    textureStreamer->Pump();
+    return true;
+}
+
+void Rovski::FinishTextureStreaming() {
+    ROVSKI_CPU_FUNCTION();
+    textureStreamer->Finish();
+    // no upload budget here, every level goes out in the next flush
+    VkDeviceSize budget = streamBytesPerFrame;
+    streamBytesPerFrame = std::numeric_limits<VkDeviceSize>::max();
+    StreamTextures();
+    streamBytesPerFrame = budget;
+}
+
+void Rovski::StreamTextures() {
+    ROVSKI_CPU_FUNCTION();
+    ReleaseRetiredBindings(false);
+    if (streamingTextures.empty()) {
+        return;
+    }
+    UpdateTexturePriorities();
+    textureStreamer->Pump();
+    uint32_t ticket;
+    std::unique_ptr<PreparedTexture> prepared;
+    while (textureStreamer->TakeReady(ticket, prepared)) {
+        auto streaming = std::find_if(streamingTextures.begin(), streamingTextures.end(),
+                                      [ticket](const StreamingTexture &candidate) { return candidate.ticket == ticket; });
+        if (!prepared || !BeginStreamedTexture(*streaming, std::move(prepared))) {
+            std::cout << "texture " << streaming->texture << " keeps the placeholder" << std::endl;
+            streamingTextures.erase(streaming);
+        }
+    }
+    // the larger levels, most important texture first; one level always goes so huge mips can't stall streaming
+    std::sort(streamingTextures.begin(), streamingTextures.end(),
+              [](const StreamingTexture &a, const StreamingTexture &b) { return a.priority > b.priority; });
+    VkDeviceSize uploaded = 0;
+    for (auto &streaming : streamingTextures) {
+        if (!streaming.prepared) {
+            continue;
+        }
+        while (streaming.residentLevel > 0) {
+            VkDeviceSize size = streaming.prepared->levels[streaming.residentLevel - 1].size;
+            if ((uploaded > 0 && uploaded + size > streamBytesPerFrame) || !UploadStreamedLevel(streaming, streaming.residentLevel - 1)) {
+                break;
+            }
+            uploaded += size;
+        }
+        // a full descriptor pool only delays the switch, the next frame tries again
+        if (streaming.boundLevel != streaming.residentLevel) {
+            BindStreamedLevels(streaming);
+        }
+    }
+    std::erase_if(streamingTextures, [](const StreamingTexture &streaming) { return streaming.prepared && streaming.boundLevel == 0; });
+}
+
+void Rovski::UpdateTexturePriorities() {
+    ROVSKI_CPU_FUNCTION();
+    // roughly the share of the screen each texture covers: (radius / distance)^2 summed over the draws sampling it,
+    // with the model's longest axis standing in for the radius
+    textureImportance.assign(textures.size(), 0.0f);
+    glm::vec3 eye = glm::vec3(glm::inverse(frameView)[3]);
+    for (const DrawCommand &draw : drawList) {
+        if (draw.texture >= textureImportance.size()) {
+            continue;
+        }
+        float radius = std::max({glm::length(glm::vec3(draw.model[0])), glm::length(glm::vec3(draw.model[1])),
+                                 glm::length(glm::vec3(draw.model[2]))});
+        float distance = std::max(glm::length(glm::vec3(draw.model[3]) - eye), radius);
+        if (distance > 0) {
+            textureImportance[draw.texture] += (radius / distance) * (radius / distance);
+        }
+    }
+    for (auto &streaming : streamingTextures) {
+        streaming.priority = streaming.hint + textureImportance[streaming.texture];
+        textureStreamer->SetPriority(streaming.ticket, streaming.priority);
+    }
+}
+
+bool Rovski::BeginStreamedTexture(StreamingTexture &streaming, std::unique_ptr<PreparedTexture> prepared) {
+    ROVSKI_CPU_FUNCTION();
+    if (!SupportsSampling(prepared->format)) {
+        std::cout << "format " << prepared->format << " can't be sampled on this device" << std::endl;
+        return false;
+    }
+    Texture &texture = textures[streaming.texture];
+    const uint32_t mipLevels = static_cast<uint32_t>(prepared->levels.size());
+    if (!CreateImage(prepared->width, prepared->height, prepared->format, VK_IMAGE_TILING_OPTIMAL,
+                     VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                     texture.image, texture.memory, mipLevels)) {
+        return false;
+    }
+    TransitionImageLayout(texture.image, prepared->format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, mipLevels);
+    // the tail, every level no larger than streamTailSize and at least the smallest one, goes up right away
+    uint32_t tail = mipLevels - 1;
+    while (tail > 0 && std::max(prepared->width >> (tail - 1), prepared->height >> (tail - 1)) <= streamTailSize) {
+        tail--;
+    }
+    streaming.prepared = std::move(prepared);
+    streaming.residentLevel = mipLevels;
+    streaming.boundLevel = mipLevels;
+    while (streaming.residentLevel > tail) {
+        if (!UploadStreamedLevel(streaming, streaming.residentLevel - 1)) {
+            // never bound, so only the image goes; the set keeps sampling the placeholder
+            VkDescriptorSet descriptorSet = texture.descriptorSet;
+            DeferDestroyTexture(texture);
+            texture.descriptorSet = descriptorSet;
+            return false;
+        }
+    }
+    BindStreamedLevels(streaming);
+    return true;
+}
+
+bool Rovski::UploadStreamedLevel(StreamingTexture &streaming, uint32_t level) {
+    const PreparedTexture &prepared = *streaming.prepared;
+    Texture &texture = textures[streaming.texture];
+    uint32_t blockBytes, blockDim;
+    if (!FormatBlockInfo(prepared.format, blockBytes, blockDim)) {
+        return false;
+    }
+    VkImageSubresourceLayers subresource{};
+    subresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    subresource.mipLevel = level;
+    subresource.baseArrayLayer = 0;
+    subresource.layerCount = 1;
+    VkExtent3D extent = {std::max(1u, prepared.width >> level), std::max(1u, prepared.height >> level), 1};
+    if (!uploadEngine.UploadImage(texture.image, subresource, extent, prepared.levels[level].data, blockBytes, blockDim)) {
+        return false;
+    }
+    TransitionImageLayout(texture.image, prepared.format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, level, 1);
+    streaming.residentLevel = level;
+    return true;
+}
+
+bool Rovski::BindStreamedLevels(StreamingTexture &streaming) {
+    Texture &texture = textures[streaming.texture];
+    const uint32_t mipLevels = static_cast<uint32_t>(streaming.prepared->levels.size());
+    // the levels still waiting for their copies stay outside the view
+    Texture bound = texture;
+    bound.view = CreateImageView(texture.image, streaming.prepared->format, mipLevels - streaming.residentLevel, streaming.residentLevel);
+    if (bound.view == VK_NULL_HANDLE || !WriteTextureDescriptorSet(bound)) {
+        vkDestroyImageView(vkDevice, bound.view, nullptr);
+        return false;
+    }
+    // frames in flight may still sample through the old set and view
+    Texture retired;
+    retired.view = texture.view;
+    retired.descriptorSet = texture.descriptorSet;
+    retiredTextureBindings.emplace_back(frameStats.frameIndex + maxFrameInFlight, retired);
+    texture.view = bound.view;
+    texture.descriptorSet = bound.descriptorSet;
+    // the tables of the frames in flight keep the old view until each flushes, before it is retired
+    WriteBindlessTexture(streaming.texture);
+    streaming.boundLevel = streaming.residentLevel;
+    return true;
+}
+
+void Rovski::ReleaseRetiredBindings(bool all) {
+    std::erase_if(retiredTextureBindings, [this, all](std::pair<uint64_t, Texture> &retired) {
+        if (!all && retired.first > frameStats.frameIndex) {
+            return false;
+        }
+        vkDestroyImageView(vkDevice, retired.second.view, nullptr);
+        vkFreeDescriptorSets(vkDevice, vkDescriptorPool, 1, &retired.second.descriptorSet);
+        return true;
+    });
+}
+
+bool Rovski::UploadTextureLevels(VkFormat format, uint32_t width, uint32_t height, const std::vector<Ktx2Level> &levels, Texture &texture) {
+    ROVSKI_CPU_FUNCTION();
+    uint32_t blockBytes, blockDim;
+    if (!FormatBlockInfo(format, blockBytes, blockDim) || levels.empty()) {
+        return false;
+    }
+    const uint32_t mipLevels = static_cast<uint32_t>(levels.size());
+    if (!CreateImage(width, height, format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture.image, texture.memory, mipLevels)) {
+        std::cout << "failed to create texture image" << std::endl;
+        return false;
+    }
+    TransitionImageLayout(texture.image, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, mipLevels);
+    VkImageSubresourceLayers subresource{};
+    subresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    subresource.baseArrayLayer = 0;
+    subresource.layerCount = 1;
+    bool uploaded = true;
+    for (uint32_t level = 0; uploaded && level < mipLevels; level++) {
+        subresource.mipLevel = level;
+        VkExtent3D extent = {std::max(1u, width >> level), std::max(1u, height >> level), 1};
+        uploaded = uploadEngine.UploadImage(texture.image, subresource, extent, levels[level].data, blockBytes, blockDim);
+    }
+    TransitionImageLayout(texture.image, format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, mipLevels);
+    texture.view = uploaded ? CreateImageView(texture.image, format, mipLevels) : VK_NULL_HANDLE;
+    if (texture.view == VK_NULL_HANDLE) {
+        DeferDestroyTexture(texture);
+        return false;
+    }
+    return true;
+}
+
+bool Rovski::AddTexture(Texture &created, uint32_t &texture) {
+    if (!WriteTextureDescriptorSet(created)) {
+        DeferDestroyTexture(created);
+        return false;
+    }
+    texture = static_cast<uint32_t>(textures.size());
+    textures.push_back(created);
+    WriteBindlessTexture(texture);
+    return true;
+}
+
+void Rovski::DeferDestroyTexture(Texture &texture) {
+    if (texture.view != VK_NULL_HANDLE) {
+        vkDestroyImageView(vkDevice, texture.view, nullptr);
+    }
+    // the image may still be referenced by recorded copies, release it with their batch
+    VkImage image = texture.image;
+    MemoryAllocation memory = texture.memory;
+    uploadEngine.DeferRelease([this, image, memory]() mutable { DestroyImage(image, memory); });
+    texture = {};
+}
+
+bool Rovski::SupportsSampling(VkFormat format) const {
+    uint32_t blockBytes, blockDim;
+    if (!FormatBlockInfo(format, blockBytes, blockDim) || (blockDim > 1 && vkDeviceFeatures.textureCompressionBC != VK_TRUE)) {
+        return false;
+    }
+    VkFormatProperties properties{};
+    vkGetPhysicalDeviceFormatProperties(vkPhysicalDevice, format, &properties);
+    const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (properties.optimalTilingFeatures & required) == required;
+}
+
+bool Rovski::SelectBlockFormat(TextureKind kind, bool hasAlpha, BlockFormat &format) const {
+    // texture memory is the tighter limit: opaque color takes BC1 at half the size of BC7
+    std::vector<BlockFormat> candidates;
+    if (kind == TextureKind::NormalMap) {
+        candidates = {BlockFormat::BC5};
+    } else if (hasAlpha) {
+        candidates = {BlockFormat::BC7, BlockFormat::BC3};
+    } else {
+        candidates = {BlockFormat::BC1, BlockFormat::BC7};
+    }
+    for (BlockFormat candidate : candidates) {
+        if (SupportsSampling(BlockVkFormat(candidate, kind == TextureKind::Color))) {
+            format = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+VkFormat Rovski::SelectTextureFormat(TextureKind kind, bool hasAlpha) const {
+    bool srgb = kind == TextureKind::Color;
+    BlockFormat blockFormat;
+    if (SelectBlockFormat(kind, hasAlpha, blockFormat)) {
+        return BlockVkFormat(blockFormat, srgb);
+    }
+    return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+}
+
+bool Rovski::CreateTexture(uint32_t width, uint32_t height, const void *pixels, uint32_t &texture) {
+    ROVSKI_CPU_FUNCTION();
+    if (textures.size() >= maxTextures) {
+        std::cout << "texture limit reached" << std::endl;
+        return false;
+    }
+    Texture created;
+    if (!UploadTexture(width, height, pixels, created)) {
+        return false;
+    }
+    return AddTexture(created, texture);
+}
+
+std::string Rovski::GetDeviceName() const {
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(vkPhysicalDevice, &properties);
+    return properties.deviceName;
+}
+
 bool Rovski::CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling,
                          VkImageUsageFlags usageFlags, VkMemoryPropertyFlags propertyFlags, VkImage &image,
-                         VkDeviceMemory &imageMemory) {
+                         MemoryAllocation &imageMemory, uint32_t mipLevels) {
     VkImageCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     createInfo.imageType = VK_IMAGE_TYPE_2D;
     createInfo.extent.depth = 1;
     createInfo.extent.width = width;
     createInfo.extent.height = height;
-    createInfo.mipLevels = 1;
+    createInfo.mipLevels = mipLevels;
     createInfo.arrayLayers = 1;
     createInfo.format = format;
     createInfo.tiling = tiling;
@@ -1255,112 +3644,45 @@ bool Rovski::CreateImage(uint32_t width, uint32_t height, VkFormat format, VkIma
         return false;
     }
     VkMemoryRequirements memoryRequirements{};
-    vkGetImageMemoryRequirements(vkDevice, vkTextureImage, &memoryRequirements);
-    VkMemoryAllocateInfo allocateInfo{};
-    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocateInfo.allocationSize = memoryRequirements.size;
-    allocateInfo.memoryTypeIndex = FindMemoryType(memoryRequirements.memoryTypeBits, propertyFlags);
-    if (VK_SUCCESS != vkAllocateMemory(vkDevice, &allocateInfo, nullptr, &imageMemory)) {
+    vkGetImageMemoryRequirements(vkDevice, image, &memoryRequirements);
+    uint32_t memoryType = FindMemoryType(memoryRequirements.memoryTypeBits, propertyFlags);
+    auto kind = tiling == VK_IMAGE_TILING_LINEAR ? DeviceMemoryAllocator::ResourceKind::Buffer : DeviceMemoryAllocator::ResourceKind::Image;
+    if (!memoryAllocator.Allocate(memoryRequirements, memoryType, kind, imageMemory)) {
         std::cout << __LINE__ << std::endl;
+        vkDestroyImage(vkDevice, image, nullptr);
+        image = VK_NULL_HANDLE;
         return false;
     }
-    vkBindImageMemory(vkDevice, vkTextureImage, vkTextureMemory, 0);
+    vkBindImageMemory(vkDevice, image, imageMemory.memory, imageMemory.offset);
     return true;
 }
 
-VkCommandBuffer Rovski::BeginSingleTimeCommands() {
-    VkCommandBufferAllocateInfo allocateInfo{};
-    allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocateInfo.commandBufferCount = 1;
-    allocateInfo.commandPool = vkCommandPool;
-    allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    VkCommandBuffer commandBuffer;
-    vkAllocateCommandBuffers(vkDevice, &allocateInfo, &commandBuffer);
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    vkBeginCommandBuffer(commandBuffer, &beginInfo);
-    return commandBuffer;
+void Rovski::DestroyImage(VkImage &image, MemoryAllocation &imageMemory) {
+    vkDestroyImage(vkDevice, image, nullptr);
+    memoryAllocator.Free(imageMemory);
+    image = VK_NULL_HANDLE;
 }
 
-void Rovski::EndSingleTimeCommands(VkCommandBuffer commandBuffer) {
-    vkEndCommandBuffer(commandBuffer);
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
-    vkQueueSubmit(vkGraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(vkGraphicsQueue);
-    vkFreeCommandBuffers(vkDevice, vkCommandPool, 1, &commandBuffer);
+void Rovski::TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout,
+                                   uint32_t baseMipLevel, uint32_t levelCount) {
+    VkImageSubresourceRange range{};
+    range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    range.baseArrayLayer = 0;
+    range.baseMipLevel = baseMipLevel;
+    range.layerCount = 1;
+    range.levelCount = levelCount;
+    uploadEngine.TransitionImageLayout(image, range, oldLayout, newLayout);
 }
 
-bool Rovski::CopyBuffer(VkBuffer &dst, VkBuffer &src, VkDeviceSize size) {
-    VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
-    VkBufferCopy region{};
-    region.size = size;
-    vkCmdCopyBuffer(commandBuffer, src, dst, 1, &region);
-    EndSingleTimeCommands(commandBuffer);
-    return true;
+bool Rovski::SupportsLinearBlit(VkFormat format) const {
+    VkFormatProperties properties{};
+    vkGetPhysicalDeviceFormatProperties(vkPhysicalDevice, format, &properties);
+    const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                          VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (properties.optimalTilingFeatures & required) == required;
 }
 
-void Rovski::TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout) {
-    VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
-    VkImageMemoryBarrier barrier{};
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.oldLayout = oldLayout;
-    barrier.newLayout = newLayout;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image = image;
-    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.layerCount = 1;
-    barrier.subresourceRange.levelCount = 1;
-
-    VkPipelineStageFlags srcStage, dstStage;
-    if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-        barrier.srcAccessMask = 0;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL){
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    } else {
-        std::cout << "Invalid transition type!" << std::endl;
-    }
-
-    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-    EndSingleTimeCommands(commandBuffer);
-}
-
-void Rovski::CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
-    VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
-    VkBufferImageCopy region{};
-    region.bufferImageHeight = 0;
-    region.bufferRowLength = 0;
-    region.bufferOffset = 0;
-    region.imageSubresource.layerCount = 1;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageOffset = {0,0,0};
-    region.imageExtent = {width, height, 1};
-    vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-    EndSingleTimeCommands(commandBuffer);
-}
-
-bool Rovski::CreateTextureImageView() {
-    vkTextureImageView = CreateImageView(vkTextureImage, VK_FORMAT_R8G8B8A8_SRGB);
-    if (vkTextureImageView == VK_NULL_HANDLE) {
-        return false;
-    }
-    return true;
-}
-VkImageView Rovski::CreateImageView(VkImage image, VkFormat format) {
+VkImageView Rovski::CreateImageView(VkImage image, VkFormat format, uint32_t mipLevels, uint32_t baseMipLevel, VkImageAspectFlags aspect) {
     VkImageViewCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     createInfo.image = image;
@@ -1370,10 +3692,10 @@ VkImageView Rovski::CreateImageView(VkImage image, VkFormat format) {
     createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
     createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
     createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-    createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    createInfo.subresourceRange.aspectMask = aspect;
     createInfo.subresourceRange.baseArrayLayer = 0;
-    createInfo.subresourceRange.baseMipLevel = 0;
-    createInfo.subresourceRange.levelCount = 1;
+    createInfo.subresourceRange.baseMipLevel = baseMipLevel;
+    createInfo.subresourceRange.levelCount = mipLevels;
     createInfo.subresourceRange.layerCount = 1;
     VkImageView imageView;
     if (VK_SUCCESS != vkCreateImageView(vkDevice, &createInfo, nullptr, &imageView)) {
@@ -1383,6 +3705,7 @@ VkImageView Rovski::CreateImageView(VkImage image, VkFormat format) {
 }
 
 bool Rovski::CreateTextureSampler() {
+    ROVSKI_CPU_FUNCTION();
     VkSamplerCreateInfo createInfo{};
     VkPhysicalDeviceProperties deviceProperties{};
     vkGetPhysicalDeviceProperties(vkPhysicalDevice, &deviceProperties);
@@ -1406,7 +3729,7 @@ bool Rovski::CreateTextureSampler() {
     createInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     createInfo.mipLodBias = 0.0f;
     createInfo.minLod = 0.0f;
-    createInfo.maxLod = 0.0f;
+    createInfo.maxLod = VK_LOD_CLAMP_NONE;
     if (VK_SUCCESS != vkCreateSampler(vkDevice, &createInfo, nullptr, &vkTextureSampler)) {
         return false;
     }
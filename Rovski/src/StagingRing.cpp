@@ -0,0 +1,28 @@
+//
+//  StagingRing.cpp
+//  Rovski
+//
+
+#include "StagingRing.hpp"
+
+void StagingRing::Init(VkBuffer buffer, void *mapped, uint64_t capacity) {
+    this->buffer = buffer;
+    this->mapped = static_cast<char*>(mapped);
+    this->capacity = capacity;
+    head = 0;
+    tail = 0;
+}
+
+bool StagingRing::Allocate(uint64_t size, uint64_t alignment, uint64_t &offset) {
+    uint64_t begin = (head + alignment - 1) / alignment * alignment;
+    // a copy source has to be contiguous, skip the rest of the ring when it doesn't fit before the end
+    if (begin % capacity + size > capacity) {
+        begin = (begin / capacity + 1) * capacity;
+    }
+    if (begin + size - tail > capacity) {
+        return false;
+    }
+    head = begin + size;
+    offset = begin % capacity;
+    return true;
+}
@@ -0,0 +1,199 @@
+//
+//  TextureStreamer.cpp
+//  Rovski
+//
+
+#include "TextureStreamer.hpp"
+#include "CpuProfiler.hpp"
+#include "MappedFile.hpp"
+#include "MipChain.hpp"
+#include "stb_image.h"
+#include <algorithm>
+#include <iostream>
+
+bool PrepareTexture(const TextureRequest &request, JobSystem &jobSystem, PreparedTexture &prepared) {
+    ROVSKI_CPU_FUNCTION();
+    const std::string &path = request.path;
+    if (path.size() > 5 && path.compare(path.size() - 5, 5, ".ktx2") == 0) {
+        if (!prepared.ktx.Open(path)) {
+            std::cout << "failed to read texture " << path << std::endl;
+            return false;
+        }
+        prepared.format = prepared.ktx.Format();
+        prepared.width = prepared.ktx.Width();
+        prepared.height = prepared.ktx.Height();
+        prepared.levels = prepared.ktx.Levels();
+        return true;
+    }
+
+    MappedFile source;
+    if (!source.Open(path)) {
+        std::cout << "failed to read texture " << path << std::endl;
+        return false;
+    }
+    // everything the encoded levels depend on besides the device, which is checked through the format
+    std::string sourceKey = std::to_string(HashBytes(source.Data(), source.Size())) + "/" +
+                            std::to_string(static_cast<int>(request.kind)) + "/" + std::to_string(static_cast<int>(request.quality));
+    std::string cachePath = path + ".ktx2";
+    Ktx2File &ktx = prepared.ktx;
+    if (ktx.Open(cachePath) && ktx.Value("rovski.source") == sourceKey &&
+        (ktx.Format() == request.opaque.format || ktx.Format() == request.alpha.format)) {
+        prepared.format = ktx.Format();
+        prepared.width = ktx.Width();
+        prepared.height = ktx.Height();
+        prepared.levels = ktx.Levels();
+        return true;
+    }
+    ktx = Ktx2File();
+
+    int width, height, channels;
+    stbi_uc *pixels;
+    {
+        ROVSKI_CPU_SCOPE("decode image");
+        pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(source.Data()), static_cast<int>(source.Size()),
+                                       &width, &height, &channels, STBI_rgb_alpha);
+    }
+    if (!pixels) {
+        std::cout << path << ": " << stbi_failure_reason() << std::endl;
+        return false;
+    }
+    const uint32_t texelCount = static_cast<uint32_t>(width) * static_cast<uint32_t>(height);
+    bool hasAlpha = false;
+    if (request.kind == TextureKind::Color && (channels == 2 || channels == 4)) {
+        for (uint32_t i = 0; i < texelCount && !hasAlpha; i++) {
+            hasAlpha = pixels[i * 4 + 3] != 255;
+        }
+    }
+    const TextureFormatChoice &choice = hasAlpha ? request.alpha : request.opaque;
+
+    // levels are filtered from the uncompressed image and then encoded one by one
+    MipChain chain;
+    {
+        ROVSKI_CPU_SCOPE("build mip chain");
+        chain.Build(pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height), request.kind == TextureKind::Color);
+    }
+    const uint32_t mipLevels = chain.LevelCount() + 1;
+    prepared.format = choice.format;
+    prepared.width = static_cast<uint32_t>(width);
+    prepared.height = static_cast<uint32_t>(height);
+    prepared.levels.resize(mipLevels);
+    if (choice.compressed) {
+        prepared.storage.resize(mipLevels);
+        BlockEncoder encoder(jobSystem);
+        for (uint32_t level = 0; level < mipLevels; level++) {
+            const uint8_t *texels = level == 0 ? pixels : chain.data.data() + chain.levelOffsets[level - 1];
+            uint32_t levelWidth = level == 0 ? prepared.width : chain.widths[level - 1];
+            uint32_t levelHeight = level == 0 ? prepared.height : chain.heights[level - 1];
+            encoder.Encode(choice.blockFormat, request.quality, texels, levelWidth, levelHeight, prepared.storage[level]);
+            prepared.levels[level] = {prepared.storage[level].data(), prepared.storage[level].size()};
+        }
+    } else {
+        // the levels outlive the decoded image, keep level 0 and the chain as they are
+        prepared.storage.emplace_back(pixels, pixels + size_t(texelCount) * 4);
+        prepared.storage.push_back(std::move(chain.data));
+        prepared.levels[0] = {prepared.storage[0].data(), prepared.storage[0].size()};
+        for (uint32_t level = 1; level < mipLevels; level++) {
+            prepared.levels[level] = {prepared.storage[1].data() + chain.levelOffsets[level - 1],
+                                      uint64_t(chain.widths[level - 1]) * chain.heights[level - 1] * 4};
+        }
+    }
+    stbi_image_free(pixels);
+    if (!Ktx2File::Write(cachePath, prepared.format, prepared.width, prepared.height, prepared.levels,
+                         {{"KTXwriter", "Rovski"}, {"rovski.source", sourceKey}})) {
+        std::cout << "failed to write texture cache " << cachePath << std::endl;
+    }
+    return true;
+}
+
+TextureStreamer::TextureStreamer(uint32_t workerCount) : jobs(std::max(1u, workerCount), "texture worker"),
+                                                         maxDecoding(std::max(1u, workerCount)) {
+}
+
+TextureStreamer::~TextureStreamer() {
+    // the jobs write into entries, let them finish before either goes away
+    jobs.Wait(counter);
+}
+
+uint32_t TextureStreamer::Request(TextureRequest request, float priority) {
+    uint32_t ticket = static_cast<uint32_t>(entries.size());
+    Entry &entry = entries.emplace_back();
+    entry.request = std::move(request);
+    entry.priority = priority;
+    heap.push_back({priority, ticket, entry.version});
+    std::push_heap(heap.begin(), heap.end());
+    queuedCount++;
+    return ticket;
+}
+
+void TextureStreamer::SetPriority(uint32_t ticket, float priority) {
+    Entry &entry = entries[ticket];
+    if (entry.state != State::Queued || entry.priority == priority) {
+        return;
+    }
+    // the old heap item stays behind and is dropped by Pump once its version no longer matches
+    entry.priority = priority;
+    entry.version++;
+    heap.push_back({priority, ticket, entry.version});
+    std::push_heap(heap.begin(), heap.end());
+}
+
+void TextureStreamer::Pump() {
+    ROVSKI_CPU_FUNCTION();
+    // finished decodes wait in decoding until they're taken, only the running ones count against the limit
+    uint32_t running = 0;
+    for (uint32_t ticket : decoding) {
+        running += entries[ticket].done.load(std::memory_order_acquire) ? 0 : 1;
+    }
+    if (running < maxDecoding) {
+        Start(maxDecoding - running);
+    }
+}
+
+void TextureStreamer::Start(uint32_t count) {
+    while (count > 0 && !heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end());
+        HeapItem item = heap.back();
+        heap.pop_back();
+        Entry &entry = entries[item.ticket];
+        if (entry.state != State::Queued || entry.version != item.version) {
+            continue;
+        }
+        entry.state = State::Decoding;
+        queuedCount--;
+        decoding.push_back(item.ticket);
+        count--;
+        Entry *decoded = &entry;
+        jobs.Submit([this, decoded](uint32_t) {
+            auto prepared = std::make_unique<PreparedTexture>();
+            if (PrepareTexture(decoded->request, jobs, *prepared)) {
+                decoded->prepared = std::move(prepared);
+            }
+            decoded->done.store(true, std::memory_order_release);
+        }, counter);
+    }
+}
+
+bool TextureStreamer::TakeReady(uint32_t &ticket, std::unique_ptr<PreparedTexture> &prepared) {
+    auto best = decoding.end();
+    for (auto it = decoding.begin(); it != decoding.end(); ++it) {
+        if (entries[*it].done.load(std::memory_order_acquire) && (best == decoding.end() || entries[*it].priority > entries[*best].priority)) {
+            best = it;
+        }
+    }
+    if (best == decoding.end()) {
+        return false;
+    }
+    ticket = *best;
+    decoding.erase(best);
+    Entry &entry = entries[ticket];
+    entry.state = State::Taken;
+    entry.request = {};
+    prepared = std::move(entry.prepared);
+    return true;
+}
+
+void TextureStreamer::Finish() {
+    ROVSKI_CPU_FUNCTION();
+    Start(queuedCount);
+    jobs.Wait(counter);
+}
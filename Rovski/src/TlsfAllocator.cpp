@@ -0,0 +1,216 @@
+//
+//  TlsfAllocator.cpp
+//  Rovski
+//
+
+#include "TlsfAllocator.hpp"
+#include <bit>
+#include <algorithm>
+
+TlsfAllocator::TlsfAllocator(uint64_t capacity) {
+    Reset(capacity);
+}
+
+void TlsfAllocator::Reset(uint64_t capacity) {
+    this->capacity = capacity;
+    usedSize = 0;
+    allocationCount = 0;
+    flBitmap = 0;
+    slBitmap.fill(0);
+    for (auto &heads : freeHeads) {
+        heads.fill(InvalidNode);
+    }
+    blocks.clear();
+    unusedNodes.clear();
+    if (capacity == 0) {
+        return;
+    }
+    uint32_t node = NewNode();
+    blocks[node].offset = 0;
+    blocks[node].size = capacity;
+    InsertFreeBlock(node);
+}
+
+void TlsfAllocator::Mapping(uint64_t size, uint32_t &fl, uint32_t &sl) {
+    if (size < SlCount) {
+        fl = 0;
+        sl = static_cast<uint32_t>(size);
+    } else {
+        uint32_t msb = 63 - std::countl_zero(size);
+        fl = msb - SlIndexLog2 + 1;
+        sl = static_cast<uint32_t>(size >> (msb - SlIndexLog2)) ^ SlCount;
+    }
+}
+
+uint32_t TlsfAllocator::FindSuitableBlock(uint64_t size) {
+    // round the request up to the next list boundary so any block in the list fits
+    uint64_t rounded = size;
+    if (size >= SlCount) {
+        uint32_t msb = 63 - std::countl_zero(size);
+        rounded += (1ull << (msb - SlIndexLog2)) - 1;
+    }
+    uint32_t fl, sl;
+    Mapping(rounded, fl, sl);
+    uint32_t slMap = slBitmap[fl] & (~0u << sl);
+    if (slMap == 0) {
+        uint64_t flMap = fl + 1 < 64 ? flBitmap & (~0ull << (fl + 1)) : 0;
+        if (flMap == 0) {
+            return InvalidNode;
+        }
+        fl = std::countr_zero(flMap);
+        slMap = slBitmap[fl];
+    }
+    sl = std::countr_zero(slMap);
+    return freeHeads[fl][sl];
+}
+
+void TlsfAllocator::InsertFreeBlock(uint32_t node) {
+    uint32_t fl, sl;
+    Mapping(blocks[node].size, fl, sl);
+    uint32_t head = freeHeads[fl][sl];
+    blocks[node].free = true;
+    blocks[node].prevFree = InvalidNode;
+    blocks[node].nextFree = head;
+    if (head != InvalidNode) {
+        blocks[head].prevFree = node;
+    }
+    freeHeads[fl][sl] = node;
+    flBitmap |= 1ull << fl;
+    slBitmap[fl] |= 1u << sl;
+}
+
+void TlsfAllocator::RemoveFreeBlock(uint32_t node) {
+    uint32_t fl, sl;
+    Mapping(blocks[node].size, fl, sl);
+    Block &block = blocks[node];
+    if (block.prevFree != InvalidNode) {
+        blocks[block.prevFree].nextFree = block.nextFree;
+    } else {
+        freeHeads[fl][sl] = block.nextFree;
+    }
+    if (block.nextFree != InvalidNode) {
+        blocks[block.nextFree].prevFree = block.prevFree;
+    }
+    if (freeHeads[fl][sl] == InvalidNode) {
+        slBitmap[fl] &= ~(1u << sl);
+        if (slBitmap[fl] == 0) {
+            flBitmap &= ~(1ull << fl);
+        }
+    }
+    block.free = false;
+    block.prevFree = InvalidNode;
+    block.nextFree = InvalidNode;
+}
+
+uint32_t TlsfAllocator::NewNode() {
+    if (!unusedNodes.empty()) {
+        uint32_t node = unusedNodes.back();
+        unusedNodes.pop_back();
+        blocks[node] = Block{};
+        return node;
+    }
+    blocks.emplace_back();
+    return static_cast<uint32_t>(blocks.size() - 1);
+}
+
+void TlsfAllocator::ReleaseNode(uint32_t node) {
+    blocks[node] = Block{};
+    unusedNodes.push_back(node);
+}
+
+uint32_t TlsfAllocator::SplitBlock(uint32_t node, uint64_t size) {
+    if (blocks[node].size <= size) {
+        return InvalidNode;
+    }
+    uint32_t remain = NewNode();
+    blocks[remain].offset = blocks[node].offset + size;
+    blocks[remain].size = blocks[node].size - size;
+    blocks[remain].prevPhysical = node;
+    blocks[remain].nextPhysical = blocks[node].nextPhysical;
+    if (blocks[remain].nextPhysical != InvalidNode) {
+        blocks[blocks[remain].nextPhysical].prevPhysical = remain;
+    }
+    blocks[node].size = size;
+    blocks[node].nextPhysical = remain;
+    return remain;
+}
+
+uint32_t TlsfAllocator::MergeBlock(uint32_t node) {
+    uint32_t prev = blocks[node].prevPhysical;
+    if (prev != InvalidNode && blocks[prev].free) {
+        RemoveFreeBlock(prev);
+        blocks[prev].size += blocks[node].size;
+        blocks[prev].nextPhysical = blocks[node].nextPhysical;
+        if (blocks[prev].nextPhysical != InvalidNode) {
+            blocks[blocks[prev].nextPhysical].prevPhysical = prev;
+        }
+        ReleaseNode(node);
+        node = prev;
+    }
+    uint32_t next = blocks[node].nextPhysical;
+    if (next != InvalidNode && blocks[next].free) {
+        RemoveFreeBlock(next);
+        blocks[node].size += blocks[next].size;
+        blocks[node].nextPhysical = blocks[next].nextPhysical;
+        if (blocks[node].nextPhysical != InvalidNode) {
+            blocks[blocks[node].nextPhysical].prevPhysical = node;
+        }
+        ReleaseNode(next);
+    }
+    return node;
+}
+
+bool TlsfAllocator::Allocate(uint64_t size, uint64_t alignment, Range &range) {
+    if (size == 0) {
+        size = 1;
+    }
+    if (alignment == 0) {
+        alignment = 1;
+    }
+    uint32_t node = FindSuitableBlock(size + alignment - 1);
+    if (node == InvalidNode) {
+        return false;
+    }
+    RemoveFreeBlock(node);
+    uint64_t alignedOffset = (blocks[node].offset + alignment - 1) & ~(alignment - 1);
+    uint64_t padding = alignedOffset - blocks[node].offset;
+    if (padding > 0) {
+        // hand the alignment gap back as its own free block, the previous block is never free here
+        uint32_t tail = SplitBlock(node, padding);
+        InsertFreeBlock(node);
+        node = tail;
+    }
+    uint32_t remain = SplitBlock(node, size);
+    if (remain != InvalidNode) {
+        InsertFreeBlock(remain);
+    }
+    usedSize += blocks[node].size;
+    allocationCount++;
+    range.offset = blocks[node].offset;
+    range.size = blocks[node].size;
+    range.node = node;
+    return true;
+}
+
+void TlsfAllocator::Free(uint32_t node) {
+    if (node == InvalidNode || node >= blocks.size() || blocks[node].free) {
+        return;
+    }
+    usedSize -= blocks[node].size;
+    allocationCount--;
+    node = MergeBlock(node);
+    InsertFreeBlock(node);
+}
+
+uint64_t TlsfAllocator::LargestFreeRange() const {
+    if (flBitmap == 0) {
+        return 0;
+    }
+    uint32_t fl = 63 - std::countl_zero(flBitmap);
+    uint32_t sl = 31 - std::countl_zero(slBitmap[fl]);
+    uint64_t largest = 0;
+    for (uint32_t node = freeHeads[fl][sl]; node != InvalidNode; node = blocks[node].nextFree) {
+        largest = std::max(largest, blocks[node].size);
+    }
+    return largest;
+}
@@ -0,0 +1,32 @@
+//
+//  UniformRingBuffer.cpp
+//  Rovski
+//
+
+#include "UniformRingBuffer.hpp"
+#include <stdexcept>
+
+void UniformRingBuffer::Init(void *mapped, uint64_t sliceSize, uint32_t frameCount, uint64_t alignment) {
+    this->mapped = static_cast<char*>(mapped);
+    this->alignment = alignment == 0 ? 1 : alignment;
+    this->sliceSize = sliceSize & ~(this->alignment - 1);
+    this->frameCount = frameCount;
+    sliceBegin = 0;
+    head = 0;
+}
+
+void UniformRingBuffer::BeginFrame(uint32_t frameIndex) {
+    sliceBegin = sliceSize * (frameIndex % frameCount);
+    head = sliceBegin;
+}
+
+void *UniformRingBuffer::Allocate(uint64_t size, uint32_t &dynamicOffset) {
+    // every block is rounded up to the alignment, so offsets stay aligned without a CAS loop
+    uint64_t alignedSize = (size + alignment - 1) & ~(alignment - 1);
+    uint64_t offset = head.fetch_add(alignedSize, std::memory_order_relaxed);
+    if (offset + size > sliceBegin + sliceSize) {
+        throw std::runtime_error("uniform ring slice overflow");
+    }
+    dynamicOffset = static_cast<uint32_t>(offset);
+    return mapped + offset;
+}
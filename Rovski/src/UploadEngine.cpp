@@ -0,0 +1,419 @@
+//
+//  UploadEngine.cpp
+//  Rovski
+//
+
+#include "UploadEngine.hpp"
+#include "CpuProfiler.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+
+bool UploadEngine::Init(VkDevice device, VkQueue transferQueue, uint32_t transferFamily, VkQueue graphicsQueue, uint32_t graphicsFamily,
+                        VkBuffer stagingBuffer, void *stagingMapped, uint64_t stagingSize) {
+    this->device = device;
+    this->transferQueue = transferQueue;
+    this->transferFamily = transferFamily;
+    this->graphicsQueue = graphicsQueue;
+    this->graphicsFamily = graphicsFamily;
+    staging.Init(stagingBuffer, stagingMapped, stagingSize);
+
+    VkCommandPoolCreateInfo poolCreateInfo{};
+    poolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolCreateInfo.queueFamilyIndex = transferFamily;
+    if (vkCreateCommandPool(device, &poolCreateInfo, nullptr, &transferPool) != VK_SUCCESS) {
+        return false;
+    }
+    poolCreateInfo.queueFamilyIndex = graphicsFamily;
+    if (vkCreateCommandPool(device, &poolCreateInfo, nullptr, &graphicsPool) != VK_SUCCESS) {
+        return false;
+    }
+
+    VkSemaphoreTypeCreateInfo typeCreateInfo{};
+    typeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeCreateInfo.initialValue = 0;
+    VkSemaphoreCreateInfo semaphoreCreateInfo{};
+    semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreCreateInfo.pNext = &typeCreateInfo;
+    return vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &timelineSemaphore) == VK_SUCCESS;
+}
+
+void UploadEngine::Destroy() {
+    Flush();
+    Wait(submittedValue);
+    Collect();
+    vkDestroySemaphore(device, timelineSemaphore, nullptr);
+    vkDestroyCommandPool(device, transferPool, nullptr);
+    vkDestroyCommandPool(device, graphicsPool, nullptr);
+}
+
+VkCommandBuffer UploadEngine::BeginCommands(VkCommandPool pool) {
+    VkCommandBufferAllocateInfo allocateInfo{};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocateInfo.commandBufferCount = 1;
+    allocateInfo.commandPool = pool;
+    allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    VkCommandBuffer commandBuffer;
+    vkAllocateCommandBuffers(device, &allocateInfo, &commandBuffer);
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    return commandBuffer;
+}
+
+VkCommandBuffer UploadEngine::TransferCommands() {
+    if (recording.transferCommands == VK_NULL_HANDLE) {
+        recording.transferCommands = BeginCommands(transferPool);
+    }
+    return recording.transferCommands;
+}
+
+VkCommandBuffer UploadEngine::GraphicsCommands() {
+    if (recording.graphicsCommands == VK_NULL_HANDLE) {
+        recording.graphicsCommands = BeginCommands(graphicsPool);
+    }
+    return recording.graphicsCommands;
+}
+
+void UploadEngine::LayoutUsage(VkImageLayout layout, VkPipelineStageFlags &stage, VkAccessFlags &access) {
+    switch (layout) {
+        case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+            stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            access = VK_ACCESS_TRANSFER_WRITE_BIT;
+            break;
+        case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+            stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            access = VK_ACCESS_TRANSFER_READ_BIT;
+            break;
+        case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+            stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+            access = VK_ACCESS_SHADER_READ_BIT;
+            break;
+        default:
+            stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+            access = 0;
+            break;
+    }
+}
+
+bool UploadEngine::AcquireStaging(uint64_t size, uint64_t alignment, uint64_t &offset) {
+    if (size > staging.Capacity()) {
+        std::cout << "staging chunk larger than the staging ring" << std::endl;
+        return false;
+    }
+    while (!staging.Allocate(size, alignment, offset)) {
+        ROVSKI_CPU_SCOPE("wait staging ring");
+        // the ring is full of data the GPU hasn't consumed yet, push our part and reclaim the oldest batch
+        Flush();
+        if (inFlight.empty()) {
+            std::cout << "staging ring exhausted" << std::endl;
+            return false;
+        }
+        Wait(inFlight.front().value);
+        Collect();
+    }
+    recording.stagingEnd = staging.Head();
+    return true;
+}
+
+void UploadEngine::ReleaseBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+    if (!NeedOwnershipTransfer()) {
+        // same family: the timeline wait of the consumer already makes the write visible
+        return;
+    }
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = transferFamily;
+    barrier.dstQueueFamilyIndex = graphicsFamily;
+    barrier.buffer = buffer;
+    barrier.offset = offset;
+    barrier.size = size;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(TransferCommands(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                         0, 0, nullptr, 1, &barrier, 0, nullptr);
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = dstAccess;
+    vkCmdPipelineBarrier(GraphicsCommands(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage,
+                         0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void UploadEngine::CopyBuffer(VkBuffer src, VkBuffer dst, const VkBufferCopy &region, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+    vkCmdCopyBuffer(TransferCommands(), src, dst, 1, &region);
+    ReleaseBuffer(dst, region.dstOffset, region.size, dstStage, dstAccess);
+}
+
+bool UploadEngine::UploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void *data, VkDeviceSize size, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+    ROVSKI_CPU_FUNCTION();
+    // chunks stay well under the ring size, so a chunk never waits on the batch that holds its predecessor
+    const uint64_t maxChunk = staging.Capacity() / 4;
+    const char *source = static_cast<const char*>(data);
+    for (VkDeviceSize done = 0; done < size;) {
+        uint64_t chunk = std::min<uint64_t>(size - done, maxChunk);
+        uint64_t offset;
+        if (!AcquireStaging(chunk, 16, offset)) {
+            return false;
+        }
+        memcpy(staging.Mapped(offset), source + done, chunk);
+        VkBufferCopy region{};
+        region.srcOffset = offset;
+        region.dstOffset = dstOffset + done;
+        region.size = chunk;
+        vkCmdCopyBuffer(TransferCommands(), staging.Buffer(), dst, 1, &region);
+        done += chunk;
+    }
+    // earlier chunks may sit in earlier submits of the same queue, one release after the last covers them all
+    ReleaseBuffer(dst, dstOffset, size, dstStage, dstAccess);
+    return true;
+}
+
+bool UploadEngine::UploadImage(VkImage dst, const VkImageSubresourceLayers &subresource, VkExtent3D extent, const void *data, uint32_t blockSize,
+                               uint32_t blockDim) {
+    ROVSKI_CPU_FUNCTION();
+    const uint64_t maxChunk = staging.Capacity() / 4;
+    const uint32_t blockRows = (extent.height + blockDim - 1) / blockDim;
+    const uint64_t rowPitch = uint64_t((extent.width + blockDim - 1) / blockDim) * blockSize;
+    const uint64_t alignment = std::lcm<uint64_t>(16, blockSize);
+    if (rowPitch > maxChunk) {
+        std::cout << "image row does not fit the staging ring" << std::endl;
+        return false;
+    }
+    const uint32_t rowsPerChunk = static_cast<uint32_t>(maxChunk / rowPitch);
+    const char *source = static_cast<const char*>(data);
+    for (uint32_t z = 0; z < extent.depth; z++) {
+        for (uint32_t row = 0; row < blockRows;) {
+            uint32_t rows = std::min(blockRows - row, rowsPerChunk);
+            uint64_t offset;
+            if (!AcquireStaging(rowPitch * rows, alignment, offset)) {
+                return false;
+            }
+            memcpy(staging.Mapped(offset), source + (uint64_t(z) * blockRows + row) * rowPitch, rowPitch * rows);
+            // copies are in texels, a partial block at the bottom edge ends at the image edge
+            uint32_t y = row * blockDim;
+            VkBufferImageCopy region{};
+            region.bufferOffset = offset;
+            region.bufferRowLength = 0;
+            region.bufferImageHeight = 0;
+            region.imageSubresource = subresource;
+            region.imageOffset = {0, static_cast<int32_t>(y), static_cast<int32_t>(z)};
+            region.imageExtent = {extent.width, std::min(rows * blockDim, extent.height - y), 1};
+            vkCmdCopyBufferToImage(TransferCommands(), staging.Buffer(), dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+            row += rows;
+        }
+    }
+    return true;
+}
+
+void UploadEngine::CopyBufferToImage(VkBuffer src, VkImage dst, const VkBufferImageCopy &region) {
+    vkCmdCopyBufferToImage(TransferCommands(), src, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+}
+
+void UploadEngine::TransitionImageLayout(VkImage image, const VkImageSubresourceRange &range, VkImageLayout oldLayout, VkImageLayout newLayout) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = range;
+
+    VkPipelineStageFlags srcStage, dstStage;
+    LayoutUsage(oldLayout, srcStage, barrier.srcAccessMask);
+    LayoutUsage(newLayout, dstStage, barrier.dstAccessMask);
+    if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED) {
+        barrier.srcAccessMask = 0;
+    }
+
+    bool leavesTransfer = newLayout != VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    if (!leavesTransfer || !NeedOwnershipTransfer()) {
+        vkCmdPipelineBarrier(TransferCommands(), srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        return;
+    }
+    // release on the transfer queue and acquire on the graphics queue, both carry the same layout change
+    barrier.srcQueueFamilyIndex = transferFamily;
+    barrier.dstQueueFamilyIndex = graphicsFamily;
+    VkAccessFlags dstAccess = barrier.dstAccessMask;
+    barrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(TransferCommands(), srcStage, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = dstAccess;
+    vkCmdPipelineBarrier(GraphicsCommands(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void UploadEngine::GenerateMipmaps(VkImage image, VkExtent2D extent, uint32_t levelCount, VkImageLayout finalLayout) {
+    ROVSKI_CPU_FUNCTION();
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = levelCount;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    if (NeedOwnershipTransfer()) {
+        // the whole chain moves to the graphics family, the copies into level 0 are made available by the release
+        barrier.srcQueueFamilyIndex = transferFamily;
+        barrier.dstQueueFamilyIndex = graphicsFamily;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        vkCmdPipelineBarrier(TransferCommands(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &barrier);
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(GraphicsCommands(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &barrier);
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    }
+
+    VkPipelineStageFlags finalStage;
+    VkAccessFlags finalAccess;
+    LayoutUsage(finalLayout, finalStage, finalAccess);
+    VkCommandBuffer commands = GraphicsCommands();
+    barrier.subresourceRange.levelCount = 1;
+    int32_t width = static_cast<int32_t>(extent.width);
+    int32_t height = static_cast<int32_t>(extent.height);
+    for (uint32_t level = 1; level < levelCount; level++) {
+        // the previous level was written by the upload or the last blit, read it as the source
+        barrier.subresourceRange.baseMipLevel = level - 1;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(commands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        int32_t nextWidth = std::max(1, width / 2);
+        int32_t nextHeight = std::max(1, height / 2);
+        VkImageBlit blit{};
+        blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1};
+        blit.srcOffsets[1] = {width, height, 1};
+        blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+        blit.dstOffsets[1] = {nextWidth, nextHeight, 1};
+        vkCmdBlitImage(commands, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       1, &blit, VK_FILTER_LINEAR);
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.newLayout = finalLayout;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = finalAccess;
+        vkCmdPipelineBarrier(commands, VK_PIPELINE_STAGE_TRANSFER_BIT, finalStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        width = nextWidth;
+        height = nextHeight;
+    }
+    // the smallest level was only ever written
+    barrier.subresourceRange.baseMipLevel = levelCount - 1;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = finalLayout;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = finalAccess;
+    vkCmdPipelineBarrier(commands, VK_PIPELINE_STAGE_TRANSFER_BIT, finalStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void UploadEngine::DeferRelease(std::function<void()> release) {
+    recording.releases.push_back(std::move(release));
+}
+
+uint64_t UploadEngine::Flush() {
+    ROVSKI_CPU_FUNCTION();
+    if (recording.transferCommands == VK_NULL_HANDLE && recording.graphicsCommands == VK_NULL_HANDLE) {
+        if (!recording.releases.empty()) {
+            // nothing recorded, the releases only have to wait for what is already queued
+            recording.value = submittedValue;
+            inFlight.push_back(std::move(recording));
+            recording = Batch{};
+        }
+        return submittedValue;
+    }
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &timelineSemaphore;
+    timelineInfo.signalSemaphoreValueCount = 1;
+
+    uint64_t transferValue = submittedValue;
+    if (recording.transferCommands != VK_NULL_HANDLE) {
+        vkEndCommandBuffer(recording.transferCommands);
+        transferValue = submittedValue + 1;
+        submitInfo.pCommandBuffers = &recording.transferCommands;
+        timelineInfo.pSignalSemaphoreValues = &transferValue;
+        if (vkQueueSubmit(transferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+            std::cout << "failed to submit upload batch" << std::endl;
+        }
+        submittedValue = transferValue;
+    }
+    if (recording.graphicsCommands != VK_NULL_HANDLE) {
+        vkEndCommandBuffer(recording.graphicsCommands);
+        uint64_t graphicsValue = submittedValue + 1;
+        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        submitInfo.pCommandBuffers = &recording.graphicsCommands;
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = &timelineSemaphore;
+        submitInfo.pWaitDstStageMask = &waitStage;
+        timelineInfo.waitSemaphoreValueCount = 1;
+        timelineInfo.pWaitSemaphoreValues = &transferValue;
+        timelineInfo.pSignalSemaphoreValues = &graphicsValue;
+        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+            std::cout << "failed to submit upload acquire" << std::endl;
+        }
+        submittedValue = graphicsValue;
+    }
+    recording.value = submittedValue;
+    inFlight.push_back(std::move(recording));
+    recording = Batch{};
+    return submittedValue;
+}
+
+void UploadEngine::Wait(uint64_t value) {
+    if (value == 0 || CompletedValue() >= value) {
+        return;
+    }
+    ROVSKI_CPU_SCOPE("wait upload");
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &timelineSemaphore;
+    waitInfo.pValues = &value;
+    vkWaitSemaphores(device, &waitInfo, UINT64_MAX);
+}
+
+uint64_t UploadEngine::CompletedValue() const {
+    uint64_t value = 0;
+    vkGetSemaphoreCounterValue(device, timelineSemaphore, &value);
+    return value;
+}
+
+void UploadEngine::Collect() {
+    if (inFlight.empty()) {
+        return;
+    }
+    uint64_t completed = CompletedValue();
+    while (!inFlight.empty() && inFlight.front().value <= completed) {
+        Batch &batch = inFlight.front();
+        if (batch.transferCommands != VK_NULL_HANDLE) {
+            vkFreeCommandBuffers(device, transferPool, 1, &batch.transferCommands);
+        }
+        if (batch.graphicsCommands != VK_NULL_HANDLE) {
+            vkFreeCommandBuffers(device, graphicsPool, 1, &batch.graphicsCommands);
+        }
+        staging.Release(batch.stagingEnd);
+        for (auto &release : batch.releases) {
+            release();
+        }
+        inFlight.pop_front();
+    }
+}
@@ -1,17 +1,104 @@
 #include "Rovski.hpp"
+#include "CpuProfiler.hpp"
+#include <glm/gtc/matrix_transform.hpp>
 #include <stdexcept>
 #include <iostream>
 #include <cstdlib>
+#include <string>
+#include <vector>
+#include <algorithm>
 
-int main() {
+int main(int argc, char **argv) {
+    // Rovski [--trace <file.json>] --headless <frames> [outputDir] renders offscreen and writes every frame as PPM,
+    // --trace dumps the CPU zones of the whole run in Chrome trace_event format (chrome://tracing, Perfetto)
+    // --mesh <file.obj|.gltf|.glb> draws that mesh, scaled into the unit cube, instead of the demo quads
+    // --texture-quality fast|normal|high sets the BC encoder effort for textures without an up to date .ktx2 cache
+    // --depth-prepass lays down depth before shading so every pixel is shaded once
+    // --no-frustum-culling records every draw, visible or not
+    // --gpu-driven culls in a compute pass and draws with vkCmdDrawIndexedIndirectCount
+    // --occlusion-culling adds two phase culling against a depth pyramid to --gpu-driven
+    // --bindless binds one descriptor table per frame and indexes textures per draw instead of a set per texture
+    // --texture <file> replaces the default texture; headless runs wait for it to stream in so every frame shows it
+    std::string tracePath;
+    std::string meshPath;
+    std::string texturePath;
+    bool depthPrepass = false;
+    bool frustumCulling = true;
+    bool gpuDriven = false;
+    bool occlusionCulling = false;
+    bool bindless = false;
+    EncodeQuality textureQuality = EncodeQuality::Normal;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--trace" && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (std::string(argv[i]) == "--mesh" && i + 1 < argc) {
+            meshPath = argv[++i];
+        } else if (std::string(argv[i]) == "--depth-prepass") {
+            depthPrepass = true;
+        } else if (std::string(argv[i]) == "--no-frustum-culling") {
+            frustumCulling = false;
+        } else if (std::string(argv[i]) == "--gpu-driven") {
+            gpuDriven = true;
+        } else if (std::string(argv[i]) == "--occlusion-culling") {
+            occlusionCulling = true;
+        } else if (std::string(argv[i]) == "--bindless") {
+            bindless = true;
+        } else if (std::string(argv[i]) == "--texture" && i + 1 < argc) {
+            texturePath = argv[++i];
+        } else if (std::string(argv[i]) == "--texture-quality" && i + 1 < argc) {
+            std::string quality = argv[++i];
+            textureQuality = quality == "fast" ? EncodeQuality::Fast : quality == "high" ? EncodeQuality::High : EncodeQuality::Normal;
+        } else {
+            args.emplace_back(argv[i]);
+        }
+    }
+    bool headless = !args.empty() && args[0] == "--headless";
     Rovski rovski;
+    rovski.SetTextureQuality(textureQuality);
+    rovski.SetDepthPrepass(depthPrepass);
+    rovski.SetFrustumCulling(frustumCulling);
+    rovski.SetGpuDriven(gpuDriven);
+    rovski.SetOcclusionCulling(occlusionCulling);
+    rovski.SetBindless(bindless);
+    if (!texturePath.empty()) {
+        rovski.SetDefaultTexture(texturePath);
+    }
+    if (headless) {
+        rovski.SetHeadless(true);
+        rovski.SetReadbackDirectory(args.size() > 2 ? args[2] : ".");
+    }
     rovski.Init(800, 600);
     try{
-        rovski.Run();
+        if (!meshPath.empty()) {
+            MeshRange mesh;
+            MeshBounds bounds;
+            if (!rovski.LoadMesh(meshPath, mesh, &bounds)) {
+                throw std::runtime_error("failed to load mesh " + meshPath);
+            }
+            glm::vec3 extent = bounds.max - bounds.min;
+            float scale = 1.0f / std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f));
+            DrawCommand draw{};
+            draw.model = glm::translate(glm::scale(glm::mat4(1), glm::vec3(scale)), -(bounds.min + bounds.max) * 0.5f);
+            draw.indexCount = mesh.indexCount;
+            draw.firstIndex = mesh.firstIndex;
+            draw.vertexOffset = mesh.vertexOffset;
+            draw.bounds = bounds;
+            rovski.SetDrawList({draw});
+        }
+        if (headless) {
+            rovski.FinishTextureStreaming();
+            rovski.RunFrames(args.size() > 1 ? static_cast<uint32_t>(std::stoul(args[1])) : 1);
+        } else {
+            rovski.Run();
+        }
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
         return EXIT_FAILURE;
     }
     rovski.Clean();
+    if (!tracePath.empty() && !CpuProfiler::Instance().ExportChromeTrace(tracePath)) {
+        std::cerr << "failed to write trace " << tracePath << std::endl;
+    }
     return EXIT_SUCCESS;
 }
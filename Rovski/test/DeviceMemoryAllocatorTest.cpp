@@ -0,0 +1,107 @@
+//
+//  DeviceMemoryAllocatorTest.cpp
+//  Rovski
+//
+//  Requests of about a whole block against a real device, each followed by a
+//  small buffer that must not land inside it. Exits with 77 (skipped) when no
+//  Vulkan device is available.
+//
+
+#include "DeviceMemoryAllocator.hpp"
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+
+static constexpr int SkipCode = 77;
+static constexpr VkDeviceSize BlockSize = 1ull << 20;
+
+static bool Overlap(const MemoryAllocation &a, const MemoryAllocation &b) {
+    return a.memory == b.memory && a.offset < b.offset + b.size && b.offset < a.offset + a.size;
+}
+
+static bool CheckPair(DeviceMemoryAllocator &allocator, uint32_t memoryType, VkDeviceSize size, VkDeviceSize alignment) {
+    VkMemoryRequirements large{size, alignment, 1u << memoryType};
+    VkMemoryRequirements small{4096, 256, 1u << memoryType};
+    MemoryAllocation first, second;
+    if (!allocator.Allocate(large, memoryType, DeviceMemoryAllocator::ResourceKind::Buffer, first)
+        || !allocator.Allocate(small, memoryType, DeviceMemoryAllocator::ResourceKind::Buffer, second)) {
+        std::cout << "failed to allocate " << size << " bytes aligned to " << alignment << std::endl;
+        return false;
+    }
+    bool ok = first.size == size && first.offset % alignment == 0 && !Overlap(first, second);
+    if (!ok) {
+        std::cout << size << " bytes aligned to " << alignment << " got [" << first.offset << ", "
+                  << first.offset + first.size << "), the next buffer got [" << second.offset << ", "
+                  << second.offset + second.size << ")" << std::endl;
+    }
+    allocator.Free(second);
+    allocator.Free(first);
+    return ok;
+}
+
+int main() {
+    VkApplicationInfo appInfo{};
+    appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    appInfo.pApplicationName = "DeviceMemoryAllocatorTest";
+    appInfo.apiVersion = VK_API_VERSION_1_0;
+    VkInstanceCreateInfo instanceInfo{};
+    instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    instanceInfo.pApplicationInfo = &appInfo;
+    VkInstance instance;
+    if (vkCreateInstance(&instanceInfo, nullptr, &instance) != VK_SUCCESS) {
+        std::cout << "no Vulkan instance, skipped" << std::endl;
+        return SkipCode;
+    }
+    uint32_t physicalDeviceCount = 0;
+    vkEnumeratePhysicalDevices(instance, &physicalDeviceCount, nullptr);
+    if (physicalDeviceCount == 0) {
+        std::cout << "no Vulkan device, skipped" << std::endl;
+        vkDestroyInstance(instance, nullptr);
+        return SkipCode;
+    }
+    std::vector<VkPhysicalDevice> physicalDevices(physicalDeviceCount);
+    vkEnumeratePhysicalDevices(instance, &physicalDeviceCount, physicalDevices.data());
+    VkPhysicalDevice physicalDevice = physicalDevices[0];
+
+    float priority = 1.0f;
+    VkDeviceQueueCreateInfo queueInfo{};
+    queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queueInfo.queueFamilyIndex = 0;
+    queueInfo.queueCount = 1;
+    queueInfo.pQueuePriorities = &priority;
+    VkDeviceCreateInfo deviceInfo{};
+    deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    deviceInfo.queueCreateInfoCount = 1;
+    deviceInfo.pQueueCreateInfos = &queueInfo;
+    VkDevice device;
+    if (vkCreateDevice(physicalDevice, &deviceInfo, nullptr, &device) != VK_SUCCESS) {
+        std::cout << "failed to create logical device" << std::endl;
+        vkDestroyInstance(instance, nullptr);
+        return EXIT_FAILURE;
+    }
+
+    // a heap of at least 8 blocks keeps the block size at BlockSize
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    uint32_t memoryType = UINT32_MAX;
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount && memoryType == UINT32_MAX; i++) {
+        if (memoryProperties.memoryHeaps[memoryProperties.memoryTypes[i].heapIndex].size >= BlockSize * 8) {
+            memoryType = i;
+        }
+    }
+
+    DeviceMemoryAllocator allocator;
+    allocator.Init(physicalDevice, device, BlockSize);
+    bool ok = memoryType != UINT32_MAX;
+    if (ok) {
+        ok &= CheckPair(allocator, memoryType, BlockSize, 256);
+        ok &= CheckPair(allocator, memoryType, BlockSize - 256, 4096);
+        ok &= CheckPair(allocator, memoryType, BlockSize / 2 + 4096, 65536);
+    } else {
+        std::cout << "no memory heap of " << BlockSize * 8 << " bytes" << std::endl;
+    }
+    allocator.Destroy();
+    vkDestroyDevice(device, nullptr);
+    vkDestroyInstance(instance, nullptr);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}